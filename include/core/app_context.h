@@ -3,6 +3,8 @@
 
 #include "config.h"
 #include "fingerprint_set.h"
+#include "fp_store.h"
+#include "path_arena.h"
 
 /* record_path 批量缓冲 */
 #define RECORD_BATCH_COUNT 4096
@@ -10,11 +12,13 @@
 
 typedef struct {
     char *paths[RECORD_BATCH_COUNT];
+    PathArena *arenas[RECORD_BATCH_COUNT];  /* 非 NULL 时 paths[i] 位于该共享缓冲内（持有一个引用） */
     struct stat stats[RECORD_BATCH_COUNT];
     int count;
     size_t total_bytes;
 } RecordBatch;
 #include "reference_map.h"
+#include "dir_index.h"
 #include "worker_proc.h"
 #include "msg_queue.h"
 #include "ipc_thread.h"
@@ -40,9 +44,11 @@ typedef struct AppContext {
     RuntimeState  state;
 
     /* === 去重与参考索引(仅主进程访问) === */
-    FingerprintSet *visited_set;      /* 本次任务防环 */
-    FingerprintSet *reference_set;    /* 半增量:历史存在性(可能 NULL) */
-    ReferenceMap   *reference_map;    /* 半增量:fingerprint -> (mtime, d_type) */
+    FpStore        *visited_set;      /* 本次任务防环（--max-dedup-memory 时分层下刷到磁盘） */
+    bool            visited_history;  /* visited_set 已载入历史进度（含文件指纹），不入集合的条目仍需查询 */
+    FingerprintSet *pruned_dirs;      /* 被拒绝的本地下探目录（fp_set_insert_path），其子树条目直接丢弃；按需创建 */
+    ReferenceMap   *reference_map;    /* 半增量:fingerprint -> (mtime, d_type)，同时判断历史存在性 */
+    DirIndex       *dir_index;        /* 半增量:上次任务的目录清单（目录级 blind-trust），NULL 表示不可用 */
 
     /* === 进程管理 === */
     WorkerPool     *worker_pool;
@@ -57,8 +63,8 @@ typedef struct AppContext {
     /* === 事件循环 === */
     int             epfd;
     bool            running;
-    int             next_requeue_worker;
     int             next_dispatch_worker;   // [新增] 轮询分发 Worker 索引
+    int             next_steal_worker;      // [新增] 轮询窃取 Worker 索引
 
     LostTasksQueue  lost_tasks;
     
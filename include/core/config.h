@@ -11,6 +11,7 @@
 
 struct AsyncWorker;
 struct DeviceManager;
+struct OutputShard;
 
 // =======================================================
 // 全局常量与宏
@@ -29,6 +30,10 @@ struct DeviceManager;
 #define DEFAULT_OUTPUT_SLICE_LINES 100000
 #define PROGRESS_SLICE_FORMAT "%06lu"
 #define OUTPUT_SLICE_FORMAT "%06lu.txt"
+#define OUTPUT_SHARD_FORMAT "w%d_%06lu.txt"   // --output-shards：w<输出线程号>_<切片号>.txt
+#define OUTPUT_MANIFEST_FILE "manifest.tsv"
+#define OUTPUT_GZIP_SUFFIX ".gz"             // --output-compress=gzip 时切片文件名追加的后缀
+#define DEFAULT_GZIP_LEVEL 6
 #define VERBOSE_TYPE_FULL 0
 #define VERBOSE_TYPE_VERSIONED 1
 #define DEFAULT_VERBOSE_LEVEL 0
@@ -54,6 +59,20 @@ struct DeviceManager;
 #define DEFAULT_BATCH_SIZE 1024
 #define DEFAULT_ESTIMATED_FILES 10000000
 #define DEFAULT_MASTER_THREADS 4
+#define DEFAULT_DIRENT_BUFFER (1024 * 1024)  // getdents64 缓冲区 1MB
+#define MAX_DIRENT_BUFFER (64 * 1024 * 1024)
+#define MAX_URING_DEPTH 4096
+#define DEFAULT_WORKER_CREDITS 4             // 每个 Worker 的在途目录任务窗口
+#define MAX_WORKER_CREDITS 256
+#define DEFAULT_LOCAL_DEPTH 8                // Worker 本地子树下探深度，0 表示关闭
+#define DEFAULT_LOCAL_ENTRIES 65536          // 单个下发任务在 Worker 本地累计扫描的条目预算
+#define DEFAULT_SCANNER_THREADS 1            // 每个 Worker 进程的 Scanner 线程数
+#define MAX_SCANNER_THREADS 64
+#define DEFAULT_SHM_RING (8 * 1024 * 1024)   // 每个 Worker 的 W→M 共享内存数据环 8MB，0 表示走 fd_data 管道
+#define MAX_SHM_RING (1024UL * 1024 * 1024)
+#define MIN_MAX_DEDUP_MEMORY (64UL * 1024 * 1024)  // --max-dedup-memory 下限，过小时热表频繁冻结、run 过碎
+#define DEFAULT_WRITER_THREADS 1             // 输出格式化线程数，1 表示单线程渲染并写出
+#define MAX_WRITER_THREADS 64
 
 /* Pbin / fpbin Footer 常量 */
 #define PBIN_FOOTER_MAGIC   0xDEADBEEF66AAC0FFULL
@@ -74,6 +93,14 @@ typedef enum {
     FMT_XATTR
 } FormatType;
 
+/* visited_set 去重策略（--dedup） */
+typedef enum {
+    DEDUP_AUTO = 0,     /* 解析参数后确定：--follow-symlinks 时为 FULL，否则为 DIRS */
+    DEDUP_DIRS,         /* 仅目录入集合 */
+    DEDUP_LINKS,        /* 目录 + st_nlink > 1 的非目录（按 dev+ino 去重） */
+    DEDUP_FULL          /* 全部条目入集合 */
+} DedupPolicy;
+
 typedef enum {
     DEV_STATUS_UNKNOWN = 0,
     DEV_STATUS_SUPPORTED,
@@ -194,6 +221,21 @@ typedef struct {
     unsigned long estimated_files; // 预估文件数，用于预分配 HashSet
     int master_threads;         // Master 去重线程数，默认 4
     int worker_count;           // [新增] Worker 进程数，0 表示自动（默认上限 8）
+    size_t dirent_buffer;       // [新增] getdents64 缓冲区字节数，0 表示使用 readdir
+    bool statx_dont_sync;       // [新增] --statx-dont-sync：允许直接使用网络文件系统缓存的属性
+    int uring_depth;            // [新增] io_uring 批量 statx 队列深度，0 表示同步 statx
+    int worker_credits;         // [新增] 每个 Worker 允许的在途 SCAN 任务数（credit 窗口）
+    int local_depth;            // [新增] Worker 本地下探子目录的最大深度，0 表示全部交回 Master
+    long local_entries;         // [新增] 单个下发任务本地下探的条目预算，超出后子目录交回 Master
+    int scanner_threads;        // [新增] 每个 Worker 进程的 Scanner 线程数，共享 Worker 本地任务队列
+    size_t shm_ring;            // [新增] 每个 Worker 的 memfd 共享内存数据环字节数，0 表示 BATCH 走 fd_data 管道
+    bool fp_set_mutex;          // [新增] --fp-set=mutex：指纹集合使用分片互斥锁实现（默认无锁 CAS 实现）
+    DedupPolicy dedup_policy;   // [新增] --dedup：visited_set 收录哪些条目（默认随 --follow-symlinks 自动选择）
+    size_t max_dedup_memory;    // [新增] --max-dedup-memory：visited_set 内存预算，超出后下刷为磁盘有序 run，0 表示不限制
+    int writer_threads;         // [新增] --writer-threads：输出格式化线程数，>1 时由单独的写出线程合并
+    bool writer_unordered;      // [新增] --writer-order=unordered：格式化结果按完成顺序写出（默认按提交顺序）
+    bool output_sharded;        // [新增] --output-shards：-O 模式下每个输出线程写独立的切片序列，结束时生成清单
+    int output_compress;        // [新增] --output-compress=gzip[:level]：gzip 压缩级别 1..9，0 表示不压缩
 } Config;
 
 // 运行时状态
@@ -205,9 +247,12 @@ typedef struct {
     size_t uid_cache_count;
     GroupCacheEntry *gid_cache[GID_CACHE_SIZE];
     size_t gid_cache_count;
+    pthread_mutex_t name_cache_mutex;   // 串行化 uid/gid 缓存的插入（查询无锁，支持多个输出格式化线程）
     unsigned long write_slice_index, process_slice_index;
     FILE *write_slice_file, *output_fp, *dir_info_fp;
     unsigned long output_line_count, output_slice_num;
+    struct OutputShard *shards;         // --output-shards：每个输出线程一个分片写出端，NULL 表示未启用
+    int shard_count;
     time_t start_time;
     unsigned long completed_count;
     const char *current_path;
@@ -221,6 +266,10 @@ typedef struct {
     struct DeviceManager *dev_mgr;
     // [新增] 全局错误标志
     volatile bool has_error;
+    // [新增] 本次任务的指纹快照写入端（{base}.fpsnap.tmp），finalize 时封口发布
+    struct ReferenceMap *snapshot;
+    // 本次任务的目录清单写入端（{base}.fpdir.tmp，O_APPEND，Worker 经 fork 继承），-1 表示不记录
+    int dirlist_fd;
 } RuntimeState;
 
 // 线程共享状态结构体
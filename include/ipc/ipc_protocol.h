@@ -13,19 +13,53 @@
 #define IPC_MSG_DEV_TIMEOUT 7  /* Scanner self-detected timeout */
 #define IPC_MSG_READY       8  /* Worker initialization complete */
 #define IPC_MSG_FINISH      9  /* Scanner task complete */
+#define IPC_MSG_STEAL      10  /* Master asks for locally queued subdirectories */
+#define IPC_MSG_STOLEN     11  /* Worker hands back subdirectories (reply to STEAL) */
+#define IPC_MSG_PRUNE      12  /* Master rejected a locally claimed directory: stop descending below it */
 
 typedef struct __attribute__((packed)) {
     uint32_t msg_type;
     uint32_t payload_len;
 } IpcMessageHeader;
 
-/* MSG_BATCH payload header, followed by count records:
- *   [uint32_t path_len][char path[path_len]][struct stat st]
+/* MSG_BATCH payload (v2, 目录前缀压缩):
+ *   IpcBatchHeader  [char dir[dir_len]]
+ *   count * ( [uint16_t name_len][char name[name_len]][IpcBatchStat][可选字段...] )
+ * 条目完整路径 = dir + "/" + name。可选字段按 fields 位依次出现：
+ *   IPC_BATCH_F_SIZE  uint64_t size
+ *   IPC_BATCH_F_UID   uint32_t uid
+ *   IPC_BATCH_F_GID   uint32_t gid
+ *   IPC_BATCH_F_ATIME int64_t  atime
+ *   IPC_BATCH_F_CTIME int64_t  ctime
+ *   IPC_BATCH_F_NLINK uint32_t nlink
+ * name_len 最高位为 IPC_BATCH_LOCAL：该目录已进入 Worker 本地下探队列，Master 不再分发
  */
+#define IPC_BATCH_VERSION   2
+#define IPC_BATCH_LOCAL     0x8000u
+#define IPC_BATCH_LEN_MASK  0x7fffu
+
+#define IPC_BATCH_F_SIZE    0x01u
+#define IPC_BATCH_F_UID     0x02u
+#define IPC_BATCH_F_GID     0x04u
+#define IPC_BATCH_F_ATIME   0x08u
+#define IPC_BATCH_F_CTIME   0x10u
+#define IPC_BATCH_F_NLINK   0x20u
+
 typedef struct __attribute__((packed)) {
+    uint16_t version;      /* IPC_BATCH_VERSION */
+    uint16_t fields;       /* IPC_BATCH_F_* 组合，整批一致（由输出格式与去重策略推导） */
     uint32_t count;
+    uint32_t dir_len;
 } IpcBatchHeader;
 
+/* 每条记录必带的属性：去重指纹（dev/ino）、目录判定（mode）与进度文件（mtime）所需 */
+typedef struct __attribute__((packed)) {
+    uint64_t dev;
+    uint64_t ino;
+    uint32_t mode;
+    int64_t  mtime;
+} IpcBatchStat;
+
 /* MSG_ERROR payload header, followed by path string */
 typedef struct __attribute__((packed)) {
     uint32_t errno_code;
@@ -44,6 +78,15 @@ typedef struct __attribute__((packed)) {
     /* char path[path_len] follows */
 } IpcFinishPayload;
 
+/* MSG_STEAL payload: uint32_t max_count
+ * MSG_STOLEN payload header, followed by count records:
+ *   [uint32_t path_len][uint64_t dev][char path[path_len]]
+ * MSG_PRUNE payload: char path[payload_len]（不含结尾 NUL）
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t count;
+} IpcStolenHeader;
+
 /* IPC 协议函数 */
 int ipc_send(int fd, uint32_t msg_type, const void *payload, uint32_t payload_len);
 int ipc_recv_header(int fd, IpcMessageHeader *hdr);
@@ -3,6 +3,7 @@
 
 #include "msg_queue.h"
 #include "worker_proc.h"
+#include "shm_ring.h"
 
 /* ================================================================
  * IPC Thread (v13.0.0)
@@ -22,6 +23,7 @@ typedef struct {
     int             fd_cmd;         /* Current Worker cmd read end (M→W) */
     int             fd_data;        /* Current Worker data read end (W→M BATCH) */
     int             fd_ctrl;        /* Current Worker ctrl read end (W→M signals) */
+    ShmRing        *ring;           /* Current Worker data ring (BATCH/FINISH/STOLEN), NULL = fd_data only */
     pid_t           pid;            /* Current Worker pid */
     _Atomic bool    waiting_replace;/* Set after DEAD, cleared after REPLACE */
     int             eagain_retry_count; /* EAGAIN retry counter (reset on REPLACE) */
@@ -61,8 +63,11 @@ void ipc_thread_stop(IpcThreadCtx *ctx);
 void worker_mark_dead(IpcThreadCtx *ctx, bool send_notify);
 void worker_timeout_kill(IpcThreadCtx *ctx);
 void send_return(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len);
+void send_return_shm(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len);
 void read_ctrl_message(IpcThreadCtx *ctx);
 void read_data_message(IpcThreadCtx *ctx);
+void read_ring_messages(IpcThreadCtx *ctx);
+void ipc_detach_ring(IpcThreadCtx *ctx);
 void handle_cmd(IpcThreadCtx *ctx, IpcThreadMsg *cmd);
 
 #endif
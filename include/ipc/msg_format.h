@@ -6,6 +6,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+struct ShmRing;
+
 /* ================================================================
  * v13.0.0 IPC Thread Isolation Architecture
  * Message format for Master Thread <-> IPC Thread communication
@@ -15,6 +17,8 @@
 #define CMD_SCAN       1   /* Send SCAN task to Worker */
 #define CMD_REPLACE    2   /* Replace Worker with new fd/pid */
 #define CMD_STOP       3   /* Stop IPC thread */
+#define CMD_STEAL      4   /* Ask Worker to hand back locally queued subdirectories */
+#define CMD_PRUNE      5   /* Tell Worker to stop local descent below a rejected directory */
 
 /* Return types: IPC Thread -> Master Thread */
 #define RET_BATCH      10  /* Worker returned BATCH results */
@@ -26,18 +30,22 @@
 #define RET_DEV_TIMEOUT 16  /* Worker scanner self-detected timeout */
 #define RET_READY      17  /* Worker initialization complete */
 #define RET_FINISH     18  /* Worker task complete */
+#define RET_STOLEN     19  /* Worker handed back subdirectories (raw IpcStolenHeader payload, NULL = none) */
 
 /**
  * @brief  Unified message structure for Master <-> IPC Thread queues
  *
  * All messages are fixed-size (pointer-based) for lock-free queue compatibility.
- * The `data` pointer is malloc'd by sender and free'd by receiver.
+ * The `data` pointer is malloc'd by sender and free'd by receiver,
+ * unless `ring` is set: then `data` points into that shared-memory ring and is
+ * returned with msg_release_data() (shm_ring_release + unref) instead of free().
  */
 typedef struct {
     uint32_t type;      /* CMD_* or RET_* */
     int      slot_id;   /* Worker slot index [0, num_workers-1] */
-    void    *data;      /* Type-specific payload (malloc'd) */
+    void    *data;      /* Type-specific payload (malloc'd, or in-ring when ring != NULL) */
     size_t   data_len;  /* Payload length in bytes */
+    struct ShmRing *ring; /* Owning ring for in-place payloads (holds one reference), else NULL */
 } IpcThreadMsg;
 
 /* ================================================================
@@ -57,10 +65,11 @@ typedef struct {
     int    fd_data;     /* new Worker data read end (master reads BATCH) */
     int    fd_ctrl;     /* new Worker ctrl read end (master reads signals) */
     pid_t  pid;         /* new Worker process id */
+    struct ShmRing *ring; /* new Worker data ring (reference handed to IPC thread), NULL = fd_data only */
 } CmdReplacePayload;
 
 /* RET_BATCH payload: raw IPC batch data (same as current IPC_MSG_BATCH payload) */
-/* Reuses existing IpcBatchHeader + records format */
+/* Reuses existing IpcBatchHeader + records format (v2 prefix-compressed, see ipc_protocol.h) */
 
 /* RET_HEARTBEAT payload */
 typedef struct {
@@ -74,7 +83,19 @@ typedef struct {
     char     path[4096];
 } RetErrorPayload;
 
-/* RET_DEAD / RET_EXIT: no payload needed (data = NULL) */
+/* CMD_STEAL payload */
+typedef struct {
+    uint32_t max_count;
+} CmdStealPayload;
+
+/* CMD_PRUNE payload: malloc 的目录路径字符串（data_len = strlen，不含 NUL） */
+
+/* RET_DEAD payload: 死亡的 Worker 进程号，主线程据此识别替换后迟到的重复通知 */
+typedef struct {
+    pid_t pid;
+} RetDeadPayload;
+
+/* RET_EXIT: no payload needed (data = NULL) */
 
 /* MSG_DROP payload */
 typedef struct {
@@ -58,4 +58,9 @@ bool msg_queue_recv_wait(MsgQueue *q, IpcThreadMsg *out, int timeout_ms);
  */
 void msg_queue_drain_eventfd(MsgQueue *q);
 
+/**
+ * @brief  Release a message payload: free() it, or hand it back to its shared-memory ring
+ */
+void msg_release_data(IpcThreadMsg *msg);
+
 #endif
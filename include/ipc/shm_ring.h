@@ -0,0 +1,63 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* ================================================================
+ * Worker → Master 数据通道：memfd 共享内存环 (单生产者 / 单读取者)
+ * Worker 直接把 BATCH / FINISH / STOLEN 序列化进环，Master 原地解析后归还空间。
+ * 通知走两个 eventfd（有数据 / 有空间），仅在对端声明等待时才写。
+ * 管道 fd_cmd / fd_ctrl 不变，D-state 隔离模型不受影响。
+ * ================================================================ */
+
+typedef struct ShmRing ShmRing;
+
+/* Master：创建容量为 capacity 字节的环（fork 前调用）。失败返回 NULL，调用方回退 fd_data 管道 */
+ShmRing *shm_ring_create(size_t capacity);
+
+/* Master：fork 之后关闭 memfd（映射与 eventfd 保留） */
+void shm_ring_close_memfd(ShmRing *r);
+
+/* Worker 子进程：重新映射 memfd（父进程映射为 MADV_DONTFORK，不会被继承）。失败返回 false */
+bool shm_ring_attach(ShmRing *r);
+
+/* Worker 子进程关闭继承 fd 时判断 fd 是否属于本环 */
+bool shm_ring_owns_fd(const ShmRing *r, int fd);
+
+/* 单条消息负载上限（保证任何记录都能在环回绕后放下） */
+uint32_t shm_ring_max_payload(const ShmRing *r);
+
+/* ---- Worker 侧（生产者，调用方负责串行化） ---- */
+
+/* 预留一条 msg_type 记录的 len 字节负载空间，环满时等待 Master 归还。
+ * stop 非 NULL 且变为 true 时放弃并返回 NULL；len 超过上限也返回 NULL */
+void *shm_ring_reserve(ShmRing *r, uint32_t msg_type, uint32_t len, const bool *stop);
+
+/* 发布最近一次 reserve 的记录并在 Master 等待时唤醒 */
+void shm_ring_commit(ShmRing *r);
+
+/* ---- Master 侧（IPC 线程读取，任意线程归还） ---- */
+
+/* 数据通知 eventfd（加入 IPC 线程 epoll） */
+int shm_ring_event_fd(const ShmRing *r);
+
+/* 进入 epoll_wait 前调用：声明等待，返回 true 表示环中已有未读记录（不应阻塞） */
+bool shm_ring_prepare_wait(ShmRing *r);
+
+/* epoll_wait 返回后调用：取消等待声明并清空 eventfd 计数 */
+void shm_ring_finish_wait(ShmRing *r);
+
+/* 读取下一条记录。返回 1 表示取得（payload 指向环内，须 shm_ring_release 归还），
+ * 0 表示暂无记录，-1 表示记录损坏（应视为 Worker 死亡） */
+int shm_ring_next(ShmRing *r, uint32_t *msg_type, void **payload, uint32_t *len);
+
+/* 归还 shm_ring_next 取得的记录。允许乱序归还：连续已归还的记录才释放空间 */
+void shm_ring_release(ShmRing *r, void *payload);
+
+/* 引用计数：IPC 线程持有一个，每条原地转发给主线程的消息持有一个 */
+void shm_ring_ref(ShmRing *r);
+void shm_ring_unref(ShmRing *r);
+
+#endif
@@ -10,6 +10,7 @@
 #include "reference_map.h"
 #include "ipc_protocol.h"
 #include "worker_scanner.h"
+#include "shm_ring.h"
 
 /* Worker 显式状态机 (v15.1.0) */
 #define WORKER_STATE_IDLE         0
@@ -17,6 +18,12 @@
 #define WORKER_STATE_DEAD         2
 #define WORKER_STATE_INITIALIZING 3
 
+/* Worker 本地下探认领的子目录：root 指向所属在途根任务（inflight_paths 中的字符串，仅比较地址） */
+typedef struct {
+    char       *path;
+    const char *root;
+} WorkerLocalClaim;
+
 typedef struct {
     int      slot_id;
     pid_t    pid;
@@ -24,6 +31,7 @@ typedef struct {
     int      fd_cmd_rd;        /* master read end of fd_cmd pipe (draining) */
     int      fd_data;          /* master read end (W→M BATCH data) */
     int      fd_ctrl;          /* master read end (W→M control signals) */
+    ShmRing *ring;             /* W→M 共享内存数据环，spawn 创建，经 CMD_REPLACE 移交 IPC 线程后置 NULL */
     _Atomic time_t last_heartbeat;
     _Atomic bool   is_alive;
     _Atomic int    state;      /* WORKER_STATE_IDLE / BUSY / DEAD (v15.1.0) */
@@ -32,6 +40,14 @@ typedef struct {
     char   **backlog_paths;
     int      backlog_count;
     int      backlog_capacity;
+    char   **inflight_paths;    /* 已下发、尚未 FINISH 的目录（credit 窗口，仅主线程修改） */
+    int      inflight_capacity;
+    _Atomic int inflight_count; /* 在途任务数，monitor 线程只读 */
+    WorkerLocalClaim *claims;   /* 已认领、所属根任务尚未 FINISH 的子目录（仅主线程修改），Worker 死亡时重新入队 */
+    int      claim_count;
+    int      claim_capacity;
+    bool     steal_pending;     /* 已发送 STEAL、尚未收到 STOLEN */
+    uint64_t steal_retry_ms;    /* STOLEN 为空后的退避截止时间（CLOCK_MONOTONIC 毫秒） */
     atomic_flag cleanup_done;   /* 防止 monitor 和 epoll 并发 cleanup 的竞态 */
 } WorkerSlot;
 
@@ -39,6 +55,7 @@ typedef struct {
     WorkerSlot *slots;
     int         num_workers;
     _Atomic int active_count;
+    size_t      ring_capacity; /* 每个 Worker 数据环容量（--shm-ring），0 表示 BATCH 走 fd_data 管道 */
 } WorkerPool;
 
 /* Master-side */
@@ -56,7 +73,7 @@ bool        worker_pool_replace(WorkerPool *pool, int slot_id);
 void        worker_pool_stop_all(WorkerPool *pool);
 
 /* Worker-side */
-void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id);
+void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id, ShmRing *ring);
 
 /* Forward declaration to break circular dependency with app_context.h */
 struct AppContext;
@@ -2,14 +2,22 @@
 #define ASYNC_WORKER_H
 
 #include "config.h"
+#include "output.h"
+#include "path_arena.h"
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define ASYNC_BATCH_SIZE 256
+#define ASYNC_CHUNK_TASKS 4096          /* --writer-threads > 1 时每个格式化块的目标记录数 */
+#define ASYNC_INFLIGHT_PER_THREAD 4     /* 每个格式化线程允许的在途块数（已领取未写出） */
 
 typedef struct OutputTask {
     char *path;
     struct stat st;
+    PathArena *arena;           /* 非 NULL 时 path 指向共享路径缓冲，释放时减引用；否则 path 为 strdup */
+    struct OutputTask *block;   /* 非 NULL 时节点属于批量分配的节点块 */
+    bool block_end;             /* 块内最后一个节点：处理完后整块释放 */
     struct OutputTask *next;
 } OutputTask;
 
@@ -17,23 +25,52 @@ typedef struct {
     OutputTask *head;
     OutputTask *tail;
     int count;
+    OutputTask *block;          /* 当前节点块（output_batch_append 按 ASYNC_BATCH_SIZE 分配） */
+    int block_used;
 } OutputBatch;
 
+/* 格式化线程渲染完成、等待写出线程写出的块 */
+typedef struct RenderedChunk {
+    uint64_t seq;               /* 领取顺序（即提交顺序） */
+    LineBuf buf;
+    unsigned long lines;
+    size_t *ends;               /* 分片目录模式：每行结束偏移，供写出线程在行边界轮转切片 */
+    struct RenderedChunk *next;
+} RenderedChunk;
+
 typedef struct AsyncWorker {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
-    pthread_t thread;
+    pthread_t thread;           /* 单线程模式：渲染并写出；--writer-threads > 1：写出线程 */
     OutputTask *head;
     OutputTask *tail;
     bool stop;
     const Config *cfg;
     RuntimeState *state;
+
+    /* --writer-threads > 1：格式化线程组 + 单个写出线程 */
+    int nformatters;
+    pthread_t *formatters;
+    uint64_t next_seq;          /* 受 mutex 保护：下一个领取块的序号 */
+    pthread_mutex_t done_mutex;
+    pthread_cond_t done_cond;   /* 有块完成，或格式化线程全部退出 */
+    pthread_cond_t space_cond;  /* 在途块数回落 */
+    RenderedChunk *done;        /* 受 done_mutex 保护：已渲染待写出的块 */
+    RenderedChunk *done_tail;
+    uint64_t written_seq;       /* ordered 模式下一个应写出的块序号 */
+    int inflight;               /* 已领取未写出的块数 */
+    int formatters_alive;
+    int next_shard;             /* --output-shards：格式化线程启动时原子认领的分片号 */
 } AsyncWorker;
 
 AsyncWorker* async_worker_init(const Config *cfg, RuntimeState *state);
 void async_worker_shutdown(AsyncWorker *worker);
 void async_writer_submit(AsyncWorker *worker, const char *path, const struct stat *st);
 
+/* 向批次追加一条记录：节点取自批量分配的节点块，path 位于 arena 内时只增加引用（arena 为 NULL 则复制 path）。
+ * 内存不足返回 false */
+bool output_batch_append(OutputBatch *batch, const char *path, const struct stat *st, PathArena *arena);
+
 /* 批量提交：将 OutputBatch 中所有任务一次性加入队列（仅一次 mutex lock） */
 void async_writer_submit_batch(AsyncWorker *worker, OutputBatch *batch);
 
@@ -9,9 +9,42 @@ void precompile_format(Config *cfg);
 // 清理预编译的格式
 void cleanup_compiled_format(Config *cfg);
 
-// [核心接口] 直接将文件信息格式化并输出到文件流
-// 替代旧的 format_output，避免中间缓冲区拷贝，支持 CSV 转义
-void print_to_stream(const Config *cfg, RuntimeState *state, const char *path, const struct stat *st, FILE *fp);
+// 根据预编译格式推导 Worker statx 字段掩码（去重/进度所需字段始终包含）
+unsigned int format_statx_mask(const Config *cfg);
+
+// 行渲染缓冲区：整批记录渲染为连续字节后一次 write()
+typedef struct {
+    char  *data;
+    size_t len;
+    size_t cap;
+} LineBuf;
+
+#define OUTPUT_RENDER_FLUSH (4 * 1024 * 1024)   // 渲染缓冲区达到该大小即写出
+
+void line_buf_init(LineBuf *lb, size_t cap);
+void line_buf_free(LineBuf *lb);
+
+// [核心接口] 按预编译格式将一条记录渲染为一行并追加到缓冲区（支持 CSV 转义）
+void render_line(const Config *cfg, RuntimeState *state, const char *path, const struct stat *st, LineBuf *lb);
+
+// 将缓冲区内容 write() 到输出流并清空；写入失败返回 false
+bool line_buf_flush(LineBuf *lb, FILE *fp);
+bool output_write_all(FILE *fp, const char *data, size_t len);
+
+// --output-compress=gzip：把渲染好的整行数据压缩为独立的 gzip member（线程私有，跨 member 复用）
+typedef struct {
+    z_stream zs;
+    bool ready;
+} GzipEncoder;
+
+bool gzip_encoder_init(GzipEncoder *enc, int level);
+bool gzip_encode_member(GzipEncoder *enc, const char *data, size_t len, LineBuf *out);
+void gzip_encoder_end(GzipEncoder *enc);
+
+// 输出切片文件名后缀：压缩时为 ".gz"，否则为空串
+static inline const char *output_slice_suffix(const Config *cfg) {
+    return cfg->output_compress ? OUTPUT_GZIP_SUFFIX : "";
+}
 
 // 初始化输出文件（包括普通输出和分片输出）
 void init_output_files(const Config *cfg, RuntimeState *state);
@@ -19,6 +52,22 @@ void init_output_files(const Config *cfg, RuntimeState *state);
 // 执行切片轮转
 void rotate_output_slice(const Config *cfg, RuntimeState *state);
 
+// --output-shards：单个输出线程独占的切片序列（<dir>/w<id>_<n>.txt），仅由所属线程访问
+typedef struct OutputShard {
+    int id;
+    FILE *fp;
+    unsigned long slice_num;        // 当前切片编号，0 表示尚未打开
+    unsigned long line_count;       // 当前切片已写行数
+    unsigned long first_slice;      // 本次任务的第一个切片编号（续传时跳过已存在的切片）
+    unsigned long *slice_lines;     // 本次任务各切片行数，下标 slice_num - first_slice
+    size_t slice_cap;
+} OutputShard;
+
+void rotate_output_shard(const Config *cfg, OutputShard *shard);
+void close_output_shard(OutputShard *shard);
+bool write_output_manifest(const Config *cfg, const RuntimeState *state);
+void free_output_shards(RuntimeState *state);
+
 void cleanup_cache(RuntimeState *state);
 void close_output_file(FILE *fp);
 void format_mode_str(mode_t mode, char *buf);
@@ -13,7 +13,8 @@ void record_skip(const Config *cfg, RuntimeState *state, const SpbinEntry *entry
 /* 批量缓冲 */
 void record_path_batch_init(RecordBatch *batch);
 void record_path_batch_flush(const Config *cfg, RuntimeState *state, RecordBatch *batch);
-bool record_path_batch_append(const Config *cfg, RuntimeState *state, RecordBatch *batch, const char *path, const struct stat *info);
+bool record_path_batch_append(const Config *cfg, RuntimeState *state, RecordBatch *batch, const char *path,
+                              const struct stat *info, PathArena *arena);
 
 /* 索引与游标 */
 void atomic_update_index(const Config *cfg, RuntimeState *state);
@@ -32,6 +33,8 @@ void fpbin_append(AppContext *ctx, const char *path, const struct stat *st);
 /* 配置与生命周期 */
 void save_config_to_disk(const Config* cfg);
 void finalize_progress(const Config *cfg, RuntimeState *state);
+void open_snapshot_writer(const Config *cfg, RuntimeState *state);
+void open_dirlist_writer(const Config *cfg, RuntimeState *state, bool resume);
 void cleanup_progress(const Config *cfg, RuntimeState *state);
 
 /* 锁 */
@@ -46,6 +49,8 @@ char *get_spbin_filename(const char *base);
 char *get_per_slice_index_filename(const char *base, unsigned long index);
 char *get_fpbin_slice_filename(const char *base, unsigned long index);
 char *get_fpbin_index_filename(const char *base);
+char *get_snapshot_filename(const char *base);
+char *get_dirlist_filename(const char *base);
 
 /* Footer 读写与校验 */
 bool write_pbin_footer(FILE *fp, uint64_t row_count);
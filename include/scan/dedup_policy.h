@@ -0,0 +1,32 @@
+#ifndef DEDUP_POLICY_H
+#define DEDUP_POLICY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include "config.h"
+#include "fingerprint_set.h"
+
+/* 条目在 visited_set 中的键 */
+typedef enum {
+    DEDUP_KEY_NONE = 0,     /* 不入集合 */
+    DEDUP_KEY_PATH,         /* fp_compute(path, dev, ino)：同一路径重复到达 */
+    DEDUP_KEY_INODE         /* fp_compute(NULL, dev, ino)：同一 inode 经不同路径（硬链接）到达 */
+} DedupKey;
+
+/* 把 DEDUP_AUTO 解析为具体策略 */
+DedupPolicy dedup_policy_resolve(DedupPolicy policy, bool follow_symlinks);
+
+/* 策略名（日志 / 帮助） */
+const char *dedup_policy_name(DedupPolicy policy);
+
+/* 按策略估算 visited_set 需要容纳的条目数（传给 fp_set_create） */
+size_t dedup_policy_set_size(DedupPolicy policy, unsigned long estimated_files);
+
+/* 条目 st 在该策略下的集合键 */
+DedupKey dedup_policy_key(DedupPolicy policy, const struct stat *st);
+
+/* 按键计算指纹。key 不能为 DEDUP_KEY_NONE */
+void dedup_policy_fingerprint(DedupKey key, const char *path, const struct stat *st, uint8_t out[FP_SIZE]);
+
+#endif
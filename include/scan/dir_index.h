@@ -0,0 +1,67 @@
+#ifndef DIR_INDEX_H
+#define DIR_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fingerprint_set.h"
+#include "reference_map.h"
+
+#define DIR_LIST_MAGIC 0x4C44524CU   /* "LRDL" */
+
+/*
+ * 目录清单记录（{base}.fpdir）：Worker 每读完一个目录追加一条，记录头 + 子条目区。
+ * 子条目：[u16 name_len][u8 d_type][u64 ino][i64 mtime][name]，逐字段 memcpy，无对齐要求；
+ * 子条目区末尾补零到 8 字节对齐，保证下一条记录头对齐。
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t count;             /* 子条目数 */
+    uint64_t bytes;             /* 子条目区字节数 */
+    uint8_t  fp[FP_SIZE];       /* 目录自身指纹 fp_compute(path, dev, ino) */
+    int64_t  mtime;             /* 读取前 lstat 得到的目录 mtime / ctime */
+    int64_t  ctime;
+} DirListHeader;
+
+/* 子条目视图（name 指向清单文件映射，不以 '\0' 结尾） */
+typedef struct {
+    const char *name;
+    uint16_t name_len;
+    uint8_t  d_type;
+    uint64_t ino;
+    int64_t  mtime;
+} DirListChild;
+
+/* 上次任务发布的目录清单：只读映射 + 目录指纹 → 记录偏移索引 */
+typedef struct DirIndex {
+    const uint8_t *base;
+    size_t size;
+    ReferenceMap *map;          /* 复用 ReferenceMap：mtime 字段存记录偏移 */
+    size_t dirs;
+} DirIndex;
+
+/* 清单构建器（Scanner 线程私有，跨目录复用缓冲区） */
+typedef struct {
+    uint8_t *buf;
+    size_t len, cap;
+    bool failed;
+} DirListBuilder;
+
+/* 读取端：打开并索引清单文件，文件不存在或为空时返回 NULL */
+DirIndex* dir_index_open(const char *path);
+void dir_index_destroy(DirIndex *index);
+
+/* 按目录指纹查找清单记录，未找到返回 NULL */
+const DirListHeader* dir_index_lookup(const DirIndex *index, const uint8_t fp[FP_SIZE]);
+
+/* 依次取出记录中的子条目；*pos 从 0 开始，返回 false 表示结束 */
+bool dir_list_next(const DirListHeader *hdr, size_t *pos, DirListChild *out);
+
+/* 写入端：begin → add* → write；write 以一次 write() 追加到 O_APPEND 的 fd */
+void dir_list_begin(DirListBuilder *b, const uint8_t fp[FP_SIZE], int64_t mtime, int64_t ctime);
+void dir_list_add(DirListBuilder *b, const char *name, size_t name_len, uint8_t d_type,
+                  uint64_t ino, int64_t mtime);
+bool dir_list_write(DirListBuilder *b, int fd);
+void dir_list_free(DirListBuilder *b);
+
+#endif
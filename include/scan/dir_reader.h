@@ -0,0 +1,39 @@
+#ifndef DIR_READER_H
+#define DIR_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <dirent.h>
+
+/* getdents64 缓冲区下限：至少容纳一条最长记录（NAME_MAX + 头部）；--dirent-buffer 的非 0 值向上取整到此值 */
+#define DIR_READER_MIN_BUF 4096
+
+/* 目录条目视图（name 指向 reader 内部缓冲区，下次 next 调用前有效） */
+typedef struct {
+    const char   *name;
+    uint64_t      ino;
+    unsigned char type;     /* DT_* */
+} DirEntry;
+
+/* 目录读取器：getdents64 大缓冲区后端 + readdir 兼容后端 */
+typedef struct {
+    int     fd;             /* 目录 fd，两种后端均有效 */
+    DIR    *dir;            /* readdir 后端句柄；getdents64 后端为 NULL */
+    char   *buf;            /* getdents64 缓冲区（由调用方持有，可跨目录复用） */
+    size_t  buf_size;
+    size_t  pos;            /* 当前解析偏移 */
+    size_t  len;            /* 缓冲区有效字节数 */
+    bool    eof;
+} DirReader;
+
+/* 打开目录。buf 为 NULL 或 buf_size 过小时退化为 readdir 后端。成功返回 0，失败返回 -1（errno 有效） */
+int dir_reader_open(DirReader *r, const char *path, char *buf, size_t buf_size);
+
+/* 读取下一个条目。返回 1 表示取得条目，0 表示目录结束，-1 表示读取出错（errno 有效） */
+int dir_reader_next(DirReader *r, DirEntry *out);
+
+/* 关闭目录（不释放调用方持有的缓冲区） */
+void dir_reader_close(DirReader *r);
+
+#endif
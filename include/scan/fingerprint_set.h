@@ -4,35 +4,104 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 
 #define FP_SIZE 16
 #define FP_SHARD_COUNT 64
+#define FP_INSERT_BATCH 256     /* fp_set_insert_batch 内部分块大小，调用方按此聚合即可 */
+
+/* 集合实现：分片互斥锁（兼容回退）或无锁 CAS 开放寻址 */
+typedef enum {
+    FP_SET_MUTEX = 0,
+    FP_SET_LOCKFREE = 1,
+} FpSetMode;
 
 typedef struct {
     uint8_t md5[FP_SIZE];
 } Fingerprint;
 
 typedef struct {
-    uint8_t *meta;        /* 0=empty, 1=occupied, 2=tombstone */
+    int8_t *ctrl;         /* 控制字节：SWISS_EMPTY / SWISS_DELETED / 7-bit 哈希标签 */
     Fingerprint *table;
     size_t capacity;
     size_t count;
     size_t tombstones;
+    /* 渐进式扩容：上一代表在后续插入中分步迁入当前表，迁移完成前查询两代表 */
+    int8_t *old_ctrl;     /* NULL 表示没有进行中的迁移 */
+    Fingerprint *old_table;
+    size_t old_capacity;
+    size_t migrate_pos;   /* 上一代表中下一个待迁移槽位 */
     pthread_mutex_t mutex;
 } FingerprintShard;
 
+/* 无锁槽位：两个 64-bit 字分两步发布。k0: 0 = 空，UINT64_MAX = 已迁移；k1: 0 = 写入中 */
+typedef struct {
+    _Atomic uint64_t k0;
+    _Atomic uint64_t k1;
+} FpLfSlot;
+
+/* 无锁分片的一代哈希表；扩容时 next 指向新表，插入线程每次至多领取一块协作迁移 */
+typedef struct FpLfTable {
+    FpLfSlot *slots;
+    size_t    capacity;
+    _Atomic size_t count;
+    struct FpLfTable *_Atomic next;
+    _Atomic size_t migrate_next;    /* 下一个待领取的迁移块起点 */
+    _Atomic size_t migrate_done;    /* 已迁移完成的槽位数 */
+    struct FpLfTable *retired;      /* 上一代表；分片无读者时释放其槽位，表头保留到集合销毁 */
+    _Atomic bool reclaimed;         /* 槽位已释放 */
+} FpLfTable;
+
 typedef struct {
-    FingerprintShard shards[FP_SHARD_COUNT];
+    _Alignas(64) FpLfTable *_Atomic cur;
+    _Atomic int resizing;
+    _Alignas(64) _Atomic size_t readers;    /* 正在访问本分片的线程数，归零时回收退役表 */
+} FpLfShard;
+
+/* 扩容停顿统计：单次插入因扩容（分配新表 / 迁移槽位）额外耗费的时间 */
+typedef struct {
+    uint64_t resizes;           /* 已发起的分片扩容次数 */
+    uint64_t pause_max_ns;      /* 单次插入的最长扩容停顿 */
+    uint64_t pause_total_ns;    /* 扩容停顿累计 */
+} FpResizeStats;
+
+typedef struct {
+    FpSetMode mode;
+    FingerprintShard shards[FP_SHARD_COUNT];    /* FP_SET_MUTEX */
+    FpLfShard lf_shards[FP_SHARD_COUNT];        /* FP_SET_LOCKFREE */
+    _Atomic uint64_t resizes;
+    _Atomic uint64_t pause_max_ns;
+    _Atomic uint64_t pause_total_ns;
+    _Atomic size_t mem_bytes;                   /* 槽位存储占用的字节数（含迁移中的上一代表） */
 } FingerprintSet;
 
-FingerprintSet* fp_set_create(size_t expected_count);
+/* 创建集合。平台不支持 64-bit 无锁原子操作时 FP_SET_LOCKFREE 自动回退为 FP_SET_MUTEX */
+FingerprintSet* fp_set_create(size_t expected_count, FpSetMode mode);
 void fp_set_destroy(FingerprintSet *set);
 
 /* 返回 true 表示已存在，false 表示新插入 */
 bool fp_set_insert(FingerprintSet *set, const uint8_t md5[FP_SIZE]);
 bool fp_set_contains(const FingerprintSet *set, const uint8_t md5[FP_SIZE]);
 
+/* 子树集合：按 fp_compute(目录路径, 0, 0) 记录子树根；
+ * 查询 path[0..len) 自身或长度大于 floor 的上级目录是否已记录（floor 为负责该路径的任务根长度） */
+bool fp_set_insert_path(FingerprintSet *set, const char *path);
+bool fp_set_contains_path_prefix(const FingerprintSet *set, const char *path, size_t len, size_t floor);
+
+/* 批量插入：results[i] 为 true 表示 fps[i] 已存在（允许为 NULL）。结果与按顺序逐条插入一致 */
+void fp_set_insert_batch(FingerprintSet *set, const Fingerprint *fps, size_t n, bool *results);
+
+/* 读取扩容停顿统计（线程安全，数值为近似快照） */
+void fp_set_resize_stats(const FingerprintSet *set, FpResizeStats *out);
+
+/* 槽位存储占用的字节数（线程安全，随扩容更新） */
+size_t fp_set_memory(const FingerprintSet *set);
+
+/* 元素个数与导出：仅在没有并发插入时调用（如已冻结、即将下刷的集合） */
+size_t fp_set_count(const FingerprintSet *set);
+size_t fp_set_export(const FingerprintSet *set, Fingerprint *out, size_t max);
+
 /* 计算指纹: xxHash3_128bits(path + dev + ino) */
 void fp_compute(const char *path, uint64_t dev, uint64_t ino, uint8_t out[FP_SIZE]);
 
@@ -0,0 +1,78 @@
+#ifndef FP_STORE_H
+#define FP_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "fingerprint_set.h"
+
+#define FP_RUN_FENCE_STRIDE 256     /* 每 256 个键（4KB，一页）取一个围栏键，run 内查找只读一页 */
+#define FP_RUN_BLOOM_BITS   10      /* 每个键的 Bloom 位数（7 个哈希，误判率约 1%） */
+#define FP_STORE_MAX_RUNS   8       /* run 数达到该值时后台合并为一个 */
+
+/* 磁盘上的一个有序不可变 run：键按字节序排序，mmap 只读访问 */
+typedef struct {
+    int fd;                         /* 创建后立即 unlink 的临时文件，进程退出即回收 */
+    const Fingerprint *keys;
+    size_t count;
+    size_t map_size;
+    uint64_t *fence;                /* keys[i * FP_RUN_FENCE_STRIDE] 的高 64 位（大端） */
+    size_t fence_count;
+    uint64_t *bloom;                /* 分块 Bloom：每块 512 位（一条缓存行） */
+    size_t bloom_blocks;
+} FpRun;
+
+/* 分层存储统计 */
+typedef struct {
+    FpResizeStats hot;              /* 当前热表的扩容停顿统计 */
+    size_t hot_bytes;               /* 热表（含待下刷的冻结表）槽位字节数 */
+    size_t index_bytes;             /* 所有 run 的 Bloom + 围栏字节数（常驻内存） */
+    size_t runs;
+    uint64_t spilled;               /* 已下刷到磁盘的指纹数 */
+    uint64_t spills;
+    uint64_t compactions;
+} FpStoreStats;
+
+/*
+ * 分层指纹存储：内存热表（FingerprintSet）+ 磁盘有序 run。
+ * max_memory 为 0 时只有热表，所有操作直接转发给 FingerprintSet，不加任何锁。
+ */
+typedef struct FpStore {
+    FingerprintSet *hot;
+    FingerprintSet *frozen;         /* 已冻结、等待后台线程下刷的热表，NULL 表示没有 */
+    FpRun **runs;                   /* 按生成顺序排列，仅后台线程增删 */
+    size_t run_count;
+
+    FpSetMode mode;
+    size_t hot_expected;            /* 新热表的预估容量 */
+    size_t max_memory;              /* 0 表示不分层 */
+    char *spill_prefix;             /* run 临时文件名前缀 */
+
+    pthread_rwlock_t lock;          /* 读：插入 / 查询；写：切换热表、发布 / 替换 run。锁顺序：bg_mutex → lock */
+    pthread_mutex_t bg_mutex;
+    pthread_cond_t bg_cond;         /* 唤醒后台线程 / 等待冻结表下刷完成 */
+    pthread_t bg_tid;
+    bool bg_running;
+    bool bg_stop;
+    bool spill_pending;             /* 有冻结表等待下刷（bg_mutex 保护） */
+
+    _Atomic size_t index_bytes;
+    _Atomic uint64_t spilled;
+    _Atomic uint64_t spills;
+    _Atomic uint64_t compactions;
+} FpStore;
+
+/* spill_prefix 在 max_memory > 0 时不能为空，run 文件为 "{spill_prefix}.fprun.XXXXXX" */
+FpStore* fp_store_create(size_t expected_count, FpSetMode mode, size_t max_memory, const char *spill_prefix);
+void fp_store_destroy(FpStore *store);
+
+/* 语义与 fp_set_insert / fp_set_insert_batch / fp_set_contains 相同，覆盖热表与全部 run */
+bool fp_store_insert(FpStore *store, const uint8_t md5[FP_SIZE]);
+void fp_store_insert_batch(FpStore *store, const Fingerprint *fps, size_t n, bool *results);
+bool fp_store_contains(FpStore *store, const uint8_t md5[FP_SIZE]);
+
+/* 读取统计（线程安全，数值为近似快照） */
+void fp_store_stats(FpStore *store, FpStoreStats *out);
+
+#endif
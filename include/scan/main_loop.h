@@ -11,16 +11,46 @@ void destroy_ipc_threads(AppContext *ctx);
 void stop_all_ipc_threads(AppContext *ctx);
 
 /* IPC helper: send REPLACE to IPC thread (used by main.c for initial bootstrap) */
-void send_replace_to_ipc(AppContext *ctx, int wid, int fd_cmd, int fd_data, int fd_ctrl, pid_t pid);
+void send_replace_to_ipc(AppContext *ctx, int wid, int fd_cmd, int fd_data, int fd_ctrl, pid_t pid,
+                         ShmRing *ring);
 
 /* IPC helper: send SCAN to IPC thread */
 bool send_scan_to_ipc(AppContext *ctx, int wid, const char *path, uint64_t dev);
 
+/* IPC helper: send STEAL to IPC thread */
+bool send_steal_to_ipc(AppContext *ctx, int wid, uint32_t max_count);
+
+/* IPC helper: send PRUNE to IPC thread */
+bool send_prune_to_ipc(AppContext *ctx, int wid, const char *path);
+
 /* IPC helper: send STOP to IPC thread */
 void send_stop_to_ipc(AppContext *ctx, int wid);
 
-/* Worker dispatch: find next IDLE worker, -1 if none available */
-int dispatch_find_idle_worker(AppContext *ctx);
+/* Worker dispatch: find the least-loaded worker with a free credit, -1 if all windows are full */
+int dispatch_find_worker(AppContext *ctx);
+
+/* Send one directory to a specific worker and record it in-flight (pending_tasks untouched) */
+bool dispatch_to_worker(AppContext *ctx, int wid, const char *path, uint64_t dev);
+
+/* Count a new directory task and dispatch it, or queue it in lost_tasks until a credit frees up */
+void dispatch_task(AppContext *ctx, const char *path, uint64_t dev);
+
+/* FINISH / MSG_DROP bookkeeping: return the credit held by path */
+void dispatch_task_finished(AppContext *ctx, int wid, const char *path);
+void dispatch_task_dropped(AppContext *ctx, int wid, const char *path);
+
+/* Record subdirectories a worker claimed for local descent (LOCAL entries of a batch) */
+void dispatch_track_local_claims(AppContext *ctx, int wid, const TPBatch *batch);
+
+/* Reject already-visited LOCAL directories and prune their subtrees; true = whole batch lies in a pruned subtree */
+bool dispatch_prune_local(AppContext *ctx, int wid, TPBatch *batch);
+
+/* Work stealing: ask a busy worker for local subdirectories when others are idle */
+void dispatch_steal_for_idle(AppContext *ctx);
+void dispatch_stolen_tasks(AppContext *ctx, int wid, const void *payload, size_t len);
+
+/* Derive IDLE / BUSY from the slot's in-flight count */
+void worker_slot_refresh_state(WorkerSlot *slot);
 
 /* Dispatch lost tasks to available workers */
 void dispatch_lost_tasks(AppContext *ctx);
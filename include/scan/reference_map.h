@@ -2,27 +2,42 @@
 #define REFERENCE_MAP_H
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
 #include <time.h>
 #include "fingerprint_set.h"
 
+/* 24 字节：d_type 压入 mtime 的低 8 位（mtime 有效范围 ±2^55 秒） */
 typedef struct {
     uint8_t fingerprint[FP_SIZE];
-    time_t  mtime;
-    uint8_t d_type;
-    uint8_t _pad[7];
+    int64_t meta;         /* (mtime << 8) | d_type */
 } ReferenceEntry;
 
-typedef struct {
-    uint8_t *meta;        /* 0=empty, 1=occupied */
+static inline time_t ref_entry_mtime(const ReferenceEntry *e) { return (time_t)(e->meta >> 8); }
+static inline uint8_t ref_entry_dtype(const ReferenceEntry *e) { return (uint8_t)(e->meta & 0xff); }
+
+typedef struct ReferenceMap {
+    int8_t *ctrl;         /* 控制字节：SWISS_EMPTY 或 7-bit 哈希标签（无删除操作，不产生墓碑） */
     ReferenceEntry *entries;
     size_t capacity;
     size_t count;
+    /* 文件映射（快照）：base 为 NULL 表示 ctrl/entries 位于堆内存 */
+    void *base;
+    size_t base_size;
+    char *path;           /* 可写快照的文件路径（封口时建表），只读映射与堆表为 NULL */
+    FILE *log;            /* 可写快照封口前的记录日志：插入只顺序追加，封口时按记录数一次建表 */
 } ReferenceMap;
 
+/* 半增量的唯一参考索引：存在性与 (mtime, d_type) 一次查询得到，只读查询不加锁 */
 ReferenceMap* ref_map_create(size_t expected_count);
 void ref_map_destroy(ReferenceMap *map);
 
 void ref_map_insert(ReferenceMap *map, const uint8_t fp[FP_SIZE], time_t mtime, uint8_t d_type);
 const ReferenceEntry* ref_map_lookup(const ReferenceMap *map, const uint8_t fp[FP_SIZE]);
 
+/* 可 mmap 的快照文件：写入端封口时在文件映射上一次建表，读取端只读映射、无需重建 */
+ReferenceMap* ref_map_create_mapped(const char *path);
+bool ref_map_seal(ReferenceMap *map, const char *final_path);
+ReferenceMap* ref_map_open_snapshot(const char *path);
+
 #endif
@@ -4,16 +4,26 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <sys/stat.h>
+#include "path_arena.h"
 
-/* 单个 batch 去重任务 */
+/* 单个 batch 去重任务（tp_batch_create 一次分配，数组紧随结构体） */
 typedef struct {
-    char **paths;
+    char **paths;       /* 指向 arena 内的完整路径 */
     struct stat *stats;
     int count;
     uint8_t *results;   /* 输出掩码：bit0=duplicate, bit1=blacklisted */
     int worker_id;
+    PathArena *arena;   /* 本批次路径缓冲，batch 持有一个引用 */
+    void *job;          /* 非去重任务（如并行恢复）的任务数据，count 为 0，batch 不持有 */
 } TPBatch;
 
+/* 分配可容纳 count 条记录的 batch（paths/stats/results 与结构体同一块内存，results 清零）。
+ * arena 由调用方创建后挂入。内存不足返回 NULL */
+TPBatch* tp_batch_create(int count);
+
+/* 释放 batch 及其 arena 引用，允许传入 NULL */
+void tp_batch_free(TPBatch *batch);
+
 typedef void (*tp_process_fn)(TPBatch *batch, void *user_data);
 
 typedef struct ThreadPool ThreadPool;
@@ -25,7 +35,7 @@ void thread_pool_destroy(ThreadPool *tp);
 bool thread_pool_submit(ThreadPool *tp, TPBatch *batch);
 
 /* 主线程调用：取出所有已完成的 batch。返回 NULL 表示没有已完成的 batch。
- * 调用方需负责释放返回的 TPBatch 及其内部内存。 */
+ * 调用方需以 tp_batch_free 释放返回的 TPBatch。 */
 TPBatch* thread_pool_poll_completed(ThreadPool *tp);
 
 #endif
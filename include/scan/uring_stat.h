@@ -0,0 +1,19 @@
+#ifndef URING_STAT_H
+#define URING_STAT_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+/* io_uring 批量 statx 提交器（每个 Scanner 线程独享一个实例） */
+typedef struct UringStat UringStat;
+
+/* 创建队列深度为 depth 的 io_uring 实例。内核/编译环境不支持 IORING_OP_STATX 时返回 NULL */
+UringStat *uring_stat_create(unsigned depth);
+void uring_stat_destroy(UringStat *u);
+
+/* 批量 statx：names[i] 相对 dirfd 解析，结果写入 out[i]，res[i] 为 0 或 -errno。
+ * 同时在途请求数不超过队列深度。返回 0 表示全部完成，-1 表示 io_uring 自身出错（调用方应回退同步路径） */
+int uring_stat_batch(UringStat *u, int dirfd, const char *const *names, int n,
+                     int flags, unsigned int mask, struct statx *out, int *res);
+
+#endif
@@ -2,39 +2,106 @@
 #define WORKER_SCANNER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <pthread.h>
 #include "config.h"
 #include "fingerprint_set.h"
 #include "reference_map.h"
+#include "dir_index.h"
+#include "shm_ring.h"
 
-/* Worker 内部多线程上下文 (v14.0.0) */
+/* Master 下发的根任务：本地下探的子树全部完成（或被窃取）后才发送 FINISH */
+typedef struct {
+    char *path;             /* 下发路径，FINISH 原样携带 */
+    int   refs;             /* 尚未完成的本地目录数（含根目录自身） */
+    long  entries;          /* 子树已扫描条目数，用于 --local-entries 预算 */
+} WorkerTaskRoot;
+
+/* 本地下探队列中的子目录 */
 typedef struct {
+    char           *path;
+    WorkerTaskRoot *root;
+    int             depth;  /* 相对根任务的深度，根目录为 0 */
+    uint64_t        dev;    /* 所在设备号（STOLEN 交回 Master 时携带），根目录为 0 */
+} WorkerLocalDir;
+
+struct WorkerThreadCtx;
+
+/* 单个 Scanner 线程的状态（--scanner-threads 个线程共享同一 WorkerThreadCtx 的任务队列） */
+typedef struct {
+    struct WorkerThreadCtx *ctx;
+    int       index;
+    pthread_t tid;
+    bool      started;
+    char      current_task[4096];   /* 当前扫描的目录（卡死上报用），受 task_mutex 保护 */
+    time_t    last_progress;        /* 受 progress_mutex 保护 */
+    bool      active;               /* 受 progress_mutex 保护 */
+} WorkerScanner;
+
+/* Worker 内部多线程上下文 (v14.0.0) */
+typedef struct WorkerThreadCtx {
     int fd_cmd;
     int fd_data;
     int fd_ctrl;
     int worker_id;
+    ShmRing *ring;              /* 共享内存数据环（--shm-ring），NULL 表示 BATCH 等走 fd_data 管道 */
 
-    /* 任务同步 */
+    /* 任务同步：本地 SCAN 队列（Master 按 credit 窗口预先下发多个目录） */
     pthread_mutex_t task_mutex;
     pthread_cond_t  task_cond;
-    char   task_path[4096];
-    bool   task_ready;
+    char **task_queue;          /* 环形队列，元素为 malloc 的目录路径 */
+    int    task_head;
+    int    task_count;
+    int    task_capacity;
     bool   stop_flag;
 
-    /* Scanner 进度监控 */
+    /* 本地子树下探：尾部 LIFO 供 Scanner 深度优先，头部（最早、最浅）供 Master 窃取。受 task_mutex 保护 */
+    WorkerLocalDir *local;
+    int    local_head;
+    int    local_count;
+    int    local_capacity;
+    pthread_mutex_t send_mutex; /* 串行化数据通道（环或 fd_data）上的 BATCH / FINISH / STOLEN（保证 STOLEN 先于根任务 FINISH） */
+    FingerprintSet *pruned;     /* Master 经 PRUNE 拒绝的子树根（fp_set_insert_path），受 task_mutex 保护；按需创建 */
+
+    /* Scanner 线程组与进度监控 */
+    WorkerScanner *scanners;
+    int    scanner_count;
     pthread_mutex_t progress_mutex;
-    time_t last_progress;
-    bool   scanner_active;
 } WorkerThreadCtx;
 
 /* 设置 Worker 只读上下文（fork 前由主进程调用） */
-void worker_set_context(const Config *cfg, const FingerprintSet *ref_set, const ReferenceMap *ref_map);
+void worker_set_context(const Config *cfg, const ReferenceMap *ref_map, const DirIndex *dir_index,
+                        int dirlist_fd, unsigned int statx_mask);
 
 /* 获取当前 Worker 配置指针（供 IPC 线程查询 heartbeat_timeout 等） */
 const Config* worker_get_config(void);
 
-/* Scanner 线程入口 */
+/* 获取目录清单写入端 fd（Worker fork 后关闭继承 fd 时保留），未记录时返回 -1 */
+int worker_get_dirlist_fd(void);
+
+/* 将 SCAN 目录加入本地队列并唤醒 Scanner（接管 path 所有权）。内存不足返回 false */
+bool worker_task_push(WorkerThreadCtx *ctx, char *path);
+
+/* 响应 Master 的 STEAL：从本地下探队列头部取出最多 max_count 个子目录经数据通道交回 */
+void worker_steal_local(WorkerThreadCtx *ctx, uint32_t max_count);
+
+/* 响应 Master 的 PRUNE：不再认领、执行该目录子树下的本地目录 */
+void worker_prune_local(WorkerThreadCtx *ctx, const char *path);
+
+/* 释放本地队列中未执行的目录（Scanner 线程退出后调用） */
+void worker_task_queue_free(WorkerThreadCtx *ctx);
+
+/* 启动 count 个 Scanner 线程。成功返回已启动的线程数（>= 1），一个都未启动时返回 0 */
+int worker_scanners_start(WorkerThreadCtx *ctx, int count);
+
+/* 通知全部 Scanner 线程停止并等待退出，释放线程组 */
+void worker_scanners_join(WorkerThreadCtx *ctx);
+
+/* 查询最久未推进的活跃 Scanner：有活跃线程时返回 true，并输出其开始时间与当前目录 */
+bool worker_scanners_oldest_active(WorkerThreadCtx *ctx, time_t *since, char *path, size_t path_size);
+
+/* Scanner 线程入口（arg 为 WorkerScanner*） */
 void *worker_scanner_thread(void *arg);
 
 #endif
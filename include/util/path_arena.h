@@ -0,0 +1,32 @@
+/**
+ * @file path_arena.h
+ * @brief 引用计数的路径缓冲：一个 BATCH 的全部完整路径共用一次分配
+ *
+ * 主线程解析 BATCH 时把 dir + "/" + name 依次写入同一块缓冲，
+ * TPBatch、OutputTask、RecordBatch 只保存指向缓冲内部的指针并各持一个引用，
+ * 最后一个持有者释放时整块归还，主线程热路径不再逐条 malloc/strdup/free。
+ */
+#ifndef PATH_ARENA_H
+#define PATH_ARENA_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+typedef struct PathArena {
+    _Atomic int refs;
+    size_t      size;   /* data 容量（字节） */
+    size_t      used;   /* 已写入字节数，仅创建者在发布前修改 */
+    char        data[];
+} PathArena;
+
+/* 创建容量为 size 字节的缓冲，初始引用为 1。内存不足返回 NULL */
+PathArena *path_arena_create(size_t size);
+
+/* 追加 prefix + "/" + name 并以 '\0' 结尾，返回缓冲内的路径；容量不足返回 NULL */
+char *path_arena_join(PathArena *a, const char *prefix, size_t prefix_len, const char *name, size_t name_len);
+
+/* 引用计数（线程安全），unref 允许传入 NULL */
+void path_arena_ref(PathArena *a);
+void path_arena_unref(PathArena *a);
+
+#endif
@@ -0,0 +1,66 @@
+/**
+ * @file swiss_group.h
+ * @brief Swiss table 风格的控制字节分组探测（SSE2 一次比较 16 个槽位）
+ *
+ * 每个槽位对应一个控制字节：0x00~0x7F 为已占用槽位的 7-bit 哈希标签，
+ * SWISS_EMPTY / SWISS_DELETED 为负值。探测以 16 个槽位为一组，
+ * 一次向量比较即可得到组内标签命中的位掩码，绝大多数未命中无需访问槽位本身。
+ * 非 x86 或未启用 SSE2 时使用逐字节的等价实现。
+ */
+#ifndef SWISS_GROUP_H
+#define SWISS_GROUP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define SWISS_GROUP_WIDTH 16
+#define SWISS_EMPTY   ((int8_t)-128)   /* 0x80 */
+#define SWISS_DELETED ((int8_t)-2)     /* 0xFE，墓碑 */
+
+/* 由 64-bit 哈希拆出组索引部分与 7-bit 标签 */
+static inline size_t swiss_h1(uint64_t h) { return (size_t)(h >> 7); }
+static inline int8_t swiss_h2(uint64_t h) { return (int8_t)(h & 0x7f); }
+
+/* 初始化控制字节数组（全部为空） */
+static inline void swiss_ctrl_reset(int8_t *ctrl, size_t capacity) {
+    memset(ctrl, (uint8_t)SWISS_EMPTY, capacity);
+}
+
+/* 组内标签等于 tag 的槽位掩码（bit i 对应组内第 i 个槽位） */
+static inline uint32_t swiss_match(const int8_t *group, int8_t tag) {
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(tag)));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        if (group[i] == tag) m |= 1u << i;
+    }
+    return m;
+#endif
+}
+
+/* 组内空槽掩码：存在空槽说明探测链到此结束 */
+static inline uint32_t swiss_match_empty(const int8_t *group) {
+    return swiss_match(group, SWISS_EMPTY);
+}
+
+/* 组内空槽或墓碑掩码（控制字节为负），即可写入的位置 */
+static inline uint32_t swiss_match_free(const int8_t *group) {
+#if defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < SWISS_GROUP_WIDTH; i++) {
+        if (group[i] < 0) m |= 1u << i;
+    }
+    return m;
+#endif
+}
+
+#endif
@@ -9,9 +9,14 @@
 #include "cmdline.h"
 #include "utils.h"
 #include "output.h"
+#include "dir_reader.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <getopt.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -46,13 +51,28 @@ void show_help() {
     printf("      --estimated-files=数量 预估文件数,用于预分配内存 (默认: %u)\n", (unsigned)DEFAULT_ESTIMATED_FILES);
     printf("      --master-threads=数量  Master 去重线程数 (默认: %d)\n", DEFAULT_MASTER_THREADS);
     printf("      --worker-count=数量  Worker 进程数 (默认: 自动, 上限 8)\n");
+    printf("      --dirent-buffer=大小 getdents64 目录读取缓冲区, 支持 K/M 后缀, 0 表示使用 readdir, 非 0 值至少 4K (默认: 1M)\n");
+    printf("      --statx-dont-sync  statx 使用 AT_STATX_DONT_SYNC, 直接采用 NFS 等缓存属性 (可能略旧)\n");
+    printf("      --uring-depth=数量 使用 io_uring 批量提交 statx 的队列深度, 0 表示同步 (默认: 0, 上限 %d)\n", MAX_URING_DEPTH);
+    printf("      --worker-credits=数量 每个 Worker 的在途目录任务窗口 (默认: %d, 上限 %d)\n", DEFAULT_WORKER_CREDITS, MAX_WORKER_CREDITS);
+    printf("      --local-depth=层数 Worker 在本地继续下探子目录的深度, 0 表示全部交回 Master (默认: %d)\n", DEFAULT_LOCAL_DEPTH);
+    printf("      --local-entries=数量 单个任务本地下探的条目预算, 超出后子目录交回 Master (默认: %d)\n", DEFAULT_LOCAL_ENTRIES);
+    printf("      --scanner-threads=数量 每个 Worker 进程的 Scanner 线程数 (默认: %d, 上限 %d)\n", DEFAULT_SCANNER_THREADS, MAX_SCANNER_THREADS);
+    printf("      --shm-ring=大小    Worker 结果回传的共享内存环, 支持 K/M/G 后缀, 0 表示使用管道 (默认: 8M, 最小 64K)\n");
+    printf("      --fp-set=实现      去重指纹集合实现: lockfree (无锁 CAS) 或 mutex (分片互斥锁) (默认: lockfree)\n");
+    printf("      --dedup=策略       去重范围: dirs (仅目录) / links (目录 + 多链接文件) / full (全部条目) (默认: 跟随符号链接时 full, 否则 dirs)\n");
+    printf("      --max-dedup-memory=大小 去重指纹集合内存上限, 支持 K/M/G 后缀, 超出后下刷到 {进度文件}.fprun.* 磁盘文件, 0 表示不限制 (默认: 0, 最小 64M)\n");
     printf("  -t, --timeout=秒       心跳超时时间 (默认: %d)\n", HEARTBEAT_TIMEOUT_SEC);
     printf("\n输出控制:\n");
     printf("  -f, --progress-file=文件 进度文件/历史记录前缀 (默认: progress)\n");
     printf("  -o, --output=文件      将结果写入指定文件 (默认: %s)\n", DEFAULT_OUTPUT_FILE);
     printf("  -O, --output-split=目录 将结果按行拆分到指定目录\n");
+    printf("      --output-compress=方式 输出压缩: none / gzip[:1-9] (默认级别 %d); 按块压缩为多 member gzip 流, -O 切片追加 %s 后缀\n", DEFAULT_GZIP_LEVEL, OUTPUT_GZIP_SUFFIX);
+    printf("      --output-shards    配合 -O: 每个输出线程写独立的切片序列 w<线程号>_<切片号>.txt, 结束时生成 %s\n", OUTPUT_MANIFEST_FILE);
     printf("      --csv              启用标准 CSV 输出格式\n");
     printf("  -Q, --quote            对输出结果进行引号包裹\n");
+    printf("      --writer-threads=数量 输出格式化线程数 (默认: %d, 上限 %d)\n", DEFAULT_WRITER_THREADS, MAX_WRITER_THREADS);
+    printf("      --writer-order=顺序 多格式化线程的写出顺序: ordered (按提交顺序, 结果确定) / unordered (按完成顺序, 最快) (默认: ordered)\n");
     printf("  -D, --dirs             包含目录本身的信息\n");
     printf("  -d, --print-dir        打印目录路径到标准错误\n");
     printf("  -M, --mute             禁用所有输出\n");
@@ -105,9 +125,48 @@ void init_config(Config *cfg) {
     cfg->estimated_files = DEFAULT_ESTIMATED_FILES;
     cfg->master_threads = DEFAULT_MASTER_THREADS;
     cfg->worker_count = 0;
+    cfg->dirent_buffer = DEFAULT_DIRENT_BUFFER;
+    cfg->worker_credits = DEFAULT_WORKER_CREDITS;
+    cfg->local_depth = DEFAULT_LOCAL_DEPTH;
+    cfg->local_entries = DEFAULT_LOCAL_ENTRIES;
+    cfg->scanner_threads = DEFAULT_SCANNER_THREADS;
+    cfg->shm_ring = DEFAULT_SHM_RING;
+    cfg->writer_threads = DEFAULT_WRITER_THREADS;
     cfg->skip_interval = 0;
 }
 
+/**
+ * @brief  解析带 K/M/G 后缀的字节数
+ * @param  arg  const char*  参数字符串，如 "4M"、"512K"、"1048576"，不能为空
+ * @param  out  size_t*      输出字节数，不能为空
+ * @return bool  解析成功返回 true；格式非法、负数或溢出返回 false
+ *
+ * @note   strtoull 会接受前导 '-' 并取反，这里显式拒绝；后缀左移前检查溢出。
+ */
+static bool parse_size_arg(const char *arg, size_t *out) {
+    const char *p = arg;
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '-') return false;
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(p, &end, 10);
+    if (end == p || errno == ERANGE) return false;
+    unsigned shift = 0;
+    switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        default: break;
+    }
+    if (v > (ULLONG_MAX >> shift)) return false;
+    v <<= shift;
+    if (*end == 'B' || *end == 'b') end++;
+    if (*end != '\0' || v > SIZE_MAX) return false;
+    *out = (size_t)v;
+    return true;
+}
+
 /**
  * @brief  解析命令行参数并填充 Config 结构体
  * @param  argc  int      命令行参数个数，取值范围: >= 1（argv[0] 为程序名）
@@ -157,6 +216,21 @@ int parse_arguments(int argc, char *argv[], Config *cfg) {
         {"estimated-files", required_argument, 0, 24},
         {"master-threads", required_argument, 0, 25},
         {"worker-count", required_argument, 0, 26},
+        {"dirent-buffer", required_argument, 0, 27},
+        {"statx-dont-sync", no_argument, 0, 28},
+        {"uring-depth", required_argument, 0, 29},
+        {"worker-credits", required_argument, 0, 30},
+        {"local-depth", required_argument, 0, 31},
+        {"local-entries", required_argument, 0, 32},
+        {"scanner-threads", required_argument, 0, 33},
+        {"shm-ring", required_argument, 0, 34},
+        {"fp-set", required_argument, 0, 35},
+        {"dedup", required_argument, 0, 36},
+        {"max-dedup-memory", required_argument, 0, 37},
+        {"writer-threads", required_argument, 0, 38},
+        {"writer-order", required_argument, 0, 39},
+        {"output-shards", no_argument, 0, 40},
+        {"output-compress", required_argument, 0, 41},
         {"timeout", required_argument, 0, 't'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -243,6 +317,109 @@ int parse_arguments(int argc, char *argv[], Config *cfg) {
                 cfg->worker_count = atoi(optarg);
                 if (cfg->worker_count < 1) cfg->worker_count = 0;
                 break;
+            case 27:
+                if (!parse_size_arg(optarg, &cfg->dirent_buffer)) {
+                    log_error("无效的 dirent 缓冲区大小: %s", optarg);
+                    return -1;
+                }
+                if (cfg->dirent_buffer > MAX_DIRENT_BUFFER) cfg->dirent_buffer = MAX_DIRENT_BUFFER;
+                /* 过小的缓冲区会被 dir_reader_open 静默退回 readdir：非 0 值向上取整到下限 */
+                if (cfg->dirent_buffer > 0 && cfg->dirent_buffer < DIR_READER_MIN_BUF) {
+                    cfg->dirent_buffer = DIR_READER_MIN_BUF;
+                }
+                break;
+            case 28: cfg->statx_dont_sync = true; break;
+            case 29:
+                cfg->uring_depth = atoi(optarg);
+                if (cfg->uring_depth < 0) cfg->uring_depth = 0;
+                if (cfg->uring_depth > MAX_URING_DEPTH) cfg->uring_depth = MAX_URING_DEPTH;
+                break;
+            case 30:
+                cfg->worker_credits = atoi(optarg);
+                if (cfg->worker_credits < 1) cfg->worker_credits = 1;
+                if (cfg->worker_credits > MAX_WORKER_CREDITS) cfg->worker_credits = MAX_WORKER_CREDITS;
+                break;
+            case 31:
+                cfg->local_depth = atoi(optarg);
+                if (cfg->local_depth < 0) cfg->local_depth = 0;
+                break;
+            case 32:
+                cfg->local_entries = atol(optarg);
+                if (cfg->local_entries < 1) cfg->local_entries = 1;
+                break;
+            case 33:
+                cfg->scanner_threads = atoi(optarg);
+                if (cfg->scanner_threads < 1) cfg->scanner_threads = 1;
+                if (cfg->scanner_threads > MAX_SCANNER_THREADS) cfg->scanner_threads = MAX_SCANNER_THREADS;
+                break;
+            case 34:
+                if (!parse_size_arg(optarg, &cfg->shm_ring)) {
+                    log_error("无效的共享内存环大小: %s", optarg);
+                    return -1;
+                }
+                if (cfg->shm_ring > MAX_SHM_RING) cfg->shm_ring = MAX_SHM_RING;
+                break;
+            case 35:
+                if (strcmp(optarg, "mutex") == 0) {
+                    cfg->fp_set_mutex = true;
+                } else if (strcmp(optarg, "lockfree") == 0) {
+                    cfg->fp_set_mutex = false;
+                } else {
+                    log_error("无效的指纹集合实现: %s (可选 lockfree / mutex)", optarg);
+                    return -1;
+                }
+                break;
+            case 36:
+                if (strcmp(optarg, "dirs") == 0) {
+                    cfg->dedup_policy = DEDUP_DIRS;
+                } else if (strcmp(optarg, "links") == 0) {
+                    cfg->dedup_policy = DEDUP_LINKS;
+                } else if (strcmp(optarg, "full") == 0) {
+                    cfg->dedup_policy = DEDUP_FULL;
+                } else {
+                    log_error("无效的去重策略: %s (可选 dirs / links / full)", optarg);
+                    return -1;
+                }
+                break;
+            case 37:
+                if (!parse_size_arg(optarg, &cfg->max_dedup_memory)) {
+                    log_error("无效的去重内存上限: %s", optarg);
+                    return -1;
+                }
+                if (cfg->max_dedup_memory > 0 && cfg->max_dedup_memory < MIN_MAX_DEDUP_MEMORY) {
+                    cfg->max_dedup_memory = MIN_MAX_DEDUP_MEMORY;
+                }
+                break;
+            case 38:
+                cfg->writer_threads = atoi(optarg);
+                if (cfg->writer_threads < 1) cfg->writer_threads = 1;
+                if (cfg->writer_threads > MAX_WRITER_THREADS) cfg->writer_threads = MAX_WRITER_THREADS;
+                break;
+            case 39:
+                if (strcmp(optarg, "ordered") == 0) {
+                    cfg->writer_unordered = false;
+                } else if (strcmp(optarg, "unordered") == 0) {
+                    cfg->writer_unordered = true;
+                } else {
+                    log_error("无效的写出顺序: %s (可选 ordered / unordered)", optarg);
+                    return -1;
+                }
+                break;
+            case 40:
+                cfg->output_sharded = true;
+                break;
+            case 41:
+                if (strcmp(optarg, "none") == 0) {
+                    cfg->output_compress = 0;
+                } else if (strcmp(optarg, "gzip") == 0) {
+                    cfg->output_compress = DEFAULT_GZIP_LEVEL;
+                } else if (strncmp(optarg, "gzip:", 5) == 0 && optarg[5] >= '1' && optarg[5] <= '9' && optarg[6] == '\0') {
+                    cfg->output_compress = optarg[5] - '0';
+                } else {
+                    log_error("无效的输出压缩方式: %s (可选 none / gzip / gzip:1..9)", optarg);
+                    return -1;
+                }
+                break;
             case 't':
                 cfg->heartbeat_timeout = atol(optarg);
                 if (cfg->heartbeat_timeout <= 0) {
@@ -279,11 +456,23 @@ int parse_arguments(int argc, char *argv[], Config *cfg) {
         return -1;
     }
 
+    if (cfg->output_sharded && !cfg->is_output_split_dir) {
+        log_error("--output-shards 需要与 -O 同时使用");
+        return -1;
+    }
+
     if (cfg->archive && cfg->clean) {
         log_error("-Z 与 -C 不能同时使用");
         return -1;
     }
 
+    /* credit 窗口至少为每个 Scanner 线程保留一个在途目录，否则多出的线程只能依赖本地下探取活 */
+    if (cfg->worker_credits < cfg->scanner_threads) {
+        verbose_printf(cfg, 1, "worker-credits 由 %d 提升至 %d (与 scanner-threads 对齐)\n",
+                       cfg->worker_credits, cfg->scanner_threads);
+        cfg->worker_credits = cfg->scanner_threads;
+    }
+
     if (cfg->format) {
         verbose_printf(cfg, 1, "预编译输出格式: %s\n", cfg->format);
     }
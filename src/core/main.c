@@ -19,6 +19,7 @@
 #include "log.h"
 #include "msg_format.h"
 #include "msg_queue.h"
+#include "dedup_policy.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,7 +44,7 @@ static void app_context_init(AppContext *ctx) {
     ctx->event_fd = -1;
     ctx->running = false;
     ctx->hist_pump_state = HIST_PUMP_DONE;
-    ctx->next_requeue_worker = 0;
+    ctx->state.dirlist_fd = -1;
     atomic_init(&ctx->pending_tasks, 0);
     atomic_init(&ctx->pending_batches, 0);
     lost_tasks_init(&ctx->lost_tasks);
@@ -77,6 +78,7 @@ static void app_context_destroy(AppContext *ctx) {
         async_worker_shutdown(ctx->async_writer);
         ctx->async_writer = NULL;
     }
+    free_output_shards(&ctx->state);
     if (ctx->worker_pool) {
         worker_pool_destroy(ctx->worker_pool);
         ctx->worker_pool = NULL;
@@ -90,18 +92,24 @@ static void app_context_destroy(AppContext *ctx) {
         ctx->dev_mgr = NULL;
     }
     if (ctx->visited_set) {
-        fp_set_destroy(ctx->visited_set);
+        fp_store_destroy(ctx->visited_set);
         ctx->visited_set = NULL;
     }
+    fp_set_destroy(ctx->pruned_dirs);
+    ctx->pruned_dirs = NULL;
     lost_tasks_destroy(&ctx->lost_tasks);
-    if (ctx->reference_set) {
-        fp_set_destroy(ctx->reference_set);
-        ctx->reference_set = NULL;
-    }
     if (ctx->reference_map) {
         ref_map_destroy(ctx->reference_map);
         ctx->reference_map = NULL;
     }
+    if (ctx->dir_index) {
+        dir_index_destroy(ctx->dir_index);
+        ctx->dir_index = NULL;
+    }
+    if (ctx->state.dirlist_fd >= 0) {
+        close(ctx->state.dirlist_fd);
+        ctx->state.dirlist_fd = -1;
+    }
     if (ctx->spbin_entries) {
         for (size_t i = 0; i < ctx->spbin_count; i++) {
             free(ctx->spbin_entries[i].path);
@@ -235,7 +243,7 @@ static void init_output_buffers(AppContext *ctx) {
  *
  * @note   完整流程参见文件头部注释。关键设计点：
  *         - 使用 fork() + pipe 的 Worker 进程模型，通过 COW 共享只读上下文。
- *         - 半增量模式（skip_interval > 0）下加载 reference_set/map。
+ *         - 半增量模式（skip_interval > 0）下加载 reference_map。
  *         - 单文件目标直接提交到 async_writer，不创建 Worker 任务。
  *         - 主循环退出后先 join 监控线程，再执行 finalize_progress 归档。
  */
@@ -278,14 +286,18 @@ int main(int argc, char *argv[]) {
         save_config_to_disk(&ctx.cfg);
     }
 
-    /* Pre-allocate fingerprint set */
-    ctx.visited_set = fp_set_create(ctx.cfg.estimated_files);
+    /* Pre-allocate fingerprint set (sized by dedup policy) */
+    ctx.cfg.dedup_policy = dedup_policy_resolve(ctx.cfg.dedup_policy, ctx.cfg.follow_symlinks);
+    log_debug("[Dedup] policy=%s", dedup_policy_name(ctx.cfg.dedup_policy));
+    FpSetMode fp_mode = ctx.cfg.fp_set_mutex ? FP_SET_MUTEX : FP_SET_LOCKFREE;
+    ctx.visited_set = fp_store_create(dedup_policy_set_size(ctx.cfg.dedup_policy, ctx.cfg.estimated_files),
+                                      fp_mode, ctx.cfg.max_dedup_memory, ctx.cfg.progress_base);
     if (!ctx.visited_set) {
         log_fatal("无法分配 VisitedSet 内存");
         return 1;
     }
 
-    /* Incremental mode: load reference set/map */
+    /* Incremental mode: load reference map */
     if (ctx.cfg.continue_mode && ctx.cfg.skip_interval > 0) {
         char path[1024];
         snprintf(path, sizeof(path), "%s.config", ctx.cfg.progress_base);
@@ -302,16 +314,38 @@ int main(int argc, char *argv[]) {
             fclose(fp);
         }
         if (is_success) {
-            log_info("检测到上次任务已完成，加载历史索引进行半增量扫描...");
-            ctx.reference_set = fp_set_create(ctx.cfg.estimated_files);
-            ctx.reference_map = ref_map_create(ctx.cfg.estimated_files);
-            restore_progress_to_memory(&ctx.cfg, &ctx);
-            log_info("历史索引加载完成");
+            /* 优先只读映射上次任务发布的指纹快照，失败时回退为解压重放历史分片 */
+            char *snap_path = get_snapshot_filename(ctx.cfg.progress_base);
+            ctx.reference_map = ref_map_open_snapshot(snap_path);
+            if (ctx.reference_map) {
+                log_info("检测到上次任务已完成，已映射指纹快照 %s (%zu 条)，进行半增量扫描",
+                         snap_path, ctx.reference_map->count);
+            } else {
+                log_info("检测到上次任务已完成，加载历史索引进行半增量扫描...");
+                ctx.reference_map = ref_map_create(ctx.cfg.estimated_files);
+                restore_progress_to_memory(&ctx.cfg, &ctx);
+                log_info("历史索引加载完成");
+            }
+            free(snap_path);
+
+            /* 目录清单：目录自身未变化时 Worker 直接按清单发出子条目，跳过 readdir */
+            if (!ctx.cfg.follow_symlinks) {
+                char *list_path = get_dirlist_filename(ctx.cfg.progress_base);
+                ctx.dir_index = dir_index_open(list_path);
+                if (ctx.dir_index) {
+                    log_info("已映射目录清单 %s (%zu 个目录)", list_path, ctx.dir_index->dirs);
+                }
+                free(list_path);
+            }
         }
     }
 
-    /* Setup worker context (COW, read-only in workers) */
-    worker_set_context(&ctx.cfg, ctx.reference_set, ctx.reference_map);
+    /* 本次任务的目录清单写入端：须在 fork Worker 前打开；中断任务续传时保留已写入的记录 */
+    open_dirlist_writer(&ctx.cfg, &ctx.state, has_history && !ctx.reference_map);
+
+    /* Setup worker context (read-only in workers; snapshot shared via page cache, heap tables via COW) */
+    worker_set_context(&ctx.cfg, ctx.reference_map, ctx.dir_index, ctx.state.dirlist_fd,
+                       format_statx_mask(&ctx.cfg));
 
     /* Create worker pool */
     int num_workers = ctx.cfg.worker_count;
@@ -331,6 +365,8 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    ctx.worker_pool->ring_capacity = ctx.cfg.shm_ring;
+
     /* Start monitor thread */
     pthread_create(&ctx.monitor->tid, NULL, monitor_thread_entry, ctx.monitor);
 
@@ -347,11 +383,15 @@ int main(int argc, char *argv[]) {
     }
     for (int i = 0; i < num_workers; i++) {
         WorkerSlot *slot = &ctx.worker_pool->slots[i];
-        send_replace_to_ipc(&ctx, i, slot->fd_cmd, slot->fd_data, slot->fd_ctrl, slot->pid);
+        send_replace_to_ipc(&ctx, i, slot->fd_cmd, slot->fd_data, slot->fd_ctrl, slot->pid, slot->ring);
+        slot->ring = NULL; /* 引用已移交 IPC 线程 */
     }
 
+    /* 本次任务的指纹快照写入端（Worker 已 fork，写入端映射不会被继承） */
+    open_snapshot_writer(&ctx.cfg, &ctx.state);
+
     /* Resume mode: restore progress and replay unfinished tasks */
-    if (ctx.cfg.continue_mode && !ctx.reference_set) {
+    if (ctx.cfg.continue_mode && !ctx.reference_map) {
         restore_progress(&ctx.cfg, &ctx);
     }
 
@@ -364,30 +404,10 @@ int main(int argc, char *argv[]) {
     struct stat root_info;
     if (lstat(ctx.cfg.target_path, &root_info) == 0) {
         if (S_ISDIR(root_info.st_mode)) {
+            /* Worker 0 尚在 INITIALIZING，不经过 dispatch_find_worker，直接占用其第一个 credit */
             atomic_fetch_add(&ctx.pending_tasks, 1);
-            WorkerSlot *slot = ctx.worker_pool->slots;
-            slot->current_dev = root_info.st_dev;
-            safe_strcpy(slot->current_path, ctx.cfg.target_path, sizeof(slot->current_path));
-
-            CmdScanPayload *scan = malloc(sizeof(CmdScanPayload));
-            if (!scan) {
-                log_fatal("根任务内存分配失败");
-                app_context_destroy(&ctx);
-                return 1;
-            }
-            scan->path_len = (uint32_t)strlen(ctx.cfg.target_path);
-            scan->dev = root_info.st_dev;
-            safe_strcpy(scan->path, ctx.cfg.target_path, sizeof(scan->path));
-
-            IpcThreadMsg msg = {
-                .type = CMD_SCAN,
-                .slot_id = 0,
-                .data = scan,
-                .data_len = sizeof(*scan)
-            };
-            if (!msg_queue_send(ctx.ipc_cmd_queues[0], &msg)) {
+            if (!dispatch_to_worker(&ctx, 0, ctx.cfg.target_path, root_info.st_dev)) {
                 log_fatal("根任务发送失败: cmd_queue full");
-                free(scan);
                 app_context_destroy(&ctx);
                 return 1;
             }
@@ -416,7 +436,27 @@ int main(int argc, char *argv[]) {
     if (!ctx.cfg.mute) {
         log_info("任务完成。耗时: %ld 秒", time(NULL) - ctx.state.start_time);
     }
+    if (ctx.visited_set) {
+        FpStoreStats ss;
+        fp_store_stats(ctx.visited_set, &ss);
+        log_debug("[FPSet] visited_set resizes=%lu pause_max=%.3fms pause_total=%.3fms",
+                  (unsigned long)ss.hot.resizes, ss.hot.pause_max_ns / 1e6, ss.hot.pause_total_ns / 1e6);
+        if (ss.spills > 0) {
+            log_debug("[FPStore] spilled=%lu spills=%lu runs=%zu compactions=%lu index=%zuKB",
+                      (unsigned long)ss.spilled, (unsigned long)ss.spills, ss.runs,
+                      (unsigned long)ss.compactions, ss.index_bytes / 1024);
+        }
+    }
 
+    /* 输出线程先于 finalize 退出：索引中的输出切片位置与分片清单的行数须为最终值 */
+    if (ctx.thread_pool) {
+        thread_pool_destroy(ctx.thread_pool);
+        ctx.thread_pool = NULL;
+    }
+    if (ctx.async_writer) {
+        async_worker_shutdown(ctx.async_writer);
+        ctx.async_writer = NULL;
+    }
     finalize_progress(&ctx.cfg, &ctx.state);
     app_context_destroy(&ctx);
 
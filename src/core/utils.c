@@ -38,19 +38,79 @@ void __attribute__((noinline)) verbose_printf(const Config *cfg, int level, cons
     va_end(args);
 }
 
+/* format_time 的小时缓存：一个槽位保存一个本地整点小时 [start, start + 3600) 的 "YYYY-mm-dd HH:" 前缀 */
+#define TIME_CACHE_SLOTS 64
+
+typedef struct {
+    time_t start;           /* 本地整点对应的 UTC 时间戳 */
+    bool   valid;
+    char   prefix[24];      /* strftime("%Y-%m-%d %H:") */
+    size_t prefix_len;
+} TimeCacheSlot;
+
+static __thread TimeCacheSlot t_time_cache[TIME_CACHE_SLOTS];
+
+/**
+ * @brief  计算 t 所在的本地整点小时并写入缓存槽
+ * @param  slot  TimeCacheSlot*  目标槽位，不能为空
+ * @param  t     time_t          时间戳
+ * @param  tm    const struct tm* localtime_r(t) 的结果
+ * @return bool  该小时可整体缓存返回 true；小时内存在时区偏移变化（DST 切换落在非整点）或闰秒时返回 false
+ *
+ * @note   以 tm_min/tm_sec 回推整点，并对整点与 59:59 各做一次 localtime_r 校验：
+ *         两端 UTC 偏移相同且时分秒恰为 HH:00:00 / HH:59:59，才说明这 3600 秒与墙钟一一对应。
+ */
+static bool time_cache_fill(TimeCacheSlot *slot, time_t t, const struct tm *tm) {
+    time_t start = t - (time_t)tm->tm_min * 60 - tm->tm_sec;
+    struct tm a, b;
+    time_t last = start + 3599;
+    if (!localtime_r(&start, &a) || !localtime_r(&last, &b)) return false;
+    if (a.tm_gmtoff != tm->tm_gmtoff || b.tm_gmtoff != tm->tm_gmtoff) return false;
+    if (a.tm_hour != tm->tm_hour || a.tm_min != 0 || a.tm_sec != 0) return false;
+    if (b.tm_hour != tm->tm_hour || b.tm_min != 59 || b.tm_sec != 59) return false;
+    slot->prefix_len = strftime(slot->prefix, sizeof(slot->prefix), "%Y-%m-%d %H:", tm);
+    if (slot->prefix_len == 0) return false;
+    slot->start = start;
+    slot->valid = true;
+    return true;
+}
+
 /**
  * @brief  将 time_t 时间戳格式化为可读字符串
  * @param  t  time_t  要格式化的 Unix 时间戳，取值范围: 有效 Unix 时间（通常为 1970 年之后）
  * @return const char*  指向格式化后字符串的指针，格式为 "YYYY-MM-DD HH:MM:SS"
  *
+ * @note   每线程按小时缓存 "YYYY-mm-dd HH:" 前缀（TIME_CACHE_SLOTS 个直接映射槽位），
+ *         命中时只做算术拼接 MM:SS，不调用 localtime_r（glibc 中持有全局锁，可能 stat /etc/localtime）。
+ *         未命中时 localtime_r + strftime 与旧实现相同，并校验整点两端后填充缓存；
+ *         DST 切换所在的小时若不能整体对应墙钟则不缓存，始终按旧路径逐次转换，输出与旧实现逐字节一致。
  * @warning 返回的指针指向线程局部存储(static __thread)缓冲区，无需释放，
  *          但同一线程后续调用会覆盖前一次结果。如需保留，调用方应自行拷贝。
  */
 const char *format_time(time_t t) {
     static __thread char buffer[32];  // 线程局部存储，避免多线程竞争
-    struct tm tm_buf;
-    localtime_r(&t, &tm_buf);  // 线程安全版本
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_buf);
+    /* 槽位按 UTC 小时直接映射（floor 除法，兼容 1970 年以前的负时间戳） */
+    time_t hour = t / 3600 - (t % 3600 < 0);
+    TimeCacheSlot *slot = &t_time_cache[(size_t)hour % TIME_CACHE_SLOTS];
+
+    if (!slot->valid || t < slot->start || t - slot->start >= 3600) {
+        struct tm tm_buf;
+        if (!localtime_r(&t, &tm_buf) || !time_cache_fill(slot, t, &tm_buf)) {
+            strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tm_buf);
+            return buffer;
+        }
+    }
+
+    unsigned sec = (unsigned)(t - slot->start);
+    unsigned mm = sec / 60, ss = sec % 60;
+    memcpy(buffer, slot->prefix, slot->prefix_len);
+    char *p = buffer + slot->prefix_len;
+    p[0] = (char)('0' + mm / 10);
+    p[1] = (char)('0' + mm % 10);
+    p[2] = ':';
+    p[3] = (char)('0' + ss / 10);
+    p[4] = (char)('0' + ss % 10);
+    p[5] = '\0';
     return buffer;
 }
 
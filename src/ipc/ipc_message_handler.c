@@ -5,8 +5,8 @@
  * 负责 IPC 线程中的消息安全接收与协议处理：
  * - 带 poll 超时的 IPC 安全接收（safe_ipc_recv_header / safe_ipc_recv_payload）
  * - 控制消息读取：HEARTBEAT / ERROR / DEV_TIMEOUT / READY / FINISH / EXIT（read_ctrl_message）
- * - 数据消息读取：BATCH 数据转发（read_data_message）
- * - 主线程命令处理：CMD_SCAN / CMD_REPLACE / CMD_STOP（handle_cmd）
+ * - 数据消息读取：BATCH / FINISH / STOLEN 按序转发（read_data_message；共享内存环为 read_ring_messages）
+ * - 主线程命令处理：CMD_SCAN / CMD_STEAL / CMD_PRUNE / CMD_REPLACE / CMD_STOP（handle_cmd）
  */
 #define _GNU_SOURCE
 #include "ipc_thread.h"
@@ -69,6 +69,26 @@ static int safe_ipc_recv_payload(int fd, void *buf, uint32_t len) {
     return 0;
 }
 
+/* ================================================================
+ * FINISH forwarding (shared by fd_ctrl and fd_data readers)
+ * ================================================================ */
+
+static void forward_finish(IpcThreadCtx *ctx, const void *payload, uint32_t payload_len) {
+    if (payload_len < sizeof(IpcFinishPayload)) return;
+    const IpcFinishPayload *fin = (const IpcFinishPayload*)payload;
+    log_info("[IPC-%d] received FINISH (path_len=%u), forwarding RET_FINISH", ctx->slot_id, fin->path_len);
+    /* Payload: IpcFinishPayload + path bytes */
+    size_t path_len = fin->path_len;
+    if (path_len > 4095) path_len = 4095;
+    char *path_buf = malloc(path_len + 1);
+    if (!path_buf) return;
+    if (payload_len >= sizeof(IpcFinishPayload) + path_len) {
+        memcpy(path_buf, (const char*)payload + sizeof(IpcFinishPayload), path_len);
+    }
+    path_buf[path_len] = '\0';
+    send_return(ctx, RET_FINISH, path_buf, path_len + 1);
+}
+
 /* ================================================================
  * Read a complete IPC message from Worker fd_ctrl
  * ================================================================ */
@@ -173,21 +193,7 @@ void read_ctrl_message(IpcThreadCtx *ctx) {
             break;
         }
         case IPC_MSG_FINISH: {
-            if (hdr.payload_len >= sizeof(IpcFinishPayload)) {
-                IpcFinishPayload *fin = (IpcFinishPayload*)payload;
-                log_info("[IPC-%d] received FINISH (path_len=%u), forwarding RET_FINISH", ctx->slot_id, fin->path_len);
-                /* Payload: IpcFinishPayload + path bytes */
-                size_t path_len = fin->path_len;
-                if (path_len > 4095) path_len = 4095;
-                char *path_buf = malloc(path_len + 1);
-                if (path_buf) {
-                    if (hdr.payload_len >= sizeof(IpcFinishPayload) + path_len) {
-                        memcpy(path_buf, (char*)payload + sizeof(IpcFinishPayload), path_len);
-                    }
-                    path_buf[path_len] = '\0';
-                    send_return(ctx, RET_FINISH, path_buf, path_len + 1);
-                }
-            }
+            forward_finish(ctx, payload, hdr.payload_len);
             free(payload);
             break;
         }
@@ -218,7 +224,8 @@ void read_data_message(IpcThreadCtx *ctx) {
         return;
     }
 
-    if (hdr.msg_type != IPC_MSG_BATCH) {
+    if (hdr.msg_type != IPC_MSG_BATCH && hdr.msg_type != IPC_MSG_FINISH &&
+        hdr.msg_type != IPC_MSG_STOLEN) {
         /* Unexpected message type on fd_data - discard */
         void *tmp = malloc(hdr.payload_len);
         if (tmp) { safe_ipc_recv_payload(ctx->fd_data, tmp, hdr.payload_len); free(tmp); }
@@ -247,11 +254,71 @@ void read_data_message(IpcThreadCtx *ctx) {
         }
     }
 
+    /* FINISH / STOLEN 与 BATCH 同走 fd_data：ret_queue 中严格排在其前序 BATCH 之后 */
+    if (hdr.msg_type == IPC_MSG_FINISH) {
+        forward_finish(ctx, payload, hdr.payload_len);
+        free(payload);
+        return;
+    }
+    if (hdr.msg_type == IPC_MSG_STOLEN) {
+        /* Payload: IpcStolenHeader + records, parsed by master */
+        log_debug("[IPC-%d] received STOLEN (payload=%u), forwarding RET_STOLEN", ctx->slot_id, hdr.payload_len);
+        send_return(ctx, RET_STOLEN, payload, hdr.payload_len);
+        return;
+    }
+
     log_debug("[IPC-%d] received BATCH (payload=%u), forwarding RET_BATCH", ctx->slot_id, hdr.payload_len);
     send_return(ctx, RET_BATCH, payload, hdr.payload_len);
     /* ownership transferred */
 }
 
+/* ================================================================
+ * Read records from the Worker shared-memory data ring
+ * ================================================================ */
+
+/* 单次最多处理的记录数：让出时间给 cmd_queue 与心跳检测，剩余记录使下一轮 epoll_wait 不阻塞 */
+#define RING_READ_BUDGET 256
+
+/**
+ * @brief  读取共享内存环中已发布的记录并按序转发
+ * @param  ctx  IpcThreadCtx*  IPC 线程上下文，不能为空；ctx->ring 为 NULL 时直接返回
+ * @return void
+ *
+ * @note   BATCH / STOLEN 原地转发（主线程解析完成后归还记录）；FINISH 复制路径后立即归还。
+ *         记录越界说明 Worker 写坏了共享内存，按 Worker 死亡处理。
+ */
+void read_ring_messages(IpcThreadCtx *ctx) {
+    for (int n = 0; n < RING_READ_BUDGET && ctx->ring; n++) {
+        uint32_t type = 0, len = 0;
+        void *payload = NULL;
+        int rc = shm_ring_next(ctx->ring, &type, &payload, &len);
+        if (rc == 0) break;
+        if (rc < 0) {
+            log_error("[IPC-%d] corrupt record in data ring, marking worker dead", ctx->slot_id);
+            worker_mark_dead(ctx, true);
+            break;
+        }
+
+        switch (type) {
+            case IPC_MSG_BATCH:
+                log_debug("[IPC-%d] ring BATCH (payload=%u), forwarding RET_BATCH", ctx->slot_id, len);
+                send_return_shm(ctx, RET_BATCH, payload, len);
+                break;
+            case IPC_MSG_STOLEN:
+                log_debug("[IPC-%d] ring STOLEN (payload=%u), forwarding RET_STOLEN", ctx->slot_id, len);
+                send_return_shm(ctx, RET_STOLEN, payload, len);
+                break;
+            case IPC_MSG_FINISH:
+                forward_finish(ctx, payload, len);
+                shm_ring_release(ctx->ring, payload);
+                break;
+            default:
+                shm_ring_release(ctx->ring, payload);
+                break;
+        }
+    }
+}
+
 /* ================================================================
  * Handle commands from master thread
  * ================================================================ */
@@ -309,6 +376,26 @@ void handle_cmd(IpcThreadCtx *ctx, IpcThreadMsg *cmd) {
             }
             break;
         }
+        case CMD_STEAL: {
+            CmdStealPayload *steal = (CmdStealPayload*)cmd->data;
+            if (!steal) break;
+            int rc = (ctx->fd_cmd >= 0)
+                     ? ipc_send(ctx->fd_cmd, IPC_MSG_STEAL, &steal->max_count, sizeof(steal->max_count))
+                     : -1;
+            if (rc != 0) {
+                /* STEAL 只是优化：发不出去时回一个空 STOLEN，让 Master 清除等待标记 */
+                log_debug("[IPC-%d] CMD_STEAL not delivered (rc=%d)", ctx->slot_id, rc);
+                send_return(ctx, RET_STOLEN, NULL, 0);
+            }
+            break;
+        }
+        case CMD_PRUNE: {
+            /* PRUNE 只节省 Worker 的 I/O（Master 已丢弃该子树的条目）：发不出去时直接放弃 */
+            if (!cmd->data || ctx->fd_cmd < 0) break;
+            int rc = ipc_send(ctx->fd_cmd, IPC_MSG_PRUNE, cmd->data, (uint32_t)cmd->data_len);
+            if (rc != 0) log_debug("[IPC-%d] CMD_PRUNE not delivered (rc=%d)", ctx->slot_id, rc);
+            break;
+        }
         case CMD_REPLACE: {
             CmdReplacePayload *rep = (CmdReplacePayload*)cmd->data;
             if (!rep) break;
@@ -326,6 +413,11 @@ void handle_cmd(IpcThreadCtx *ctx, IpcThreadMsg *cmd) {
                 ctx->fd_ctrl = -1;
             }
 
+            /* Switch data ring: the payload's reference is handed over to this thread */
+            ipc_detach_ring(ctx);
+            ctx->ring = rep->ring;
+            rep->ring = NULL;
+
             /* Set new fds */
             ctx->fd_cmd = rep->fd_cmd;
             ctx->fd_data = rep->fd_data;
@@ -357,8 +449,19 @@ void handle_cmd(IpcThreadCtx *ctx, IpcThreadMsg *cmd) {
                     worker_mark_dead(ctx, true);
                 }
             }
-            log_info("[IPC-%d] Worker replaced (pid=%d, fd_data=%d, fd_ctrl=%d)",
-                    ctx->slot_id, (int)ctx->pid, ctx->fd_data, ctx->fd_ctrl);
+            /* Add new data ring eventfd to epoll */
+            if (ctx->epfd >= 0 && ctx->ring) {
+                struct epoll_event ev = {0};
+                ev.events = EPOLLIN;
+                ev.data.u32 = 4; /* slot 4 = data ring eventfd */
+                if (epoll_ctl(ctx->epfd, EPOLL_CTL_ADD, shm_ring_event_fd(ctx->ring), &ev) != 0) {
+                    log_error("[IPC-%d] epoll_ctl ADD data ring eventfd failed: %s",
+                            ctx->slot_id, strerror(errno));
+                    worker_mark_dead(ctx, true);
+                }
+            }
+            log_info("[IPC-%d] Worker replaced (pid=%d, fd_data=%d, fd_ctrl=%d, ring=%s)",
+                    ctx->slot_id, (int)ctx->pid, ctx->fd_data, ctx->fd_ctrl, ctx->ring ? "shm" : "pipe");
             ctx->eagain_retry_count = 0;
             break;
         }
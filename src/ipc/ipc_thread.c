@@ -4,7 +4,7 @@
  *
  * 负责 IPC 线程的上下文创建销毁，以及 epoll 事件驱动主循环：
  * - 线程上下文创建/销毁（ipc_thread_ctx_create / ipc_thread_ctx_destroy）
- * - epoll 主循环：cmd_queue eventfd + fd_data + fd_ctrl 事件分发（ipc_thread_loop）
+ * - epoll 主循环：cmd_queue eventfd + fd_data + fd_ctrl + 数据环 eventfd 事件分发（ipc_thread_loop）
  * - 心跳超时检测与 Worker 杀掉
  * - 线程停止信号（ipc_thread_stop）
  */
@@ -72,6 +72,7 @@ void ipc_thread_ctx_destroy(IpcThreadCtx *ctx) {
     if (ctx->fd_cmd >= 0) close(ctx->fd_cmd);
     if (ctx->fd_data >= 0) close(ctx->fd_data);
     if (ctx->fd_ctrl >= 0) close(ctx->fd_ctrl);
+    shm_ring_unref(ctx->ring);
     if (ctx->epfd >= 0) close(ctx->epfd);
     free(ctx);
 }
@@ -89,8 +90,12 @@ void* ipc_thread_loop(void *arg) {
             handle_cmd(ctx, &cmd);
         }
 
-        /* 2. epoll_wait: fd_data + fd_ctrl + cmd_queue eventfd */
-        int nfds = epoll_wait(ctx->epfd, events, 8, 500);
+        /* 2. epoll_wait: fd_data + fd_ctrl + cmd_queue eventfd + data ring eventfd.
+         *    数据环先声明等待：已有未读记录时不阻塞，Worker 只在看到声明时才写 eventfd */
+        ShmRing *waited = ctx->ring;
+        int wait_ms = (waited && shm_ring_prepare_wait(waited)) ? 0 : 500;
+        int nfds = epoll_wait(ctx->epfd, events, 8, wait_ms);
+        if (waited) shm_ring_finish_wait(waited);
 
         for (int i = 0; i < nfds; i++) {
             uint32_t slot = events[i].data.u32;
@@ -127,8 +132,13 @@ void* ipc_thread_loop(void *arg) {
                 read_ctrl_message(ctx);
                 continue;
             }
+
+            /* slot 4 = data ring eventfd: records are drained below */
         }
 
+        /* 2b. Drain the shared-memory data ring */
+        read_ring_messages(ctx);
+
         /* 3. Heartbeat timeout check */
         if (!atomic_load(&ctx->waiting_replace) && ctx->pid > 0) {
             time_t now = time(NULL);
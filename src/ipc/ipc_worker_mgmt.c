@@ -5,7 +5,8 @@
  * 负责 IPC 线程中的 Worker 状态管理：
  * - Worker 死亡标记与 fd 清理（worker_mark_dead）
  * - 心跳超时杀掉（worker_timeout_kill）
- * - 向 Master 线程发送返回消息（send_return）
+ * - 向 Master 线程发送返回消息（send_return / send_return_shm）
+ * - 共享内存数据环的解绑（ipc_detach_ring）
  */
 #define _GNU_SOURCE
 #include "ipc_thread.h"
@@ -26,6 +27,7 @@
  * ================================================================ */
 
 void worker_mark_dead(IpcThreadCtx *ctx, bool send_notify) {
+    pid_t dead_pid = ctx->pid;
     if (ctx->fd_cmd >= 0) {
         close(ctx->fd_cmd);
         ctx->fd_cmd = -1;
@@ -44,22 +46,43 @@ void worker_mark_dead(IpcThreadCtx *ctx, bool send_notify) {
         close(ctx->fd_ctrl);
         ctx->fd_ctrl = -1;
     }
+    ipc_detach_ring(ctx);
     ctx->pid = -1;
     atomic_store(&ctx->waiting_replace, true);
 
     if (send_notify) {
+        RetDeadPayload *dead = malloc(sizeof(RetDeadPayload));
+        if (dead) dead->pid = dead_pid;
         IpcThreadMsg msg = {
             .type = RET_DEAD,
             .slot_id = ctx->slot_id,
-            .data = NULL,
-            .data_len = 0
+            .data = dead,
+            .data_len = dead ? sizeof(*dead) : 0
         };
         if (!msg_queue_send(ctx->ret_queue, &msg)) {
             log_error("[IPC-%d] ret_queue full, DEAD message dropped", ctx->slot_id);
+            free(dead);
         }
     }
 }
 
+/**
+ * @brief  解绑当前 Worker 的共享内存数据环（移出 epoll 并释放 IPC 线程持有的引用）
+ * @param  ctx  IpcThreadCtx*  IPC 线程上下文，不能为空
+ * @return void
+ *
+ * @note   与关闭 fd_data 等价：未读取的记录随之丢弃，在途目录由 cleanup_dead_worker_slot 重新分发。
+ *         已原地转发给主线程的消息各自持有引用，映射在其归还前保持有效。
+ */
+void ipc_detach_ring(IpcThreadCtx *ctx) {
+    if (!ctx->ring) return;
+    if (ctx->epfd >= 0) {
+        epoll_ctl(ctx->epfd, EPOLL_CTL_DEL, shm_ring_event_fd(ctx->ring), NULL);
+    }
+    shm_ring_unref(ctx->ring);
+    ctx->ring = NULL;
+}
+
 void worker_timeout_kill(IpcThreadCtx *ctx) {
     log_error("[IPC-%d] Worker %d heartbeat timeout, sending SIGKILL (pid=%d)",
             ctx->slot_id, ctx->slot_id, (int)ctx->pid);
@@ -73,16 +96,22 @@ void worker_timeout_kill(IpcThreadCtx *ctx) {
  * Send return message to master
  * ================================================================ */
 
-void send_return(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len) {
-    IpcThreadMsg msg = {
-        .type = type,
-        .slot_id = ctx->slot_id,
-        .data = data,
-        .data_len = len
-    };
-    if (!msg_queue_send(ctx->ret_queue, &msg)) {
+static void send_return_msg(IpcThreadCtx *ctx, IpcThreadMsg *msg) {
+    uint32_t type = msg->type;
+    size_t len = msg->data_len;
+    bool sent = msg_queue_send(ctx->ret_queue, msg);
+    /* BATCH / FINISH / STOLEN 丢失会漏扫或提前结束：队列满时背压等待 Master 消费，
+     * 期间不再读取 fd_data / 数据环，Worker 侧 send_batch 随管道或环写满自然阻塞 */
+    if (!sent && (type == RET_BATCH || type == RET_FINISH || type == RET_STOLEN)) {
+        while (!sent && atomic_load(&ctx->running)) {
+            if (ctx->master_cond) pthread_cond_signal(ctx->master_cond);
+            usleep(1000);
+            sent = msg_queue_send(ctx->ret_queue, msg);
+        }
+    }
+    if (!sent) {
         log_error("[IPC-%d] ret_queue full, message type=%u dropped", ctx->slot_id, type);
-        free(data);
+        msg_release_data(msg);
     } else {
         log_info("[IPC-%d] ret_queue send OK (type=%u, len=%zu, queue=%p)", ctx->slot_id, type, len, (void*)ctx->ret_queue);
         if (ctx->master_cond) {
@@ -90,3 +119,35 @@ void send_return(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len) {
         }
     }
 }
+
+void send_return(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len) {
+    IpcThreadMsg msg = {
+        .type = type,
+        .slot_id = ctx->slot_id,
+        .data = data,
+        .data_len = len
+    };
+    send_return_msg(ctx, &msg);
+}
+
+/**
+ * @brief  原地转发共享内存环中的记录（不拷贝负载）
+ * @param  ctx   IpcThreadCtx*  IPC 线程上下文，不能为空；ctx->ring 不能为空
+ * @param  type  uint32_t       RET_BATCH / RET_STOLEN
+ * @param  data  void*          shm_ring_next 返回的环内负载指针
+ * @param  len   size_t         负载字节数
+ * @return void
+ *
+ * @note   消息持有环的一个引用，主线程处理后经 msg_release_data 归还记录并释放引用。
+ */
+void send_return_shm(IpcThreadCtx *ctx, uint32_t type, void *data, size_t len) {
+    shm_ring_ref(ctx->ring);
+    IpcThreadMsg msg = {
+        .type = type,
+        .slot_id = ctx->slot_id,
+        .data = data,
+        .data_len = len,
+        .ring = ctx->ring
+    };
+    send_return_msg(ctx, &msg);
+}
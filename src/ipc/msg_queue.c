@@ -1,5 +1,6 @@
 #define _GNU_SOURCE
 #include "msg_queue.h"
+#include "shm_ring.h"
 #include "log.h"
 #include <stdlib.h>
 #include <string.h>
@@ -56,7 +57,7 @@ void msg_queue_destroy(MsgQueue *q) {
     /* Drain and free all undelivered messages */
     IpcThreadMsg msg;
     while (msg_queue_recv(q, &msg)) {
-        free(msg.data);
+        msg_release_data(&msg);
     }
 
     if (q->eventfd >= 0) close(q->eventfd);
@@ -157,3 +158,15 @@ void msg_queue_drain_eventfd(MsgQueue *q) {
         /* drain all notifications */
     }
 }
+
+void msg_release_data(IpcThreadMsg *msg) {
+    if (!msg) return;
+    if (msg->ring) {
+        if (msg->data) shm_ring_release(msg->ring, msg->data);
+        shm_ring_unref(msg->ring);
+        msg->ring = NULL;
+    } else {
+        free(msg->data);
+    }
+    msg->data = NULL;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file shm_ring.c
+ * @brief Worker → Master 数据通道的 memfd 共享内存环
+ *
+ * 管道传输一批结果要经过：Worker malloc+memcpy → ipc_send 再 malloc+memcpy → write →
+ * IPC 线程 read 进新 malloc → parse_batch 再拷贝。共享内存环把这一路径缩短为：
+ * Worker 直接序列化进环，Master 在环内原地解析，解析完成后归还空间。
+ *
+ * 布局：ShmRingShared 头部 + capacity 字节数据区，记录为 ShmRingRecord + 负载（16 字节对齐）。
+ * 记录不跨越环尾：剩余连续空间不足时写一条 PAD 记录填满尾部，再从头部写入。
+ * Master 侧允许乱序归还（IPC 线程直接归还 FINISH，主线程稍后归还 BATCH）：
+ * 归还只打标记，tail 仅越过连续已归还的记录。
+ * 等待/唤醒采用「声明等待 → 复查 → 阻塞」的 Dekker 式握手，对端只在看到等待声明时写 eventfd。
+ */
+#define _GNU_SOURCE
+#include "shm_ring.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#define SHM_RING_MAGIC      0x4c46524e47763031ULL   /* "LFRNGv01" */
+#define SHM_RING_MIN_SIZE   (64 * 1024)
+#define SHM_RING_PAD        0u      /* 填充记录类型（IPC_MSG_* 从 1 开始） */
+#define SHM_RING_DONE       1u
+
+/* 共享头部：生产者字段与消费者字段分处不同缓存行 */
+typedef struct {
+    uint64_t         magic;
+    uint64_t         capacity;
+    _Atomic uint64_t head;              /* Worker 已发布位置（字节，单调递增） */
+    char             pad0[40];
+    _Atomic uint64_t tail;              /* Master 已释放位置 */
+    _Atomic uint32_t consumer_waiting;  /* Master IPC 线程即将阻塞在 efd_data 上 */
+    _Atomic uint32_t producer_waiting;  /* Worker 因环满阻塞在 efd_space 上 */
+    char             pad1[48];
+} ShmRingShared;
+
+typedef struct {
+    uint32_t msg_type;
+    uint32_t payload_len;
+    uint32_t state;         /* 0 = 未归还；SHM_RING_DONE = Master 已归还 */
+    uint32_t reserved;
+} ShmRingRecord;
+
+struct ShmRing {
+    ShmRingShared *shm;
+    uint8_t       *data;
+    size_t         map_size;
+    uint64_t       capacity;
+    int            memfd;
+    int            efd_data;    /* Worker → Master：有新记录 */
+    int            efd_space;   /* Master → Worker：有空间 */
+
+    /* 生产者私有 */
+    uint64_t       pending_head;
+
+    /* Master 私有 */
+    _Atomic uint64_t read_pos;  /* IPC 线程已读取位置（>= tail） */
+    pthread_mutex_t  release_mutex;
+    _Atomic int      refs;
+};
+
+static inline uint64_t rec_size(uint32_t payload_len) {
+    return sizeof(ShmRingRecord) + (((uint64_t)payload_len + 15) & ~(uint64_t)15);
+}
+
+static void efd_signal(int fd) {
+    uint64_t one = 1;
+    ssize_t n;
+    do {
+        n = write(fd, &one, sizeof(one));
+    } while (n < 0 && errno == EINTR);
+}
+
+static void efd_drain(int fd) {
+    uint64_t v;
+    while (read(fd, &v, sizeof(v)) > 0) { }
+}
+
+static bool ring_map(ShmRing *r) {
+    void *p = mmap(NULL, r->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, r->memfd, 0);
+    if (p == MAP_FAILED) return false;
+    r->shm = p;
+    r->data = (uint8_t *)p + sizeof(ShmRingShared);
+    return true;
+}
+
+/**
+ * @brief  创建共享内存环（Master 在 fork Worker 前调用）
+ * @param  capacity  size_t  数据区字节数，不足 64KB 时取 64KB，按 16 字节向上取整
+ * @return ShmRing*  成功返回实例（引用计数为 1）；memfd/eventfd/mmap 任一失败返回 NULL
+ *
+ * @note   父进程映射标记 MADV_DONTFORK：之后 fork 的其他 Worker 不会继承本环，
+ *         本环的 Worker 通过 shm_ring_attach 从 memfd 重新映射。
+ */
+ShmRing *shm_ring_create(size_t capacity) {
+    if (capacity < SHM_RING_MIN_SIZE) capacity = SHM_RING_MIN_SIZE;
+    capacity = (capacity + 15) & ~(size_t)15;
+
+    ShmRing *r = calloc(1, sizeof(ShmRing));
+    if (!r) return NULL;
+    r->memfd = r->efd_data = r->efd_space = -1;
+    r->capacity = capacity;
+    r->map_size = sizeof(ShmRingShared) + capacity;
+
+    r->memfd = memfd_create("listfiles-ring", MFD_CLOEXEC);
+    if (r->memfd < 0 || ftruncate(r->memfd, (off_t)r->map_size) != 0 || !ring_map(r)) {
+        log_warn("[ShmRing] create failed (%zu bytes): %s", r->map_size, strerror(errno));
+        if (r->memfd >= 0) close(r->memfd);
+        free(r);
+        return NULL;
+    }
+    madvise(r->shm, r->map_size, MADV_DONTFORK);
+
+    r->efd_data = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    r->efd_space = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->efd_data < 0 || r->efd_space < 0) {
+        log_warn("[ShmRing] eventfd failed: %s", strerror(errno));
+        atomic_init(&r->refs, 1);
+        pthread_mutex_init(&r->release_mutex, NULL);
+        shm_ring_unref(r);
+        return NULL;
+    }
+
+    r->shm->magic = SHM_RING_MAGIC;
+    r->shm->capacity = capacity;
+    atomic_init(&r->shm->head, 0);
+    atomic_init(&r->shm->tail, 0);
+    atomic_init(&r->shm->consumer_waiting, 0);
+    atomic_init(&r->shm->producer_waiting, 0);
+    atomic_init(&r->read_pos, 0);
+    atomic_init(&r->refs, 1);
+    pthread_mutex_init(&r->release_mutex, NULL);
+    return r;
+}
+
+void shm_ring_close_memfd(ShmRing *r) {
+    if (r && r->memfd >= 0) {
+        close(r->memfd);
+        r->memfd = -1;
+    }
+}
+
+/**
+ * @brief  Worker 子进程中重新映射共享内存环
+ * @param  r  ShmRing*  fork 继承的实例副本，不能为空
+ * @return bool  返回 true 表示映射成功；false 时调用方回退 fd_data 管道
+ */
+bool shm_ring_attach(ShmRing *r) {
+    if (r->memfd < 0) return false;
+    bool ok = ring_map(r) && r->shm->magic == SHM_RING_MAGIC && r->shm->capacity == r->capacity;
+    close(r->memfd);
+    r->memfd = -1;
+    r->pending_head = ok ? atomic_load(&r->shm->head) : 0;
+    return ok;
+}
+
+bool shm_ring_owns_fd(const ShmRing *r, int fd) {
+    return r && (fd == r->memfd || fd == r->efd_data || fd == r->efd_space);
+}
+
+uint32_t shm_ring_max_payload(const ShmRing *r) {
+    uint64_t m = r->capacity / 2 - sizeof(ShmRingRecord);
+    return m > UINT32_MAX ? UINT32_MAX : (uint32_t)m;
+}
+
+/* ================================================================
+ * Producer (Worker)
+ * ================================================================ */
+
+static bool ring_has_space(ShmRing *r, uint64_t head, uint64_t need) {
+    uint64_t tail = atomic_load(&r->shm->tail);
+    return r->capacity - (head - tail) >= need;
+}
+
+/**
+ * @brief  预留一条记录的负载空间
+ * @param  r         ShmRing*     已 attach 的实例，不能为空
+ * @param  msg_type  uint32_t     IPC_MSG_* 类型
+ * @param  len       uint32_t     负载字节数，取值范围: <= shm_ring_max_payload
+ * @param  stop      const bool*  放弃标志，允许为 NULL
+ * @return void*  负载写入位置；超长或被 stop 放弃时返回 NULL
+ *
+ * @note   调用方须串行化 reserve/commit（Worker 内由 send_mutex 保证）。
+ *         环满时以 100ms 为周期等待 efd_space，期间检查 stop。
+ */
+void *shm_ring_reserve(ShmRing *r, uint32_t msg_type, uint32_t len, const bool *stop) {
+    if (len > shm_ring_max_payload(r)) return NULL;
+
+    uint64_t head = r->pending_head;
+    uint64_t need = rec_size(len);
+    uint64_t pos = head % r->capacity;
+    uint64_t contiguous = r->capacity - pos;
+    uint64_t total = (need > contiguous) ? contiguous + need : need;
+
+    while (!ring_has_space(r, head, total)) {
+        if (stop && __atomic_load_n(stop, __ATOMIC_RELAXED)) return NULL;
+        atomic_store(&r->shm->producer_waiting, 1);
+        if (!ring_has_space(r, head, total)) {
+            struct pollfd pfd = { r->efd_space, POLLIN, 0 };
+            poll(&pfd, 1, 100);
+            efd_drain(r->efd_space);
+        }
+        atomic_store(&r->shm->producer_waiting, 0);
+    }
+
+    if (need > contiguous) {
+        ShmRingRecord *pad = (ShmRingRecord *)(r->data + pos);
+        pad->msg_type = SHM_RING_PAD;
+        pad->payload_len = (uint32_t)(contiguous - sizeof(ShmRingRecord));
+        pad->state = 0;
+        head += contiguous;
+        pos = 0;
+    }
+
+    ShmRingRecord *rec = (ShmRingRecord *)(r->data + pos);
+    rec->msg_type = msg_type;
+    rec->payload_len = len;
+    rec->state = 0;
+    r->pending_head = head + need;
+    return rec + 1;
+}
+
+void shm_ring_commit(ShmRing *r) {
+    atomic_store(&r->shm->head, r->pending_head);
+    if (atomic_load(&r->shm->consumer_waiting)) efd_signal(r->efd_data);
+}
+
+/* ================================================================
+ * Consumer (Master)
+ * ================================================================ */
+
+int shm_ring_event_fd(const ShmRing *r) {
+    return r->efd_data;
+}
+
+bool shm_ring_prepare_wait(ShmRing *r) {
+    atomic_store(&r->shm->consumer_waiting, 1);
+    return atomic_load(&r->shm->head) != atomic_load(&r->read_pos);
+}
+
+void shm_ring_finish_wait(ShmRing *r) {
+    atomic_store(&r->shm->consumer_waiting, 0);
+    efd_drain(r->efd_data);
+}
+
+/**
+ * @brief  读取下一条记录（仅 IPC 线程调用）
+ * @param  r         ShmRing*   实例，不能为空
+ * @param  msg_type  uint32_t*  输出：IPC_MSG_* 类型
+ * @param  payload   void**     输出：环内负载指针，归还前有效
+ * @param  len       uint32_t*  输出：负载字节数
+ * @return int  1 表示取得记录；0 表示暂无；-1 表示记录越界（Worker 写坏了共享内存）
+ *
+ * @note   PAD 记录在此直接归还并跳过。
+ */
+int shm_ring_next(ShmRing *r, uint32_t *msg_type, void **payload, uint32_t *len) {
+    uint64_t head = atomic_load_explicit(&r->shm->head, memory_order_acquire);
+    uint64_t rp = atomic_load_explicit(&r->read_pos, memory_order_relaxed);
+
+    while (rp != head) {
+        if (head - rp > r->capacity) return -1;
+        uint64_t pos = rp % r->capacity;
+        if (r->capacity - pos < sizeof(ShmRingRecord)) return -1;
+        ShmRingRecord *rec = (ShmRingRecord *)(r->data + pos);
+        uint32_t plen = rec->payload_len;
+        if (plen > r->capacity - pos - sizeof(ShmRingRecord)) return -1;
+        uint64_t size = rec_size(plen);
+        if (size > head - rp) return -1;
+        rp += size;
+        atomic_store_explicit(&r->read_pos, rp, memory_order_release);
+
+        if (rec->msg_type == SHM_RING_PAD) {
+            shm_ring_release(r, rec + 1);
+            continue;
+        }
+        *msg_type = rec->msg_type;
+        *payload = rec + 1;
+        *len = plen;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief  归还一条记录
+ * @param  r        ShmRing*  实例，不能为空
+ * @param  payload  void*     shm_ring_next 返回的负载指针
+ * @return void
+ *
+ * @note   任意 Master 线程可调用。标记后从 tail 起越过连续已归还的记录，
+ *         空间增长且 Worker 正在等待时写 efd_space 唤醒。
+ */
+void shm_ring_release(ShmRing *r, void *payload) {
+    ShmRingRecord *rec = (ShmRingRecord *)payload - 1;
+
+    pthread_mutex_lock(&r->release_mutex);
+    rec->state = SHM_RING_DONE;
+    uint64_t old_tail = atomic_load_explicit(&r->shm->tail, memory_order_relaxed);
+    uint64_t tail = old_tail;
+    uint64_t rp = atomic_load_explicit(&r->read_pos, memory_order_acquire);
+    while (tail != rp) {
+        ShmRingRecord *t = (ShmRingRecord *)(r->data + tail % r->capacity);
+        if (t->state != SHM_RING_DONE) break;
+        tail += rec_size(t->payload_len);
+    }
+    if (tail != old_tail) atomic_store(&r->shm->tail, tail);
+    pthread_mutex_unlock(&r->release_mutex);
+
+    if (tail != old_tail && atomic_load(&r->shm->producer_waiting)) efd_signal(r->efd_space);
+}
+
+void shm_ring_ref(ShmRing *r) {
+    if (r) atomic_fetch_add(&r->refs, 1);
+}
+
+/**
+ * @brief  释放一个引用，归零时解除映射并关闭 fd
+ * @param  r  ShmRing*  实例，允许为 NULL
+ * @return void
+ */
+void shm_ring_unref(ShmRing *r) {
+    if (!r) return;
+    if (atomic_fetch_sub(&r->refs, 1) != 1) return;
+    if (r->shm) munmap(r->shm, r->map_size);
+    if (r->memfd >= 0) close(r->memfd);
+    if (r->efd_data >= 0) close(r->efd_data);
+    if (r->efd_space >= 0) close(r->efd_space);
+    pthread_mutex_destroy(&r->release_mutex);
+    free(r);
+}
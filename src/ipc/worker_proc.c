@@ -2,12 +2,13 @@
  * @file worker_proc.c
  * @brief Worker 进程池管理与 Worker 子进程主入口
  *
- * Master 侧：创建、销毁、替换 Worker 子进程，管理双向管道。
+ * Master 侧：创建、销毁、替换 Worker 子进程，管理双向管道与共享内存数据环。
  * Worker 侧：worker_main 入口，创建 Scanner 线程，维护 IPC 心跳循环。
  */
 #define _GNU_SOURCE
 #include "worker_proc.h"
 #include "log.h"
+#include "shm_ring.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -26,19 +27,20 @@
 
 /**
  * @brief  Worker 子进程主入口函数 (v14.0.0 多线程版)
- * @param  fd_cmd     int  Master→Worker 命令通道 fd (SCAN / STOP)
- * @param  fd_data    int  Worker→Master 数据通道 fd (BATCH)
- * @param  fd_ctrl    int  Worker→Master 控制通道 fd (HEARTBEAT / ERROR / EXIT / FINISH)
+ * @param  fd_cmd     int  Master→Worker 命令通道 fd (SCAN / STEAL / PRUNE / STOP)
+ * @param  fd_data    int  Worker→Master 数据通道 fd (BATCH / FINISH / STOLEN，同一通道保证顺序)
+ * @param  fd_ctrl    int  Worker→Master 控制通道 fd (HEARTBEAT / DEV_TIMEOUT / READY / EXIT)
  * @param  worker_id  int  Worker 编号
+ * @param  ring       ShmRing*  已映射的共享内存数据环，允许为 NULL（数据消息走 fd_data）
  * @return void
  *
- * @note   内部拆分为两条线程：
- *         - Scanner 线程：专职执行 readdir/lstat 等阻塞 IO（worker_scanner_thread）
+ * @note   内部拆分为两类线程：
+ *         - Scanner 线程（--scanner-threads 个）：共享本地任务队列，专职执行 readdir/lstat 等阻塞 IO（worker_scanner_thread）
  *         - IPC 线程（本函数，即主线程）：专职维护 fd_cmd/fd_ctrl 通信与心跳
  *         fd_cmd 设为非阻塞，主线程通过 poll(5s) 循环同时处理：
  *         读任务、发心跳、响应 STOP。Scanner 卡住不影响心跳。
  */
-void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
+void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id, ShmRing *ring) {
     /* 设置 fd_cmd 为非阻塞，使 IPC 线程可用 poll 循环 */
     int flags = fcntl(fd_cmd, F_GETFL);
     if (flags >= 0) {
@@ -50,17 +52,17 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
         .fd_data = fd_data,
         .fd_ctrl = fd_ctrl,
         .worker_id = worker_id,
-        .task_ready = false,
+        .ring = ring,
         .stop_flag = false,
-        .last_progress = time(NULL),
-        .scanner_active = false,
     };
     pthread_mutex_init(&ctx.task_mutex, NULL);
     pthread_cond_init(&ctx.task_cond, NULL);
     pthread_mutex_init(&ctx.progress_mutex, NULL);
+    pthread_mutex_init(&ctx.send_mutex, NULL);
 
-    pthread_t scanner_tid;
-    if (pthread_create(&scanner_tid, NULL, worker_scanner_thread, &ctx) != 0) {
+    const Config *wcfg = worker_get_config();
+    int scanner_threads = (wcfg && wcfg->scanner_threads > 0) ? wcfg->scanner_threads : 1;
+    if (worker_scanners_start(&ctx, scanner_threads) == 0) {
         log_error("[Worker-%d] Failed to create scanner thread", worker_id);
         ipc_send(fd_ctrl, IPC_MSG_EXIT, NULL, 0);
         return;
@@ -70,9 +72,10 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
     int rc_ready = ipc_send(fd_ctrl, IPC_MSG_READY, NULL, 0);
     log_debug("[Worker-%d] READY sent (rc=%d)", worker_id, rc_ready);
 
-    log_info("[Worker-%d] Started, cfg=%p, hb_timeout=%d",
+    log_info("[Worker-%d] Started, cfg=%p, hb_timeout=%d, scanners=%d, data=%s",
              worker_id, (void*)worker_get_config(),
-             worker_get_config() ? worker_get_config()->heartbeat_timeout : -1);
+             worker_get_config() ? worker_get_config()->heartbeat_timeout : -1, ctx.scanner_count,
+             ring ? "shm" : "pipe");
 
     struct pollfd pfd = { fd_cmd, POLLIN, 0 };
     time_t last_heartbeat = time(NULL);
@@ -92,7 +95,8 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
 
         if (rc == 0 || elapsed >= 5) {
             heartbeat_count++;
-            if (ctx.scanner_active) {
+            time_t active_since;
+            if (worker_scanners_oldest_active(&ctx, &active_since, NULL, 0)) {
                 log_info("[Worker-%d] Scanner active (heartbeat %d)", worker_id, heartbeat_count);
             }
             IpcHeartbeatPayload hb = { (uint64_t)time(NULL) };
@@ -123,11 +127,36 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
                 }
                 ctx.stop_flag = true;
                 pthread_mutex_lock(&ctx.task_mutex);
-                pthread_cond_signal(&ctx.task_cond);
+                pthread_cond_broadcast(&ctx.task_cond);
                 pthread_mutex_unlock(&ctx.task_mutex);
                 break;
             }
 
+            if (hdr.msg_type == IPC_MSG_STEAL) {
+                uint32_t max_count = 0;
+                if (hdr.payload_len == sizeof(max_count)) {
+                    if (ipc_recv_payload(fd_cmd, &max_count, sizeof(max_count)) != 0) break;
+                } else if (hdr.payload_len > 0) {
+                    void *tmp = malloc(hdr.payload_len);
+                    if (tmp) { ipc_recv_payload(fd_cmd, tmp, hdr.payload_len); free(tmp); }
+                }
+                worker_steal_local(&ctx, max_count);
+                continue;
+            }
+
+            if (hdr.msg_type == IPC_MSG_PRUNE) {
+                char *prune_path = malloc(hdr.payload_len + 1);
+                if (!prune_path) break;
+                if (ipc_recv_payload(fd_cmd, prune_path, hdr.payload_len) != 0) {
+                    free(prune_path);
+                    break;
+                }
+                prune_path[hdr.payload_len] = '\0';
+                worker_prune_local(&ctx, prune_path);
+                free(prune_path);
+                continue;
+            }
+
             if (hdr.msg_type != IPC_MSG_SCAN) {
                 log_debug("[Worker-%d] unexpected msg_type=%d, dropping", worker_id, hdr.msg_type);
                 if (hdr.payload_len > 0) {
@@ -147,14 +176,11 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
             }
             dir_path[hdr.payload_len] = '\0';
 
-            pthread_mutex_lock(&ctx.task_mutex);
-            strncpy(ctx.task_path, dir_path, sizeof(ctx.task_path) - 1);
-            ctx.task_path[sizeof(ctx.task_path) - 1] = '\0';
-            ctx.task_ready = true;
-            pthread_cond_signal(&ctx.task_cond);
-            pthread_mutex_unlock(&ctx.task_mutex);
-
-            free(dir_path);
+            /* 入本地队列：Scanner 扫完当前目录后直接取下一个，无需等待 Master 往返 */
+            if (!worker_task_push(&ctx, dir_path)) {
+                free(dir_path);
+                break;
+            }
         }
 
         if (pfd.revents & (POLLERR | POLLHUP)) {
@@ -162,22 +188,16 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
         }
         /* Scanner progress timeout check */
         const Config *cfg = worker_get_config();
-        if (cfg && ctx.scanner_active) {
-            pthread_mutex_lock(&ctx.progress_mutex);
-            time_t scanner_last = ctx.last_progress;
-            pthread_mutex_unlock(&ctx.progress_mutex);
+        time_t scanner_last;
+        char stuck_path[4096];
+        if (cfg && worker_scanners_oldest_active(&ctx, &scanner_last, stuck_path, sizeof(stuck_path))) {
             int timeout_sec = cfg->heartbeat_timeout > 0
                               ? cfg->heartbeat_timeout
                               : HEARTBEAT_TIMEOUT_SEC;
             if (difftime(now, scanner_last) > timeout_sec) {
                 log_error("[Worker-%d] Scanner stuck for %ds on %s, reporting to master",
-                          worker_id, timeout_sec, ctx.task_path);
+                          worker_id, timeout_sec, stuck_path);
                 IpcErrorHeader eh = { ETIMEDOUT, 0 };
-                char stuck_path[4096];
-                pthread_mutex_lock(&ctx.task_mutex);
-                strncpy(stuck_path, ctx.task_path, sizeof(stuck_path) - 1);
-                stuck_path[sizeof(stuck_path) - 1] = '\0';
-                pthread_mutex_unlock(&ctx.task_mutex);
                 uint32_t plen = (uint32_t)strlen(stuck_path);
                 size_t err_total = sizeof(eh) + sizeof(plen) + plen;
                 uint8_t *err_buf = malloc(err_total);
@@ -192,18 +212,16 @@ void worker_main(int fd_cmd, int fd_data, int fd_ctrl, int worker_id) {
         }
     }
 
-    /* 通知 Scanner 停止并等待其结束 */
-    pthread_mutex_lock(&ctx.task_mutex);
-    ctx.stop_flag = true;
-    pthread_cond_signal(&ctx.task_cond);
-    pthread_mutex_unlock(&ctx.task_mutex);
-    pthread_join(scanner_tid, NULL);
+    /* 通知全部 Scanner 停止并等待其结束 */
+    worker_scanners_join(&ctx);
+    worker_task_queue_free(&ctx);
 
     ipc_send(fd_ctrl, IPC_MSG_EXIT, NULL, 0);
 
     pthread_mutex_destroy(&ctx.task_mutex);
     pthread_cond_destroy(&ctx.task_cond);
     pthread_mutex_destroy(&ctx.progress_mutex);
+    pthread_mutex_destroy(&ctx.send_mutex);
 }
 
 /* ================================================================
@@ -234,7 +252,7 @@ WorkerPool* worker_pool_create(int num_workers) {
  * @return void
  *
  * @note   对存活的 Worker 发送 SIGKILL（不阻塞等待，避免 D-State 挂起），
- *         关闭所有管道 fd，释放 backlog_paths 中的路径内存。
+ *         关闭所有管道 fd，释放 backlog_paths、inflight_paths 与 claims 中的路径内存。
  *         最后以非阻塞方式收割所有僵尸子进程（waitpid(-1, WNOHANG)）。
  */
 void worker_pool_destroy(WorkerPool *pool) {
@@ -253,6 +271,17 @@ void worker_pool_destroy(WorkerPool *pool) {
             free(slot->backlog_paths[j]);
         }
         free(slot->backlog_paths);
+        /* Free in-flight paths */
+        for (int j = 0; j < atomic_load(&slot->inflight_count); j++) {
+            free(slot->inflight_paths[j]);
+        }
+        free(slot->inflight_paths);
+        /* Free local descent claims */
+        for (int j = 0; j < slot->claim_count; j++) {
+            free(slot->claims[j].path);
+        }
+        free(slot->claims);
+        shm_ring_unref(slot->ring);
     }
     /* Non-blocking reap of any zombie children */
     for (int i = 0; i < pool->num_workers * 3; i++) {
@@ -287,8 +316,15 @@ static void enlarge_pipe(int fd) {
  * @note   创建双向 pipe2(O_CLOEXEC)，子进程关闭无关 fd 后进入 worker_main 循环。
  *         Master 的 fd_in 写端设置为非阻塞（O_NONBLOCK），配合 backlog 机制防止双向管道死锁。
  *         成功后会初始化 slot 的心跳时间和积压队列。
+ *         pool->ring_capacity > 0 时额外创建 memfd 数据环（创建失败则告警并回退 fd_data 管道），
+ *         子进程保留环的 memfd/eventfd 并重新映射；父进程 fork 后关闭 memfd。
  */
 bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
+    WorkerSlot *slot = &pool->slots[slot_id];
+    /* 上一次 spawn 的环尚未移交 IPC 线程（替换失败等），先释放 */
+    shm_ring_unref(slot->ring);
+    slot->ring = NULL;
+
     int cmd_pipe[2], data_pipe[2], ctrl_pipe[2];
     if (pipe2(cmd_pipe, O_CLOEXEC) != 0) return false;
     if (pipe2(data_pipe, O_CLOEXEC) != 0) {
@@ -334,8 +370,17 @@ bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
         log_warn("[worker_pool_spawn] fcntl(F_GETFL) on fd_ctrl_wr failed: errno=%d", errno);
     }
 
+    ShmRing *ring = NULL;
+    if (pool->ring_capacity > 0) {
+        ring = shm_ring_create(pool->ring_capacity);
+        if (!ring) {
+            log_warn("[worker_pool_spawn] shm ring unavailable for worker %d, falling back to fd_data pipe", slot_id);
+        }
+    }
+
     pid_t pid = fork();
     if (pid < 0) {
+        shm_ring_unref(ring);
         close(cmd_pipe[0]); close(cmd_pipe[1]);
         close(data_pipe[0]); close(data_pipe[1]);
         close(ctrl_pipe[0]); close(ctrl_pipe[1]);
@@ -348,16 +393,22 @@ bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
         close(data_pipe[0]);
         close(ctrl_pipe[0]);
 
-        /* Close all inherited fds except our pipes */
+        /* Close all inherited fds except our pipes (and the directory listing writer) */
         int max_fd = (int)sysconf(_SC_OPEN_MAX);
         if (max_fd < 0) max_fd = 65536;
+        int dirlist_fd = worker_get_dirlist_fd();
         for (int fd = 3; fd < max_fd; fd++) {
-            if (fd != cmd_pipe[0] && fd != data_pipe[1] && fd != ctrl_pipe[1]) {
+            if (fd != cmd_pipe[0] && fd != data_pipe[1] && fd != ctrl_pipe[1] && fd != dirlist_fd &&
+                !(ring && shm_ring_owns_fd(ring, fd))) {
                 close(fd);
             }
         }
+        if (ring && !shm_ring_attach(ring)) {
+            log_warn("[Worker-%d] shm ring attach failed, using fd_data pipe", slot_id);
+            ring = NULL;
+        }
 
-        worker_main(cmd_pipe[0], data_pipe[1], ctrl_pipe[1], slot_id);
+        worker_main(cmd_pipe[0], data_pipe[1], ctrl_pipe[1], slot_id, ring);
         _exit(0);
     }
 
@@ -365,6 +416,7 @@ bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
     /* 注意：保留 cmd_pipe[0] 给 cleanup_dead_worker_slot drain 用，不要在这里关闭 */
     close(data_pipe[1]);
     close(ctrl_pipe[1]);
+    if (ring) shm_ring_close_memfd(ring);
 
     /* Master write end must be non-blocking to prevent bidirectional pipe deadlock */
     int flags = fcntl(cmd_pipe[1], F_GETFL);
@@ -374,8 +426,8 @@ bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
         log_warn("[worker_pool_spawn] fcntl(F_GETFL) on fd_cmd failed: errno=%d", errno);
     }
 
-    WorkerSlot *slot = &pool->slots[slot_id];
     slot->pid = pid;
+    slot->ring = ring;
     slot->fd_cmd = cmd_pipe[1];
     slot->fd_cmd_rd = cmd_pipe[0];
     slot->fd_data = data_pipe[0];
@@ -388,6 +440,17 @@ bool worker_pool_spawn(WorkerPool *pool, int slot_id) {
     slot->backlog_paths = NULL;
     slot->backlog_count = 0;
     slot->backlog_capacity = 0;
+    /* 在途记录由 cleanup_dead_worker_slot 迁移到 lost_tasks；新进程从空窗口开始 */
+    for (int j = 0; j < atomic_load(&slot->inflight_count); j++) {
+        free(slot->inflight_paths[j]);
+    }
+    atomic_store(&slot->inflight_count, 0);
+    for (int j = 0; j < slot->claim_count; j++) {
+        free(slot->claims[j].path);
+    }
+    slot->claim_count = 0;
+    slot->steal_pending = false;
+    slot->steal_retry_ms = 0;
     atomic_flag_clear(&slot->cleanup_done);
     atomic_fetch_add(&pool->active_count, 1);
     return true;
@@ -2,10 +2,22 @@
  * @file async_worker.c
  * @brief 异步输出工作线程实现
  *
- * 独立的后台线程负责将主循环批量提交的文件记录格式化并写入输出流。
+ * 独立的后台线程负责将主循环批量提交的文件记录渲染到行缓冲区，并整块写入输出流。
  * 采用 mutex + cond 的生产者-消费者模型，支持批量 dequeue（一次性取出整个链表），
  * 将锁竞争降低至 1/256（ASYNC_BATCH_SIZE）。
+ * 主循环经 output_batch_append 提交的节点按块分配，路径引用批次的共享路径缓冲，
+ * 逐条记录不再 malloc/strdup。
  * 同时支持按行数切分输出文件（output_split_dir 模式）。
+ *
+ * --writer-threads > 1 时拆为两级：N 个格式化线程各自从队列领取约 ASYNC_CHUNK_TASKS 条记录
+ * 渲染到独立缓冲区，单个写出线程按领取顺序（ordered）或完成顺序（unordered）追加写出，
+ * 切片轮转与 output_line_count 计数只在写出线程中进行。
+ *
+ * --output-shards 时不创建写出线程：每个格式化线程把渲染结果直接写入自己独占的切片序列
+ * （OutputShard），彼此之间没有任何写出串行化。
+ *
+ * --output-compress=gzip 时（不论线程数）同样走格式化线程组：每个块渲染后在格式化线程中
+ * 压缩为独立的 gzip member，写出端按块拼接成多 member gzip 流，切片只在块边界轮转。
  */
 #include "async_worker.h"
 #include "output.h"
@@ -13,6 +25,28 @@
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include "log.h"
+#include "utils.h"
+
+/**
+ * @brief  释放已处理的输出节点
+ * @param  t  OutputTask*  节点指针，不能为空；调用后不得再访问
+ * @return void
+ *
+ * @note   块内节点只在最后一个节点处理完后整块释放（块内节点按追加顺序出现在链表中）。
+ */
+static void output_task_free(OutputTask *t) {
+    if (t->arena) {
+        path_arena_unref(t->arena);
+    } else {
+        free(t->path);
+    }
+    if (!t->block) {
+        free(t);
+    } else if (t->block_end) {
+        free(t->block);
+    }
+}
 
 /**
  * @brief  异步输出工作线程主函数
@@ -20,12 +54,15 @@
  * @return void*  始终返回 NULL
  *
  * @note   线程启动后进入循环：等待条件变量唤醒 → 批量取出任务链表 →
- *         串行调用 print_to_stream 写入文件 → 释放任务内存。
+ *         串行调用 render_line 渲染到行缓冲区 → 释放任务内存。
+ *         缓冲区超过 OUTPUT_RENDER_FLUSH、切片轮转前以及本轮链表处理完时整块 write()。
  *         当 stop 标志为 true 且任务链表为空时退出循环。
  *         退出前执行 fflush 确保数据落盘。
  */
 static void *async_writer_thread(void *arg) {
     AsyncWorker *w = (AsyncWorker*)arg;
+    LineBuf lb;
+    line_buf_init(&lb, OUTPUT_RENDER_FLUSH + MAX_PATH_LENGTH * 4);
     while (1) {
         pthread_mutex_lock(&w->mutex);
         while (!w->stop && w->head == NULL) {
@@ -47,16 +84,355 @@ static void *async_writer_thread(void *arg) {
         while (task) {
             OutputTask *next = task->next;
             if (w->state->output_fp) {
-                print_to_stream(w->cfg, w->state, task->path, &task->st, w->state->output_fp);
+                render_line(w->cfg, w->state, task->path, &task->st, &lb);
                 w->state->output_line_count++;
                 if (w->cfg->is_output_split_dir && w->state->output_line_count >= w->cfg->output_slice_lines) {
+                    line_buf_flush(&lb, w->state->output_fp);
                     rotate_output_slice(w->cfg, w->state);
+                } else if (lb.len >= OUTPUT_RENDER_FLUSH) {
+                    line_buf_flush(&lb, w->state->output_fp);
                 }
             }
-            free(task->path);
-            free(task);
+            output_task_free(task);
             task = next;
         }
+        if (w->state->output_fp) line_buf_flush(&lb, w->state->output_fp);
+    }
+    line_buf_free(&lb);
+    if (w->state->output_fp && w->state->output_fp != stdout) {
+        fflush(w->state->output_fp);
+    }
+    return NULL;
+}
+
+/* ================================================================
+ * --writer-threads > 1：格式化线程组 + 写出线程
+ * ================================================================ */
+
+/**
+ * @brief  从输出队列头部摘下一个格式化块（调用方持有 w->mutex，队列非空）
+ * @param  w      AsyncWorker*  工作线程控制结构，不能为空
+ * @param  count  size_t*       输出块内记录数，不能为空
+ * @return OutputTask*  块首节点，块内节点以 next 相连且尾节点 next 为 NULL
+ *
+ * @note   取满 ASYNC_CHUNK_TASKS 条后继续取到节点块边界（非块节点或 block_end 节点）为止：
+ *         节点块在处理完 block_end 节点后整块释放，同一节点块不能分给两个格式化线程。
+ */
+static OutputTask *chunk_detach_locked(AsyncWorker *w, size_t *count) {
+    OutputTask *first = w->head, *last = first;
+    size_t n = 1;
+    while (last->next && (n < ASYNC_CHUNK_TASKS || (last->block && !last->block_end))) {
+        last = last->next;
+        n++;
+    }
+    w->head = last->next;
+    if (!w->head) w->tail = NULL;
+    last->next = NULL;
+    *count = n;
+    return first;
+}
+
+/**
+ * @brief  渲染一个块内的全部记录并释放任务节点
+ * @param  w     AsyncWorker*  工作线程控制结构，不能为空
+ * @param  task  OutputTask*   块首节点（chunk_detach_locked 的返回值）
+ * @param  lb    LineBuf*      追加渲染结果的缓冲区，不能为空
+ * @param  ends  size_t*       非 NULL 时记录每行在 lb 中的结束偏移，容量不少于块内记录数
+ * @return unsigned long  渲染的行数
+ */
+static unsigned long render_chunk(AsyncWorker *w, OutputTask *task, LineBuf *lb, size_t *ends) {
+    unsigned long lines = 0;
+    while (task) {
+        OutputTask *next = task->next;
+        render_line(w->cfg, w->state, task->path, &task->st, lb);
+        if (ends) ends[lines] = lb->len;
+        lines++;
+        output_task_free(task);
+        task = next;
+    }
+    return lines;
+}
+
+/**
+ * @brief  初始化格式化线程私有的 gzip 编码器（未启用压缩时不初始化）
+ * @param  w    AsyncWorker*  工作线程控制结构，不能为空
+ * @param  enc  GzipEncoder*  编码器，不能为空
+ * @return void
+ *
+ * @note   初始化失败（zlib 内存不足）时记录 fatal 并退出，与缓冲区扩容失败的处理一致。
+ */
+static void chunk_encoder_init(AsyncWorker *w, GzipEncoder *enc) {
+    enc->ready = false;
+    if (w->cfg->output_compress && !gzip_encoder_init(enc, w->cfg->output_compress)) {
+        log_fatal("无法初始化输出压缩");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief  把渲染好的块压缩为一个 gzip member
+ * @param  enc  GzipEncoder*    已初始化的编码器，不能为空
+ * @param  raw  const LineBuf*  渲染结果
+ * @param  out  LineBuf*        输出缓冲区，先清空再写入
+ * @return void
+ *
+ * @note   压缩失败时记录 fatal 并退出，不写出半压缩的输出。
+ */
+static void chunk_compress(GzipEncoder *enc, const LineBuf *raw, LineBuf *out) {
+    out->len = 0;
+    if (!gzip_encode_member(enc, raw->data, raw->len, out)) {
+        log_fatal("输出压缩失败");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief  --output-shards：领取、渲染并写入本线程独占的分片，直到 stop 且队列为空
+ * @param  w      AsyncWorker*  工作线程控制结构，不能为空
+ * @param  shard  OutputShard*  本线程认领的分片，不能为空
+ * @return void
+ *
+ * @note   渲染缓冲区与行结束偏移表跨块复用；每写满 output_slice_lines 行在行边界轮转到
+ *         下一个切片。分片的第一个切片在首次写出时创建，没有领取到记录的线程不产生文件。
+ *         压缩输出时整块压缩为一个 gzip member 写出，切片写满后在下一个块之前轮转。
+ */
+static void shard_writer_loop(AsyncWorker *w, OutputShard *shard) {
+    LineBuf lb, zb = {0};
+    GzipEncoder enc;
+    chunk_encoder_init(w, &enc);
+    line_buf_init(&lb, ASYNC_CHUNK_TASKS * 128);
+    size_t ends_cap = ASYNC_CHUNK_TASKS + ASYNC_BATCH_SIZE;
+    size_t *ends = safe_malloc(ends_cap * sizeof(size_t));
+    while (1) {
+        pthread_mutex_lock(&w->mutex);
+        while (!w->stop && w->head == NULL) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->head == NULL) {
+            pthread_mutex_unlock(&w->mutex);
+            break;
+        }
+        size_t count;
+        OutputTask *task = chunk_detach_locked(w, &count);
+        if (w->head) pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->mutex);
+
+        if (count > ends_cap) {
+            free(ends);
+            ends_cap = count;
+            ends = safe_malloc(ends_cap * sizeof(size_t));
+        }
+        lb.len = 0;
+        unsigned long lines = render_chunk(w, task, &lb, enc.ready ? NULL : ends);
+
+        if (enc.ready) {
+            if (!shard->fp || shard->line_count >= w->cfg->output_slice_lines) {
+                rotate_output_shard(w->cfg, shard);
+            }
+            chunk_compress(&enc, &lb, &zb);
+            output_write_all(shard->fp, zb.data, zb.len);
+            shard->line_count += lines;
+            continue;
+        }
+        unsigned long done = 0;
+        size_t off = 0;
+        while (done < lines) {
+            if (!shard->fp || shard->line_count >= w->cfg->output_slice_lines) {
+                rotate_output_shard(w->cfg, shard);
+            }
+            unsigned long room = w->cfg->output_slice_lines > shard->line_count
+                               ? w->cfg->output_slice_lines - shard->line_count : 1;
+            unsigned long take = lines - done < room ? lines - done : room;
+            size_t end = ends[done + take - 1];
+            output_write_all(shard->fp, lb.data + off, end - off);
+            off = end;
+            done += take;
+            shard->line_count += take;
+        }
+    }
+    free(ends);
+    line_buf_free(&lb);
+    line_buf_free(&zb);
+    gzip_encoder_end(&enc);
+}
+
+/**
+ * @brief  格式化线程主函数
+ * @param  arg  void*  指向 AsyncWorker 的指针
+ * @return void*  始终返回 NULL
+ *
+ * @note   循环：预留在途名额（超过 ASYNC_INFLIGHT_PER_THREAD × 线程数时等待写出线程追上）→
+ *         从输出队列领取一个块并分配序号 → render_line 渲染到块私有缓冲区、释放任务 →
+ *         挂入已完成链表唤醒写出线程。stop 且队列为空时归还名额退出。
+ *         --output-shards 时按启动顺序认领一个 OutputShard，领取的块渲染后直接写入该分片，
+ *         不经过在途名额与已完成链表，退出时关闭分片。
+ */
+static void *async_formatter_thread(void *arg) {
+    AsyncWorker *w = (AsyncWorker*)arg;
+    if (w->state->shards) {
+        OutputShard *shard = &w->state->shards[__atomic_fetch_add(&w->next_shard, 1, __ATOMIC_RELAXED)];
+        shard_writer_loop(w, shard);
+        close_output_shard(shard);
+        return NULL;
+    }
+    int cap = ASYNC_INFLIGHT_PER_THREAD * w->nformatters;
+    GzipEncoder enc;
+    LineBuf raw = {0};
+    chunk_encoder_init(w, &enc);
+    while (1) {
+        pthread_mutex_lock(&w->done_mutex);
+        while (w->inflight >= cap) {
+            pthread_cond_wait(&w->space_cond, &w->done_mutex);
+        }
+        w->inflight++;
+        pthread_mutex_unlock(&w->done_mutex);
+
+        pthread_mutex_lock(&w->mutex);
+        while (!w->stop && w->head == NULL) {
+            pthread_cond_wait(&w->cond, &w->mutex);
+        }
+        if (w->head == NULL) {
+            pthread_mutex_unlock(&w->mutex);
+            pthread_mutex_lock(&w->done_mutex);
+            w->inflight--;
+            pthread_cond_signal(&w->space_cond);
+            pthread_mutex_unlock(&w->done_mutex);
+            break;
+        }
+        size_t count;
+        OutputTask *task = chunk_detach_locked(w, &count);
+        uint64_t seq = w->next_seq++;
+        if (w->head) pthread_cond_signal(&w->cond);  /* 队列仍有剩余，接力唤醒其他格式化线程 */
+        pthread_mutex_unlock(&w->mutex);
+
+        RenderedChunk *c = safe_malloc(sizeof(RenderedChunk));
+        c->seq = seq;
+        c->next = NULL;
+        c->ends = w->cfg->is_output_split_dir && !enc.ready ? safe_malloc(count * sizeof(size_t)) : NULL;
+        if (enc.ready) {
+            raw.len = 0;
+            c->lines = render_chunk(w, task, &raw, NULL);
+            line_buf_init(&c->buf, raw.len / 4 + 64);
+            chunk_compress(&enc, &raw, &c->buf);
+        } else {
+            line_buf_init(&c->buf, count * 128);
+            c->lines = render_chunk(w, task, &c->buf, c->ends);
+        }
+
+        pthread_mutex_lock(&w->done_mutex);
+        if (w->done_tail) {
+            w->done_tail->next = c;
+        } else {
+            w->done = c;
+        }
+        w->done_tail = c;
+        pthread_cond_signal(&w->done_cond);
+        pthread_mutex_unlock(&w->done_mutex);
+    }
+
+    line_buf_free(&raw);
+    gzip_encoder_end(&enc);
+
+    pthread_mutex_lock(&w->done_mutex);
+    w->formatters_alive--;
+    pthread_cond_signal(&w->done_cond);
+    pthread_mutex_unlock(&w->done_mutex);
+    return NULL;
+}
+
+/**
+ * @brief  从已完成链表取出下一个可写出的块（调用方持有 done_mutex）
+ * @param  w  AsyncWorker*  工作线程控制结构，不能为空
+ * @return RenderedChunk*  可写出的块；暂无时返回 NULL
+ *
+ * @note   unordered 取链表头（完成顺序）；ordered 取序号等于 written_seq 的块（提交顺序），
+ *         在途块数有上限，线性查找开销可忽略。
+ */
+static RenderedChunk *sink_take_locked(AsyncWorker *w) {
+    RenderedChunk *prev = NULL, *c = w->done;
+    if (!w->cfg->writer_unordered) {
+        while (c && c->seq != w->written_seq) {
+            prev = c;
+            c = c->next;
+        }
+    }
+    if (!c) return NULL;
+    if (prev) {
+        prev->next = c->next;
+    } else {
+        w->done = c->next;
+    }
+    if (w->done_tail == c) w->done_tail = prev;
+    w->written_seq++;
+    return c;
+}
+
+/**
+ * @brief  写出一个已渲染块，必要时在行边界轮转输出切片
+ * @param  w  AsyncWorker*    工作线程控制结构，不能为空
+ * @param  c  RenderedChunk*  待写出的块，不能为空
+ * @return void
+ *
+ * @note   与单线程模式相同：每写满 output_slice_lines 行立即调用 rotate_output_slice，
+ *         切片内行数与 output_line_count 计数逐行一致。
+ *         压缩输出的块（无行偏移表）不可拆分，整块写出后切片写满即轮转，切片行数按块取整。
+ */
+static void sink_write_chunk(AsyncWorker *w, RenderedChunk *c) {
+    RuntimeState *st = w->state;
+    if (!st->output_fp) return;
+    if (!c->ends) {
+        output_write_all(st->output_fp, c->buf.data, c->buf.len);
+        st->output_line_count += c->lines;
+        if (w->cfg->is_output_split_dir && st->output_line_count >= w->cfg->output_slice_lines) {
+            rotate_output_slice(w->cfg, st);
+        }
+        return;
+    }
+    unsigned long done = 0;
+    size_t off = 0;
+    while (done < c->lines) {
+        unsigned long room = w->cfg->output_slice_lines > st->output_line_count
+                           ? w->cfg->output_slice_lines - st->output_line_count : 1;
+        unsigned long take = c->lines - done < room ? c->lines - done : room;
+        size_t end = c->ends[done + take - 1];
+        output_write_all(st->output_fp, c->buf.data + off, end - off);
+        off = end;
+        done += take;
+        st->output_line_count += take;
+        if (st->output_line_count >= w->cfg->output_slice_lines) {
+            rotate_output_slice(w->cfg, st);
+        }
+    }
+}
+
+/**
+ * @brief  写出线程主函数（--writer-threads > 1）
+ * @param  arg  void*  指向 AsyncWorker 的指针
+ * @return void*  始终返回 NULL
+ *
+ * @note   按 --writer-order 取块写出并归还在途名额；格式化线程全部退出且无剩余块时结束，
+ *         退出前 fflush 输出流。
+ */
+static void *async_sink_thread(void *arg) {
+    AsyncWorker *w = (AsyncWorker*)arg;
+    while (1) {
+        pthread_mutex_lock(&w->done_mutex);
+        RenderedChunk *c;
+        while ((c = sink_take_locked(w)) == NULL && w->formatters_alive > 0) {
+            pthread_cond_wait(&w->done_cond, &w->done_mutex);
+        }
+        pthread_mutex_unlock(&w->done_mutex);
+        if (!c) break;
+
+        sink_write_chunk(w, c);
+        line_buf_free(&c->buf);
+        free(c->ends);
+        free(c);
+
+        pthread_mutex_lock(&w->done_mutex);
+        w->inflight--;
+        pthread_cond_signal(&w->space_cond);
+        pthread_mutex_unlock(&w->done_mutex);
     }
     if (w->state->output_fp && w->state->output_fp != stdout) {
         fflush(w->state->output_fp);
@@ -70,7 +446,11 @@ static void *async_writer_thread(void *arg) {
  * @param  state  RuntimeState*   运行时状态指针，不能为空（用于访问 output_fp 等输出句柄）
  * @return AsyncWorker*  成功返回指向新分配工作线程控制结构的指针；内存不足时返回 NULL
  *
- * @note   内部创建独立 pthread，线程函数为 async_writer_thread。
+ * @note   --writer-threads 为 1 时创建单个 async_writer_thread；大于 1 时创建
+ *         writer_threads 个 async_formatter_thread 与一个 async_sink_thread。
+ *         --output-shards 时（不论线程数）只创建 writer_threads 个 async_formatter_thread，
+ *         各自写入 state->shards 中的一个分片。--output-compress 时即使只有 1 个线程也走格式化线程组，
+ *         压缩与写出重叠进行。
  *         调用方需在程序结束前调用 async_worker_shutdown 进行清理。
  */
 AsyncWorker* async_worker_init(const Config *cfg, RuntimeState *state) {
@@ -80,7 +460,27 @@ AsyncWorker* async_worker_init(const Config *cfg, RuntimeState *state) {
     w->state = state;
     pthread_mutex_init(&w->mutex, NULL);
     pthread_cond_init(&w->cond, NULL);
-    pthread_create(&w->thread, NULL, async_writer_thread, w);
+    if (cfg->writer_threads <= 1 && !state->shards && !cfg->output_compress) {
+        pthread_create(&w->thread, NULL, async_writer_thread, w);
+        return w;
+    }
+
+    pthread_mutex_init(&w->done_mutex, NULL);
+    pthread_cond_init(&w->done_cond, NULL);
+    pthread_cond_init(&w->space_cond, NULL);
+    w->formatters = safe_malloc((size_t)cfg->writer_threads * sizeof(pthread_t));
+    w->nformatters = cfg->writer_threads;
+    w->formatters_alive = cfg->writer_threads;
+    for (int i = 0; i < cfg->writer_threads; i++) {
+        pthread_create(&w->formatters[i], NULL, async_formatter_thread, w);
+    }
+    if (state->shards) {
+        log_debug("[Output] %d 个输出线程, 分片写出", cfg->writer_threads);
+        return w;
+    }
+    pthread_create(&w->thread, NULL, async_sink_thread, w);
+    log_debug("[Output] %d 个格式化线程, 写出顺序: %s", cfg->writer_threads,
+              cfg->writer_unordered ? "unordered" : "ordered");
     return w;
 }
 
@@ -89,7 +489,8 @@ AsyncWorker* async_worker_init(const Config *cfg, RuntimeState *state) {
  * @param  w  AsyncWorker*  要关闭的工作线程指针，允许传入 NULL（空操作）
  * @return void
  *
- * @note   流程：设置 stop 标志 → 发送 cond 信号唤醒线程 → pthread_join 等待线程结束 →
+ * @note   流程：设置 stop 标志 → 广播 cond 唤醒线程 → pthread_join 等待线程结束
+ *         （多线程模式先等格式化线程、再等写出线程写完剩余块）→
  *         释放链表中残留的任务内存 → 销毁 mutex/cond → 释放控制结构。
  *         若链表中仍有未处理任务，会被静默丢弃（仅在 mute 模式下可能发生）。
  */
@@ -97,19 +498,27 @@ void async_worker_shutdown(AsyncWorker *w) {
     if (!w) return;
     pthread_mutex_lock(&w->mutex);
     w->stop = true;
-    pthread_cond_signal(&w->cond);
+    pthread_cond_broadcast(&w->cond);
     pthread_mutex_unlock(&w->mutex);
-    pthread_join(w->thread, NULL);
+    for (int i = 0; i < w->nformatters; i++) {
+        pthread_join(w->formatters[i], NULL);
+    }
+    if (!w->state->shards) pthread_join(w->thread, NULL);
 
     OutputTask *t = w->head;
     while (t) {
         OutputTask *next = t->next;
-        free(t->path);
-        free(t);
+        output_task_free(t);
         t = next;
     }
     pthread_mutex_destroy(&w->mutex);
     pthread_cond_destroy(&w->cond);
+    if (w->formatters) {
+        pthread_mutex_destroy(&w->done_mutex);
+        pthread_cond_destroy(&w->done_cond);
+        pthread_cond_destroy(&w->space_cond);
+        free(w->formatters);
+    }
     free(w);
 }
 
@@ -141,6 +550,59 @@ void async_writer_submit(AsyncWorker *w, const char *path, const struct stat *st
     pthread_mutex_unlock(&w->mutex);
 }
 
+/**
+ * @brief  向输出批次追加一条记录
+ * @param  batch  OutputBatch*        批次指针，不能为空
+ * @param  path   const char*         文件路径，不能为空
+ * @param  st     const struct stat*  文件 stat 信息，不能为空
+ * @param  arena  PathArena*          path 所在的共享路径缓冲，允许为 NULL（此时复制 path）
+ * @return bool  返回 true 表示已追加；false 表示内存分配失败
+ *
+ * @note   节点从 ASYNC_BATCH_SIZE 个一组的节点块中取出，块用完或批次提交时
+ *         把最后一个节点标记为 block_end，由输出线程在处理完它之后整块释放。
+ */
+bool output_batch_append(OutputBatch *batch, const char *path, const struct stat *st, PathArena *arena) {
+    if (batch->block && batch->block_used == ASYNC_BATCH_SIZE) {
+        batch->tail->block_end = true;
+        batch->block = NULL;
+    }
+    if (!batch->block) {
+        batch->block = malloc(ASYNC_BATCH_SIZE * sizeof(OutputTask));
+        if (!batch->block) return false;
+        batch->block_used = 0;
+    }
+
+    OutputTask *task = &batch->block[batch->block_used];
+    if (arena) {
+        path_arena_ref(arena);
+        task->path = (char *)path;
+    } else {
+        task->path = strdup(path);
+        if (!task->path) {
+            if (batch->block_used == 0) {
+                free(batch->block);
+                batch->block = NULL;
+            }
+            return false;
+        }
+    }
+    task->arena = arena;
+    task->st = *st;
+    task->block = batch->block;
+    task->block_end = false;
+    task->next = NULL;
+    batch->block_used++;
+
+    if (batch->tail) {
+        batch->tail->next = task;
+    } else {
+        batch->head = task;
+    }
+    batch->tail = task;
+    batch->count++;
+    return true;
+}
+
 /**
  * @brief  批量提交输出任务到异步工作线程
  * @param  w      AsyncWorker*  目标工作线程指针，允许传入 NULL（空操作）
@@ -153,6 +615,12 @@ void async_writer_submit(AsyncWorker *w, const char *path, const struct stat *st
  */
 void async_writer_submit_batch(AsyncWorker *w, OutputBatch *batch) {
     if (!w || !batch || batch->count == 0) return;
+    if (batch->block) {
+        /* 当前节点块到此为止，尾节点负责整块释放 */
+        batch->tail->block_end = true;
+        batch->block = NULL;
+        batch->block_used = 0;
+    }
     
     pthread_mutex_lock(&w->mutex);
     if (w->tail) {
@@ -122,7 +122,7 @@ static void format_elapsed_time(time_t start_time, char *buffer, size_t buf_size
  * @note   若 stdout 为终端（isatty），则先清屏（ANSI 转义序列）。
  *         面板内容包括：版本号、运行时间、活跃 Worker 数、待处理任务数、
  *         目录/文件/消费速率、已扫描目录/文件数、输出切片状态、
- *         进度分片状态、设备熔断状态、敢死队探测状态。
+ *         进度分片状态、去重集合扩容停顿、设备熔断状态、敢死队探测状态。
  */
 void print_progress(Monitor *mon) {
     AppContext *ctx = mon->ctx;
@@ -183,8 +183,9 @@ void print_progress(Monitor *mon) {
                 snprintf(path_display, sizeof(path_display), "...%.*s",
                          (int)(sizeof(path_display)-4), p);
             }
-            fprintf(fp, "  W%d: %-4s pid=%d path=%s\n", i, state_str,
-                    (int)slot->pid, path_display);
+            fprintf(fp, "  W%d: %-4s pid=%d credits=%d/%d path=%s\n", i, state_str,
+                    (int)slot->pid, atomic_load(&slot->inflight_count),
+                    cfg->worker_credits, path_display);
         }
     }
 
@@ -197,7 +198,9 @@ void print_progress(Monitor *mon) {
     fprintf(fp, "  Dirs:  %lu\n", state->dir_count);
     fprintf(fp, "  Files: %lu\n", state->file_count);
 
-    if (cfg->is_output_split_dir) {
+    if (state->shards) {
+        fprintf(fp, "  Output shards: %d\n", state->shard_count);
+    } else if (cfg->is_output_split_dir) {
         fprintf(fp, "  Output slice: %lu (line: %lu)\n", state->output_slice_num, state->output_line_count);
     }
 
@@ -205,6 +208,21 @@ void print_progress(Monitor *mon) {
         fprintf(fp, "  Progress slice: %lu (line: %lu)\n", state->write_slice_index, state->line_count);
     }
 
+    if (ctx->visited_set) {
+        FpStoreStats ss;
+        fp_store_stats(ctx->visited_set, &ss);
+        if (ss.hot.resizes > 0 || ss.spills > 0) {
+            fprintf(fp, "\n[Dedup]\n");
+            fprintf(fp, "  Resizes: %lu, pause max: %.3f ms, total: %.3f ms\n",
+                    (unsigned long)ss.hot.resizes, ss.hot.pause_max_ns / 1e6, ss.hot.pause_total_ns / 1e6);
+        }
+        if (ss.spills > 0) {
+            fprintf(fp, "  Memory: %.1f MB (hot) + %.1f MB (run index), spilled: %lu in %zu run(s), compactions: %lu\n",
+                    ss.hot_bytes / 1048576.0, ss.index_bytes / 1048576.0, (unsigned long)ss.spilled,
+                    ss.runs, (unsigned long)ss.compactions);
+        }
+    }
+
     if (ctx->dev_mgr) {
         size_t dev_count = atomic_load(&ctx->dev_mgr->count);
         if (dev_count > 0) {
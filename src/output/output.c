@@ -2,8 +2,9 @@
  * @file output.c
  * @brief 格式化输出引擎
  *
- * 负责将扫描结果按照预编译格式输出到流。
- * 包含 CSV 转义、类型字符串转换、核心输出循环及缓存清理。
+ * 负责将扫描结果按照预编译格式渲染到连续的行缓冲区（LineBuf），再整块 write() 到输出流。
+ * 包含 CSV 转义、类型字符串转换、整数/八进制就地格式化、核心渲染循环及缓存清理。
+ * --output-compress=gzip 时渲染结果经 GzipEncoder 压缩为独立的 gzip member 后写出。
  */
 #include "output.h"
 #include "utils.h"
@@ -19,6 +20,7 @@
 #include <sys/ioctl.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
+#include <limits.h>
 #include "log.h"
 
 /**
@@ -39,88 +41,295 @@ static const char* get_type_str(mode_t mode) {
     return "UNKNOWN";
 }
 
+/* ================================================================
+ * 行渲染缓冲区
+ * ================================================================ */
+
+/**
+ * @brief  初始化行渲染缓冲区
+ * @param  lb   LineBuf*  缓冲区，不能为空
+ * @param  cap  size_t    初始容量（字节）
+ * @return void
+ */
+void line_buf_init(LineBuf *lb, size_t cap) {
+    lb->data = safe_malloc(cap);
+    lb->len = 0;
+    lb->cap = cap;
+}
+
+/**
+ * @brief  释放行渲染缓冲区
+ * @param  lb  LineBuf*  缓冲区，不能为空
+ * @return void
+ */
+void line_buf_free(LineBuf *lb) {
+    free(lb->data);
+    lb->data = NULL;
+    lb->len = lb->cap = 0;
+}
+
+/**
+ * @brief  保证缓冲区尾部至少还有 need 字节可写
+ * @param  lb    LineBuf*  缓冲区，不能为空
+ * @param  need  size_t    需要的字节数
+ * @return char*  写入位置（data + len）
+ *
+ * @note   按 2 倍扩容；分配失败与 safe_malloc 相同，记录 fatal 并退出。
+ */
+static inline char *lb_reserve(LineBuf *lb, size_t need) {
+    if (lb->len + need > lb->cap) {
+        size_t cap = lb->cap ? lb->cap : 4096;
+        while (cap < lb->len + need) cap *= 2;
+        char *data = realloc(lb->data, cap);
+        if (!data) {
+            log_fatal("输出缓冲区扩容失败 (%zu bytes)", cap);
+            exit(EXIT_FAILURE);
+        }
+        lb->data = data;
+        lb->cap = cap;
+    }
+    return lb->data + lb->len;
+}
+
+static inline void lb_put(LineBuf *lb, const char *s, size_t n) {
+    memcpy(lb_reserve(lb, n), s, n);
+    lb->len += n;
+}
+
+static inline void lb_putc(LineBuf *lb, char c) {
+    *lb_reserve(lb, 1) = c;
+    lb->len++;
+}
+
+/**
+ * @brief  无符号十进制整数转字符串（等价于 printf("%lu")）
+ * @param  end  char*          缓冲区末尾（写入 '\0' 的位置），向前填充数字
+ * @param  v    unsigned long  数值
+ * @return char*  数字串起始位置
+ */
+static char *fmt_ulong(char *end, unsigned long v) {
+    char *p = end;
+    *p = '\0';
+    do {
+        *--p = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    return p;
+}
+
+/**
+ * @brief  有符号十进制整数转字符串（等价于 printf("%ld")）
+ * @param  end  char*  缓冲区末尾（写入 '\0' 的位置）
+ * @param  v    long   数值
+ * @return char*  数字串起始位置
+ */
+static char *fmt_long(char *end, long v) {
+    if (v >= 0) return fmt_ulong(end, (unsigned long)v);
+    char *p = fmt_ulong(end, 0UL - (unsigned long)v);
+    *--p = '-';
+    return p;
+}
+
+/**
+ * @brief  权限位转 "0%o" 形式的八进制串（等价于 printf("0%o", mode & 0777)）
+ * @param  end   char*   缓冲区末尾（写入 '\0' 的位置）
+ * @param  mode  mode_t  文件模式位
+ * @return char*  八进制串起始位置
+ */
+static char *fmt_octal_mode(char *end, mode_t mode) {
+    unsigned v = mode & 0777;
+    char *p = end;
+    *p = '\0';
+    do {
+        *--p = (char)('0' + (v & 7));
+        v >>= 3;
+    } while (v);
+    *--p = '0';
+    return p;
+}
+
 /**
- * @brief  按 RFC 4180 标准打印 CSV 字段（始终用双引号包裹）
- * @param  fp   FILE*       输出文件指针，不能为空
- * @param  str  const char* 要输出的字符串，允许为 NULL（按空串处理）
+ * @brief  按 RFC 4180 标准追加 CSV 字段（始终用双引号包裹）
+ * @param  lb   LineBuf*     缓冲区，不能为空
+ * @param  str  const char*  字段内容，不能为空
  * @return void
  *
  * @note   规则：字段整体用双引号包裹，内容中的每个双引号替换为两个双引号。
  *         示例：输入 `He said "hi"` → 输出 `"He said ""hi"""`。
+ *         以 memchr 定位双引号，两个引号之间的片段整段复制。
  */
-static void print_csv_field(FILE *fp, const char *str) {
-    fputc('"', fp);
-    while (*str) {
-        if (*str == '"') {
-            fputc('"', fp); // Escape " to ""
-        }
-        fputc(*str, fp);
-        str++;
+static void lb_put_csv(LineBuf *lb, const char *str) {
+    size_t n = strlen(str);
+    lb_putc(lb, '"');
+    const char *q;
+    while ((q = memchr(str, '"', n)) != NULL) {
+        size_t seg = (size_t)(q - str) + 1;
+        lb_put(lb, str, seg);
+        lb_putc(lb, '"'); // Escape " to ""
+        str += seg;
+        n -= seg;
     }
-    fputc('"', fp);
+    lb_put(lb, str, n);
+    lb_putc(lb, '"');
 }
 
 /**
- * @brief  将单个文件记录格式化并输出到指定流
+ * @brief  将单个文件记录渲染为一行并追加到缓冲区
  * @param  cfg    const Config*       全局配置指针，不能为空
  * @param  state  RuntimeState*       运行时状态指针，不能为空（用于用户名/组名/扩展属性缓存）
  * @param  path   const char*         文件路径，不能为空
  * @param  st     const struct stat*  文件 stat 信息指针，不能为空
- * @param  fp     FILE*               目标输出流指针，不能为空
+ * @param  lb     LineBuf*            目标缓冲区，不能为空
  * @return void
  *
  * @note   遍历预编译的 compiled_format 数组，根据每个 FormatSegment 的类型生成对应字段：
  *         - FMT_TEXT: 原样输出文本
- *         - FMT_PATH/FMT_SIZE/FMT_USER/...: 调用对应生成函数
- *         - CSV 模式下所有字段通过 print_csv_field 输出（自动转义）
+ *         - 数值字段（%s/%U/%G/%i/%O）由 fmt_long/fmt_ulong/fmt_octal_mode 就地转换，不经过 snprintf
+ *         - CSV 模式下所有字段经 lb_put_csv 输出（自动转义）
  *         - quote 模式下用双引号包裹字段
- *         每行末尾输出换行符 '\n'。
- *         使用栈缓冲区 temp_buf 避免频繁堆分配。
+ *         每行末尾追加换行符 '\n'。输出与逐字段 fputs/fputc 的旧实现逐字节一致。
  */
-void print_to_stream(const Config *cfg, RuntimeState *state, const char *path, const struct stat *st, FILE *fp) {
+void render_line(const Config *cfg, RuntimeState *state, const char *path, const struct stat *st, LineBuf *lb) {
     char temp_buf[MAX_PATH_LENGTH]; // 通用缓冲区
 
     for (int i = 0; i < cfg->format_segment_count; i++) {
         FormatSegment *seg = &cfg->compiled_format[i];
-        
+
         if (seg->type == FMT_TEXT) {
             // CSV 模式下，如果格式串里包含逗号，这里原样输出即可
             // 因为 precompile_format 会保证生成正确的逗号分隔符
-            if (seg->text) fputs(seg->text, fp);
+            if (seg->text) lb_put(lb, seg->text, strlen(seg->text));
             continue;
         }
 
         const char *val_str = NULL;
-        
+        char *num_end = temp_buf + 32;  /* 数值字段从此处向前填充 */
+
         switch (seg->type) {
             case FMT_PATH: val_str = path; break;
-            case FMT_SIZE: snprintf(temp_buf, sizeof(temp_buf), "%ld", (long)st->st_size); val_str = temp_buf; break;
+            case FMT_SIZE: val_str = fmt_long(num_end, (long)st->st_size); break;
             case FMT_USER: val_str = get_username(state, st->st_uid); break;
             case FMT_GROUP: val_str = get_groupname(state, st->st_gid); break;
-            case FMT_UID: snprintf(temp_buf, sizeof(temp_buf), "%d", st->st_uid); val_str = temp_buf; break;
-            case FMT_GID: snprintf(temp_buf, sizeof(temp_buf), "%d", st->st_gid); val_str = temp_buf; break;
+            case FMT_UID: val_str = fmt_long(num_end, (int)st->st_uid); break;
+            case FMT_GID: val_str = fmt_long(num_end, (int)st->st_gid); break;
             case FMT_MTIME: val_str = format_time(st->st_mtime); break;
             case FMT_ATIME: val_str = format_time(st->st_atime); break;
             case FMT_CTIME: val_str = format_time(st->st_ctime); break;
             case FMT_MODE: format_mode_str(st->st_mode, temp_buf); val_str = temp_buf; break;
-            case FMT_ST_MODE: snprintf(temp_buf, sizeof(temp_buf), "0%o", st->st_mode & 0777); val_str = temp_buf; break;
+            case FMT_ST_MODE: val_str = fmt_octal_mode(num_end, st->st_mode); break;
             case FMT_TYPE: val_str = get_type_str(st->st_mode); break;
-            case FMT_INODE: snprintf(temp_buf, sizeof(temp_buf), "%lu", (unsigned long)st->st_ino); val_str = temp_buf; break;
+            case FMT_INODE: val_str = fmt_ulong(num_end, (unsigned long)st->st_ino); break;
             case FMT_XATTR: get_xattr_str(state, path, st, temp_buf); val_str = temp_buf; break;
             default: val_str = "";
         }
 
         if (cfg->csv) {
-            print_csv_field(fp, val_str);
+            lb_put_csv(lb, val_str);
         } else if (cfg->quote) {
-            fputc('"', fp);
-            if (val_str) fputs(val_str, fp);
-            fputc('"', fp);
+            lb_putc(lb, '"');
+            lb_put(lb, val_str, strlen(val_str));
+            lb_putc(lb, '"');
         } else {
-            if (val_str) fputs(val_str, fp);
+            lb_put(lb, val_str, strlen(val_str));
         }
     }
-    fputc('\n', fp);
+    lb_putc(lb, '\n');
+}
+
+/**
+ * @brief  将一段已渲染的输出一次性写入输出流
+ * @param  fp    FILE*        目标输出流，不能为空
+ * @param  data  const char*  数据
+ * @param  len   size_t       字节数
+ * @return bool  全部写入返回 true；写入失败返回 false
+ *
+ * @note   先 fflush 流中可能残留的 stdio 数据，再对 fileno(fp) 直接 write()，
+ *         部分写入与 EINTR 时继续写剩余部分。输出流只由一个线程写入，二者不会交错。
+ */
+bool output_write_all(FILE *fp, const char *data, size_t len) {
+    if (len == 0) return true;
+    fflush(fp);
+    int fd = fileno(fp);
+    while (len > 0) {
+        ssize_t w = write(fd, data, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            log_error("写入输出文件失败: %s", strerror(errno));
+            return false;
+        }
+        data += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+/**
+ * @brief  将缓冲区内容一次性写入输出流并清空缓冲区
+ * @param  lb  LineBuf*  缓冲区，不能为空
+ * @param  fp  FILE*     目标输出流，不能为空
+ * @return bool  全部写入返回 true；写入失败返回 false（缓冲区同样清空）
+ */
+bool line_buf_flush(LineBuf *lb, FILE *fp) {
+    bool ok = output_write_all(fp, lb->data, lb->len);
+    lb->len = 0;
+    return ok;
+}
+
+/* ================================================================
+ * gzip member 编码（--output-compress=gzip）
+ * ================================================================ */
+
+/**
+ * @brief  初始化 gzip 编码器
+ * @param  enc    GzipEncoder*  编码器，不能为空
+ * @param  level  int           压缩级别 1..9
+ * @return bool  成功返回 true；zlib 初始化失败返回 false
+ *
+ * @note   windowBits = 15 + 16 输出 gzip 封装；编码器由单个线程独占，跨 member 复用（deflateReset）。
+ */
+bool gzip_encoder_init(GzipEncoder *enc, int level) {
+    memset(&enc->zs, 0, sizeof(enc->zs));
+    enc->ready = deflateInit2(&enc->zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    if (!enc->ready) log_error("gzip 编码器初始化失败 (level=%d)", level);
+    return enc->ready;
+}
+
+/**
+ * @brief  将一段数据压缩为一个完整的 gzip member 并追加到缓冲区
+ * @param  enc   GzipEncoder*  已初始化的编码器，不能为空
+ * @param  data  const char*   待压缩数据（整行，不跨 member 拆行）
+ * @param  len   size_t        字节数
+ * @param  out   LineBuf*      输出缓冲区，member 追加在 out->len 之后
+ * @return bool  成功返回 true；压缩失败返回 false（out 不变）
+ *
+ * @note   每个 member 独立压缩（无跨块字典），多个 member 直接拼接即为合法的多 member gzip 流，
+ *         gzip -d / zcat / zlib gzread 均按顺序解出全部内容。按 deflateBound 预留空间后一次 Z_FINISH。
+ */
+bool gzip_encode_member(GzipEncoder *enc, const char *data, size_t len, LineBuf *out) {
+    if (!enc->ready || len > UINT_MAX) return false;
+    if (deflateReset(&enc->zs) != Z_OK) return false;
+    size_t bound = deflateBound(&enc->zs, (uLong)len);
+    if (bound > UINT_MAX) return false;
+    enc->zs.next_in = (Bytef *)data;
+    enc->zs.avail_in = (uInt)len;
+    enc->zs.next_out = (Bytef *)lb_reserve(out, bound);
+    enc->zs.avail_out = (uInt)bound;
+    if (deflate(&enc->zs, Z_FINISH) != Z_STREAM_END) {
+        log_error("gzip 压缩失败: %s", enc->zs.msg ? enc->zs.msg : "deflate");
+        return false;
+    }
+    out->len += bound - enc->zs.avail_out;
+    return true;
+}
+
+/**
+ * @brief  释放 gzip 编码器
+ * @param  enc  GzipEncoder*  编码器，不能为空；未初始化成功时为空操作
+ * @return void
+ */
+void gzip_encoder_end(GzipEncoder *enc) {
+    if (enc->ready) deflateEnd(&enc->zs);
+    enc->ready = false;
 }
 
 /**
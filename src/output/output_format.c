@@ -4,7 +4,9 @@
  *
  * 负责格式模板预编译（解析为 FormatSegment 数组）
  * 以及输出文件的创建、打开、关闭和切片轮转管理。
+ * 同时根据预编译结果推导 Worker 所需的 statx 字段掩码。
  */
+#define _GNU_SOURCE
 #include "output.h"
 #include "utils.h"
 #include <stdio.h>
@@ -19,6 +21,7 @@
 #include <sys/ioctl.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
+#include <dirent.h>
 #include "log.h"
 
 void cleanup_compiled_format(Config *cfg) {
@@ -135,6 +138,37 @@ void precompile_format(Config *cfg) {
     cfg->format_segment_count = count;
 }
 
+/**
+ * @brief  根据预编译格式推导 Worker 需要的 statx 字段掩码
+ * @param  cfg  const Config*  配置指针，不能为空；须已执行 precompile_format
+ * @return unsigned int  STATX_* 掩码
+ *
+ * @note   基础字段（去重与进度文件必需）：TYPE/MODE（目录判定、d_type）、INO（指纹）、
+ *         MTIME（pbin 记录与 blind-trust）；设备号由 statx 无条件返回。
+ *         其余字段按格式段追加：%%s→SIZE，%%u/%%U→UID，%%g/%%G→GID，
+ *         %%a→ATIME，%%c→CTIME。%%X 通过 open+ioctl 获取，不占用 statx 字段。
+ *         --dedup=links 时追加 NLINK，供 Master 识别多链接文件。
+ *         NFS 上未请求的字段可直接使用客户端缓存，减少 GETATTR 往返。
+ */
+unsigned int format_statx_mask(const Config *cfg) {
+    unsigned int mask = STATX_TYPE | STATX_MODE | STATX_INO | STATX_MTIME;
+
+    for (int i = 0; i < cfg->format_segment_count; i++) {
+        switch (cfg->compiled_format[i].type) {
+            case FMT_SIZE:  mask |= STATX_SIZE; break;
+            case FMT_USER:
+            case FMT_UID:   mask |= STATX_UID; break;
+            case FMT_GROUP:
+            case FMT_GID:   mask |= STATX_GID; break;
+            case FMT_ATIME: mask |= STATX_ATIME; break;
+            case FMT_CTIME: mask |= STATX_CTIME; break;
+            default: break;
+        }
+    }
+    if (cfg->dedup_policy == DEDUP_LINKS) mask |= STATX_NLINK;
+    return mask;
+}
+
 /**
  * @brief  创建输出文件
  * @param  path  const char*  输出文件路径，不能为空
@@ -175,7 +209,9 @@ void close_output_file(FILE *fp) {
  * @return void
  *
  * @note   根据配置选择三种输出模式之一：
- *         - 分片目录模式（-O）：创建目录并按 PROGRESS_SLICE_FORMAT 命名切片文件
+ *         - 分片目录模式（-O）：创建目录并按 PROGRESS_SLICE_FORMAT 命名切片文件；
+ *           --output-shards 时不打开 output_fp，为每个输出线程分配一个 OutputShard，
+ *           切片文件由各线程首次写出时创建
  *         - 单文件模式（-o）：直接打开指定文件
  *         - 标准输出模式（默认）：output_fp = stdout
  *         同时处理 --print-dir 的目录信息输出流：
@@ -202,15 +238,23 @@ void init_output_files(const Config *cfg, RuntimeState *state) {
             perror("无法创建输出目录"); exit(EXIT_FAILURE);
         }
         char slice_path[1024];
-        snprintf(slice_path, sizeof(slice_path), "%s/" OUTPUT_SLICE_FORMAT, cfg->output_split_dir, state->output_slice_num);
-        if (cfg->continue_mode && access(slice_path, F_OK) == 0) {
+        snprintf(slice_path, sizeof(slice_path), "%s/" OUTPUT_SLICE_FORMAT "%s",
+                 cfg->output_split_dir, state->output_slice_num, output_slice_suffix(cfg));
+        if (cfg->output_sharded) {
+            state->shard_count = cfg->writer_threads;
+            state->shards = safe_malloc((size_t)state->shard_count * sizeof(OutputShard));
+            memset(state->shards, 0, (size_t)state->shard_count * sizeof(OutputShard));
+            for (int i = 0; i < state->shard_count; i++) state->shards[i].id = i;
+            state->output_fp = NULL;
+            verbose_printf(cfg, 1, "分片输出: %d 个切片序列\n", state->shard_count);
+        } else if (cfg->continue_mode && access(slice_path, F_OK) == 0) {
             state->output_fp = open_output_file_append(slice_path);
             verbose_printf(cfg, 1, "恢复输出切片文件: %s\n", slice_path);
         } else {
             state->output_fp = create_output_file(slice_path);
             verbose_printf(cfg, 1, "打开新切片文件: %s\n", slice_path);
         }
-        if (!state->output_fp) state->output_fp = stdout;
+        if (!state->output_fp && !state->shards) state->output_fp = stdout;
     } else if (cfg->is_output_file && cfg->output_file) {
         // 模式 B: 单文件
         if (cfg->continue_mode && access(cfg->output_file, F_OK) == 0) {
@@ -225,7 +269,7 @@ void init_output_files(const Config *cfg, RuntimeState *state) {
         // 模式 C: 标准输出
         state->output_fp = stdout;
     }
-    if (!state->output_fp) { perror("无法打开输出文件"); exit(EXIT_FAILURE); }
+    if (!state->output_fp && !state->shards) { perror("无法打开输出文件"); exit(EXIT_FAILURE); }
 
     // 启用大块缓冲以减少系统调用
     if (state->output_fp && state->output_fp != stdout) {
@@ -273,7 +317,7 @@ void init_output_files(const Config *cfg, RuntimeState *state) {
  * @return void
  *
  * @note   仅在 is_output_split_dir 模式下生效。
- *         递增 output_slice_num，按 OUTPUT_SLICE_FORMAT 生成新文件名。
+ *         递增 output_slice_num，按 OUTPUT_SLICE_FORMAT 生成新文件名（压缩输出时追加 .gz）。
  *         若创建新文件失败则调用 perror 并 exit(EXIT_FAILURE)。
  */
 void rotate_output_slice(const Config *cfg, RuntimeState *state) {
@@ -291,8 +335,8 @@ void rotate_output_slice(const Config *cfg, RuntimeState *state) {
     state->output_slice_num++;
     verbose_printf(cfg, 1,"递增切片编号: %lu\n", state->output_slice_num);
     char slice_path[1024];
-    snprintf(slice_path, sizeof(slice_path), "%s/" OUTPUT_SLICE_FORMAT,
-            cfg->output_split_dir, state->output_slice_num);
+    snprintf(slice_path, sizeof(slice_path), "%s/" OUTPUT_SLICE_FORMAT "%s",
+            cfg->output_split_dir, state->output_slice_num, output_slice_suffix(cfg));
     state->output_fp = create_output_file(slice_path);
     if (!state->output_fp) {
         perror("无法创建新的输出切片文件");
@@ -302,3 +346,199 @@ void rotate_output_slice(const Config *cfg, RuntimeState *state) {
     }
     state->output_line_count = 0;
 }
+
+/**
+ * @brief  关闭分片当前的切片文件并记录其行数
+ * @param  shard  OutputShard*  分片写出端，不能为空；尚未打开切片时为空操作
+ * @return void
+ *
+ * @note   仅由分片所属的输出线程调用。行数记入 slice_lines，供 write_output_manifest 使用。
+ */
+void close_output_shard(OutputShard *shard) {
+    if (!shard->fp) return;
+    close_output_file(shard->fp);
+    shard->fp = NULL;
+    size_t idx = shard->slice_num - shard->first_slice;
+    if (idx >= shard->slice_cap) {
+        size_t cap = shard->slice_cap ? shard->slice_cap * 2 : 16;
+        while (cap <= idx) cap *= 2;
+        unsigned long *lines = realloc(shard->slice_lines, cap * sizeof(unsigned long));
+        if (!lines) {
+            log_fatal("分片行数表扩容失败");
+            exit(EXIT_FAILURE);
+        }
+        memset(lines + shard->slice_cap, 0, (cap - shard->slice_cap) * sizeof(unsigned long));
+        shard->slice_lines = lines;
+        shard->slice_cap = cap;
+    }
+    shard->slice_lines[idx] = shard->line_count;
+}
+
+/**
+ * @brief  分片切换到下一个切片文件（首次调用时打开第一个切片）
+ * @param  cfg    const Config*  全局配置指针，不能为空
+ * @param  shard  OutputShard*   分片写出端，不能为空
+ * @return void
+ *
+ * @note   仅由分片所属的输出线程调用，不访问 RuntimeState 中的共享输出状态。
+ *         断点续传时跳过目录中已存在的同名切片（上次任务写出的内容保留，由清单一并列出）。
+ *         创建文件失败时与 rotate_output_slice 相同，perror 后 exit(EXIT_FAILURE)。
+ */
+void rotate_output_shard(const Config *cfg, OutputShard *shard) {
+    close_output_shard(shard);
+    char slice_path[1024];
+    do {
+        shard->slice_num++;
+        snprintf(slice_path, sizeof(slice_path), "%s/" OUTPUT_SHARD_FORMAT "%s",
+                 cfg->output_split_dir, shard->id, shard->slice_num, output_slice_suffix(cfg));
+    } while (shard->first_slice == 0 && cfg->continue_mode && access(slice_path, F_OK) == 0);
+    if (shard->first_slice == 0) shard->first_slice = shard->slice_num;
+
+    shard->fp = create_output_file(slice_path);
+    if (!shard->fp) {
+        perror("无法创建新的输出分片文件");
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(shard->fp, NULL, _IOFBF, 8 * 1024 * 1024);
+    verbose_printf(cfg, 1, "打开新分片文件: %s\n", slice_path);
+    shard->line_count = 0;
+}
+
+/* 清单条目 */
+typedef struct {
+    int id;
+    unsigned long slice;
+    unsigned long lines;
+} ManifestEntry;
+
+static int manifest_entry_cmp(const void *a, const void *b) {
+    const ManifestEntry *x = a, *y = b;
+    if (x->id != y->id) return x->id < y->id ? -1 : 1;
+    return (x->slice > y->slice) - (x->slice < y->slice);
+}
+
+/**
+ * @brief  统计文件行数（续传时上次任务留下的分片）
+ * @param  path  const char*  文件路径
+ * @return unsigned long  换行符个数；无法打开时返回 0
+ *
+ * @note   经 zlib gzread 读取：.gz 切片按多 member 流解压后计数，未压缩文件原样读取。
+ */
+static unsigned long count_file_lines(const char *path) {
+    gzFile gz = gzopen(path, "rb");
+    if (!gz) return 0;
+    char buf[65536];
+    unsigned long lines = 0;
+    int n;
+    while ((n = gzread(gz, buf, sizeof(buf))) > 0) {
+        const char *p = buf, *end = buf + n;
+        while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            lines++;
+            p++;
+        }
+    }
+    gzclose(gz);
+    return lines;
+}
+
+/**
+ * @brief  生成分片输出清单（<dir>/manifest.tsv）
+ * @param  cfg    const Config*        全局配置指针，不能为空
+ * @param  state  const RuntimeState*  运行时状态指针，不能为空；所有输出线程须已退出
+ * @return bool  成功发布返回 true；未启用分片或写入失败返回 false
+ *
+ * @note   首行为表头 "file\tlines"，其后每个切片一行「文件名\t行数」，按线程号、切片号排序。
+ *         本次任务写出的切片使用内存中的计数；断点续传时目录中上次任务留下的切片逐个统计行数后并入。
+ *         先写 manifest.tsv.tmp 再 rename，下游看到的清单总是完整的。
+ */
+bool write_output_manifest(const Config *cfg, const RuntimeState *state) {
+    if (!state->shards) return false;
+    size_t count = 0, cap = 64;
+    ManifestEntry *entries = safe_malloc(cap * sizeof(ManifestEntry));
+    for (int i = 0; i < state->shard_count; i++) {
+        const OutputShard *sh = &state->shards[i];
+        if (sh->slice_num == 0) continue;
+        for (unsigned long s = sh->first_slice; s <= sh->slice_num; s++) {
+            if (count == cap) {
+                cap *= 2;
+                ManifestEntry *grown = realloc(entries, cap * sizeof(ManifestEntry));
+                if (!grown) { free(entries); return false; }
+                entries = grown;
+            }
+            entries[count++] = (ManifestEntry){ sh->id, s, sh->slice_lines[s - sh->first_slice] };
+        }
+    }
+
+    char path[1024];
+    if (cfg->continue_mode) {
+        DIR *dir = opendir(cfg->output_split_dir);
+        struct dirent *de;
+        while (dir && (de = readdir(dir)) != NULL) {
+            int id;
+            unsigned long slice;
+            char expect[64];
+            if (sscanf(de->d_name, "w%d_%lu", &id, &slice) != 2 || id < 0) continue;
+            snprintf(expect, sizeof(expect), OUTPUT_SHARD_FORMAT "%s", id, slice, output_slice_suffix(cfg));
+            if (strcmp(expect, de->d_name) != 0) continue;
+            if (id < state->shard_count) {
+                const OutputShard *sh = &state->shards[id];
+                if (sh->slice_num && slice >= sh->first_slice && slice <= sh->slice_num) continue;
+            }
+            if (count == cap) {
+                cap *= 2;
+                ManifestEntry *grown = realloc(entries, cap * sizeof(ManifestEntry));
+                if (!grown) break;
+                entries = grown;
+            }
+            snprintf(path, sizeof(path), "%s/%s", cfg->output_split_dir, de->d_name);
+            entries[count++] = (ManifestEntry){ id, slice, count_file_lines(path) };
+        }
+        if (dir) closedir(dir);
+    }
+    qsort(entries, count, sizeof(ManifestEntry), manifest_entry_cmp);
+
+    char tmp_path[sizeof(path) + sizeof(".tmp")];
+    snprintf(path, sizeof(path), "%s/" OUTPUT_MANIFEST_FILE, cfg->output_split_dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *fp = fopen(tmp_path, "w");
+    if (!fp) {
+        log_error("创建分片清单 %s 失败: %s", tmp_path, strerror(errno));
+        free(entries);
+        return false;
+    }
+    unsigned long total = 0;
+    fprintf(fp, "file\tlines\n");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(fp, OUTPUT_SHARD_FORMAT "%s\t%lu\n", entries[i].id, entries[i].slice,
+                output_slice_suffix(cfg), entries[i].lines);
+        total += entries[i].lines;
+    }
+    free(entries);
+    bool ok = fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        log_error("分片清单 %s 写入失败", path);
+        unlink(tmp_path);
+        return false;
+    }
+    log_debug("[Output] 分片清单 %s 已发布 (%zu 个切片, %lu 行)", path, count, total);
+    return true;
+}
+
+/**
+ * @brief  释放分片写出端数组
+ * @param  state  RuntimeState*  运行时状态指针，不能为空
+ * @return void
+ *
+ * @note   须在输出线程退出后调用；仍打开的切片文件一并关闭。
+ */
+void free_output_shards(RuntimeState *state) {
+    if (!state->shards) return;
+    for (int i = 0; i < state->shard_count; i++) {
+        close_output_shard(&state->shards[i]);
+        free(state->shards[i].slice_lines);
+    }
+    free(state->shards);
+    state->shards = NULL;
+    state->shard_count = 0;
+}
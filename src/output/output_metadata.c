@@ -197,19 +197,29 @@ void get_xattr_str(RuntimeState *state, const char *path, const struct stat *inf
  * @note   使用哈希链表缓存（桶数 UID_CACHE_SIZE=4096），缓存命中时 O(1) 返回。
  *         缓存未命中时调用 getpwuid 查询系统，格式化为 "name(uid)" 或纯数字 UID。
  *         返回的指针指向缓存节点，无需释放，但生命周期与 RuntimeState 一致。
+ *         多个输出格式化线程并发调用：查询不加锁（节点完整初始化后以 release 语义挂到桶头），
+ *         未命中时在 name_cache_mutex 内复查并插入，getpwuid 的静态结果也由该锁保护。
  */
 const char *get_username(RuntimeState *state, uid_t uid) {
     // 计算哈希桶索引
     unsigned bucket = uid % UID_CACHE_SIZE;
     
     // 在桶中查找
-    UserCacheEntry *entry = state->uid_cache[bucket];
+    UserCacheEntry *entry = __atomic_load_n(&state->uid_cache[bucket], __ATOMIC_ACQUIRE);
     while (entry) {
         if (entry->uid == uid) {
             return entry->name;
         }
         entry = entry->next;
     }
+
+    pthread_mutex_lock(&state->name_cache_mutex);
+    for (entry = state->uid_cache[bucket]; entry; entry = entry->next) {
+        if (entry->uid == uid) {
+            pthread_mutex_unlock(&state->name_cache_mutex);
+            return entry->name;
+        }
+    }
     
     // 缓存未命中,查询系统
     struct passwd *pw = getpwuid(uid);
@@ -231,8 +241,9 @@ const char *get_username(RuntimeState *state, uid_t uid) {
     
     // 添加到桶的头部
     new_entry->next = state->uid_cache[bucket];
-    state->uid_cache[bucket] = new_entry;
+    __atomic_store_n(&state->uid_cache[bucket], new_entry, __ATOMIC_RELEASE);
     state->uid_cache_count++;
+    pthread_mutex_unlock(&state->name_cache_mutex);
     
     return new_entry->name;
 }
@@ -251,13 +262,21 @@ const char *get_groupname(RuntimeState *state, gid_t gid) {
     unsigned bucket = gid % GID_CACHE_SIZE;
     
     // 在桶中查找
-    GroupCacheEntry *entry = state->gid_cache[bucket];
+    GroupCacheEntry *entry = __atomic_load_n(&state->gid_cache[bucket], __ATOMIC_ACQUIRE);
     while (entry) {
         if (entry->gid == gid) {
             return entry->name;
         }
         entry = entry->next;
     }
+
+    pthread_mutex_lock(&state->name_cache_mutex);
+    for (entry = state->gid_cache[bucket]; entry; entry = entry->next) {
+        if (entry->gid == gid) {
+            pthread_mutex_unlock(&state->name_cache_mutex);
+            return entry->name;
+        }
+    }
     
     // 缓存未命中,查询系统
     struct group *gr = getgrgid(gid);
@@ -278,8 +297,9 @@ const char *get_groupname(RuntimeState *state, gid_t gid) {
     
     // 添加到桶的头部
     new_entry->next = state->gid_cache[bucket];
-    state->gid_cache[bucket] = new_entry;
+    __atomic_store_n(&state->gid_cache[bucket], new_entry, __ATOMIC_RELEASE);
     state->gid_cache_count++;
+    pthread_mutex_unlock(&state->name_cache_mutex);
     
     return new_entry->name;
 }
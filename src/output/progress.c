@@ -17,12 +17,15 @@
  * - task1.fpbin.idx    fpbin 分片的游标索引
  * - task1.archive      zlib 压缩的历史分片归档
  * - task1.config       会话配置快照
+ * - task1.fpsnap       已完成任务的指纹 → (mtime, d_type) 快照（可直接 mmap 的哈希表）
+ * - task1.fpdir        已完成任务的目录清单（目录 → 子条目，目录级 blind-trust 使用）
  */
 #include "progress.h"
 #include "utils.h"
 #include "archive_format.h"
 #include "msg_format.h"
 #include "msg_queue.h"
+#include "main_loop.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +33,7 @@
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <time.h>
 #include <zlib.h>
 #include <stdint.h>
@@ -121,6 +125,28 @@ char *get_fpbin_index_filename(const char *base) {
     return name;
 }
 
+/**
+ * @brief  生成指纹快照文件名（{base}.fpsnap）
+ * @param  base  const char*  进度文件前缀，不能为空
+ * @return char*  动态分配的字符串，调用方负责 free；写入中的临时文件为其后追加 ".tmp"
+ */
+char *get_snapshot_filename(const char *base) {
+    char *name = safe_malloc(strlen(base) + 32);
+    sprintf(name, "%s.fpsnap", base);
+    return name;
+}
+
+/**
+ * @brief  生成目录清单文件名（{base}.fpdir）
+ * @param  base  const char*  进度文件前缀，不能为空
+ * @return char*  动态分配的字符串，调用方负责 free；写入中的临时文件为其后追加 ".tmp"
+ */
+char *get_dirlist_filename(const char *base) {
+    char *name = safe_malloc(strlen(base) + 32);
+    sprintf(name, "%s.fpdir", base);
+    return name;
+}
+
 /**
  * @brief  将 stat::st_mode 转换为 dirent::d_type 等价值
  * @param  mode  mode_t  文件模式位
@@ -162,18 +188,51 @@ void save_config_to_disk(const Config* cfg) {
  * @param  state  RuntimeState*   运行时状态指针，不能为空
  * @return void
  *
- * @note   非 --clean 模式：
+ * @note   --output-shards 时（两种模式均）先发布输出分片清单 <dir>/manifest.tsv，调用方须已停止输出线程。
+ *         非 --clean 模式：
  *         1. 调用 finalize_archive 封口活跃分片并归档
  *         2. 原子更新统一索引
- *         3. 追加状态行到 .config（Success/Incomplete + 结束时间）
+ *         3. 成功结束时封口并发布指纹快照 {base}.fpsnap 与目录清单 {base}.fpdir；否则丢弃写入中的临时文件
+ *         4. 追加状态行到 .config（Success/Incomplete + 结束时间）
+ *         快照与清单先于 status=Success 落盘，读到 Success 的下一次任务总能看到与之匹配的版本。
  *         --clean 模式：
  *         关闭并删除活跃分片文件，不保留任何进度记录。
  */
 void finalize_progress(const Config *cfg, RuntimeState *state) {
+    if (state->shards) {
+        write_output_manifest(cfg, state);
+    }
     if (!cfg->clean) {
         finalize_archive(cfg, state);
         /* Ensure index is written so resume can locate the cursor */
         atomic_update_index(cfg, state);
+        if (state->snapshot) {
+            char *snap_path = get_snapshot_filename(cfg->progress_base);
+            if (!state->has_error && ref_map_seal(state->snapshot, snap_path)) {
+                log_debug("[Snapshot] %s 已发布 (%zu 条)", snap_path, state->snapshot->count);
+            } else if (state->snapshot->path) {
+                unlink(state->snapshot->path);
+            }
+            ref_map_destroy(state->snapshot);
+            state->snapshot = NULL;
+            free(snap_path);
+        }
+        if (state->dirlist_fd >= 0) {
+            char *list_path = get_dirlist_filename(cfg->progress_base);
+            size_t len = strlen(list_path) + sizeof(".tmp");
+            char *tmp_path = safe_malloc(len);
+            snprintf(tmp_path, len, "%s.tmp", list_path);
+            bool ok = !state->has_error && fsync(state->dirlist_fd) == 0;
+            close(state->dirlist_fd);
+            state->dirlist_fd = -1;
+            if (ok && rename(tmp_path, list_path) == 0) {
+                log_debug("[DirIndex] %s 已发布", list_path);
+            } else {
+                unlink(tmp_path);
+            }
+            free(tmp_path);
+            free(list_path);
+        }
         if (cfg->progress_base) {
             char config_path[1024];
             snprintf(config_path, sizeof(config_path), "%s.config", cfg->progress_base);
@@ -201,6 +260,63 @@ void finalize_progress(const Config *cfg, RuntimeState *state) {
     }
 }
 
+/**
+ * @brief  打开本次任务的指纹快照写入端
+ * @param  cfg    const Config*   全局配置指针，不能为空
+ * @param  state  RuntimeState*   运行时状态指针，不能为空
+ * @return void
+ *
+ * @note   创建 {base}.fpsnap.tmp 的快照写入端，此后 record_path 写入的每条记录（以及断点恢复时
+ *         重放的历史记录）都追加到写入端的记录日志；finalize_progress 成功时按实际记录数一次建表并发布，
+ *         扫描期间 Master 主线程不做任何建表或扩容。
+ *         -c 模式即生成快照（非 -c 模式不记录 pbin）：快照独立于归档，非归档模式下已完成分片随轮转删除，
+ *         快照仍覆盖本次任务的全部记录，下次半增量扫描不再只能重放残留分片。
+ *         局限：非归档任务中断后续传时，已删除的分片无法重放，发布的快照只含续传后的记录与残留分片
+ *         （缺失的条目在半增量扫描中按新条目 stat，只损失命中率）。
+ *         --clean 模式或创建失败时不生成快照，半增量扫描回退为重放历史分片。
+ */
+void open_snapshot_writer(const Config *cfg, RuntimeState *state) {
+    if (cfg->clean || !cfg->continue_mode || !cfg->progress_base || state->snapshot) return;
+    char *snap_path = get_snapshot_filename(cfg->progress_base);
+    size_t len = strlen(snap_path) + sizeof(".tmp");
+    char *tmp_path = safe_malloc(len);
+    snprintf(tmp_path, len, "%s.tmp", snap_path);
+    state->snapshot = ref_map_create_mapped(tmp_path);
+    if (!state->snapshot) {
+        log_warn("[Snapshot] 无法创建 %s，本次不生成指纹快照", tmp_path);
+    }
+    free(tmp_path);
+    free(snap_path);
+}
+
+/**
+ * @brief  打开本次任务的目录清单写入端
+ * @param  cfg     const Config*   全局配置指针，不能为空
+ * @param  state   RuntimeState*   运行时状态指针，不能为空
+ * @param  resume  bool            是否为中断任务的断点续传（保留已写入的清单记录）
+ * @return void
+ *
+ * @note   以 O_APPEND 打开 {base}.fpdir.tmp，必须在 fork Worker 之前调用：各 Worker 继承该 fd，
+ *         每读完一个目录以一次 write() 追加一条记录。续传时不截断，已扫描目录的记录继续有效，
+ *         重扫产生的重复记录由读取端以后写为准。生成条件与指纹快照相同（-c，非 --clean）；
+ *         --follow-symlinks 时 Worker 不记录清单，不打开写入端。
+ */
+void open_dirlist_writer(const Config *cfg, RuntimeState *state, bool resume) {
+    if (cfg->clean || !cfg->continue_mode || !cfg->progress_base) return;
+    if (cfg->follow_symlinks || state->dirlist_fd >= 0) return;
+    char *list_path = get_dirlist_filename(cfg->progress_base);
+    size_t len = strlen(list_path) + sizeof(".tmp");
+    char *tmp_path = safe_malloc(len);
+    snprintf(tmp_path, len, "%s.tmp", list_path);
+    int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (resume ? 0 : O_TRUNC);
+    state->dirlist_fd = open(tmp_path, flags, 0644);
+    if (state->dirlist_fd < 0) {
+        log_warn("[DirIndex] 无法创建 %s: %s，本次不生成目录清单", tmp_path, strerror(errno));
+    }
+    free(tmp_path);
+    free(list_path);
+}
+
 /**
  * @brief  清理所有进度文件（--clean 或 --runone 时调用）
  * @param  cfg    const Config*   全局配置指针，不能为空
@@ -208,7 +324,7 @@ void finalize_progress(const Config *cfg, RuntimeState *state) {
  * @return void
  *
  * @note   删除：统一索引、所有分片文件、按分片草稿 idx、归档文件、spbin、
- *         错误日志、config、fpbin 索引和分片、以及兼容旧版本的 progress.fpbin。
+ *         错误日志、config、指纹快照、目录清单、fpbin 索引和分片、以及兼容旧版本的 progress.fpbin。
  *         注意：仅删除到 write_slice_index + 200 为止的分片，保留可能更远的残留。
  */
 void cleanup_progress(const Config *cfg, RuntimeState *state) {
@@ -247,6 +363,19 @@ void cleanup_progress(const Config *cfg, RuntimeState *state) {
         unlink(config_path);
     }
 
+    char *snap_path = get_snapshot_filename(cfg->progress_base);
+    unlink(snap_path);
+    free(snap_path);
+
+    char *list_path = get_dirlist_filename(cfg->progress_base);
+    size_t list_len = strlen(list_path) + sizeof(".tmp");
+    char *list_tmp = safe_malloc(list_len);
+    snprintf(list_tmp, list_len, "%s.tmp", list_path);
+    unlink(list_path);
+    unlink(list_tmp);
+    free(list_tmp);
+    free(list_path);
+
     /* 清理残留 fpbin（基于 progress_base） */
     char *fpbin_idx = get_fpbin_index_filename(cfg->progress_base);
     unlink(fpbin_idx);
@@ -323,43 +452,13 @@ void spbin_append(AppContext *ctx, const SpbinEntry *entry) {
  * @return void
  *
  * @note   遍历 spbin_entries 数组，找到匹配 dev 且状态非 CONDEMNED 的条目，
- *         增加 pending_tasks 并通过 ipc_send 发送 IPC_MSG_SCAN 给 Worker。
- *         使用 next_requeue_worker 轮询选择 Worker，实现负载均衡。
+ *         通过 dispatch_task 按 credit 窗口分发给 Worker；窗口占满时进入 lost_tasks，
+ *         待 FINISH 归还 credit 后补发。
  */
 void spbin_requeue_recovered(AppContext *ctx, dev_t dev) {
     for (size_t i = 0; i < ctx->spbin_count; i++) {
         if (ctx->spbin_entries[i].dev == dev && ctx->spbin_entries[i].s_status != SP_STATUS_CONDEMNED) {
-            atomic_fetch_add(&ctx->pending_tasks, 1);
-            uint32_t plen = (uint32_t)strlen(ctx->spbin_entries[i].path);
-            int wid = ctx->next_requeue_worker % ctx->worker_pool->num_workers;
-            WorkerSlot *slot = &ctx->worker_pool->slots[wid];
-            slot->current_dev = ctx->spbin_entries[i].dev;
-            safe_strcpy(slot->current_path, ctx->spbin_entries[i].path, sizeof(slot->current_path));
-            ctx->next_requeue_worker++;
-            
-            /* v13.0.0: Send CMD_SCAN through cmd_queue instead of direct ipc_send */
-            CmdScanPayload *scan = malloc(sizeof(CmdScanPayload));
-            if (!scan) {
-                log_warn("[SPBIN] malloc failed for CMD_SCAN, dropping %s", ctx->spbin_entries[i].path);
-                atomic_fetch_sub(&ctx->pending_tasks, 1);
-                lost_tasks_push(&ctx->lost_tasks, strdup(ctx->spbin_entries[i].path));
-            } else {
-                scan->path_len = plen;
-                scan->dev = ctx->spbin_entries[i].dev;
-                safe_strcpy(scan->path, ctx->spbin_entries[i].path, sizeof(scan->path));
-                IpcThreadMsg msg = {
-                    .type = CMD_SCAN,
-                    .slot_id = wid,
-                    .data = scan,
-                    .data_len = sizeof(*scan)
-                };
-                if (!msg_queue_send(ctx->ipc_cmd_queues[wid], &msg)) {
-                    free(scan);
-                    log_warn("[SPBIN] cmd_queue full, dropping %s", ctx->spbin_entries[i].path);
-                    atomic_fetch_sub(&ctx->pending_tasks, 1);
-                    lost_tasks_push(&ctx->lost_tasks, strdup(ctx->spbin_entries[i].path));
-                }
-            }
+            dispatch_task(ctx, ctx->spbin_entries[i].path, ctx->spbin_entries[i].dev);
         }
     }
 }
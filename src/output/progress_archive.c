@@ -17,12 +17,14 @@
  * - task1.fpbin.idx    fpbin 分片的游标索引
  * - task1.archive      zlib 压缩的历史分片归档
  * - task1.config       会话配置快照
+ * - task1.fpsnap       已完成任务的指纹 → (mtime, d_type) 快照（可直接 mmap 的哈希表）
  */
 #include "progress.h"
 #include "utils.h"
 #include "archive_format.h"
 #include "msg_format.h"
 #include "msg_queue.h"
+#include "main_loop.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,6 +37,8 @@
 #include <stdint.h>
 #include <dirent.h>
 #include <stdatomic.h>
+#include <sys/eventfd.h>
+#include "thread_pool.h"
 #include "log.h"
 
 /* ================================================================
@@ -172,24 +176,102 @@ void finalize_archive(const Config *cfg, RuntimeState *state) {
  * 进度恢复 (从 archive 和散落 pbin)
  * ================================================================ */
 
+/* ================================================================
+ * 并行恢复任务
+ * ================================================================ */
+
+#define RESTORE_INFLIGHT_PER_THREAD 2   /* 每个解压线程最多 2 个在途块，限制恢复期间的缓冲内存 */
+
+/*
+ * 一个待恢复的数据块（归档块或散落 pbin 分片）。
+ * 解压、解析、指纹计算与 visited_set 插入在线程池中完成；
+ * reference_map 写入与 spbin 解析交回读取线程按 seq 顺序执行，保持与串行恢复相同的覆盖顺序。
+ */
+typedef struct RestoreJob {
+    unsigned long seq;
+    uint8_t block_type;           /* ARCHIVE_BLOCK_NORMAL / ARCHIVE_BLOCK_SPBIN */
+    bool compressed;              /* data 为 zlib 压缩数据（归档块），否则为原始数据区（pbin 分片） */
+    unsigned char *data;
+    size_t data_size;
+    size_t raw_size;              /* 解压后大小（仅 compressed） */
+    unsigned char *raw;           /* 解压结果；SPBIN 块保留到按序应用 */
+    size_t raw_len;
+    bool ok;
+    /* 供 reference_map 按序写入的解析结果（仅 ref_map 非 NULL 时收集） */
+    Fingerprint *fps;
+    time_t *mtimes;
+    unsigned char *d_types;
+    size_t n, cap;
+    struct RestoreJob *next;      /* 乱序完成的任务按 seq 挂链 */
+} RestoreJob;
+
+/**
+ * @brief  把一块解析结果追加到任务的 reference_map 待写入数组
+ * @param  job      RestoreJob*            目标任务，不能为空；数组已按 restore_job_run 预估的上限分配
+ * @param  fps      const Fingerprint*     指纹数组
+ * @param  mtimes   const time_t*          对应 mtime
+ * @param  d_types  const unsigned char*   对应 d_type
+ * @param  n        size_t                 条目数
+ * @return void
+ */
+static void restore_job_collect(RestoreJob *job, const Fingerprint *fps, const time_t *mtimes,
+                                const unsigned char *d_types, size_t n) {
+    if (n > job->cap - job->n) n = job->cap - job->n;
+    memcpy(job->fps + job->n, fps, n * sizeof(Fingerprint));
+    memcpy(job->mtimes + job->n, mtimes, n * sizeof(time_t));
+    memcpy(job->d_types + job->n, d_types, n);
+    job->n += n;
+}
+
+/**
+ * @brief  把 parse_pbin_buffer 攒下的一块指纹写入各集合
+ * @param  fps          const Fingerprint*     指纹数组
+ * @param  mtimes       const time_t*          对应记录的 mtime
+ * @param  d_types      const unsigned char*   对应记录的 d_type
+ * @param  n            size_t                 条目数，允许为 0
+ * @param  visited_set  FpStore*               允许为 NULL
+ * @param  ref_map      ReferenceMap*          允许为 NULL
+ * @param  collect      RestoreJob*            非 NULL 时 ref_map 的写入改为暂存到任务中，由读取线程按序应用
+ * @return void
+ */
+static void flush_pbin_fingerprints(const Fingerprint *fps, const time_t *mtimes,
+                                    const unsigned char *d_types, size_t n,
+                                    FpStore *visited_set,
+                                    ReferenceMap *ref_map,
+                                    RestoreJob *collect) {
+    if (n == 0) return;
+    if (visited_set) fp_store_insert_batch(visited_set, fps, n, NULL);
+    if (ref_map && collect) {
+        restore_job_collect(collect, fps, mtimes, d_types, n);
+    } else if (ref_map) {
+        for (size_t i = 0; i < n; i++) ref_map_insert(ref_map, fps[i].md5, mtimes[i], d_types[i]);
+    }
+}
+
 /**
  * @brief  解析 pbin/fpbin 数据缓冲区，提取指纹并插入集合
  * @param  buf          const uint8_t*    数据缓冲区指针，不能为空
  * @param  size         size_t            缓冲区大小（字节）
  * @param  max_rows     uint64_t          最大解析行数，0 表示无限制
- * @param  visited_set  FingerprintSet*   本次任务的 visited_set（去重），允许为 NULL
- * @param  ref_set      FingerprintSet*   半增量的 reference_set，允许为 NULL
+ * @param  visited_set  FpStore*          本次任务的 visited_set（去重），允许为 NULL
  * @param  ref_map      ReferenceMap*     半增量的 reference_map，允许为 NULL
+ * @param  collect      RestoreJob*       并行恢复时非 NULL，见 flush_pbin_fingerprints
  * @return void
  *
  * @note   按 pbin 记录格式顺序解析：path_len → path → dev → ino → mtime → d_type。
- *         对每条记录计算指纹并插入 visited_set（若提供）和 ref_set/ref_map（若提供）。
+ *         对每条记录计算指纹，每攒满 FP_INSERT_BATCH 条以 fp_set_insert_batch 批量插入
+ *         visited_set（若提供），并逐条写入 ref_map（若提供）。
  *         当 max_rows > 0 且已解析行数达到 max_rows 时提前停止。
  */
 static void parse_pbin_buffer(const uint8_t *buf, size_t size, uint64_t max_rows,
-                              FingerprintSet *visited_set,
-                              FingerprintSet *ref_set,
-                              ReferenceMap *ref_map) {
+                              FpStore *visited_set,
+                              ReferenceMap *ref_map,
+                              RestoreJob *collect) {
+    Fingerprint fps[FP_INSERT_BATCH];
+    time_t mtimes[FP_INSERT_BATCH];
+    unsigned char d_types[FP_INSERT_BATCH];
+    size_t pending = 0;
+
     size_t pos = 0;
     uint64_t rows = 0;
     while (pos < size) {
@@ -213,15 +295,18 @@ static void parse_pbin_buffer(const uint8_t *buf, size_t size, uint64_t max_rows
         memcpy(&mtime, buf + pos, sizeof(time_t)); pos += sizeof(time_t);
         memcpy(&d_type, buf + pos, sizeof(unsigned char)); pos += sizeof(unsigned char);
 
-        uint8_t fp[FP_SIZE];
-        fp_compute(path_str, dev, ino, fp);
+        fp_compute(path_str, dev, ino, fps[pending].md5);
         free(path_str);
-
-        if (visited_set) fp_set_insert(visited_set, fp);
-        if (ref_set) fp_set_insert(ref_set, fp);
-        if (ref_map) ref_map_insert(ref_map, fp, mtime, d_type);
+        mtimes[pending] = mtime;
+        d_types[pending] = d_type;
         rows++;
+
+        if (++pending == FP_INSERT_BATCH) {
+            flush_pbin_fingerprints(fps, mtimes, d_types, pending, visited_set, ref_map, collect);
+            pending = 0;
+        }
     }
+    flush_pbin_fingerprints(fps, mtimes, d_types, pending, visited_set, ref_map, collect);
 }
 
 /**
@@ -280,28 +365,222 @@ static void parse_spbin_buffer(const uint8_t *buf, size_t size,
     }
 }
 
+/* ================================================================
+ * 并行恢复流水线：读取线程（调用方）→ 线程池解压 / 解析 → 按序应用
+ * ================================================================ */
+
+typedef struct {
+    AppContext *ctx;              /* SPBIN 块应用目标，仅归档恢复时非 NULL */
+    FpStore *visited_set;
+    ReferenceMap *ref_map;
+    ThreadPool *pool;             /* NULL 表示线程池不可用，任务在读取线程内同步执行 */
+    int event_fd;
+    int max_inflight;
+    int inflight;
+    unsigned long next_seq;       /* 下一个提交的序号 */
+    unsigned long apply_seq;      /* 下一个待按序应用的序号 */
+    RestoreJob *pending;          /* 已完成、等待按序应用的任务（按 seq 升序） */
+} RestorePipeline;
+
+/* pbin 记录最小字节数（空路径），用于估算块内记录数上限 */
+#define PBIN_MIN_RECORD (sizeof(size_t) + sizeof(dev_t) + sizeof(ino_t) + sizeof(time_t) + sizeof(unsigned char))
+
+/**
+ * @brief  线程池回调：解压并解析一个恢复任务
+ * @param  batch      TPBatch*  count 为 0 的任务载体，batch->job 为 RestoreJob*
+ * @param  user_data  void*     RestorePipeline*
+ * @return void
+ *
+ * @note   NORMAL 块在此完成指纹计算并直接批量插入 visited_set（FpStore 线程安全，插入顺序无关）；
+ *         reference_map 非线程安全且后写覆盖先写，解析结果暂存在任务中交回读取线程。
+ *         SPBIN 块只解压，解析涉及 DeviceManager / ProbeScheduler，留给读取线程。
+ */
+static void restore_job_run(TPBatch *batch, void *user_data) {
+    RestorePipeline *rp = user_data;
+    RestoreJob *job = batch->job;
+
+    if (job->compressed) {
+        job->raw = safe_malloc(job->raw_size ? job->raw_size : 1);
+        unsigned long dest_len = job->raw_size;
+        job->ok = uncompress(job->raw, &dest_len, job->data, job->data_size) == Z_OK;
+        job->raw_len = dest_len;
+        free(job->data);
+    } else {
+        job->raw = job->data;
+        job->raw_len = job->data_size;
+        job->ok = true;
+    }
+    job->data = NULL;
+    if (!job->ok || job->block_type == ARCHIVE_BLOCK_SPBIN) return;
+
+    if (rp->ref_map) {
+        job->cap = job->raw_len / PBIN_MIN_RECORD + 1;
+        job->fps = safe_malloc(job->cap * sizeof(Fingerprint));
+        job->mtimes = safe_malloc(job->cap * sizeof(time_t));
+        job->d_types = safe_malloc(job->cap);
+    }
+    parse_pbin_buffer(job->raw, job->raw_len, 0, rp->visited_set, rp->ref_map, job);
+    free(job->raw);
+    job->raw = NULL;
+}
+
+/**
+ * @brief  在读取线程中应用一个已完成的任务并释放
+ * @param  rp   RestorePipeline*  流水线，不能为空
+ * @param  job  RestoreJob*       seq 必须等于 rp->apply_seq
+ * @return void
+ */
+static void restore_job_apply(RestorePipeline *rp, RestoreJob *job) {
+    if (job->ok && job->block_type == ARCHIVE_BLOCK_SPBIN) {
+        if (rp->ctx) parse_spbin_buffer(job->raw, job->raw_len, rp->ctx);
+    } else if (rp->ref_map) {
+        for (size_t i = 0; i < job->n; i++) {
+            ref_map_insert(rp->ref_map, job->fps[i].md5, job->mtimes[i], job->d_types[i]);
+        }
+    }
+    free(job->raw);
+    free(job->fps);
+    free(job->mtimes);
+    free(job->d_types);
+    free(job);
+    rp->apply_seq++;
+}
+
+/**
+ * @brief  登记一个已完成的任务，并按序应用所有已就绪的任务
+ * @param  rp   RestorePipeline*  流水线，不能为空
+ * @param  job  RestoreJob*       已完成的任务
+ * @return void
+ */
+static void restore_job_done(RestorePipeline *rp, RestoreJob *job) {
+    RestoreJob **pp = &rp->pending;
+    while (*pp && (*pp)->seq < job->seq) pp = &(*pp)->next;
+    job->next = *pp;
+    *pp = job;
+    while (rp->pending && rp->pending->seq == rp->apply_seq) {
+        RestoreJob *ready = rp->pending;
+        rp->pending = ready->next;
+        restore_job_apply(rp, ready);
+    }
+}
+
+/**
+ * @brief  等待至少一个在途任务完成并收取全部已完成任务
+ * @param  rp  RestorePipeline*  流水线，不能为空；调用时 inflight > 0
+ * @return void
+ */
+static void restore_wait(RestorePipeline *rp) {
+    eventfd_t v;
+    eventfd_read(rp->event_fd, &v);
+    TPBatch *batch;
+    while ((batch = thread_pool_poll_completed(rp->pool)) != NULL) {
+        RestoreJob *job = batch->job;
+        tp_batch_free(batch);
+        rp->inflight--;
+        restore_job_done(rp, job);
+    }
+}
+
+/**
+ * @brief  初始化恢复流水线
+ * @param  rp           RestorePipeline*  输出，不能为空
+ * @param  cfg          const Config*     全局配置，线程数取 --master-threads
+ * @param  ctx          AppContext*       SPBIN 块应用目标，允许为 NULL
+ * @param  visited_set  FpStore*          允许为 NULL
+ * @param  ref_map      ReferenceMap*     允许为 NULL
+ * @return void
+ *
+ * @note   eventfd 或线程池创建失败时退化为在读取线程内串行处理，结果相同。
+ */
+static void restore_begin(RestorePipeline *rp, const Config *cfg, AppContext *ctx,
+                          FpStore *visited_set, ReferenceMap *ref_map) {
+    memset(rp, 0, sizeof(*rp));
+    rp->ctx = ctx;
+    rp->visited_set = visited_set;
+    rp->ref_map = ref_map;
+    rp->event_fd = -1;
+    int threads = cfg->master_threads > 0 ? cfg->master_threads : 1;
+    rp->max_inflight = threads * RESTORE_INFLIGHT_PER_THREAD;
+    if (threads > 1) {
+        rp->event_fd = eventfd(0, EFD_CLOEXEC);
+        if (rp->event_fd >= 0) rp->pool = thread_pool_create(threads, rp->event_fd, restore_job_run, rp);
+    }
+}
+
+/**
+ * @brief  提交一个数据块（读取线程调用）
+ * @param  rp          RestorePipeline*  流水线，不能为空
+ * @param  block_type  uint8_t           ARCHIVE_BLOCK_NORMAL / ARCHIVE_BLOCK_SPBIN
+ * @param  data        unsigned char*    块数据（所有权转移给流水线）
+ * @param  data_size   size_t            data 字节数
+ * @param  compressed  bool              data 是否为 zlib 压缩数据
+ * @param  raw_size    size_t            解压后大小（仅 compressed 时有效）
+ * @return void
+ *
+ * @note   在途任务达到上限时先等待完成，读取速度受解压速度反压，缓冲内存有界。
+ */
+static void restore_submit(RestorePipeline *rp, uint8_t block_type, unsigned char *data,
+                           size_t data_size, bool compressed, size_t raw_size) {
+    RestoreJob *job = safe_malloc(sizeof(RestoreJob));
+    memset(job, 0, sizeof(*job));
+    job->seq = rp->next_seq++;
+    job->block_type = block_type;
+    job->data = data;
+    job->data_size = data_size;
+    job->compressed = compressed;
+    job->raw_size = raw_size;
+
+    TPBatch *batch = rp->pool ? tp_batch_create(0) : NULL;
+    if (batch) {
+        while (rp->inflight >= rp->max_inflight) restore_wait(rp);
+        batch->job = job;
+        if (thread_pool_submit(rp->pool, batch)) {
+            rp->inflight++;
+            return;
+        }
+        tp_batch_free(batch);
+    }
+    /* 同步执行：无线程池或提交失败 */
+    TPBatch local = { .job = job };
+    restore_job_run(&local, rp);
+    restore_job_done(rp, job);
+}
+
+/**
+ * @brief  等待全部在途任务完成并释放流水线
+ * @param  rp  RestorePipeline*  流水线，不能为空
+ * @return void
+ */
+static void restore_end(RestorePipeline *rp) {
+    while (rp->inflight > 0) restore_wait(rp);
+    thread_pool_destroy(rp->pool);
+    if (rp->event_fd >= 0) close(rp->event_fd);
+    rp->pool = NULL;
+    rp->event_fd = -1;
+}
+
 /**
  * @brief  遍历归档文件，解压并解析所有块
  * @param  cfg         const Config*   全局配置指针，不能为空
  * @param  ctx         AppContext*     应用上下文指针，不能为空
- * @param  visited_set FingerprintSet* 本次任务的 visited_set，允许为 NULL
- * @param  ref_set     FingerprintSet* 半增量的 reference_set，允许为 NULL
+ * @param  visited_set FpStore*        本次任务的 visited_set，允许为 NULL
  * @param  ref_map     ReferenceMap*   半增量的 reference_map，允许为 NULL
  * @return void
  *
- * @note   顺序读取 ArchiveBlockHeader，做 sanity check（block_type、大小上限 512MB）后，
- *         分配缓冲区、读取压缩数据、调用 uncompress 解压，再根据 block_type 分发到
- *         parse_pbin_buffer 或 parse_spbin_buffer。
- *         若某块校验失败或读取不完整，则停止继续解析。
+ * @note   读取线程（调用方）顺序读取 ArchiveBlockHeader 与压缩数据，做 sanity check
+ *         （block_type、大小上限 512MB）后交给恢复流水线：--master-threads 个线程并行解压、
+ *         解析并插入 visited_set，reference_map 写入与 SPBIN 块按归档顺序在读取线程应用。
+ *         若某块校验失败或读取不完整，则停止继续读取（已提交的块照常完成）。
  */
 static void iterate_archive(const Config *cfg, AppContext *ctx,
-                            FingerprintSet *visited_set,
-                            FingerprintSet *ref_set,
+                            FpStore *visited_set,
                             ReferenceMap *ref_map) {
     char *archive_path = get_archive_filename(cfg->progress_base);
     FILE *fp = fopen(archive_path, "rb");
     if (!fp) { free(archive_path); return; }
 
+    RestorePipeline rp;
+    restore_begin(&rp, cfg, ctx, visited_set, ref_map);
     ArchiveBlockHeader bh;
     while (fread(&bh, sizeof(bh), 1, fp) == 1) {
         /* Sanity check for corrupted or old-format archive */
@@ -312,20 +591,10 @@ static void iterate_archive(const Config *cfg, AppContext *ctx,
         if (fread(cmp_buf, 1, bh.compressed_size, fp) != bh.compressed_size) {
             free(cmp_buf); break;
         }
-
-        unsigned char *raw_buf = safe_malloc(bh.uncompressed_size);
-        unsigned long dest_len = bh.uncompressed_size;
-        if (uncompress(raw_buf, &dest_len, cmp_buf, bh.compressed_size) == Z_OK) {
-            if (bh.block_type == ARCHIVE_BLOCK_SPBIN) {
-                parse_spbin_buffer(raw_buf, dest_len, ctx);
-            } else {
-                /* 归档块内是纯数据区，无 Footer */
-                parse_pbin_buffer(raw_buf, dest_len, 0, visited_set, ref_set, ref_map);
-            }
-        }
-        free(raw_buf);
-        free(cmp_buf);
+        /* 归档块内是纯数据区，无 Footer */
+        restore_submit(&rp, bh.block_type, cmp_buf, bh.compressed_size, true, bh.uncompressed_size);
     }
+    restore_end(&rp);
     fclose(fp);
     free(archive_path);
 }
@@ -334,19 +603,19 @@ static void iterate_archive(const Config *cfg, AppContext *ctx,
  * @brief  遍历磁盘上散落的 pbin 分片并解析
  * @param  cfg         const Config*   全局配置指针，不能为空
  * @param  state       RuntimeState*   运行时状态指针（当前未使用，保留接口一致性）
- * @param  visited_set FingerprintSet* 本次任务的 visited_set，允许为 NULL
- * @param  ref_set     FingerprintSet* 半增量的 reference_set，允许为 NULL
+ * @param  visited_set FpStore*        本次任务的 visited_set，允许为 NULL
  * @param  ref_map     ReferenceMap*   半增量的 reference_map，允许为 NULL
  * @return void
  *
  * @note   从分片 0 开始顺序尝试打开，连续缺失超过 50 个且已超过 write_slice_index 时停止。
- *         对每个存在的分片：读取全部内容，若末尾有有效 Footer 则剔除 Footer 后解析数据区，
+ *         对每个存在的分片：读取全部内容，若末尾有有效 Footer 则剔除 Footer 后交给恢复流水线并行解析，
  *         否则解析整个文件（可能包含无效数据，但 parse_pbin_buffer 会自动防御）。
  */
 static void iterate_pbin_slices(const Config *cfg, RuntimeState *state,
-                                FingerprintSet *visited_set,
-                                FingerprintSet *ref_set,
+                                FpStore *visited_set,
                                 ReferenceMap *ref_map) {
+    RestorePipeline rp;
+    restore_begin(&rp, cfg, NULL, visited_set, ref_map);
     int consecutive_missing = 0;
     for (unsigned long s_idx = 0; ; ++s_idx) {
         char *slice_path = get_slice_filename(cfg->progress_base, s_idx);
@@ -372,12 +641,12 @@ static void iterate_pbin_slices(const Config *cfg, RuntimeState *state,
                     data_size = fsize - (long)sizeof(PbinFooter);
                 }
             }
-            parse_pbin_buffer(buf, data_size, 0, visited_set, ref_set, ref_map);
-            free(buf);
+            restore_submit(&rp, ARCHIVE_BLOCK_NORMAL, buf, (size_t)data_size, false, 0);
         }
         fclose(slice_fp);
         free(slice_path);
     }
+    restore_end(&rp);
 }
 
 /**
@@ -681,41 +950,10 @@ void pump_pbin_batch(AppContext *ctx, int batch_size) {
         /* Load into visited_set to avoid duplicate output */
         uint8_t fp_all[FP_SIZE];
         fp_compute(path, st.st_dev, st.st_ino, fp_all);
-        fp_set_insert(ctx->visited_set, fp_all);
+        fp_store_insert(ctx->visited_set, fp_all);
 
         if (d_type == DT_DIR) {
-            atomic_fetch_add(&ctx->pending_tasks, 1);
-            uint32_t plen = (uint32_t)strlen(path);
-            static int next_wid = 0;
-            int wid = next_wid % ctx->worker_pool->num_workers;
-            next_wid++;
-            WorkerSlot *slot = &ctx->worker_pool->slots[wid];
-            slot->current_dev = st.st_dev;
-            safe_strcpy(slot->current_path, path, sizeof(slot->current_path));
-            
-            /* v13.0.0: Send CMD_SCAN through cmd_queue instead of direct ipc_send */
-            CmdScanPayload *scan = malloc(sizeof(CmdScanPayload));
-            if (!scan) {
-                log_warn("[Pump] malloc failed for CMD_SCAN, dropping %s", path);
-                atomic_fetch_sub(&ctx->pending_tasks, 1);
-                lost_tasks_push(&ctx->lost_tasks, strdup(path));
-            } else {
-                scan->path_len = plen;
-                scan->dev = st.st_dev;
-                safe_strcpy(scan->path, path, sizeof(scan->path));
-                IpcThreadMsg msg = {
-                    .type = CMD_SCAN,
-                    .slot_id = wid,
-                    .data = scan,
-                    .data_len = sizeof(*scan)
-                };
-                if (!msg_queue_send(ctx->ipc_cmd_queues[wid], &msg)) {
-                    free(scan);
-                    log_warn("[Pump] cmd_queue full, dropping %s", path);
-                    atomic_fetch_sub(&ctx->pending_tasks, 1);
-                    lost_tasks_push(&ctx->lost_tasks, strdup(path));
-                }
-            }
+            dispatch_task(ctx, path, st.st_dev);
             sent++;
         }
         free(path);
@@ -733,7 +971,7 @@ void pump_pbin_batch(AppContext *ctx, int batch_size) {
  *         1. 重置 fpbin 和 pump 状态
  *         2. 加载统一索引文件（idx）
  *         3. 统计归档块数和散落分片数
- *         4. 加载归档文件内容到 visited_set
+ *         4. 加载归档文件内容到 visited_set（历史记录同时写入指纹快照，见 open_snapshot_writer）
  *         5. 若无索引且历史块数超过 1，执行全量重扫；否则加载散落分片
  *         6. 对有索引的情况，逐个加载散落 pbin 分片：
  *            - 已完成的旧分片（< write_slice_index）：完整解析
@@ -771,7 +1009,8 @@ int restore_progress(const Config *cfg, AppContext *ctx) {
     }
 
     /* 2. Load archive (completed slices) into visited_set */
-    iterate_archive(cfg, ctx, ctx->visited_set, NULL, NULL);
+    ctx->visited_history = true;
+    iterate_archive(cfg, ctx, ctx->visited_set, ctx->state.snapshot);
 
     if (!has_idx) {
         if (total_blocks > 1) {
@@ -801,7 +1040,7 @@ int restore_progress(const Config *cfg, AppContext *ctx) {
         ctx->state.output_slice_num = 0;
         ctx->state.output_line_count = 0;
         /* Single block: load scattered slices and done */
-        iterate_pbin_slices(cfg, &ctx->state, ctx->visited_set, NULL, NULL);
+        iterate_pbin_slices(cfg, &ctx->state, ctx->visited_set, ctx->state.snapshot);
         return 0;
     }
 
@@ -849,10 +1088,10 @@ int restore_progress(const Config *cfg, AppContext *ctx) {
 
             if (s_idx < ctx->state.write_slice_index) {
                 /* 已完成分片：解析 row_count 行 */
-                parse_pbin_buffer(buf, data_size, row_count, ctx->visited_set, NULL, NULL);
+                parse_pbin_buffer(buf, data_size, row_count, ctx->visited_set, ctx->state.snapshot, NULL);
             } else if (s_idx == ctx->state.write_slice_index) {
                 /* 活跃分片：只解析已处理的 line_count 行 */
-                parse_pbin_buffer(buf, data_size, ctx->state.line_count, ctx->visited_set, NULL, NULL);
+                parse_pbin_buffer(buf, data_size, ctx->state.line_count, ctx->visited_set, ctx->state.snapshot, NULL);
             }
             free(buf);
         }
@@ -942,19 +1181,19 @@ int restore_progress(const Config *cfg, AppContext *ctx) {
 }
 
 /**
- * @brief  半增量模式：将历史索引加载到内存中的 reference_set/map
+ * @brief  半增量模式：将历史索引加载到内存中的 reference_map
  * @param  cfg  const Config*  全局配置指针，不能为空
  * @param  ctx  AppContext*     应用上下文指针，不能为空
  * @return void
  *
- * @note   遍历归档文件和散落 pbin 分片，将指纹插入 reference_set，
- *         将 (mtime, d_type) 插入 reference_map。
+ * @note   遍历归档文件和散落 pbin 分片，将 指纹 → (mtime, d_type) 插入 reference_map，
+ *         存在性与元数据共用这一张表。
  *         用于支撑半增量扫描的 blind-trust 机制。
  */
 void restore_progress_to_memory(const Config *cfg, AppContext *ctx) {
     verbose_printf(cfg, 1, "开始加载半增量索引...\n");
-    iterate_archive(cfg, ctx, NULL, ctx->reference_set, ctx->reference_map);
-    iterate_pbin_slices(cfg, &ctx->state, NULL, ctx->reference_set, ctx->reference_map);
+    iterate_archive(cfg, ctx, NULL, ctx->reference_map);
+    iterate_pbin_slices(cfg, &ctx->state, NULL, ctx->reference_map);
     verbose_printf(cfg, 1, "历史索引加载完成\n");
 }
 
@@ -17,6 +17,7 @@
  * - task1.fpbin.idx    fpbin 分片的游标索引
  * - task1.archive      zlib 压缩的历史分片归档
  * - task1.config       会话配置快照
+ * - task1.fpsnap       已完成任务的指纹 → (mtime, d_type) 快照（可直接 mmap 的哈希表）
  */
 #include "progress.h"
 #include "utils.h"
@@ -189,6 +190,7 @@ void write_pbin_record(FILE *fp, const char *path, const struct stat *info) {
  * @return void
  *
  * @note   若当前无活跃分片，自动创建新的 pbin 文件和对应的 .idx 草稿。
+ *         快照写入端已打开时，同时把 (指纹, mtime, d_type) 追加到 state->snapshot 的记录日志。
  *         当 line_count 达到 progress_slice_lines（默认 100000）时执行分片轮转：
  *         1. 写入 Footer 封口当前分片
  *         2. 删除草稿 idx（"烧草稿"）
@@ -211,6 +213,11 @@ void record_path(const Config *cfg, RuntimeState *state, const char *path, const
     }
     if (!state->write_slice_file) return;
     write_pbin_record(state->write_slice_file, path, info);
+    if (state->snapshot && info) {
+        uint8_t fp[FP_SIZE];
+        fp_compute(path, info->st_dev, info->st_ino, fp);
+        ref_map_insert(state->snapshot, fp, info->st_mtime, mode_to_dtype(info->st_mode));
+    }
     state->line_count++;
     state->processed_count++;
     if (state->line_count >= cfg->progress_slice_lines) {
@@ -265,7 +272,12 @@ static void record_path_batch_flush_internal(const Config *cfg, RuntimeState *st
     if (!batch || batch->count == 0) return;
     for (int i = 0; i < batch->count; i++) {
         record_path(cfg, state, batch->paths[i], &batch->stats[i]);
-        free(batch->paths[i]);
+        if (batch->arenas[i]) {
+            path_arena_unref(batch->arenas[i]);
+            batch->arenas[i] = NULL;
+        } else {
+            free(batch->paths[i]);
+        }
         batch->paths[i] = NULL;
     }
     batch->count = 0;
@@ -290,12 +302,15 @@ void record_path_batch_flush(const Config *cfg, RuntimeState *state, RecordBatch
  * @param  batch  RecordBatch*        批量缓冲指针，不能为空
  * @param  path   const char*         文件路径，不能为空
  * @param  info   const struct stat*  文件 stat 信息指针，允许为 NULL
+ * @param  arena  PathArena*          path 所在的共享路径缓冲，允许为 NULL（此时复制 path）
  * @return bool  返回 true 表示追加成功；false 表示内存分配失败
  *
  * @note   当 batch->count >= RECORD_BATCH_COUNT（4096）或
  *         total_bytes + entry_size >= RECORD_BATCH_BYTES（1MB）时自动刷出。
+ *         arena 非 NULL 时只增加引用，不复制路径。
  */
-bool record_path_batch_append(const Config *cfg, RuntimeState *state, RecordBatch *batch, const char *path, const struct stat *info) {
+bool record_path_batch_append(const Config *cfg, RuntimeState *state, RecordBatch *batch, const char *path,
+                              const struct stat *info, PathArena *arena) {
     if (!batch || !path) return false;
     
     size_t path_len = strlen(path);
@@ -312,7 +327,14 @@ bool record_path_batch_append(const Config *cfg, RuntimeState *state, RecordBatc
         record_path_batch_flush_internal(cfg, state, batch);
     }
     
-    batch->paths[batch->count] = strdup(path);
+    if (arena) {
+        path_arena_ref(arena);
+        batch->paths[batch->count] = (char *)path;
+    } else {
+        batch->paths[batch->count] = strdup(path);
+        if (!batch->paths[batch->count]) return false;
+    }
+    batch->arenas[batch->count] = arena;
     if (info) {
         batch->stats[batch->count] = *info;
     } else {
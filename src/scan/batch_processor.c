@@ -4,6 +4,8 @@
  *
  * 负责将从 Worker 接收的原始 IPC BATCH payload 解析为结构化数据，
  * 提交到 CPU 去重线程池，并在主线程中处理完成后的批次。
+ * 一个批次的全部完整路径写入同一个引用计数的 PathArena，
+ * 输出线程与进度记录只持有引用，逐条记录不再 malloc/strdup/free。
  */
 #define _GNU_SOURCE
 #include "main_loop.h"
@@ -14,6 +16,7 @@
 #include "msg_format.h"
 #include "msg_queue.h"
 #include "ipc_thread.h"
+#include "dedup_policy.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -23,66 +26,122 @@
 #include <stdatomic.h>
 
 /* ================================================================
- * ParsedBatch helpers
+ * Batch parsing
  * ================================================================ */
 
-typedef struct {
-    char **paths;
-    struct stat *stats;
-    int count;
-} ParsedBatch;
-
-static void parsed_batch_free(ParsedBatch *b) {
-    if (!b) return;
-    for (int i = 0; i < b->count; i++) free(b->paths[i]);
-    free(b->paths);
-    free(b->stats);
-    b->paths = NULL;
-    b->stats = NULL;
-    b->count = 0;
+/**
+ * @brief  解码 BATCH v2 紧凑属性记录为 struct stat
+ * @param  p       const uint8_t*  记录起始位置（IpcBatchStat），调用方已校验长度
+ * @param  fields  uint16_t        IPC_BATCH_F_* 组合
+ * @param  st      struct stat*    输出，未携带的字段置 0
+ * @return const uint8_t*  记录结束后的位置
+ */
+static const uint8_t *batch_get_stat(const uint8_t *p, uint16_t fields, struct stat *st) {
+    IpcBatchStat bs;
+    memcpy(&bs, p, sizeof(bs)); p += sizeof(bs);
+    memset(st, 0, sizeof(*st));
+    st->st_dev   = (dev_t)bs.dev;
+    st->st_ino   = (ino_t)bs.ino;
+    st->st_mode  = (mode_t)bs.mode;
+    st->st_mtime = (time_t)bs.mtime;
+    if (fields & IPC_BATCH_F_SIZE) {
+        uint64_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_size = (off_t)v;
+    }
+    if (fields & IPC_BATCH_F_UID) {
+        uint32_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_uid = (uid_t)v;
+    }
+    if (fields & IPC_BATCH_F_GID) {
+        uint32_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_gid = (gid_t)v;
+    }
+    if (fields & IPC_BATCH_F_ATIME) {
+        int64_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_atime = (time_t)v;
+    }
+    if (fields & IPC_BATCH_F_CTIME) {
+        int64_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_ctime = (time_t)v;
+    }
+    if (fields & IPC_BATCH_F_NLINK) {
+        uint32_t v; memcpy(&v, p, sizeof(v)); p += sizeof(v);
+        st->st_nlink = (nlink_t)v;
+    }
+    return p;
 }
 
-static bool parse_batch(const uint8_t *payload, uint32_t len, ParsedBatch *out) {
-    memset(out, 0, sizeof(*out));
-    if (len < sizeof(IpcBatchHeader)) return false;
+/**
+ * @brief  解析 Worker 发来的 BATCH v2 负载
+ * @param  payload    const uint8_t*  RET_BATCH 负载，不能为空
+ * @param  len        uint32_t        负载字节数
+ * @param  worker_id  int             来源 Worker 编号
+ * @return TPBatch*  成功返回 batch（results 初值 4 = Worker 已本地下探）；格式错误或内存不足返回 NULL
+ *
+ * @note   目录前缀在负载中只出现一次，逐条记录按 dir + "/" + name 还原到同一个 PathArena，
+ *         paths[i] 指向 arena 内部；整批只有 batch 与 arena 两次分配。
+ *         arena 容量按 count * (dir_len + 2) + 负载长度预估，名字总长不会超过负载长度。
+ *         未携带的 stat 字段为 0（本次运行的输出格式不会用到）。
+ */
+static TPBatch *parse_batch(const uint8_t *payload, uint32_t len, int worker_id) {
+    if (len < sizeof(IpcBatchHeader)) return NULL;
 
     const uint8_t *p = payload;
+    const uint8_t *end = payload + len;
     IpcBatchHeader bh;
     memcpy(&bh, p, sizeof(bh));
     p += sizeof(bh);
 
+    if (bh.version != IPC_BATCH_VERSION) {
+        log_error("[Batch] unsupported batch version %u", bh.version);
+        return NULL;
+    }
     if (bh.count > 1000000) {
         log_error("[Batch] count %u exceeds sanity limit", bh.count);
-        return false;
+        return NULL;
+    }
+    if (bh.dir_len > (size_t)(end - p)) return NULL;
+    const char *dir = (const char *)p;
+    p += bh.dir_len;
+
+    size_t stat_size = sizeof(IpcBatchStat);
+    if (bh.fields & IPC_BATCH_F_SIZE)  stat_size += sizeof(uint64_t);
+    if (bh.fields & IPC_BATCH_F_UID)   stat_size += sizeof(uint32_t);
+    if (bh.fields & IPC_BATCH_F_GID)   stat_size += sizeof(uint32_t);
+    if (bh.fields & IPC_BATCH_F_ATIME) stat_size += sizeof(int64_t);
+    if (bh.fields & IPC_BATCH_F_CTIME) stat_size += sizeof(int64_t);
+    if (bh.fields & IPC_BATCH_F_NLINK) stat_size += sizeof(uint32_t);
+
+    TPBatch *batch = tp_batch_create((int)bh.count);
+    if (!batch) return NULL;
+    batch->worker_id = worker_id;
+    if (bh.count > 0) {
+        batch->arena = path_arena_create((size_t)bh.count * (bh.dir_len + 2) + len);
+        if (!batch->arena) goto fail;
     }
-
-    out->paths = calloc(bh.count, sizeof(char*));
-    out->stats = calloc(bh.count, sizeof(struct stat));
-    if (!out->paths || !out->stats) goto fail;
 
     for (uint32_t i = 0; i < bh.count; i++) {
-        if ((size_t)(p - payload) + sizeof(uint32_t) > len) goto fail;
-        uint32_t plen;
-        memcpy(&plen, p, sizeof(plen));
-        p += sizeof(plen);
-
-        if ((size_t)(p - payload) + plen + sizeof(struct stat) > len) goto fail;
-
-        out->paths[i] = malloc(plen + 1);
-        if (!out->paths[i]) goto fail;
-        memcpy(out->paths[i], p, plen);
-        out->paths[i][plen] = '\0';
-        p += plen;
-
-        memcpy(&out->stats[i], p, sizeof(struct stat));
-        p += sizeof(struct stat);
-        out->count++;
+        if (sizeof(uint16_t) > (size_t)(end - p)) goto fail;
+        uint16_t nlen;
+        memcpy(&nlen, p, sizeof(nlen));
+        p += sizeof(nlen);
+        if (nlen & IPC_BATCH_LOCAL) batch->results[i] = 4;
+        nlen &= IPC_BATCH_LEN_MASK;
+
+        if ((size_t)nlen + stat_size > (size_t)(end - p)) goto fail;
+
+        batch->paths[i] = path_arena_join(batch->arena, dir, bh.dir_len, (const char *)p, nlen);
+        if (!batch->paths[i]) goto fail;
+        p += nlen;
+
+        p = batch_get_stat(p, bh.fields, &batch->stats[i]);
+        batch->count++;
     }
-    return true;
+    return batch;
 
 fail:
-    parsed_batch_free(out);
-    return false;
+    tp_batch_free(batch);
+    return NULL;
 }
 
 /* ================================================================
@@ -99,27 +158,54 @@ void batch_dedup_worker(TPBatch *batch, void *user_data) {
 
     AppContext *ctx = user_data;
     const int ITERATION_LIMIT = 100000; /* v15.1.2: hard timeout for single batch */
-    for (int i = 0; i < batch->count; i++) {
-        if (i >= ITERATION_LIMIT) {
-            log_fatal("[DedupWorker] batch iteration exceeded limit %d (count=%d). Aborting to prevent CPU spin.",
-                      ITERATION_LIMIT, batch->count);
-            for (int j = i; j < batch->count; j++) {
-                batch->results[j] = 1; /* duplicate (skip) */
-            }
-            return;
+    int count = batch->count;
+    if (count > ITERATION_LIMIT) {
+        log_fatal("[DedupWorker] batch iteration exceeded limit %d (count=%d). Aborting to prevent CPU spin.",
+                  ITERATION_LIMIT, batch->count);
+        for (int j = ITERATION_LIMIT; j < count; j++) {
+            batch->results[j] = 1; /* duplicate (skip) */
         }
-        const char *path = batch->paths[i];
-        struct stat *st = &batch->stats[i];
-        uint8_t fp[FP_SIZE];
-        fp_compute(path, st->st_dev, st->st_ino, fp);
-        uint8_t result = 0;
-        if (fp_set_insert(ctx->visited_set, fp)) {
-            result |= 1; /* duplicate */
+        count = ITERATION_LIMIT;
+    }
+
+    /* 先整块计算指纹，再批量插入：visited_set 的缓存未命中由预取重叠，分片锁每块每分片只取一次。
+     * 按去重策略不入集合的条目，在载入历史进度后仍需查询（历史中的文件指纹用于续传去重） */
+    DedupPolicy policy = ctx->cfg.dedup_policy;
+    Fingerprint fps[FP_INSERT_BATCH];
+    int slot[FP_INSERT_BATCH];
+    bool dup[FP_INSERT_BATCH];
+    bool existed[FP_INSERT_BATCH];
+    for (int base = 0; base < count; base += FP_INSERT_BATCH) {
+        int n = count - base < FP_INSERT_BATCH ? count - base : FP_INSERT_BATCH;
+        int m = 0;
+        for (int k = 0; k < n; k++) {
+            const char *path = batch->paths[base + k];
+            const struct stat *st = &batch->stats[base + k];
+            DedupKey key = dedup_policy_key(policy, st);
+            dup[k] = false;
+            if (key != DEDUP_KEY_PATH && ctx->visited_history) {
+                uint8_t fp[FP_SIZE];
+                dedup_policy_fingerprint(DEDUP_KEY_PATH, path, st, fp);
+                dup[k] = fp_store_contains(ctx->visited_set, fp);
+            }
+            if (key == DEDUP_KEY_NONE || dup[k]) continue;
+            dedup_policy_fingerprint(key, path, st, fps[m].md5);
+            slot[m++] = k;
         }
-        if (dev_mgr_is_blacklisted(ctx->dev_mgr, st->st_dev)) {
-            result |= 2; /* blacklisted */
+        fp_store_insert_batch(ctx->visited_set, fps, (size_t)m, existed);
+        for (int j = 0; j < m; j++) dup[slot[j]] = existed[j];
+
+        for (int k = 0; k < n; k++) {
+            int i = base + k;
+            uint8_t result = batch->results[i] & 5; /* keep worker-local flag and parse-time prune */
+            if (dup[k]) {
+                result |= 1; /* duplicate */
+            }
+            if (dev_mgr_is_blacklisted(ctx->dev_mgr, batch->stats[i].st_dev)) {
+                result |= 2; /* blacklisted */
+            }
+            batch->results[i] = result;
         }
-        batch->results[i] = result;
     }
 }
 
@@ -127,19 +213,29 @@ void batch_dedup_worker(TPBatch *batch, void *user_data) {
  * Side effects for a completed batch (must run on main thread)
  * ================================================================ */
 
+/**
+ * @brief  追加一条输出记录，内存不足时记录错误而不是静默丢弃
+ * @param  ctx    AppContext*         应用上下文指针，不能为空
+ * @param  out    OutputBatch*        当前批次的输出缓冲，不能为空
+ * @param  path   const char*         条目完整路径（位于 arena 内）
+ * @param  st     const struct stat*  条目属性
+ * @param  arena  PathArena*          path 所在的路径缓冲
+ * @return void
+ */
+static void emit_output(AppContext *ctx, OutputBatch *out, const char *path, const struct stat *st,
+                        PathArena *arena) {
+    if (output_batch_append(out, path, st, arena)) return;
+    log_error("[Batch] output append failed (out of memory), record dropped: %s", path_log_mask(path));
+    ctx->state.has_error = true;
+}
+
 static void process_completed_batch(AppContext *ctx, TPBatch *batch) {
     /* v15.1.4: defensive sanity check to prevent CPU spin from corrupted count */
     if (!batch || batch->count < 0 || batch->count > 1000000) {
         log_fatal("[Batch] batch invalid or count out of range: %p count=%d, worker=%d. Dropping.",
                   (void*)batch, batch ? batch->count : -999,
                   batch ? batch->worker_id : -999);
-        if (batch) {
-            for (int i = 0; i < batch->count && i < 1000000; i++) free(batch->paths[i]);
-            free(batch->paths);
-            free(batch->stats);
-            free(batch->results);
-            free(batch);
-        }
+        tp_batch_free(batch);
         atomic_fetch_sub(&ctx->pending_batches, 1);
         return;
     }
@@ -166,68 +262,34 @@ static void process_completed_batch(AppContext *ctx, TPBatch *batch) {
         }
 
         if (S_ISDIR(st->st_mode)) {
-            if (ctx->hist_pump_state == HIST_PUMP_OLD) {
+            if (result & 4) {
+                /* Worker 已在本地下探该目录（空闲时由 STEAL 取回），无需再分发或延后 */
+            } else if (ctx->hist_pump_state == HIST_PUMP_OLD) {
                 fpbin_append(ctx, path, st);
             } else {
-                atomic_fetch_add(&ctx->pending_tasks, 1);
-                int wid = dispatch_find_idle_worker(ctx);
-                if (wid < 0) {
-                    log_warn("[Dispatch] no IDLE worker available (path=%s), requeue to lost_tasks", path_log_mask(path));
-                    atomic_fetch_sub(&ctx->pending_tasks, 1);
-                    lost_tasks_push(&ctx->lost_tasks, strdup(path));
-                    continue;
-                }
-                WorkerSlot *slot = &ctx->worker_pool->slots[wid];
-                atomic_store(&slot->state, WORKER_STATE_BUSY);
-                slot->current_dev = st->st_dev;
-                safe_strcpy(slot->current_path, path, sizeof(slot->current_path));
-                if (!send_scan_to_ipc(ctx, wid, path, st->st_dev)) {
-                    atomic_fetch_sub(&ctx->pending_tasks, 1);
-                    atomic_store(&slot->state, WORKER_STATE_IDLE);
-                }
+                dispatch_task(ctx, path, st->st_dev);
             }
 
             ctx->state.dir_count++;
             if (ctx->cfg.include_dir) {
-                OutputTask *task = calloc(1, sizeof(OutputTask));
-                task->path = strdup(path);
-                task->st = *st;
-                if (out_batch.tail) {
-                    out_batch.tail->next = task;
-                } else {
-                    out_batch.head = task;
-                }
-                out_batch.tail = task;
-                out_batch.count++;
+                emit_output(ctx, &out_batch, path, st, batch->arena);
             }
             if (ctx->cfg.print_dir && ctx->state.dir_info_fp && !ctx->cfg.mute) {
                 fprintf(ctx->state.dir_info_fp, "%s%s\n", OUTPUT_DIR_PREFIX, path);
             }
             if (ctx->cfg.continue_mode && ctx->hist_pump_state != HIST_PUMP_OLD) {
-                record_path_batch_append(&ctx->cfg, &ctx->state, &ctx->record_batch, path, st);
+                record_path_batch_append(&ctx->cfg, &ctx->state, &ctx->record_batch, path, st, batch->arena);
             }
         } else {
             ctx->state.file_count++;
-            OutputTask *task = calloc(1, sizeof(OutputTask));
-            task->path = strdup(path);
-            task->st = *st;
-            if (out_batch.tail) {
-                out_batch.tail->next = task;
-            } else {
-                out_batch.head = task;
-            }
-            out_batch.tail = task;
-            out_batch.count++;
+            emit_output(ctx, &out_batch, path, st, batch->arena);
             if (ctx->cfg.continue_mode) {
-                record_path_batch_append(&ctx->cfg, &ctx->state, &ctx->record_batch, path, st);
+                record_path_batch_append(&ctx->cfg, &ctx->state, &ctx->record_batch, path, st, batch->arena);
             }
         }
 
         if (out_batch.count >= ASYNC_BATCH_SIZE) {
             async_writer_submit_batch(ctx->async_writer, &out_batch);
-            out_batch.head = NULL;
-            out_batch.tail = NULL;
-            out_batch.count = 0;
         }
     }
 
@@ -239,11 +301,7 @@ static void process_completed_batch(AppContext *ctx, TPBatch *batch) {
     log_debug("[Batch] pending_batches after sub: %ld", atomic_load(&ctx->pending_batches));
     ctx->state.total_dequeued_count++;
 
-    for (int i = 0; i < batch->count; i++) free(batch->paths[i]);
-    free(batch->paths);
-    free(batch->stats);
-    free(batch->results);
-    free(batch);
+    tp_batch_free(batch);
 }
 
 void drain_completed_batches(AppContext *ctx) {
@@ -258,38 +316,18 @@ void drain_completed_batches(AppContext *ctx) {
  * ================================================================ */
 
 void main_loop_handle_batch(AppContext *ctx, int worker_id, const void *payload, uint32_t len) {
-    ParsedBatch parsed;
-    if (!parse_batch(payload, len, &parsed)) {
+    TPBatch *batch = parse_batch(payload, len, worker_id);
+    if (!batch) {
         log_error("[Batch] Worker %d parse_batch FAILED (len=%u)", worker_id, len);
         return;
     }
-    log_debug("[Batch] Worker %d parse_batch OK (count=%d)", worker_id, parsed.count);
-
-    /* v15.1.4: defensive sanity check on parsed.count */
-    if (parsed.count < 0 || parsed.count > 1000000) {
-        log_fatal("[Batch] parsed.count out of range: %d (worker=%d, len=%u), dropping batch",
-                  parsed.count, worker_id, len);
-        parsed_batch_free(&parsed);
-        return;
-    }
-
-    uint8_t *results = calloc((size_t)parsed.count, 1);
-    if (!results) {
-        parsed_batch_free(&parsed);
+    log_debug("[Batch] Worker %d parse_batch OK (count=%d)", worker_id, batch->count);
+    if (dispatch_prune_local(ctx, worker_id, batch)) {
+        log_debug("[Batch] Worker %d batch lies in a pruned subtree, dropped (count=%d)", worker_id, batch->count);
+        tp_batch_free(batch);
         return;
     }
-
-    TPBatch *batch = malloc(sizeof(TPBatch));
-    if (!batch) {
-        free(results);
-        parsed_batch_free(&parsed);
-        return;
-    }
-    batch->paths = parsed.paths;
-    batch->stats = parsed.stats;
-    batch->count = parsed.count;
-    batch->results = results;
-    batch->worker_id = worker_id;
+    dispatch_track_local_claims(ctx, worker_id, batch);
 
     log_debug("[Batch] pending_batches before add: %ld", atomic_load(&ctx->pending_batches));
     atomic_fetch_add(&ctx->pending_batches, 1);
@@ -0,0 +1,87 @@
+/**
+ * @file dedup_policy.c
+ * @brief visited_set 去重策略
+ *
+ * 指纹包含完整路径，不跟随符号链接时普通文件只会在同一路径上出现一次，
+ * 为每个文件保存 16 字节指纹只是占用 Master 内存。策略决定哪些条目进入 visited_set：
+ * - DIRS：仅目录（目录去重决定是否再分发扫描，必须保留）；
+ * - LINKS：目录 + st_nlink > 1 的非目录，后者以 dev+ino 为键，同一 inode 只输出一次；
+ * - FULL：全部条目，与旧版本一致（--follow-symlinks 时的默认值）。
+ * 集合初始容量随策略缩小，--estimated-files 仍表示预估的条目总数。
+ */
+#include "dedup_policy.h"
+
+/* DIRS / LINKS 下按「平均每个目录约 10 个条目」估算集合规模 */
+#define DEDUP_DIR_RATIO   10
+/* LINKS 额外为多链接文件预留的比例（约占条目总数的 2.5%） */
+#define DEDUP_LINK_RATIO  40
+
+/**
+ * @brief  把 DEDUP_AUTO 解析为具体策略
+ * @param  policy           DedupPolicy  命令行指定的策略
+ * @param  follow_symlinks  bool         是否跟随符号链接
+ * @return DedupPolicy  DEDUP_DIRS / DEDUP_LINKS / DEDUP_FULL
+ *
+ * @note   跟随符号链接时同一文件可经不同链接路径多次到达，自动选择 FULL。
+ */
+DedupPolicy dedup_policy_resolve(DedupPolicy policy, bool follow_symlinks) {
+    if (policy != DEDUP_AUTO) return policy;
+    return follow_symlinks ? DEDUP_FULL : DEDUP_DIRS;
+}
+
+/**
+ * @brief  返回策略名
+ * @param  policy  DedupPolicy  策略
+ * @return const char*  静态字符串
+ */
+const char *dedup_policy_name(DedupPolicy policy) {
+    switch (policy) {
+        case DEDUP_DIRS:  return "dirs";
+        case DEDUP_LINKS: return "links";
+        case DEDUP_FULL:  return "full";
+        default:          return "auto";
+    }
+}
+
+/**
+ * @brief  按策略估算 visited_set 需要容纳的条目数
+ * @param  policy           DedupPolicy    已解析的策略
+ * @param  estimated_files  unsigned long  预估条目总数（--estimated-files）
+ * @return size_t  传给 fp_set_create 的 expected_count
+ *
+ * @note   估算偏小时集合会渐进扩容，不影响正确性。
+ */
+size_t dedup_policy_set_size(DedupPolicy policy, unsigned long estimated_files) {
+    switch (policy) {
+        case DEDUP_DIRS:
+            return estimated_files / DEDUP_DIR_RATIO;
+        case DEDUP_LINKS:
+            return estimated_files / DEDUP_DIR_RATIO + estimated_files / DEDUP_LINK_RATIO;
+        default:
+            return estimated_files;
+    }
+}
+
+/**
+ * @brief  计算条目在该策略下的集合键
+ * @param  policy  DedupPolicy          已解析的策略
+ * @param  st      const struct stat*   条目属性，不能为空
+ * @return DedupKey  DEDUP_KEY_NONE 表示该条目不入集合
+ */
+DedupKey dedup_policy_key(DedupPolicy policy, const struct stat *st) {
+    if (S_ISDIR(st->st_mode) || policy == DEDUP_FULL) return DEDUP_KEY_PATH;
+    if (policy == DEDUP_LINKS && st->st_nlink > 1) return DEDUP_KEY_INODE;
+    return DEDUP_KEY_NONE;
+}
+
+/**
+ * @brief  按键计算条目指纹
+ * @param  key   DedupKey            DEDUP_KEY_PATH 或 DEDUP_KEY_INODE
+ * @param  path  const char*         条目完整路径
+ * @param  st    const struct stat*  条目属性，不能为空
+ * @param  out   uint8_t[FP_SIZE]    输出指纹
+ * @return void
+ */
+void dedup_policy_fingerprint(DedupKey key, const char *path, const struct stat *st, uint8_t out[FP_SIZE]) {
+    fp_compute(key == DEDUP_KEY_INODE ? NULL : path, st->st_dev, st->st_ino, out);
+}
@@ -0,0 +1,233 @@
+/**
+ * @file dir_index.c
+ * @brief 目录清单（{base}.fpdir）：目录级 blind-trust 所需的「父目录 → 子条目」索引
+ *
+ * 写入端：-c --archive 任务中，Worker 每完整读完一个目录，就把目录自身指纹、读取前的
+ * mtime/ctime 与全部子条目 (name, d_type, ino, mtime) 编码为一条记录，以一次 write()
+ * 追加到 Master fork 前打开的 O_APPEND 文件（{base}.fpdir.tmp）。多个 Worker 进程的
+ * 追加写由内核按 inode 串行化，记录之间不会交错。任务成功结束时与指纹快照一起 rename 发布。
+ *
+ * 读取端：半增量启动时只读 mmap 上次发布的清单，顺序遍历记录头建立
+ * 目录指纹 → 记录偏移 的 ReferenceMap（堆表，随 fork COW 共享给 Worker）。
+ * 同一目录出现多条记录时（Worker 异常退出后重扫）后写的覆盖先写的。
+ * 遇到损坏或被截断的记录即停止遍历，之前的记录照常可用。
+ *
+ * 记录长度按 8 字节对齐，文件映射内的 DirListHeader 可直接按结构体访问。
+ */
+#include "dir_index.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* 子条目固定部分：name_len(2) + d_type(1) + ino(8) + mtime(8) */
+#define DIR_LIST_CHILD_FIXED 19
+
+_Static_assert(sizeof(DirListHeader) % 8 == 0, "DirListHeader must keep 8-byte alignment");
+
+/**
+ * @brief  打开并索引上次任务发布的目录清单
+ * @param  path  const char*  清单文件路径，不能为空
+ * @return DirIndex*  成功返回索引；文件不存在、为空、没有有效记录或内存不足时返回 NULL
+ *
+ * @note   只读 MAP_SHARED 映射，Worker fork 后经页缓存共享；遍历只访问记录头，
+ *         子条目区在 Worker 命中目录时按需调入。映射设置 MADV_RANDOM。
+ */
+DirIndex* dir_index_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(DirListHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    DirIndex *index = calloc(1, sizeof(DirIndex));
+    if (!index || !(index->map = ref_map_create(size / 256 + 16))) {
+        free(index);
+        munmap(base, size);
+        return NULL;
+    }
+    index->base = base;
+    index->size = size;
+
+    size_t off = 0;
+    while (off + sizeof(DirListHeader) <= size) {
+        const DirListHeader *hdr = (const DirListHeader *)(index->base + off);
+        if (hdr->magic != DIR_LIST_MAGIC || hdr->bytes % 8 != 0 ||
+            hdr->bytes > size - off - sizeof(DirListHeader)) {
+            log_warn("[DirIndex] %s 在偏移 %zu 处损坏，忽略其后的记录", path, off);
+            break;
+        }
+        /* 偏移存入 mtime 字段（ReferenceEntry 的 mtime 有 56 位，足够文件偏移） */
+        ref_map_insert(index->map, hdr->fp, (time_t)off, DT_DIR);
+        off += sizeof(DirListHeader) + hdr->bytes;
+        index->dirs++;
+    }
+    if (index->dirs == 0) {
+        dir_index_destroy(index);
+        return NULL;
+    }
+    madvise(base, size, MADV_RANDOM);
+    return index;
+}
+
+/**
+ * @brief  释放目录清单索引
+ * @param  index  DirIndex*  允许为 NULL
+ * @return void
+ */
+void dir_index_destroy(DirIndex *index) {
+    if (!index) return;
+    if (index->base) munmap((void *)index->base, index->size);
+    ref_map_destroy(index->map);
+    free(index);
+}
+
+/**
+ * @brief  按目录指纹查找清单记录
+ * @param  index  const DirIndex*         目标索引，不能为空
+ * @param  fp     const uint8_t[FP_SIZE]  目录指纹 fp_compute(path, dev, ino)
+ * @return const DirListHeader*  记录头（指向文件映射）；未找到返回 NULL
+ *
+ * @note   只读查询，不加锁。
+ */
+const DirListHeader* dir_index_lookup(const DirIndex *index, const uint8_t fp[FP_SIZE]) {
+    const ReferenceEntry *e = ref_map_lookup(index->map, fp);
+    if (!e) return NULL;
+    return (const DirListHeader *)(index->base + (size_t)ref_entry_mtime(e));
+}
+
+/**
+ * @brief  取出记录中的下一个子条目
+ * @param  hdr  const DirListHeader*  记录头，不能为空
+ * @param  pos  size_t*               子条目区内的游标，首次调用前置 0
+ * @param  out  DirListChild*         输出，不能为空
+ * @return bool  取得子条目返回 true；到达末尾或剩余字节不足（记录损坏）返回 false
+ */
+bool dir_list_next(const DirListHeader *hdr, size_t *pos, DirListChild *out) {
+    const uint8_t *p = (const uint8_t *)(hdr + 1) + *pos;
+    size_t left = hdr->bytes - *pos;
+    if (left < DIR_LIST_CHILD_FIXED) return false;
+    memcpy(&out->name_len, p, 2);
+    if (out->name_len == 0 || left < DIR_LIST_CHILD_FIXED + (size_t)out->name_len) return false;
+    out->d_type = p[2];
+    memcpy(&out->ino, p + 3, 8);
+    memcpy(&out->mtime, p + 11, 8);
+    out->name = (const char *)p + DIR_LIST_CHILD_FIXED;
+    *pos += DIR_LIST_CHILD_FIXED + out->name_len;
+    return true;
+}
+
+/**
+ * @brief  保证构建器缓冲区至少还有 need 字节
+ * @param  b     DirListBuilder*  构建器，不能为空
+ * @param  need  size_t           需要追加的字节数
+ * @return bool  成功返回 true；扩容失败时标记 failed 并返回 false
+ */
+static bool dir_list_reserve(DirListBuilder *b, size_t need) {
+    if (b->failed) return false;
+    if (b->len + need <= b->cap) return true;
+    size_t cap = b->cap ? b->cap : 65536;
+    while (cap < b->len + need) cap *= 2;
+    uint8_t *buf = realloc(b->buf, cap);
+    if (!buf) {
+        b->failed = true;
+        return false;
+    }
+    b->buf = buf;
+    b->cap = cap;
+    return true;
+}
+
+/**
+ * @brief  开始构建一个目录的清单记录
+ * @param  b      DirListBuilder*         构建器，不能为空；缓冲区跨调用复用
+ * @param  fp     const uint8_t[FP_SIZE]  目录指纹
+ * @param  mtime  int64_t                 读取目录前 lstat 得到的 mtime
+ * @param  ctime  int64_t                 同上，ctime
+ * @return void
+ */
+void dir_list_begin(DirListBuilder *b, const uint8_t fp[FP_SIZE], int64_t mtime, int64_t ctime) {
+    b->len = 0;
+    b->failed = false;
+    if (!dir_list_reserve(b, sizeof(DirListHeader))) return;
+    DirListHeader hdr = { .magic = DIR_LIST_MAGIC, .mtime = mtime, .ctime = ctime };
+    memcpy(hdr.fp, fp, FP_SIZE);
+    memcpy(b->buf, &hdr, sizeof(hdr));
+    b->len = sizeof(hdr);
+}
+
+/**
+ * @brief  追加一个子条目
+ * @param  b         DirListBuilder*  构建器，不能为空
+ * @param  name      const char*      条目名（不含目录前缀）
+ * @param  name_len  size_t           名字长度，1..65535，超出时整条记录作废
+ * @param  d_type    uint8_t          DT_*
+ * @param  ino       uint64_t         inode 号
+ * @param  mtime     int64_t          条目 mtime
+ * @return void
+ */
+void dir_list_add(DirListBuilder *b, const char *name, size_t name_len, uint8_t d_type,
+                  uint64_t ino, int64_t mtime) {
+    if (name_len == 0 || name_len > UINT16_MAX) {
+        b->failed = true;
+        return;
+    }
+    if (!dir_list_reserve(b, DIR_LIST_CHILD_FIXED + name_len)) return;
+    uint8_t *p = b->buf + b->len;
+    uint16_t len16 = (uint16_t)name_len;
+    memcpy(p, &len16, 2);
+    p[2] = d_type;
+    memcpy(p + 3, &ino, 8);
+    memcpy(p + 11, &mtime, 8);
+    memcpy(p + DIR_LIST_CHILD_FIXED, name, name_len);
+    b->len += DIR_LIST_CHILD_FIXED + name_len;
+    ((DirListHeader *)b->buf)->count++;
+}
+
+/**
+ * @brief  补齐对齐并以一次 write() 追加记录
+ * @param  b   DirListBuilder*  构建器，不能为空
+ * @param  fd  int              O_APPEND 打开的清单文件
+ * @return bool  完整写入返回 true；构建失败或写入失败 / 不完整返回 false
+ *
+ * @note   不完整写入（磁盘满等）会在文件中留下截断的记录，读取端在该处停止遍历。
+ */
+bool dir_list_write(DirListBuilder *b, int fd) {
+    if (b->failed || b->len < sizeof(DirListHeader)) return false;
+    size_t pad = (8 - b->len % 8) % 8;
+    if (!dir_list_reserve(b, pad)) return false;
+    memset(b->buf + b->len, 0, pad);
+    b->len += pad;
+    ((DirListHeader *)b->buf)->bytes = b->len - sizeof(DirListHeader);
+
+    ssize_t w;
+    do {
+        w = write(fd, b->buf, b->len);
+    } while (w < 0 && errno == EINTR);
+    if (w != (ssize_t)b->len) {
+        log_warn("[DirIndex] 清单写入失败: %s", w < 0 ? strerror(errno) : "short write");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief  释放构建器缓冲区
+ * @param  b  DirListBuilder*  构建器，不能为空
+ * @return void
+ */
+void dir_list_free(DirListBuilder *b) {
+    free(b->buf);
+    memset(b, 0, sizeof(*b));
+}
@@ -2,7 +2,9 @@
  * @file dispatch.c
  * @brief 任务调度分发、Worker 清理与 IPC send 辅助函数
  *
- * 负责将目录任务分发给空闲 Worker，处理 lost task 重发，
+ * 负责按 credit 窗口将目录任务分发给 Worker（每个 Worker 最多
+ * --worker-credits 个在途目录），处理 lost task 重发，
+ * 在有空闲 Worker 时从忙碌 Worker 窃取其本地下探队列中的子目录，
  * 以及清理死亡 Worker 的管道与状态。
  */
 #define _GNU_SOURCE
@@ -53,16 +55,19 @@ bool send_scan_to_ipc(AppContext *ctx, int wid, const char *path, uint64_t dev)
  * IPC helper: send CMD_REPLACE to IPC thread
  * ================================================================ */
 
-void send_replace_to_ipc(AppContext *ctx, int wid, int fd_cmd, int fd_data, int fd_ctrl, pid_t pid) {
+void send_replace_to_ipc(AppContext *ctx, int wid, int fd_cmd, int fd_data, int fd_ctrl, pid_t pid,
+                         ShmRing *ring) {
     CmdReplacePayload *rep = malloc(sizeof(CmdReplacePayload));
     if (!rep) {
         log_error("[Replace] malloc failed for worker %d", wid);
+        shm_ring_unref(ring);
         return;
     }
     rep->fd_cmd = fd_cmd;
     rep->fd_data = fd_data;
     rep->fd_ctrl = fd_ctrl;
     rep->pid = pid;
+    rep->ring = ring;
 
     IpcThreadMsg msg = {
         .type = CMD_REPLACE,
@@ -73,6 +78,7 @@ void send_replace_to_ipc(AppContext *ctx, int wid, int fd_cmd, int fd_data, int
 
     if (!msg_queue_send(ctx->ipc_cmd_queues[wid], &msg)) {
         log_error("[Replace] cmd_queue[%d] full, REPLACE dropped", wid);
+        shm_ring_unref(ring);
         free(rep);
     }
 }
@@ -92,21 +98,401 @@ void send_stop_to_ipc(AppContext *ctx, int wid) {
 }
 
 /* ================================================================
- * Worker dispatch helper: find next available IDLE worker
+ * IPC helper: send CMD_STEAL to IPC thread
  * ================================================================ */
 
-int dispatch_find_idle_worker(AppContext *ctx) {
+bool send_steal_to_ipc(AppContext *ctx, int wid, uint32_t max_count) {
+    CmdStealPayload *steal = malloc(sizeof(CmdStealPayload));
+    if (!steal) return false;
+    steal->max_count = max_count;
+
+    IpcThreadMsg msg = {
+        .type = CMD_STEAL,
+        .slot_id = wid,
+        .data = steal,
+        .data_len = sizeof(*steal)
+    };
+    if (!msg_queue_send(ctx->ipc_cmd_queues[wid], &msg)) {
+        free(steal);
+        return false;
+    }
+    return true;
+}
+
+/* ================================================================
+ * IPC helper: send CMD_PRUNE to IPC thread
+ * ================================================================ */
+
+bool send_prune_to_ipc(AppContext *ctx, int wid, const char *path) {
+    char *dup = strdup(path);
+    if (!dup) return false;
+
+    IpcThreadMsg msg = {
+        .type = CMD_PRUNE,
+        .slot_id = wid,
+        .data = dup,
+        .data_len = strlen(dup)
+    };
+    if (!msg_queue_send(ctx->ipc_cmd_queues[wid], &msg)) {
+        free(dup);
+        return false;
+    }
+    return true;
+}
+
+/* ================================================================
+ * Credit window: per-worker in-flight task tracking
+ * ================================================================ */
+
+/**
+ * @brief  按在途任务数刷新 Worker 状态（IDLE / BUSY）
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @return void
+ *
+ * @note   DEAD / INITIALIZING 由生命周期事件驱动，此处不覆盖。
+ */
+void worker_slot_refresh_state(WorkerSlot *slot) {
+    int state = atomic_load(&slot->state);
+    if (state == WORKER_STATE_DEAD || state == WORKER_STATE_INITIALIZING) return;
+    atomic_store(&slot->state, atomic_load(&slot->inflight_count) > 0
+                               ? WORKER_STATE_BUSY : WORKER_STATE_IDLE);
+}
+
+/**
+ * @brief  记录一个已下发到 Worker 的在途目录
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @param  path  const char*  目录路径，内部复制
+ * @return bool  返回 true 表示记录成功；false 表示内存不足
+ */
+static bool slot_inflight_add(WorkerSlot *slot, const char *path) {
+    int n = atomic_load(&slot->inflight_count);
+    if (n == slot->inflight_capacity) {
+        int new_cap = slot->inflight_capacity ? slot->inflight_capacity * 2 : 8;
+        char **arr = realloc(slot->inflight_paths, (size_t)new_cap * sizeof(char *));
+        if (!arr) return false;
+        slot->inflight_paths = arr;
+        slot->inflight_capacity = new_cap;
+    }
+    char *dup = strdup(path);
+    if (!dup) return false;
+    slot->inflight_paths[n] = dup;
+    atomic_store(&slot->inflight_count, n + 1);
+    return true;
+}
+
+/**
+ * @brief  从在途记录中取出与 path 匹配的目录
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @param  path  const char*  FINISH / DROP 携带的目录路径
+ * @return char*  匹配的路径（所有权转移给调用方）；未找到返回 NULL
+ *
+ * @note   Worker 按 FIFO 执行，匹配项通常位于数组头部；删除时保持剩余顺序，
+ *         使 current_path 始终指向最早下发、最可能正在扫描的目录。
+ */
+static char *slot_inflight_take(WorkerSlot *slot, const char *path) {
+    int n = atomic_load(&slot->inflight_count);
+    for (int i = 0; i < n; i++) {
+        if (strcmp(slot->inflight_paths[i], path) != 0) continue;
+        char *found = slot->inflight_paths[i];
+        memmove(&slot->inflight_paths[i], &slot->inflight_paths[i + 1],
+                (size_t)(n - i - 1) * sizeof(char *));
+        atomic_store(&slot->inflight_count, n - 1);
+        if (n - 1 > 0) {
+            safe_strcpy(slot->current_path, slot->inflight_paths[0], sizeof(slot->current_path));
+        } else {
+            slot->current_path[0] = '\0';
+        }
+        return found;
+    }
+    return NULL;
+}
+
+/**
+ * @brief  查找 path 所属的在途根任务
+ * @param  slot  const WorkerSlot*  Worker 槽位，不能为空
+ * @param  path  const char*        Worker 本地下探认领的子目录
+ * @return const char*  最长的、以路径分量为边界的在途前缀（可与 path 相同）；不属于任何在途任务时返回 NULL
+ *
+ * @note   同一 Worker 可能同时持有某根任务与其被窃取后又分回来的子目录，
+ *         取最长前缀使认领记录随真正负责下探的任务 FINISH 释放。
+ */
+static const char *slot_claim_owner(const WorkerSlot *slot, const char *path) {
+    const char *owner = NULL;
+    size_t owner_len = 0;
+    int n = atomic_load(&slot->inflight_count);
+    for (int i = 0; i < n; i++) {
+        const char *root = slot->inflight_paths[i];
+        size_t len = strlen(root);
+        if (len <= owner_len || strncmp(path, root, len) != 0) continue;
+        if (root[len - 1] != '/' && path[len] != '/' && path[len] != '\0') continue;
+        owner = root;
+        owner_len = len;
+    }
+    return owner;
+}
+
+/**
+ * @brief  记录一个 Worker 本地下探认领的子目录
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @param  path  const char*  子目录路径，内部复制
+ * @param  root  const char*  所属在途根任务（slot_claim_owner 的返回值）
+ * @return bool  返回 true 表示记录成功；false 表示内存不足
+ */
+static bool slot_claim_add(WorkerSlot *slot, const char *path, const char *root) {
+    if (slot->claim_count == slot->claim_capacity) {
+        int new_cap = slot->claim_capacity ? slot->claim_capacity * 2 : 16;
+        WorkerLocalClaim *arr = realloc(slot->claims, (size_t)new_cap * sizeof(*arr));
+        if (!arr) return false;
+        slot->claims = arr;
+        slot->claim_capacity = new_cap;
+    }
+    char *dup = strdup(path);
+    if (!dup) return false;
+    slot->claims[slot->claim_count].path = dup;
+    slot->claims[slot->claim_count].root = root;
+    slot->claim_count++;
+    return true;
+}
+
+/**
+ * @brief  根任务 FINISH / 退回时释放其下全部认领记录
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @param  root  const char*  刚从在途记录取出的根任务（按地址比较，调用方随后释放）
+ * @return void
+ */
+static void slot_claims_release_root(WorkerSlot *slot, const char *root) {
+    int j = 0;
+    for (int i = 0; i < slot->claim_count; i++) {
+        if (slot->claims[i].root == root) {
+            free(slot->claims[i].path);
+            continue;
+        }
+        slot->claims[j++] = slot->claims[i];
+    }
+    slot->claim_count = j;
+}
+
+/**
+ * @brief  被 STEAL 取回的子目录改由 Master 重新分发，撤销其认领记录
+ * @param  slot  WorkerSlot*  Worker 槽位，不能为空
+ * @param  path  const char*  STOLEN 携带的目录路径
+ * @return void
+ */
+static void slot_claim_release_path(WorkerSlot *slot, const char *path) {
+    for (int i = slot->claim_count - 1; i >= 0; i--) {
+        if (strcmp(slot->claims[i].path, path) != 0) continue;
+        free(slot->claims[i].path);
+        slot->claims[i] = slot->claims[--slot->claim_count];
+        return;
+    }
+}
+
+/**
+ * @brief  选择一个仍有空闲 credit 的 Worker
+ * @param  ctx  AppContext*  应用上下文指针，不能为空
+ * @return int  Worker 编号；所有存活 Worker 的窗口均已占满时返回 -1
+ *
+ * @note   优先选择在途任务最少的 Worker，数量相同时从 next_dispatch_worker 起轮询，
+ *         避免总是压给编号靠前的 Worker。INITIALIZING / DEAD 状态不参与分发。
+ */
+int dispatch_find_worker(AppContext *ctx) {
     int num_workers = ctx->worker_pool->num_workers;
-    int attempts = 0;
-    while (attempts < num_workers) {
-        int candidate = ctx->next_dispatch_worker % num_workers;
-        ctx->next_dispatch_worker++;
+    int credits = ctx->cfg.worker_credits > 0 ? ctx->cfg.worker_credits : 1;
+    int best = -1;
+    int best_load = credits;
+    for (int k = 0; k < num_workers; k++) {
+        int candidate = (ctx->next_dispatch_worker + k) % num_workers;
         WorkerSlot *cand_slot = &ctx->worker_pool->slots[candidate];
-        if (!atomic_load(&cand_slot->is_alive)) { attempts++; continue; }
-        if (atomic_load(&cand_slot->state) != WORKER_STATE_IDLE) { attempts++; continue; }
-        return candidate;
+        if (!atomic_load(&cand_slot->is_alive)) continue;
+        int state = atomic_load(&cand_slot->state);
+        if (state == WORKER_STATE_DEAD || state == WORKER_STATE_INITIALIZING) continue;
+        int load = atomic_load(&cand_slot->inflight_count);
+        if (load < best_load) {
+            best = candidate;
+            best_load = load;
+            if (load == 0) break;
+        }
     }
-    return -1;
+    if (best >= 0) ctx->next_dispatch_worker = best + 1;
+    return best;
+}
+
+/**
+ * @brief  向指定 Worker 下发一个目录并占用一个 credit
+ * @param  ctx   AppContext*  应用上下文指针，不能为空
+ * @param  wid   int          Worker 编号
+ * @param  path  const char*  目录路径
+ * @param  dev   uint64_t     目录所在设备号（未知时为 0）
+ * @return bool  返回 true 表示已记录在途并投递 CMD_SCAN；false 表示失败，未占用 credit
+ *
+ * @note   不修改 pending_tasks，由调用方负责计数。
+ */
+bool dispatch_to_worker(AppContext *ctx, int wid, const char *path, uint64_t dev) {
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    if (!slot_inflight_add(slot, path)) return false;
+    if (!send_scan_to_ipc(ctx, wid, path, dev)) {
+        free(slot_inflight_take(slot, path));
+        worker_slot_refresh_state(slot);
+        return false;
+    }
+    if (atomic_load(&slot->inflight_count) == 1) {
+        slot->current_dev = dev;
+        safe_strcpy(slot->current_path, path, sizeof(slot->current_path));
+    }
+    worker_slot_refresh_state(slot);
+    return true;
+}
+
+/**
+ * @brief  分发一个新发现的目录任务
+ * @param  ctx   AppContext*  应用上下文指针，不能为空
+ * @param  path  const char*  目录路径
+ * @param  dev   uint64_t     目录所在设备号（未知时为 0）
+ * @return void
+ *
+ * @note   pending_tasks 统计「在途 + lost_tasks 排队」的目录总数：
+ *         此处先 +1，有空闲 credit 时直接下发，否则进入 lost_tasks 等待
+ *         FINISH 归还 credit 后由 dispatch_lost_tasks 补发（计数不变）。
+ */
+void dispatch_task(AppContext *ctx, const char *path, uint64_t dev) {
+    atomic_fetch_add(&ctx->pending_tasks, 1);
+    int wid = dispatch_find_worker(ctx);
+    if (wid >= 0 && dispatch_to_worker(ctx, wid, path, dev)) return;
+
+    if (!lost_tasks_push(&ctx->lost_tasks, strdup(path))) {
+        log_warn("[Dispatch] lost_tasks push failed, dropping %s", path_log_mask(path));
+        atomic_fetch_sub(&ctx->pending_tasks, 1);
+    }
+}
+
+/**
+ * @brief  处理 Worker 的 FINISH：归还 credit 并递减 pending_tasks
+ * @param  ctx   AppContext*  应用上下文指针，不能为空
+ * @param  wid   int          Worker 编号
+ * @param  path  const char*  已完成的目录路径
+ * @return void
+ *
+ * @note   未在在途记录中的 FINISH（如 Worker 被替换前的残留消息）直接忽略，
+ *         对应任务已在 cleanup_dead_worker_slot 中重新入队或扣减。
+ */
+void dispatch_task_finished(AppContext *ctx, int wid, const char *path) {
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    char *done = slot_inflight_take(slot, path);
+    if (!done) {
+        log_debug("[Dispatch] stale FINISH from worker %d: %s", wid, path_log_mask(path));
+        return;
+    }
+    slot_claims_release_root(slot, done);
+    free(done);
+    atomic_fetch_sub(&ctx->pending_tasks, 1);
+    worker_slot_refresh_state(slot);
+}
+
+/**
+ * @brief  处理 IPC 线程退回的 SCAN（MSG_DROP）：释放 credit 并转入 lost_tasks
+ * @param  ctx   AppContext*  应用上下文指针，不能为空
+ * @param  wid   int          Worker 编号
+ * @param  path  const char*  被退回的目录路径
+ * @return void
+ */
+void dispatch_task_dropped(AppContext *ctx, int wid, const char *path) {
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    char *dropped = slot_inflight_take(slot, path);
+    if (!dropped) return;   /* 已由 cleanup_dead_worker_slot 重新入队 */
+    slot_claims_release_root(slot, dropped);
+    worker_slot_refresh_state(slot);
+    if (!lost_tasks_push(&ctx->lost_tasks, dropped)) {
+        log_warn("[Bus] MSG_DROP requeue failed: %s", path_log_mask(path));
+        free(dropped);
+        atomic_fetch_sub(&ctx->pending_tasks, 1);
+    }
+}
+
+/**
+ * @brief  记录 batch 中 Worker 已认领本地下探的子目录（LOCAL 条目）
+ * @param  ctx    AppContext*     应用上下文指针，不能为空
+ * @param  wid    int             Worker 编号
+ * @param  batch  const TPBatch*  刚解析的 batch，results 中 bit2 标记 LOCAL
+ * @return void
+ *
+ * @note   须在主线程解析 batch 时立即调用：BATCH、STOLEN 与 FINISH 在同一通道上
+ *         按序到达，此时所属根任务一定仍在在途记录中。认领的子目录随后会写入
+ *         visited_set，Worker 死亡后重扫根任务不会再报告它们，因此由
+ *         cleanup_dead_worker_slot 把未完成的认领记录作为独立任务重新入队。
+ */
+void dispatch_track_local_claims(AppContext *ctx, int wid, const TPBatch *batch) {
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    for (int i = 0; i < batch->count; i++) {
+        if (!(batch->results[i] & 4)) continue;
+        const char *root = slot_claim_owner(slot, batch->paths[i]);
+        if (!root) continue;
+        if (!slot_claim_add(slot, batch->paths[i], root)) {
+            log_warn("[Dispatch] failed to track local claim of worker %d: %s",
+                     wid, path_log_mask(batch->paths[i]));
+        }
+    }
+}
+
+/**
+ * @brief  拒绝已访问过的本地下探目录，并丢弃已裁剪子树下的整批条目
+ * @param  ctx    AppContext*  应用上下文指针，不能为空
+ * @param  wid    int          Worker 编号
+ * @param  batch  TPBatch*     刚解析的 batch；被拒绝的 LOCAL 条目改标为重复（results = 1）
+ * @return bool  返回 true 表示整批位于已裁剪子树之内，调用方应直接丢弃
+ *
+ * @note   Worker 认领子目录后立即开始下探，早于 Master 去重。目录已在 visited_set 中
+ *         （如 Worker 死亡后重新入队的认领目录已由其他任务扫描）时，只丢弃目录记录不够：
+ *         --dedup=dirs 下文件不入集合，子树内的文件会被重新扫描并输出。
+ *         这里在主线程按到达顺序处理：BATCH 与同一 Worker 的后续批次同走数据通道，
+ *         子目录自身的批次一定晚于其父目录批次解析，因此记录子树根后即可整批丢弃其下条目；
+ *         同时向 Worker 发送 PRUNE，停止认领与执行该子树下尚未开始的目录。
+ *         只裁剪来自更上层任务的本地下探：子树根本身（或其下的目录）作为任务下发时
+ *         （如 Worker 死亡后重新入队的认领目录），以该任务根为下限，其批次照常处理。
+ *         visited_set 载入了续传历史时不裁剪：pbin 在目录被发现时即记录，历史中的目录未必扫描完成，
+ *         无索引恢复时也没有泵送重新分发，本地下探是重扫这些目录的唯一途径；
+ *         子树内已输出过的文件由 visited_history 查询历史指纹去重。
+ */
+bool dispatch_prune_local(AppContext *ctx, int wid, TPBatch *batch) {
+    if (batch->count == 0 || ctx->visited_history) return false;
+
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    if (ctx->pruned_dirs) {
+        char dir[4096];
+        const char *first = batch->paths[0];
+        const char *slash = strrchr(first, '/');
+        size_t dir_len = slash ? (size_t)(slash - first) : 0;
+        if (dir_len > 0 && dir_len < sizeof(dir)) {
+            memcpy(dir, first, dir_len);
+            dir[dir_len] = '\0';
+            const char *owner = slot_claim_owner(slot, dir);
+            if (fp_set_contains_path_prefix(ctx->pruned_dirs, dir, dir_len, owner ? strlen(owner) : 0)) {
+                return true;
+            }
+        }
+    }
+
+    for (int i = 0; i < batch->count; i++) {
+        if (!(batch->results[i] & 4)) continue;
+        const char *path = batch->paths[i];
+        uint8_t fp[FP_SIZE];
+        fp_compute(path, batch->stats[i].st_dev, batch->stats[i].st_ino, fp);
+        if (!fp_store_contains(ctx->visited_set, fp)) continue;
+
+        batch->results[i] = 1; /* duplicate，不再视为本地下探 */
+        if (!ctx->pruned_dirs) {
+            ctx->pruned_dirs = fp_set_create(1024, FP_SET_MUTEX);
+            if (!ctx->pruned_dirs) {
+                log_warn("[Dispatch] pruned_dirs alloc failed, %s subtree will be rescanned", path_log_mask(path));
+                continue;
+            }
+        }
+        fp_set_insert_path(ctx->pruned_dirs, path);
+        if (!send_prune_to_ipc(ctx, wid, path)) {
+            log_debug("[Dispatch] PRUNE to worker %d not queued: %s", wid, path_log_mask(path));
+        }
+        log_debug("[Dispatch] pruned visited local dir from worker %d: %s", wid, path_log_mask(path));
+    }
+    return false;
 }
 
 /* ================================================================
@@ -114,44 +500,126 @@ int dispatch_find_idle_worker(AppContext *ctx) {
  * ================================================================ */
 
 void dispatch_lost_tasks(AppContext *ctx) {
-    /* 短路：如果所有 Worker 都死了，直接返回 */
-    bool any_alive = false;
-    for (int i = 0; i < ctx->worker_pool->num_workers; i++) {
-        if (atomic_load(&ctx->worker_pool->slots[i].is_alive)) {
-            any_alive = true;
-            break;
-        }
-    }
-    if (!any_alive) return;
-
     char *path;
     while (lost_tasks_pop(&ctx->lost_tasks, &path)) {
         if (!path) continue;
 
-        int wid = dispatch_find_idle_worker(ctx);
-        if (wid < 0) {
-            log_warn("[LostTasks] no IDLE worker available, requeue %s", path_log_mask(path));
+        /* 窗口全部占满（或无存活 Worker）：放回队列，等 FINISH 归还 credit */
+        int wid = dispatch_find_worker(ctx);
+        if (wid < 0 || !dispatch_to_worker(ctx, wid, path, 0)) {
             lost_tasks_push(&ctx->lost_tasks, path);
-            break; /* 停止继续尝试，等下一轮 */
-        }
-        WorkerSlot *slot = &ctx->worker_pool->slots[wid];
-        atomic_store(&slot->state, WORKER_STATE_BUSY);
-
-        if (!send_scan_to_ipc(ctx, wid, path, 0)) {
-            atomic_store(&slot->state, WORKER_STATE_IDLE);
-            lost_tasks_push(&ctx->lost_tasks, path);
-            continue;
+            break;
         }
-        atomic_fetch_add(&ctx->pending_tasks, 1);
         log_debug("[LostTasks] dispatched %s to worker %d, pending_tasks=%ld", path_log_mask(path), wid, atomic_load(&ctx->pending_tasks));
-
-        slot->current_dev = 0;
-        safe_strcpy(slot->current_path, path, sizeof(slot->current_path));
         free(path);
     }
     lost_tasks_compact(&ctx->lost_tasks);
 }
 
+/* ================================================================
+ * Work stealing: pull worker-local subdirectories back for idle workers
+ * ================================================================ */
+
+/* STOLEN 为空后对同一 Worker 的窃取退避时间 */
+#define STEAL_BACKOFF_MS 50
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief  有空闲 Worker 且 lost_tasks 为空时，向一个忙碌 Worker 发送 STEAL
+ * @param  ctx  AppContext*  应用上下文指针，不能为空
+ * @return void
+ *
+ * @note   每个 Worker 同时最多一个未完成的 STEAL；回复为空时退避 STEAL_BACKOFF_MS，
+ *         避免子树已扫完的 Worker 与 Master 之间空转。请求数量按空闲 Worker 的
+ *         credit 总量计算，取回的目录经 dispatch_task 均衡分发。
+ */
+void dispatch_steal_for_idle(AppContext *ctx) {
+    if (ctx->cfg.local_depth <= 0) return;
+    if (ctx->lost_tasks.count > 0) return;
+
+    int num_workers = ctx->worker_pool->num_workers;
+    int idle = 0;
+    for (int i = 0; i < num_workers; i++) {
+        WorkerSlot *slot = &ctx->worker_pool->slots[i];
+        if (atomic_load(&slot->is_alive) && atomic_load(&slot->state) == WORKER_STATE_IDLE) idle++;
+    }
+    if (idle == 0) return;
+
+    uint64_t now = monotonic_ms();
+    for (int k = 0; k < num_workers; k++) {
+        int victim = (ctx->next_steal_worker + k) % num_workers;
+        WorkerSlot *slot = &ctx->worker_pool->slots[victim];
+        if (!atomic_load(&slot->is_alive)) continue;
+        if (atomic_load(&slot->state) != WORKER_STATE_BUSY) continue;
+        if (slot->steal_pending || now < slot->steal_retry_ms) continue;
+
+        uint32_t want = (uint32_t)(idle * (ctx->cfg.worker_credits > 0 ? ctx->cfg.worker_credits : 1));
+        if (send_steal_to_ipc(ctx, victim, want)) {
+            slot->steal_pending = true;
+            log_debug("[Steal] asked worker %d for %u dirs (%d idle)", victim, want, idle);
+        }
+        ctx->next_steal_worker = victim + 1;
+        return;
+    }
+}
+
+/**
+ * @brief  处理 RET_STOLEN：把 Worker 交回的子目录作为新任务分发
+ * @param  ctx      AppContext*  应用上下文指针，不能为空
+ * @param  wid      int          回复的 Worker 编号
+ * @param  payload  const void*  IpcStolenHeader + 记录，允许为 NULL（STEAL 未送达）
+ * @param  len      size_t       payload 长度
+ * @return void
+ *
+ * @note   STOLEN 与根任务 FINISH 同走数据通道（fd_data 或共享内存环），Worker 在 send_mutex
+ *         下先发 STOLEN 再发 FINISH，这里 pending_tasks 先增后减，不会出现提前结束。
+ *         记录携带目录所在设备号，按设备的超时/黑名单管理不受影响；位于已裁剪子树内的
+ *         目录直接丢弃。
+ */
+void dispatch_stolen_tasks(AppContext *ctx, int wid, const void *payload, size_t len) {
+    WorkerSlot *slot = &ctx->worker_pool->slots[wid];
+    slot->steal_pending = false;
+
+    uint32_t count = 0;
+    if (payload && len >= sizeof(IpcStolenHeader)) {
+        IpcStolenHeader sh;
+        memcpy(&sh, payload, sizeof(sh));
+        const uint8_t *p = (const uint8_t *)payload + sizeof(sh);
+        const uint8_t *end = (const uint8_t *)payload + len;
+        char path[4096];
+        for (uint32_t i = 0; i < sh.count; i++) {
+            uint32_t plen;
+            uint64_t dev;
+            if ((size_t)(end - p) < sizeof(plen) + sizeof(dev)) break;
+            memcpy(&plen, p, sizeof(plen));
+            p += sizeof(plen);
+            memcpy(&dev, p, sizeof(dev));
+            p += sizeof(dev);
+            if ((size_t)(end - p) < plen || plen >= sizeof(path)) break;
+            memcpy(path, p, plen);
+            path[plen] = '\0';
+            p += plen;
+            count++;
+            const char *owner = slot_claim_owner(slot, path);
+            bool pruned = ctx->pruned_dirs &&
+                          fp_set_contains_path_prefix(ctx->pruned_dirs, path, plen, owner ? strlen(owner) : 0);
+            slot_claim_release_path(slot, path);
+            if (pruned) continue;
+            dispatch_task(ctx, path, dev);
+        }
+    }
+    if (count == 0) {
+        slot->steal_retry_ms = monotonic_ms() + STEAL_BACKOFF_MS;
+    } else {
+        log_debug("[Steal] worker %d handed back %u dirs", wid, count);
+    }
+}
+
 /* ================================================================
  * Cleanup dead worker slot (v13.0.0: no epoll DEL, IPC thread handles fd)
  * ================================================================ */
@@ -163,10 +631,9 @@ void cleanup_dead_worker_slot(AppContext *ctx, int worker_id, bool redispatch_cu
     if (!atomic_load(&slot->is_alive) && slot->pid == -1) return;
     if (atomic_flag_test_and_set(&slot->cleanup_done)) return;
 
-    /* Drain fd_cmd_rd to count orphaned SCAN tasks */
-    int orphaned = 0;
+    /* Drain fd_cmd_rd: 未读取的 SCAN 均已记录在 inflight_paths 中，这里只清空管道 */
     if (slot->fd_cmd_rd >= 0) {
-        orphaned = ipc_drain_and_count_tasks(slot->fd_cmd_rd);
+        int orphaned = ipc_drain_and_count_tasks(slot->fd_cmd_rd);
         if (orphaned > 0) {
             log_debug("[Cleanup] Worker %d drained %d orphaned tasks from fd_cmd_rd", worker_id, orphaned);
         }
@@ -194,13 +661,30 @@ void cleanup_dead_worker_slot(AppContext *ctx, int worker_id, bool redispatch_cu
         slot->fd_ctrl = -1;
     }
 
-    atomic_fetch_sub(&ctx->pending_tasks, 1 + orphaned);
-
-    if (redispatch_current && slot->current_path[0] != '\0') {
-        if (lost_tasks_push(&ctx->lost_tasks, strdup(slot->current_path))) {
+    /* 本地下探认领的子目录已写入 visited_set，重扫根任务不会再报告：需要重发时作为新任务入队 */
+    for (int i = 0; i < slot->claim_count; i++) {
+        char *path = slot->claims[i].path;
+        slot->claims[i].path = NULL;
+        if (redispatch_current && lost_tasks_push(&ctx->lost_tasks, path)) {
             atomic_fetch_add(&ctx->pending_tasks, 1);
+            continue;
         }
+        free(path);
+    }
+    slot->claim_count = 0;
+
+    /* 在途任务：需要重发时整体转入 lost_tasks（pending_tasks 不变），否则直接扣减 */
+    int inflight = atomic_load(&slot->inflight_count);
+    for (int i = 0; i < inflight; i++) {
+        char *path = slot->inflight_paths[i];
+        slot->inflight_paths[i] = NULL;
+        if (redispatch_current && lost_tasks_push(&ctx->lost_tasks, path)) continue;
+        free(path);
+        atomic_fetch_sub(&ctx->pending_tasks, 1);
     }
+    atomic_store(&slot->inflight_count, 0);
+    slot->current_path[0] = '\0';
+    slot->steal_pending = false;
 
     if (atomic_load(&slot->is_alive)) {
         atomic_store(&slot->is_alive, false);
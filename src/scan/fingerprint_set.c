@@ -2,9 +2,14 @@
  * @file fingerprint_set.c
  * @brief xxHash3 128-bit 分片开放寻址哈希集合实现
  *
- * 采用 64 分片（shard）+ 每分片独立开放寻址（线性探测）的结构，
- * 每个分片拥有独立的 pthread_mutex_t，将全局锁竞争分散到 64 把细粒度锁上，
- * 支持高并发场景下去重与存在性判断（visited_set / reference_set）。
+ * 采用 64 分片（shard）+ 每分片独立开放寻址的结构，支持高并发场景下
+ * 去重与存在性判断（visited_set）。两种实现运行时选择（--fp-set）：
+ * - FP_SET_MUTEX：每个分片拥有独立的 pthread_mutex_t，将全局锁竞争分散到 64 把细粒度锁上；
+ *   分片内为 Swiss table 布局，按 16 槽位一组用 SSE2 比较 7-bit 控制字节标签；
+ *   扩容为渐进式：新表分配后旧表由后续插入每次迁移有限个槽位，不再持锁重哈希整张表；
+ * - FP_SET_LOCKFREE：槽位以两步 CAS 认领（先 k0 后 k1），查询无等待，
+ *   扩容时每次插入至多领取一块迁移，迁移完成前插入与查询依次检查两代表，
+ *   --master-threads 增大时没有 futex 争用，也没有等待整张表迁完的停顿。
  *
  * 指纹计算基于 xxHash3 128-bit，输入为 path + dev + ino 的拼接数据。
  */
@@ -12,9 +17,12 @@
 #define XXH_STATIC_LINKING_ONLY
 #include "xxhash.h"
 #include "log.h"
+#include "swiss_group.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sched.h>
+#include <time.h>
 
 /* ================================================================
  * xxHash3 指纹计算
@@ -30,6 +38,9 @@
  *
  * @note   使用 xxHash3 128-bit 算法，依次 update path、dev、ino，
  *         最终输出规范化的 16 字节摘要。该指纹用于全局去重和半增量索引。
+ *         无锁集合的保留值在这里就避开（前 8 字节不取 0 / UINT64_MAX，后 8 字节不取 0，
+ *         按本机字节序解释，映射到相邻值），fp_lf_split 对本函数的输出是恒等拆分，
+ *         集合导出的指纹（快照、fp_store 运行段）与调用方计算、比较的指纹逐字节一致。
  */
 void fp_compute(const char *path, uint64_t dev, uint64_t ino, uint8_t out[FP_SIZE]) {
     XXH3_state_t state;
@@ -39,11 +50,18 @@ void fp_compute(const char *path, uint64_t dev, uint64_t ino, uint8_t out[FP_SIZ
     XXH3_128bits_update(&state, &dev, sizeof(dev));
     XXH3_128bits_update(&state, &ino, sizeof(ino));
     XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(&state));
-    memcpy(out, canonical.digest, FP_SIZE);
+    uint64_t w0, w1;
+    memcpy(&w0, canonical.digest, sizeof(w0));
+    memcpy(&w1, canonical.digest + sizeof(w0), sizeof(w1));
+    if (w0 == 0) w0 = 1;
+    else if (w0 == UINT64_MAX) w0 = UINT64_MAX - 1;
+    if (w1 == 0) w1 = 1;
+    memcpy(out, &w0, sizeof(w0));
+    memcpy(out + sizeof(w0), &w1, sizeof(w1));
 }
 
 /* ================================================================
- * FingerprintSet 实现 — 分片开放寻址法 + 线性探测
+ * FingerprintSet 实现 — 分片开放寻址法 + 控制字节分组探测
  * ================================================================ */
 
 /**
@@ -59,15 +77,14 @@ static inline uint64_t splitmix64(uint64_t x) {
 }
 
 /**
- * @brief  计算指纹在单个分片内的哈希桶索引
- * @param  md5       const uint8_t[FP_SIZE]  16 字节指纹数据
- * @param  capacity  size_t                   分片当前容量，必须为 2 的幂次
- * @return size_t  映射到 [0, capacity-1] 范围内的桶索引
+ * @brief  计算指纹在分片内使用的 64-bit 探测哈希
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹数据
+ * @return uint64_t  高位（swiss_h1）选择起始分组，低 7 位（swiss_h2）作为控制字节标签
  */
-static inline size_t fp_hash(const uint8_t md5[FP_SIZE], size_t capacity) {
+static inline uint64_t fp_hash(const uint8_t md5[FP_SIZE]) {
     uint64_t x;
     memcpy(&x, md5, sizeof(x));
-    return (size_t)(splitmix64(x) & (capacity - 1));
+    return splitmix64(x);
 }
 
 /**
@@ -95,19 +112,229 @@ static size_t next_pow2(size_t n) {
     return p;
 }
 
+/* 每次插入最多迁移的旧槽位数，限制单次持锁时间 */
+#define FP_MIGRATE_STEP 256
+
+/* 批量插入时提前预取的条目数：足以覆盖一次 DRAM 访问延迟，又不至于把预取的行挤出 L1 */
+#define FP_PREFETCH_DIST 8
+
+static inline uint64_t fp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief  记录一次插入的扩容停顿
+ * @param  set      FingerprintSet*  目标集合，不能为空
+ * @param  ns       uint64_t         本次插入花在扩容（分配 / 迁移）上的时间
+ * @param  started  bool             本次是否发起了新的扩容
+ * @return void
+ */
+static void fp_resize_record(FingerprintSet *set, uint64_t ns, bool started) {
+    if (started) atomic_fetch_add_explicit(&set->resizes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&set->pause_total_ns, ns, memory_order_relaxed);
+    uint64_t cur = atomic_load_explicit(&set->pause_max_ns, memory_order_relaxed);
+    while (ns > cur &&
+           !atomic_compare_exchange_weak_explicit(&set->pause_max_ns, &cur, ns,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
 /**
- * @brief  向指定分片内部插入指纹（无锁，调用方必须已持有该分片的 mutex）
+ * @brief  在一代控制字节表中查找指纹所在槽位
+ * @param  ctrl      const int8_t*       控制字节数组，不能为空
+ * @param  table     const Fingerprint*  槽位数组，不能为空
+ * @param  capacity  size_t              槽位数（2 的幂，>= SWISS_GROUP_WIDTH）
+ * @param  md5       const uint8_t[FP_SIZE]  要查找的 16 字节指纹
+ * @param  h         uint64_t            fp_hash(md5)
+ * @param  free_pos  size_t*  输出参数，允许为 NULL；未找到时返回探测链上第一个空槽/墓碑位置
+ * @return size_t  命中返回槽位下标；未命中返回 (size_t)-1
+ *
+ * @note   按组做三角探测（组步长 1, 2, 3, ...），组数为 2 的幂时可遍历全部分组。
+ *         组内先以 7-bit 标签做一次 16 路比较，仅对标签命中的槽位比较完整指纹；
+ *         某组内出现 SWISS_EMPTY 即说明指纹不在表中。
+ */
+static size_t fp_table_find(const int8_t *ctrl, const Fingerprint *table, size_t capacity,
+                            const uint8_t md5[FP_SIZE], uint64_t h, size_t *free_pos) {
+    size_t group_mask = capacity / SWISS_GROUP_WIDTH - 1;
+    size_t g = swiss_h1(h) & group_mask;
+    int8_t tag = swiss_h2(h);
+    if (free_pos) *free_pos = (size_t)-1;
+
+    for (size_t i = 0; i <= group_mask; i++) {
+        const int8_t *grp = ctrl + g * SWISS_GROUP_WIDTH;
+        uint32_t m = swiss_match(grp, tag);
+        while (m) {
+            size_t pos = g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(m);
+            if (memcmp(table[pos].md5, md5, FP_SIZE) == 0) return pos;
+            m &= m - 1;
+        }
+        if (free_pos && *free_pos == (size_t)-1) {
+            uint32_t f = swiss_match_free(grp);
+            if (f) *free_pos = g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(f);
+        }
+        if (swiss_match_empty(grp)) break;
+        g = (g + i + 1) & group_mask;
+    }
+    return (size_t)-1;
+}
+
+/**
+ * @brief  在当前表中为已确认不存在的指纹寻找第一个可写槽位
+ * @param  shard  const FingerprintShard*  目标分片，不能为空
+ * @param  h      uint64_t                 fp_hash(md5)
+ * @return size_t  槽位下标；表满返回 (size_t)-1
+ */
+static size_t fp_shard_find_free(const FingerprintShard *shard, uint64_t h) {
+    size_t group_mask = shard->capacity / SWISS_GROUP_WIDTH - 1;
+    size_t g = swiss_h1(h) & group_mask;
+    for (size_t i = 0; i <= group_mask; i++) {
+        uint32_t f = swiss_match_free(shard->ctrl + g * SWISS_GROUP_WIDTH);
+        if (f) return g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(f);
+        g = (g + i + 1) & group_mask;
+    }
+    return (size_t)-1;
+}
+
+/**
+ * @brief  把指纹写入当前表的指定槽位
+ * @param  shard  FingerprintShard*       目标分片，不能为空
+ * @param  pos    size_t                  fp_table_find / fp_shard_find_free 返回的空槽或墓碑
+ * @param  md5    const uint8_t[FP_SIZE]  16 字节指纹
+ * @param  h      uint64_t                fp_hash(md5)
+ * @return void
+ */
+static void fp_shard_put(FingerprintShard *shard, size_t pos, const uint8_t md5[FP_SIZE], uint64_t h) {
+    if (shard->ctrl[pos] == SWISS_DELETED) shard->tombstones--;
+    memcpy(shard->table[pos].md5, md5, FP_SIZE);
+    shard->ctrl[pos] = swiss_h2(h);
+    shard->count++;
+}
+
+/**
+ * @brief  把上一代表中最多 max_slots 个槽位迁入当前表（调用方必须已持有分片 mutex）
+ * @param  shard      FingerprintShard*  目标分片，不能为空
+ * @param  max_slots  size_t             本次最多扫描的旧槽位数；SIZE_MAX 表示迁移到底
+ * @return void
+ *
+ * @note   插入前已在两代表中确认不存在，旧表中的指纹在当前表中必然缺失，直接写入空槽即可。
+ *         旧表槽位不做清除：迁移完成前查询仍可在旧表命中，结果一致。全部迁完后释放旧表。
+ */
+static void fp_shard_migrate(FingerprintShard *shard, size_t max_slots) {
+    if (!shard->old_ctrl) return;
+    size_t end = shard->old_capacity;
+    if (max_slots < end - shard->migrate_pos) end = shard->migrate_pos + max_slots;
+
+    for (size_t i = shard->migrate_pos; i < end; i++) {
+        if (shard->old_ctrl[i] < 0) continue;
+        const uint8_t *md5 = shard->old_table[i].md5;
+        uint64_t h = fp_hash(md5);
+        size_t pos = fp_shard_find_free(shard, h);
+        if (pos == (size_t)-1) {
+            log_fatal("[FPSet] shard full during migration: capacity=%zu", shard->capacity);
+            return;
+        }
+        fp_shard_put(shard, pos, md5, h);
+    }
+    shard->migrate_pos = end;
+    if (end == shard->old_capacity) {
+        free(shard->old_ctrl);
+        free(shard->old_table);
+        shard->old_ctrl = NULL;
+        shard->old_table = NULL;
+        shard->old_capacity = 0;
+        shard->migrate_pos = 0;
+    }
+}
+
+/**
+ * @brief  分配 2 倍容量的新表并把当前表降为待迁移的上一代（调用方必须已持有分片 mutex）
+ * @param  shard  FingerprintShard*  目标分片，不能为空，且没有进行中的迁移
+ * @return bool  返回 true 表示已切换到新表；false 表示容量溢出或内存不足（继续使用原表）
+ */
+static bool fp_shard_start_resize(FingerprintShard *shard) {
+    size_t new_cap = shard->capacity << 1;
+    if (new_cap > (1ULL << 30)) {
+        log_fatal("[FPSet] shard capacity overflow during resize: %zu -> %zu", shard->capacity, new_cap);
+        return false;
+    }
+    int8_t *ctrl = malloc(new_cap);
+    Fingerprint *table = malloc(new_cap * sizeof(Fingerprint));
+    if (!ctrl || !table) {
+        log_fatal("[FPSet] shard resize allocation failed: new_cap=%zu", new_cap);
+        free(ctrl);
+        free(table);
+        return false;
+    }
+    swiss_ctrl_reset(ctrl, new_cap);
+
+    shard->old_ctrl = shard->ctrl;
+    shard->old_table = shard->table;
+    shard->old_capacity = shard->capacity;
+    shard->migrate_pos = 0;
+    shard->ctrl = ctrl;
+    shard->table = table;
+    shard->capacity = new_cap;
+    shard->count = 0;
+    shard->tombstones = 0;
+    return true;
+}
+
+/**
+ * @brief  本次插入前的扩容工作：按需发起扩容，并推进一步迁移
+ * @param  shard  FingerprintShard*  目标分片，不能为空（已持有 mutex）
+ * @return bool  返回 true 表示本次发起了一次扩容
+ *
+ * @note   新表容量为旧表 2 倍，每次插入迁移 FP_MIGRATE_STEP 个旧槽位，
+ *         迁移总能在新表到达 0.75 负载之前完成；万一未完成（如扩容失败后的重试），先迁移到底。
+ */
+static bool fp_shard_resize_step(FingerprintShard *shard) {
+    bool started = false;
+    if ((shard->count + shard->tombstones) * 4 >= shard->capacity * 3) {
+        fp_shard_migrate(shard, SIZE_MAX);
+        started = fp_shard_start_resize(shard);
+    }
+    fp_shard_migrate(shard, FP_MIGRATE_STEP);
+    return started;
+}
+
+/**
+ * @brief  插入前按需推进扩容，并计入扩容停顿统计（调用方必须已持有分片 mutex）
+ * @param  set    FingerprintSet*    所属集合，不能为空
+ * @param  shard  FingerprintShard*  目标分片，不能为空
+ * @return void
+ */
+static inline void fp_shard_maybe_resize(FingerprintSet *set, FingerprintShard *shard) {
+    if (shard->old_ctrl || (shard->count + shard->tombstones) * 4 >= shard->capacity * 3) {
+        size_t slots = shard->capacity + shard->old_capacity;
+        uint64_t t0 = fp_now_ns();
+        bool started = fp_shard_resize_step(shard);
+        fp_resize_record(set, fp_now_ns() - t0, started);
+        size_t now = shard->capacity + shard->old_capacity;
+        if (now != slots) {
+            /* 无符号回绕相加即为有符号增减 */
+            atomic_fetch_add_explicit(&set->mem_bytes, (now - slots) * (sizeof(Fingerprint) + 1),
+                                      memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief  向指定分片内部插入指纹（调用方必须已持有该分片的 mutex，且已执行 fp_shard_resize_step）
  * @param  shard       FingerprintShard*  目标分片指针，不能为空
  * @param  md5         const uint8_t[FP_SIZE]  要插入的 16 字节指纹
+ * @param  h           uint64_t                fp_hash(md5)
  * @param  out_exists  bool*  输出参数，返回 true 表示指纹已存在；false 表示新插入
  * @return bool  操作是否成功。正常情况下始终返回 true；理论上不应返回 false。
  *
- * @note   当分片负载因子超过 0.75 时自动扩容至 2 倍。
- *         使用线性探测解决冲突；遇到 tombstone（删除标记）时会复用该槽位。
+ * @note   迁移进行中时当前表未命中还需查询上一代表；新指纹总是写入当前表
+ *         探测链上第一个空槽或墓碑。
  */
-static bool fp_shard_insert_internal(FingerprintShard *shard, const uint8_t md5[FP_SIZE], bool *out_exists) {
+static bool fp_shard_insert_internal(FingerprintShard *shard, const uint8_t md5[FP_SIZE], uint64_t h,
+                                     bool *out_exists) {
     /* v15.1.3: capacity sanity check */
-    if (shard->capacity == 0 || shard->capacity > (1ULL << 30)) {
+    if (shard->capacity < SWISS_GROUP_WIDTH || shard->capacity > (1ULL << 30)) {
         log_fatal("[FPSet] shard capacity corrupted: %zu (valid range: [16, 1<<30])", shard->capacity);
         return false;
     }
@@ -116,108 +343,704 @@ static bool fp_shard_insert_internal(FingerprintShard *shard, const uint8_t md5[
         return false;
     }
 
-    if ((shard->count + shard->tombstones) * 2 >= shard->capacity * 3) {
-        /* 扩容到 2 倍 */
-        size_t old_cap = shard->capacity;
-        uint8_t *old_meta = shard->meta;
-        Fingerprint *old_table = shard->table;
+    size_t pos;
+    if (fp_table_find(shard->ctrl, shard->table, shard->capacity, md5, h, &pos) != (size_t)-1 ||
+        (shard->old_ctrl &&
+         fp_table_find(shard->old_ctrl, shard->old_table, shard->old_capacity, md5, h, NULL) != (size_t)-1)) {
+        *out_exists = true;
+        return true;
+    }
+    if (pos == (size_t)-1) {
+        /* v15.1.3: should never reach here under normal conditions */
+        log_fatal("[FPSet] open-addressing probe exhausted capacity=%zu (count=%zu, tombstones=%zu). Table full or corrupted.",
+                  shard->capacity, shard->count, shard->tombstones);
+        return false;
+    }
+    fp_shard_put(shard, pos, md5, h);
+    *out_exists = false;
+    return true;
+}
 
-        size_t new_cap = old_cap << 1;
-        if (new_cap > (1ULL << 30)) {
-            log_fatal("[FPSet] shard capacity overflow during resize: %zu -> %zu", old_cap, new_cap);
-            return false;
-        }
-        shard->meta = calloc(new_cap, sizeof(uint8_t));
-        shard->table = calloc(new_cap, sizeof(Fingerprint));
-        if (!shard->meta || !shard->table) {
-            log_fatal("[FPSet] shard resize allocation failed: new_cap=%zu", new_cap);
-            free(shard->meta);
-            free(shard->table);
-            shard->meta = old_meta;
-            shard->table = old_table;
+/**
+ * @brief  初始化互斥锁版本的 64 个分片
+ * @param  set        FingerprintSet*  目标集合，不能为空
+ * @param  per_shard  size_t           每分片初始容量（2 的幂，>= SWISS_GROUP_WIDTH）
+ * @return bool  返回 true 表示成功；false 表示内存不足（已回滚已分配的分片）
+ */
+static bool fp_mutex_create(FingerprintSet *set, size_t per_shard) {
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        FingerprintShard *shard = &set->shards[s];
+        shard->ctrl = malloc(per_shard);
+        shard->table = malloc(per_shard * sizeof(Fingerprint));
+        if (!shard->ctrl || !shard->table) {
+            for (int j = 0; j <= s; j++) {
+                free(set->shards[j].ctrl);
+                free(set->shards[j].table);
+                if (j < s) pthread_mutex_destroy(&set->shards[j].mutex);
+            }
             return false;
         }
-        shard->capacity = new_cap;
+        swiss_ctrl_reset(shard->ctrl, per_shard);
+        atomic_fetch_add_explicit(&set->mem_bytes, per_shard * (sizeof(Fingerprint) + 1), memory_order_relaxed);
+        shard->capacity = per_shard;
         shard->count = 0;
         shard->tombstones = 0;
+        pthread_mutex_init(&shard->mutex, NULL);
+    }
+    return true;
+}
+
+/**
+ * @brief  释放互斥锁版本的分片（含未迁移完的上一代表）
+ * @param  set  FingerprintSet*  目标集合，不能为空
+ * @return void
+ */
+static void fp_mutex_destroy(FingerprintSet *set) {
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        FingerprintShard *shard = &set->shards[s];
+        free(shard->ctrl);
+        free(shard->table);
+        free(shard->old_ctrl);
+        free(shard->old_table);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+}
 
-        for (size_t i = 0; i < old_cap; i++) {
-            if (old_meta[i] == 1) {
-                bool ignored;
-                fp_shard_insert_internal(shard, old_table[i].md5, &ignored);
+/**
+ * @brief  互斥锁版本插入
+ * @param  set  FingerprintSet*        目标集合指针，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  要插入的 16 字节指纹
+ * @return bool  返回 true 表示该指纹已存在于集合中；false 表示新插入成功
+ *
+ * @note   操作过程自动定位到对应分片并加锁，线程安全。
+ *         扩容不再一次性重哈希整张表：持锁期间只分配新表并迁移有限个旧槽位，
+ *         这部分耗时计入扩容停顿统计（fp_shard_maybe_resize）。
+ */
+static bool fp_mutex_insert(FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
+    size_t si = fp_shard_index(md5);
+    FingerprintShard *shard = &set->shards[si];
+    pthread_mutex_lock(&shard->mutex);
+    fp_shard_maybe_resize(set, shard);
+    bool exists = false;
+    fp_shard_insert_internal(shard, md5, fp_hash(md5), &exists);
+    pthread_mutex_unlock(&shard->mutex);
+    return exists;
+}
+
+/**
+ * @brief  预取指纹在分片当前表中的起始控制组（持锁期间调用）
+ * @param  shard  const FingerprintShard*  目标分片，不能为空
+ * @param  h      uint64_t                 fp_hash(md5)
+ * @return void
+ */
+static inline void fp_shard_prefetch_ctrl(const FingerprintShard *shard, uint64_t h) {
+    size_t g = swiss_h1(h) & (shard->capacity / SWISS_GROUP_WIDTH - 1);
+    __builtin_prefetch(shard->ctrl + g * SWISS_GROUP_WIDTH, 0, 1);
+}
+
+/**
+ * @brief  读取（已预取的）起始控制组，预取插入时将要访问的槽位（持锁期间调用）
+ * @param  shard  const FingerprintShard*  目标分片，不能为空
+ * @param  h      uint64_t                 fp_hash(md5)
+ * @return void
+ *
+ * @note   标签命中时预取第一个命中槽位（用于比较指纹），否则预取第一个可写槽位（用于写入）。
+ */
+static inline void fp_shard_prefetch_slot(const FingerprintShard *shard, uint64_t h) {
+    size_t g = swiss_h1(h) & (shard->capacity / SWISS_GROUP_WIDTH - 1);
+    const int8_t *grp = shard->ctrl + g * SWISS_GROUP_WIDTH;
+    uint32_t m = swiss_match(grp, swiss_h2(h));
+    if (m) {
+        __builtin_prefetch(&shard->table[g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(m)], 0, 1);
+        return;
+    }
+    uint32_t f = swiss_match_free(grp);
+    if (f) __builtin_prefetch(&shard->table[g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(f)], 1, 1);
+}
+
+/**
+ * @brief  互斥锁版本批量插入（单块，n <= FP_INSERT_BATCH）
+ * @param  set      FingerprintSet*    目标集合，不能为空
+ * @param  fps      const Fingerprint* 指纹数组，不能为空
+ * @param  n        size_t             指纹个数，取值范围: 1 ~ FP_INSERT_BATCH
+ * @param  results  bool*              输出数组，允许为 NULL；results[i] 为 true 表示已存在
+ * @return void
+ *
+ * @note   先统一计算哈希并按分片做稳定计数排序，每个分片只加锁一次。
+ *         加锁后先预取组内全部指纹的起始控制组，插入第 j 个指纹前再根据第 j + FP_PREFETCH_DIST 个
+ *         指纹的控制组预取其将访问的槽位，使控制字节与槽位两级缓存未命中都与插入重叠。
+ *         同一批内的重复指纹按原顺序处理，先出现者为新插入。
+ */
+static void fp_mutex_insert_chunk(FingerprintSet *set, const Fingerprint *fps, size_t n, bool *results) {
+    uint64_t hash[FP_INSERT_BATCH];
+    uint8_t shard_of[FP_INSERT_BATCH];
+    uint16_t order[FP_INSERT_BATCH];
+    uint16_t start[FP_SHARD_COUNT + 1] = {0};
+
+    for (size_t i = 0; i < n; i++) {
+        hash[i] = fp_hash(fps[i].md5);
+        shard_of[i] = (uint8_t)fp_shard_index(fps[i].md5);
+        start[shard_of[i] + 1]++;
+    }
+    for (int s = 0; s < FP_SHARD_COUNT; s++) start[s + 1] += start[s];
+    uint16_t fill[FP_SHARD_COUNT];
+    memcpy(fill, start, sizeof(fill));
+    for (size_t i = 0; i < n; i++) order[fill[shard_of[i]]++] = (uint16_t)i;
+
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        size_t lo = start[s], hi = start[s + 1];
+        if (lo == hi) continue;
+        FingerprintShard *shard = &set->shards[s];
+        pthread_mutex_lock(&shard->mutex);
+        for (size_t j = lo; j < hi; j++) fp_shard_prefetch_ctrl(shard, hash[order[j]]);
+        for (size_t j = lo; j < hi && j < lo + FP_PREFETCH_DIST; j++) {
+            fp_shard_prefetch_slot(shard, hash[order[j]]);
+        }
+        for (size_t j = lo; j < hi; j++) {
+            if (j + FP_PREFETCH_DIST < hi) fp_shard_prefetch_slot(shard, hash[order[j + FP_PREFETCH_DIST]]);
+            size_t i = order[j];
+            fp_shard_maybe_resize(set, shard);
+            bool exists = false;
+            fp_shard_insert_internal(shard, fps[i].md5, hash[i], &exists);
+            if (results) results[i] = exists;
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+/**
+ * @brief  互斥锁版本查询
+ * @param  set  const FingerprintSet*  目标集合指针，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  要查询的 16 字节指纹
+ * @return bool  返回 true 表示指纹存在于集合中；false 表示不存在
+ *
+ * @note   操作过程自动定位到对应分片并加锁，线程安全。
+ *         仅做只读查询，不推进迁移；迁移进行中时依次查询当前表与上一代表。
+ */
+static bool fp_mutex_contains(const FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
+    size_t si = fp_shard_index(md5);
+    const FingerprintShard *shard = &set->shards[si];
+    uint64_t h = fp_hash(md5);
+    pthread_mutex_lock((pthread_mutex_t *)&shard->mutex);
+    bool found = fp_table_find(shard->ctrl, shard->table, shard->capacity, md5, h, NULL) != (size_t)-1 ||
+                 (shard->old_ctrl &&
+                  fp_table_find(shard->old_ctrl, shard->old_table, shard->old_capacity, md5, h, NULL) != (size_t)-1);
+    pthread_mutex_unlock((pthread_mutex_t *)&shard->mutex);
+    return found;
+}
+
+/* ================================================================
+ * FingerprintSet 无锁实现 — 两步 CAS 开放寻址 + 协作扩容
+ * ================================================================ */
+
+#define FP_LF_EMPTY      0ULL
+#define FP_LF_MOVED      UINT64_MAX     /* 迁移时封存的空槽 */
+#define FP_LF_CHUNK      FP_MIGRATE_STEP /* 单次插入至多领取的迁移槽位数 */
+#define FP_LF_MAX_CAP    (1ULL << 30)
+
+/* 插入结果 */
+enum { FP_LF_INSERTED, FP_LF_EXISTS, FP_LF_HIT_MOVED, FP_LF_FULL };
+
+/* 发起扩容结果 */
+enum { FP_LF_RESIZE_STARTED, FP_LF_RESIZE_BUSY, FP_LF_RESIZE_FAILED };
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+/**
+ * @brief  将指纹拆分为两个非保留的 64-bit 键字
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹
+ * @param  k0   uint64_t*  输出：第一字（避开 0 与 FP_LF_MOVED）
+ * @param  k1   uint64_t*  输出：第二字（避开 0）
+ * @return void
+ *
+ * @note   保留值映射到相邻值。fp_compute 已经避开这些值，此处的映射对其输出是恒等的；
+ *         仅对不经 fp_compute 产生的输入（如旧版本写出的 fp_store 运行段）生效，
+ *         此时导出值与原值可能相差 1，概率 2^-63 量级。两处映射必须保持一致。
+ */
+static inline void fp_lf_split(const uint8_t md5[FP_SIZE], uint64_t *k0, uint64_t *k1) {
+    memcpy(k0, md5, sizeof(*k0));
+    memcpy(k1, md5 + sizeof(*k0), sizeof(*k1));
+    if (*k0 == FP_LF_EMPTY) *k0 = 1;
+    else if (*k0 == FP_LF_MOVED) *k0 = FP_LF_MOVED - 1;
+    if (*k1 == 0) *k1 = 1;
+}
+
+static inline size_t fp_lf_hash(uint64_t k0, size_t capacity) {
+    return (size_t)(splitmix64(k0) & (capacity - 1));
+}
+
+/**
+ * @brief  分配一代无锁哈希表
+ * @param  capacity  size_t  槽位数（2 的幂）
+ * @return FpLfTable*  成功返回新表；内存不足返回 NULL
+ */
+static FpLfTable *fp_lf_table_create(size_t capacity) {
+    FpLfTable *t = calloc(1, sizeof(FpLfTable));
+    if (!t) return NULL;
+    t->slots = calloc(capacity, sizeof(FpLfSlot));
+    if (!t->slots) {
+        free(t);
+        return NULL;
+    }
+    t->capacity = capacity;
+    return t;
+}
+
+/**
+ * @brief  在单代表中插入键
+ * @param  t   FpLfTable*  目标表，不能为空
+ * @param  k0  uint64_t    键第一字
+ * @param  k1  uint64_t    键第二字
+ * @return int  FP_LF_INSERTED / FP_LF_EXISTS；FP_LF_HIT_MOVED 表示本表正在迁移（键不在本表）；
+ *              FP_LF_FULL 表示探测一整圈无空位
+ *
+ * @note   先 CAS k0 认领空槽，再以 release 写入 k1 发布。看到 k0 相同而 k1 仍为 0 的槽位时
+ *         自旋等待发布：同一键的并发插入只有 CAS 成功的一方返回 FP_LF_INSERTED。
+ *         槽位只会从空变为已占用或 MOVED，已发布的键之前不存在空槽，探测到空槽或 MOVED 即可判定不存在。
+ */
+static int fp_lf_table_insert(FpLfTable *t, uint64_t k0, uint64_t k1) {
+    size_t mask = t->capacity - 1;
+    size_t idx = fp_lf_hash(k0, t->capacity);
+    for (size_t i = 0; i < t->capacity; i++) {
+        FpLfSlot *slot = &t->slots[(idx + i) & mask];
+        uint64_t cur = atomic_load_explicit(&slot->k0, memory_order_acquire);
+        if (cur == FP_LF_EMPTY) {
+            if (atomic_compare_exchange_strong_explicit(&slot->k0, &cur, k0,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                atomic_store_explicit(&slot->k1, k1, memory_order_release);
+                atomic_fetch_add_explicit(&t->count, 1, memory_order_relaxed);
+                return FP_LF_INSERTED;
             }
+            /* CAS 失败：cur 已更新为竞争者写入的值，继续判断本槽 */
+        }
+        if (cur == FP_LF_MOVED) return FP_LF_HIT_MOVED;
+        if (cur == k0) {
+            uint64_t v;
+            while ((v = atomic_load_explicit(&slot->k1, memory_order_acquire)) == 0) cpu_relax();
+            if (v == k1) return FP_LF_EXISTS;
         }
-        free(old_meta);
-        free(old_table);
     }
+    return FP_LF_FULL;
+}
 
-    size_t idx = fp_hash(md5, shard->capacity);
-    size_t first_tomb = (size_t)-1;
-    const size_t PROBE_LIMIT = 1000000; /* v15.1.3: hard limit to prevent infinite loop */
+/**
+ * @brief  在表链中查询键（无等待）
+ * @param  t   FpLfTable*  当前表，不能为空
+ * @param  k0  uint64_t    键第一字
+ * @param  k1  uint64_t    键第二字
+ * @return bool  返回 true 表示存在
+ *
+ * @note   k1 尚未发布的槽位视为尚未完成的插入，直接跳过。遇到空槽或 MOVED 说明键不在本表
+ *         （已在本表的键一定位于其探测链上任何空槽之前）；本表正在迁移时，迁移期间的新键
+ *         直接写入下一代表，因此探测结束后还要转到下一代表继续查询。
+ */
+static bool fp_lf_table_contains(FpLfTable *t, uint64_t k0, uint64_t k1) {
+    while (t) {
+        size_t mask = t->capacity - 1;
+        size_t idx = fp_lf_hash(k0, t->capacity);
+        for (size_t i = 0; i < t->capacity; i++) {
+            FpLfSlot *slot = &t->slots[(idx + i) & mask];
+            uint64_t cur = atomic_load_explicit(&slot->k0, memory_order_acquire);
+            if (cur == FP_LF_EMPTY || cur == FP_LF_MOVED) break;
+            if (cur == k0 && atomic_load_explicit(&slot->k1, memory_order_acquire) == k1) return true;
+        }
+        t = atomic_load_explicit(&t->next, memory_order_acquire);
+    }
+    return false;
+}
 
-    for (size_t i = 0; i < shard->capacity; i++) {
-        if (i >= PROBE_LIMIT) {
-            log_fatal("[FPSet] open-addressing probe limit exceeded: capacity=%zu, count=%zu, tombstones=%zu",
-                      shard->capacity, shard->count, shard->tombstones);
-            return false;
+/**
+ * @brief  在迁移中的旧表查询键，并封存探测链的终点
+ * @param  t   FpLfTable*  正在迁移的表（t->next 已设置），不能为空
+ * @param  k0  uint64_t    键第一字
+ * @param  k1  uint64_t    键第二字
+ * @return bool  返回 true 表示键已在本表（迁移会把它带到新表）；false 表示应写入新表
+ *
+ * @note   与 fp_lf_table_insert 一样等待已认领槽位的 k1 发布，因而不会错过同一键的并发插入。
+ *         探测到空槽时以 CAS 把它封存为 MOVED（提前完成该槽的迁移）：此后仍在本表插入的线程
+ *         在这里得到 FP_LF_HIT_MOVED，转去新表并在那里遇到本次写入的键，
+ *         同一键恰有一方返回"新插入"。
+ */
+static bool fp_lf_table_seal_lookup(FpLfTable *t, uint64_t k0, uint64_t k1) {
+    size_t mask = t->capacity - 1;
+    size_t idx = fp_lf_hash(k0, t->capacity);
+    for (size_t i = 0; i < t->capacity; i++) {
+        FpLfSlot *slot = &t->slots[(idx + i) & mask];
+        uint64_t cur = atomic_load_explicit(&slot->k0, memory_order_acquire);
+        if (cur == FP_LF_EMPTY) {
+            if (atomic_compare_exchange_strong_explicit(&slot->k0, &cur, FP_LF_MOVED,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                return false;
+            }
+            /* CAS 失败：cur 已更新为竞争者写入的值，继续判断本槽 */
         }
-        size_t pos = (idx + i) & (shard->capacity - 1);
-        uint8_t m = shard->meta[pos];
-
-        if (m == 0) {
-            if (first_tomb != (size_t)-1) pos = first_tomb;
-            memcpy(shard->table[pos].md5, md5, FP_SIZE);
-            shard->meta[pos] = 1;
-            shard->count++;
-            *out_exists = false;
-            return true;
+        if (cur == FP_LF_MOVED) return false;
+        if (cur == k0) {
+            uint64_t v;
+            while ((v = atomic_load_explicit(&slot->k1, memory_order_acquire)) == 0) cpu_relax();
+            if (v == k1) return true;
         }
-        if (m == 2 && first_tomb == (size_t)-1) {
-            first_tomb = pos;
+    }
+    return false;
+}
+
+/**
+ * @brief  迁移旧表中的一个槽位
+ * @param  slot  FpLfSlot*   旧表槽位，不能为空
+ * @param  dst   FpLfTable*  新表，不能为空
+ * @return void
+ *
+ * @note   空槽以 CAS 封存为 MOVED，之后的插入者必然转向新表；已认领的槽位等待 k1 发布后复制。
+ *         旧表中的键原样保留，迁移期间读者仍可在旧表命中。
+ */
+static void fp_lf_migrate_slot(FpLfSlot *slot, FpLfTable *dst) {
+    uint64_t cur = atomic_load_explicit(&slot->k0, memory_order_acquire);
+    while (cur == FP_LF_EMPTY) {
+        if (atomic_compare_exchange_weak_explicit(&slot->k0, &cur, FP_LF_MOVED,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            return;
         }
-        if (m == 1 && memcmp(shard->table[pos].md5, md5, FP_SIZE) == 0) {
-            *out_exists = true;
-            return true;
+    }
+    if (cur == FP_LF_MOVED) return;
+    uint64_t v;
+    while ((v = atomic_load_explicit(&slot->k1, memory_order_acquire)) == 0) cpu_relax();
+    fp_lf_table_insert(dst, cur, v);
+}
+
+/**
+ * @brief  协助分片扩容：至多领取并迁移一块（FP_LF_CHUNK 个槽位）
+ * @param  sh  FpLfShard*  分片，不能为空
+ * @param  t   FpLfTable*  正在迁移的旧表（t->next 已设置）
+ * @return bool  返回 true 表示本次实际迁移了槽位
+ *
+ * @note   不等待其他线程：迁完最后一块（migrate_done 达到容量）的线程负责切换当前表。
+ *         块已全部领完、但其他线程仍在迁移时直接返回，调用方随后查询旧表、写入新表即可。
+ */
+static bool fp_lf_help_resize(FpLfShard *sh, FpLfTable *t) {
+    FpLfTable *dst = atomic_load_explicit(&t->next, memory_order_acquire);
+    size_t start = atomic_fetch_add_explicit(&t->migrate_next, FP_LF_CHUNK, memory_order_relaxed);
+    if (start >= t->capacity) return false;
+    size_t end = start + FP_LF_CHUNK < t->capacity ? start + FP_LF_CHUNK : t->capacity;
+    for (size_t i = start; i < end; i++) fp_lf_migrate_slot(&t->slots[i], dst);
+    size_t done = atomic_fetch_add_explicit(&t->migrate_done, end - start, memory_order_acq_rel) + (end - start);
+    if (done == t->capacity) {
+        FpLfTable *expected = t;
+        if (atomic_compare_exchange_strong_explicit(&sh->cur, &expected, dst,
+                                                    memory_order_seq_cst, memory_order_seq_cst)) {
+            atomic_store_explicit(&sh->resizing, 0, memory_order_release);
         }
     }
-    /* v15.1.3: should never reach here under normal conditions */
-    log_fatal("[FPSet] open-addressing loop exhausted capacity=%zu (count=%zu, tombstones=%zu). Table full or corrupted.",
-              shard->capacity, shard->count, shard->tombstones);
-    return false; /* 不应该到达这里 */
+    return true;
 }
 
+/**
+ * @brief  补完旧表剩余的迁移并切换当前表
+ * @param  sh   FpLfShard*  分片，不能为空
+ * @param  old  FpLfTable*  正在迁移的旧表（old->next 已设置）
+ * @return void
+ *
+ * @note   槽位迁移是幂等的（空槽 CAS 封存，键复制到新表遇到已有键返回 FP_LF_EXISTS），
+ *         因此可以不理会 migrate_next 的领取情况，直接把整张旧表再扫一遍。
+ *         只在新表已过半而旧表仍未迁完时调用：领取了迁移块的线程被调度出去时，
+ *         新表不能无限接收新键。
+ */
+static void fp_lf_finish_resize(FpLfShard *sh, FpLfTable *old) {
+    FpLfTable *dst = atomic_load_explicit(&old->next, memory_order_acquire);
+    for (size_t i = 0; i < old->capacity; i++) fp_lf_migrate_slot(&old->slots[i], dst);
+    FpLfTable *expected = old;
+    if (atomic_compare_exchange_strong_explicit(&sh->cur, &expected, dst,
+                                                memory_order_seq_cst, memory_order_seq_cst)) {
+        atomic_store_explicit(&sh->resizing, 0, memory_order_release);
+    }
+}
+
+/**
+ * @brief  发起分片扩容（只有一个线程负责分配新表）
+ * @param  set FingerprintSet*  所属集合（扩容计数），不能为空
+ * @param  sh  FpLfShard*  分片，不能为空
+ * @param  t   FpLfTable*  当前表
+ * @return int  FP_LF_RESIZE_STARTED 表示新表已挂上（或 t 已被替换），调用方重新读取当前表；
+ *              FP_LF_RESIZE_BUSY 表示其他线程正在分配新表；FP_LF_RESIZE_FAILED 表示无法扩容
+ */
+static int fp_lf_start_resize(FingerprintSet *set, FpLfShard *sh, FpLfTable *t) {
+    int expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(&sh->resizing, &expected, 1,
+                                                 memory_order_acq_rel, memory_order_acquire)) {
+        return FP_LF_RESIZE_BUSY;
+    }
+    if (atomic_load_explicit(&sh->cur, memory_order_acquire) != t) {
+        /* t 的扩容已由其他线程完成：释放标记，调用方重新读取当前表 */
+        atomic_store_explicit(&sh->resizing, 0, memory_order_release);
+        return FP_LF_RESIZE_STARTED;
+    }
+    size_t new_cap = t->capacity << 1;
+    FpLfTable *n = (new_cap <= FP_LF_MAX_CAP) ? fp_lf_table_create(new_cap) : NULL;
+    if (!n) {
+        log_fatal("[FPSet] lock-free shard resize failed: %zu -> %zu", t->capacity, new_cap);
+        atomic_store_explicit(&sh->resizing, 0, memory_order_release);
+        return FP_LF_RESIZE_FAILED;
+    }
+    n->retired = t;
+    atomic_store_explicit(&t->next, n, memory_order_release);
+    atomic_fetch_add_explicit(&set->resizes, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&set->mem_bytes, new_cap * sizeof(FpLfSlot), memory_order_relaxed);
+    return FP_LF_RESIZE_STARTED;
+}
+
+/**
+ * @brief  释放分片当前表之前各代退役表的槽位
+ * @param  set  FingerprintSet*  所属集合（内存统计），不能为空
+ * @param  sh   FpLfShard*       分片，不能为空
+ * @return void
+ *
+ * @note   先读当前表、再确认 readers 为 0（均为 seq_cst）：此后进入的线程先增加 readers
+ *         再读当前表，只能读到这一代或更新的表，而更早各代只经由 retired 链可达，
+ *         因此释放其槽位是安全的。reclaimed 以原子交换标记，并发回收者不会重复释放；
+ *         按新到旧遍历，遇到已标记的表即停止（标记它的线程会继续处理更早的各代）。
+ *         表头保留到集合销毁：fp_lf_prefetch 不登记读者，可能读到旧表头并预取已释放的槽位，
+ *         预取指令不会因此出错。
+ */
+static void fp_lf_reclaim(FingerprintSet *set, FpLfShard *sh) {
+    FpLfTable *c = atomic_load_explicit(&sh->cur, memory_order_seq_cst);
+    FpLfTable *t = c->retired;
+    if (!t || atomic_load_explicit(&t->reclaimed, memory_order_relaxed)) return;
+    if (atomic_load_explicit(&sh->readers, memory_order_seq_cst) != 0) return;
+    for (; t && !atomic_exchange_explicit(&t->reclaimed, true, memory_order_acq_rel); t = t->retired) {
+        free(t->slots);
+        atomic_fetch_sub_explicit(&set->mem_bytes, t->capacity * sizeof(FpLfSlot), memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief  登记为分片读者并读取当前表
+ * @param  sh  FpLfShard*  分片，不能为空
+ * @return FpLfTable*  当前表；在 fp_lf_leave 之前，从它经 next 可达的各代表都不会被释放
+ */
+static inline FpLfTable *fp_lf_enter(FpLfShard *sh) {
+    atomic_fetch_add_explicit(&sh->readers, 1, memory_order_seq_cst);
+    return atomic_load_explicit(&sh->cur, memory_order_seq_cst);
+}
+
+/**
+ * @brief  注销分片读者；最后一个离开的线程尝试回收退役表
+ * @param  set  FingerprintSet*  所属集合，不能为空
+ * @param  sh   FpLfShard*       分片，不能为空
+ * @return void
+ */
+static inline void fp_lf_leave(FingerprintSet *set, FpLfShard *sh) {
+    if (atomic_fetch_sub_explicit(&sh->readers, 1, memory_order_seq_cst) == 1) fp_lf_reclaim(set, sh);
+}
+
+/**
+ * @brief  从指定表开始插入键（调用方已通过 fp_lf_enter 登记为分片读者）
+ * @param  set  FingerprintSet*  目标集合，不能为空
+ * @param  sh   FpLfShard*       键所属分片，不能为空
+ * @param  t    FpLfTable*       fp_lf_enter 返回的当前表
+ * @param  k0   uint64_t         键第一字
+ * @param  k1   uint64_t         键第二字
+ * @return bool  返回 true 表示已存在；false 表示新插入
+ *
+ * @note   负载因子达到 0.75 时发起扩容。表正在迁移时只协助迁移一块（迁移耗时计入扩容停顿统计），
+ *         然后在旧表查询该键（fp_lf_table_seal_lookup），不存在则写入新表；
+ *         不等待整张表迁完，单次插入的扩容停顿以 FP_LF_CHUNK 个槽位为上限。
+ *         只有当前表会发起扩容：新表在切换为当前表之前只接收迁入的键与迁移期间的新键；
+ *         若迁移停滞到新表已过半，本次插入补完整张旧表的迁移（fp_lf_finish_resize），
+ *         这是单次停顿唯一可能超过 FP_LF_CHUNK 个槽位的情形。
+ *         其他线程正在分配新表时，负载未到 7/8 的插入照常写入当前表（迁移会一并带走），
+ *         超过 7/8 则让出 CPU 等待新表挂上，避免小表被并发插入填满。
+ */
+static bool fp_lf_insert_from(FingerprintSet *set, FpLfShard *sh, FpLfTable *t, uint64_t k0, uint64_t k1) {
+    bool resize_failed = false;
+    for (;;) {
+        FpLfTable *next = atomic_load_explicit(&t->next, memory_order_acquire);
+        if (next) {
+            uint64_t t0 = fp_now_ns();
+            if (fp_lf_help_resize(sh, t)) fp_resize_record(set, fp_now_ns() - t0, false);
+            if (fp_lf_table_seal_lookup(t, k0, k1)) return true;
+            t = next;
+            continue;
+        }
+        size_t count = atomic_load_explicit(&t->count, memory_order_relaxed);
+        FpLfTable *cur = atomic_load_explicit(&sh->cur, memory_order_acquire);
+        bool is_cur = cur == t;
+        if (!is_cur && count * 2 >= t->capacity && cur == t->retired) {
+            /* 上一代迁移停滞（领取迁移块的线程未被调度）而新表已过半：补完迁移，使新表可以扩容。
+             * 旧表至多 7/8 满、键数不超过新表容量的 7/16，补完后新表仍有空位。
+             * 只在上一代仍是当前表时补完：否则 t 在读取 next 之后已被切换，上一代可能已回收 */
+            uint64_t t0 = fp_now_ns();
+            fp_lf_finish_resize(sh, cur);
+            fp_resize_record(set, fp_now_ns() - t0, false);
+            continue;
+        }
+        if (is_cur && !resize_failed && count * 4 >= t->capacity * 3) {
+            int rs = fp_lf_start_resize(set, sh, t);
+            if (rs == FP_LF_RESIZE_STARTED) continue;
+            if (rs == FP_LF_RESIZE_FAILED) {
+                resize_failed = true;
+            } else if (count * 8 >= t->capacity * 7) {
+                sched_yield();
+                continue;
+            }
+        }
+        int rc = fp_lf_table_insert(t, k0, k1);
+        if (rc == FP_LF_INSERTED) return false;
+        if (rc == FP_LF_EXISTS) return true;
+        if (rc == FP_LF_FULL) {
+            if (!resize_failed) {
+                sched_yield();
+                continue;
+            }
+            log_fatal("[FPSet] lock-free shard full (capacity=%zu)", t->capacity);
+            return false;
+        }
+        /* FP_LF_HIT_MOVED：t->next 已挂上，下一轮查询旧表后写入新表 */
+    }
+}
+
+/**
+ * @brief  无锁版本插入
+ * @param  set  FingerprintSet*        目标集合，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹
+ * @return bool  返回 true 表示已存在；false 表示新插入
+ */
+static bool fp_lf_insert(FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
+    uint64_t k0, k1;
+    fp_lf_split(md5, &k0, &k1);
+    FpLfShard *sh = &set->lf_shards[fp_shard_index(md5)];
+    bool exists = fp_lf_insert_from(set, sh, fp_lf_enter(sh), k0, k1);
+    fp_lf_leave(set, sh);
+    return exists;
+}
+
+/**
+ * @brief  预取指纹在其分片当前表中的起始槽位
+ * @param  set  FingerprintSet*        目标集合，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹
+ * @return void
+ *
+ * @note   不登记为读者：读到的当前表可能随即退役、槽位被回收，但表头保留到集合销毁，
+ *         预取已释放的地址不会出错（见 fp_lf_reclaim）。
+ */
+static inline void fp_lf_prefetch(FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
+    uint64_t k0, k1;
+    fp_lf_split(md5, &k0, &k1);
+    FpLfTable *t = atomic_load_explicit(&set->lf_shards[fp_shard_index(md5)].cur, memory_order_acquire);
+    __builtin_prefetch(&t->slots[fp_lf_hash(k0, t->capacity)], 0, 1);
+}
+
+/**
+ * @brief  无锁版本批量插入（单块，n <= FP_INSERT_BATCH）
+ * @param  set      FingerprintSet*    目标集合，不能为空
+ * @param  fps      const Fingerprint* 指纹数组，不能为空
+ * @param  n        size_t             指纹个数
+ * @param  results  bool*              输出数组，允许为 NULL；results[i] 为 true 表示已存在
+ * @return void
+ *
+ * @note   无锁实现不需要按分片聚合，只在插入第 i 个指纹前预取第 i + FP_PREFETCH_DIST 个的槽位。
+ */
+static void fp_lf_insert_chunk(FingerprintSet *set, const Fingerprint *fps, size_t n, bool *results) {
+    for (size_t i = 0; i < n && i < FP_PREFETCH_DIST; i++) fp_lf_prefetch(set, fps[i].md5);
+    for (size_t i = 0; i < n; i++) {
+        if (i + FP_PREFETCH_DIST < n) fp_lf_prefetch(set, fps[i + FP_PREFETCH_DIST].md5);
+        bool exists = fp_lf_insert(set, fps[i].md5);
+        if (results) results[i] = exists;
+    }
+}
+
+/**
+ * @brief  无锁版本查询
+ * @param  set  const FingerprintSet*  目标集合，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹
+ * @return bool  返回 true 表示存在
+ *
+ * @note   迁移进行中时依次查询旧表与新表（见 fp_lf_table_contains）。
+ */
+static bool fp_lf_contains(const FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
+    uint64_t k0, k1;
+    fp_lf_split(md5, &k0, &k1);
+    FingerprintSet *mset = (FingerprintSet *)set;
+    FpLfShard *sh = &mset->lf_shards[fp_shard_index(md5)];
+    bool found = fp_lf_table_contains(fp_lf_enter(sh), k0, k1);
+    fp_lf_leave(mset, sh);
+    return found;
+}
+
+/**
+ * @brief  释放无锁版本的所有分片（含迁移中的新表与各代退役表）
+ * @param  set  FingerprintSet*  目标集合，不能为空
+ * @return void
+ */
+static void fp_lf_destroy(FingerprintSet *set) {
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        FpLfTable *t = atomic_load(&set->lf_shards[s].cur);
+        while (t && atomic_load(&t->next)) t = atomic_load(&t->next);
+        while (t) {
+            FpLfTable *older = t->retired;
+            if (!atomic_load(&t->reclaimed)) free(t->slots);
+            free(t);
+            t = older;
+        }
+    }
+}
+
+/**
+ * @brief  初始化无锁版本的 64 个分片
+ * @param  set        FingerprintSet*  目标集合，不能为空
+ * @param  per_shard  size_t           每分片初始容量（2 的幂）
+ * @return bool  返回 true 表示成功；false 表示内存不足（已回滚）
+ */
+static bool fp_lf_create(FingerprintSet *set, size_t per_shard) {
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        FpLfTable *t = fp_lf_table_create(per_shard);
+        if (!t) {
+            fp_lf_destroy(set);
+            return false;
+        }
+        atomic_init(&set->lf_shards[s].cur, t);
+        atomic_init(&set->lf_shards[s].resizing, 0);
+        atomic_fetch_add_explicit(&set->mem_bytes, per_shard * sizeof(FpLfSlot), memory_order_relaxed);
+    }
+    return true;
+}
+
+/* ================================================================
+ * 公共接口（按 mode 分派）
+ * ================================================================ */
+
 /**
  * @brief  创建 FingerprintSet 实例
- * @param  expected_count  size_t  预估全局元素总数量，取值范围: > 0
+ * @param  expected_count  size_t     预估全局元素总数量，取值范围: > 0
+ * @param  mode            FpSetMode  FP_SET_MUTEX 或 FP_SET_LOCKFREE
  * @return FingerprintSet*  成功返回指向新分配集合的指针；内存不足时返回 NULL
  *
  * @note   总容量按 expected_count * 2 均摊到 64 个分片，每分片独立分配。
  *         每个分片的最小容量为 16。若某分片分配失败，则回滚并释放已分配的分片资源。
+ *         平台的 64-bit 原子操作不是无锁实现时，FP_SET_LOCKFREE 回退为 FP_SET_MUTEX。
  */
-FingerprintSet* fp_set_create(size_t expected_count) {
-    FingerprintSet *set = malloc(sizeof(FingerprintSet));
+FingerprintSet* fp_set_create(size_t expected_count, FpSetMode mode) {
+    FingerprintSet *set = calloc(1, sizeof(FingerprintSet));
     if (!set) return NULL;
 
     size_t per_shard = next_pow2((expected_count * 2 + FP_SHARD_COUNT - 1) / FP_SHARD_COUNT);
     if (per_shard < 16) per_shard = 16;
 
-    for (int s = 0; s < FP_SHARD_COUNT; s++) {
-        FingerprintShard *shard = &set->shards[s];
-        shard->meta = calloc(per_shard, sizeof(uint8_t));
-        shard->table = calloc(per_shard, sizeof(Fingerprint));
-        if (!shard->meta || !shard->table) {
-            for (int j = 0; j <= s; j++) {
-                free(set->shards[j].meta);
-                free(set->shards[j].table);
-                if (j < s) pthread_mutex_destroy(&set->shards[j].mutex);
-            }
-            free(set);
-            return NULL;
-        }
-        shard->capacity = per_shard;
-        shard->count = 0;
-        shard->tombstones = 0;
-        pthread_mutex_init(&shard->mutex, NULL);
+#if ATOMIC_LLONG_LOCK_FREE != 2 || ATOMIC_POINTER_LOCK_FREE != 2
+    if (mode == FP_SET_LOCKFREE) {
+        log_warn("[FPSet] 64-bit atomics are not lock-free on this platform, using mutex shards");
+        mode = FP_SET_MUTEX;
+    }
+#endif
+    set->mode = mode;
+    bool ok = (mode == FP_SET_LOCKFREE) ? fp_lf_create(set, per_shard) : fp_mutex_create(set, per_shard);
+    if (!ok) {
+        free(set);
+        return NULL;
     }
     return set;
 }
@@ -229,11 +1052,10 @@ FingerprintSet* fp_set_create(size_t expected_count) {
  */
 void fp_set_destroy(FingerprintSet *set) {
     if (!set) return;
-    for (int s = 0; s < FP_SHARD_COUNT; s++) {
-        FingerprintShard *shard = &set->shards[s];
-        free(shard->meta);
-        free(shard->table);
-        pthread_mutex_destroy(&shard->mutex);
+    if (set->mode == FP_SET_LOCKFREE) {
+        fp_lf_destroy(set);
+    } else {
+        fp_mutex_destroy(set);
     }
     free(set);
 }
@@ -244,17 +1066,34 @@ void fp_set_destroy(FingerprintSet *set) {
  * @param  md5  const uint8_t[FP_SIZE]  要插入的 16 字节指纹
  * @return bool  返回 true 表示该指纹已存在于集合中；false 表示新插入成功
  *
- * @note   操作过程自动定位到对应分片并加锁，线程安全。
- *         分片内可能触发自动扩容，但扩容期间仍持有该分片锁。
+ * @note   线程安全。并发插入同一指纹时恰有一个调用返回 false。
  */
 bool fp_set_insert(FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
-    size_t si = fp_shard_index(md5);
-    FingerprintShard *shard = &set->shards[si];
-    pthread_mutex_lock(&shard->mutex);
-    bool exists = false;
-    fp_shard_insert_internal(shard, md5, &exists);
-    pthread_mutex_unlock(&shard->mutex);
-    return exists;
+    return set->mode == FP_SET_LOCKFREE ? fp_lf_insert(set, md5) : fp_mutex_insert(set, md5);
+}
+
+/**
+ * @brief  批量插入指纹
+ * @param  set      FingerprintSet*    目标集合指针，不能为空
+ * @param  fps      const Fingerprint* 指纹数组，n > 0 时不能为空
+ * @param  n        size_t             指纹个数
+ * @param  results  bool*              输出数组（长度 >= n），允许为 NULL；
+ *                                     results[i] 为 true 表示 fps[i] 已存在，与逐条调用 fp_set_insert 的结果一致
+ * @return void
+ *
+ * @note   按 FP_INSERT_BATCH 分块：互斥锁版本每块按分片聚合、每个分片加锁一次，
+ *         两种实现均提前 FP_PREFETCH_DIST 条预取探测起点，使多次缓存未命中重叠而非串行。
+ */
+void fp_set_insert_batch(FingerprintSet *set, const Fingerprint *fps, size_t n, bool *results) {
+    for (size_t off = 0; off < n; off += FP_INSERT_BATCH) {
+        size_t m = n - off < FP_INSERT_BATCH ? n - off : FP_INSERT_BATCH;
+        bool *r = results ? results + off : NULL;
+        if (set->mode == FP_SET_LOCKFREE) {
+            fp_lf_insert_chunk(set, fps + off, m, r);
+        } else {
+            fp_mutex_insert_chunk(set, fps + off, m, r);
+        }
+    }
 }
 
 /**
@@ -263,24 +1102,135 @@ bool fp_set_insert(FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
  * @param  md5  const uint8_t[FP_SIZE]  要查询的 16 字节指纹
  * @return bool  返回 true 表示指纹存在于集合中；false 表示不存在
  *
- * @note   操作过程自动定位到对应分片并加锁，线程安全。
- *         仅做只读查询，不会修改集合状态，也不会触发扩容。
+ * @note   线程安全，只读。无锁版本不取任何锁、不等待其他线程。
  */
 bool fp_set_contains(const FingerprintSet *set, const uint8_t md5[FP_SIZE]) {
-    size_t si = fp_shard_index(md5);
-    const FingerprintShard *shard = &set->shards[si];
-    pthread_mutex_lock((pthread_mutex_t *)&shard->mutex);
-    size_t idx = fp_hash(md5, shard->capacity);
-    bool found = false;
-    for (size_t i = 0; i < shard->capacity; i++) {
-        size_t pos = (idx + i) & (shard->capacity - 1);
-        uint8_t m = shard->meta[pos];
-        if (m == 0) break;
-        if (m == 1 && memcmp(shard->table[pos].md5, md5, FP_SIZE) == 0) {
-            found = true;
-            break;
+    return set->mode == FP_SET_LOCKFREE ? fp_lf_contains(set, md5) : fp_mutex_contains(set, md5);
+}
+
+/**
+ * @brief  以目录路径（不含 dev/ino）为键记录一棵子树的根
+ * @param  set   FingerprintSet*  目标集合指针，不能为空
+ * @param  path  const char*      子树根目录路径，不能为空
+ * @return bool  返回 true 表示已存在，false 表示新插入
+ */
+bool fp_set_insert_path(FingerprintSet *set, const char *path) {
+    uint8_t fp[FP_SIZE];
+    fp_compute(path, 0, 0, fp);
+    return fp_set_insert(set, fp);
+}
+
+/**
+ * @brief  判断路径是否位于某棵已由 fp_set_insert_path 记录、且在 floor 之下的子树内
+ * @param  set    const FingerprintSet*  目标集合指针，不能为空
+ * @param  path   const char*            路径，不要求以 NUL 结尾
+ * @param  len    size_t                 参与判断的前缀长度（path[0..len)）
+ * @param  floor  size_t                 只查询长度大于 floor 的前缀；0 表示查询全部上级目录
+ * @return bool  返回 true 表示 path 自身或某个长度大于 floor 的上级目录已记录
+ *
+ * @note   逐级去掉最后一个路径分量后查询，代价为路径深度次指纹计算；根目录 "/" 不参与判断。
+ *         floor 取负责该路径的任务根长度：子树根等于或高于任务根时，该任务本身就负责这棵子树，
+ *         不应被裁剪。
+ */
+bool fp_set_contains_path_prefix(const FingerprintSet *set, const char *path, size_t len, size_t floor) {
+    char buf[4096];
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, path, len);
+    buf[len] = '\0';
+
+    uint8_t fp[FP_SIZE];
+    while (len > 1 && len > floor) {
+        fp_compute(buf, 0, 0, fp);
+        if (fp_set_contains(set, fp)) return true;
+        while (len > 0 && buf[len - 1] != '/') len--;
+        if (len <= 1) break;
+        buf[--len] = '\0';
+    }
+    return false;
+}
+
+/**
+ * @brief  读取扩容停顿统计
+ * @param  set  const FingerprintSet*  目标集合指针，不能为空
+ * @param  out  FpResizeStats*         输出统计，不能为空
+ * @return void
+ *
+ * @note   三个计数各自原子读取，彼此之间不保证同一时刻的一致快照，仅用于监控展示。
+ */
+void fp_set_resize_stats(const FingerprintSet *set, FpResizeStats *out) {
+    FingerprintSet *s = (FingerprintSet *)set;
+    out->resizes = atomic_load_explicit(&s->resizes, memory_order_relaxed);
+    out->pause_max_ns = atomic_load_explicit(&s->pause_max_ns, memory_order_relaxed);
+    out->pause_total_ns = atomic_load_explicit(&s->pause_total_ns, memory_order_relaxed);
+}
+
+/**
+ * @brief  读取槽位存储占用的字节数
+ * @param  set  const FingerprintSet*  目标集合指针，不能为空
+ * @return size_t  当前所有分片表（含迁移中的上一代表、无锁版本尚未回收的退役表）的槽位字节数
+ *
+ * @note   线程安全，仅统计控制字节与槽位数组，不含分片结构体等固定开销。
+ */
+size_t fp_set_memory(const FingerprintSet *set) {
+    return atomic_load_explicit(&((FingerprintSet *)set)->mem_bytes, memory_order_relaxed);
+}
+
+/**
+ * @brief  按 fp_set_export 的口径统计元素个数
+ * @param  set  const FingerprintSet*  目标集合指针，不能为空；调用期间不得有并发插入
+ * @return size_t  集合中的指纹个数
+ */
+size_t fp_set_count(const FingerprintSet *set) {
+    return fp_set_export(set, NULL, 0);
+}
+
+/**
+ * @brief  导出集合中的全部指纹（顺序不定）
+ * @param  set  const FingerprintSet*  目标集合指针，不能为空；调用期间不得有并发插入
+ * @param  out  Fingerprint*           输出数组，允许为 NULL（只计数）
+ * @param  max  size_t                 out 的容量；超出部分只计数不写入
+ * @return size_t  集合中的指纹总数
+ *
+ * @note   互斥锁版本遍历当前表与上一代表中尚未迁移的槽位（migrate_pos 之后），不会重复；
+ *         无锁版本同理：迁移进行中时遍历新表与旧表中尚未领取迁移的槽位（migrate_next 之后）；
+ *         静止时已领取的块都已迁完，两部分不重叠。
+ */
+size_t fp_set_export(const FingerprintSet *set, Fingerprint *out, size_t max) {
+    size_t n = 0;
+    for (int s = 0; s < FP_SHARD_COUNT; s++) {
+        if (set->mode == FP_SET_LOCKFREE) {
+            FpLfShard *sh = &((FingerprintSet *)set)->lf_shards[s];
+            for (FpLfTable *t = fp_lf_enter(sh); t; t = atomic_load_explicit(&t->next, memory_order_acquire)) {
+                size_t from = 0;
+                if (atomic_load_explicit(&t->next, memory_order_acquire)) {
+                    from = atomic_load_explicit(&t->migrate_next, memory_order_relaxed);
+                    if (from > t->capacity) from = t->capacity;
+                }
+                for (size_t i = from; i < t->capacity; i++) {
+                    uint64_t k0 = atomic_load_explicit(&t->slots[i].k0, memory_order_relaxed);
+                    if (k0 == FP_LF_EMPTY || k0 == FP_LF_MOVED) continue;
+                    if (out && n < max) {
+                        uint64_t k1 = atomic_load_explicit(&t->slots[i].k1, memory_order_relaxed);
+                        memcpy(out[n].md5, &k0, sizeof(k0));
+                        memcpy(out[n].md5 + sizeof(k0), &k1, sizeof(k1));
+                    }
+                    n++;
+                }
+            }
+            fp_lf_leave((FingerprintSet *)set, sh);
+        } else {
+            const FingerprintShard *shard = &set->shards[s];
+            for (size_t i = 0; i < shard->capacity; i++) {
+                if (shard->ctrl[i] < 0) continue;
+                if (out && n < max) out[n] = shard->table[i];
+                n++;
+            }
+            for (size_t i = shard->migrate_pos; shard->old_ctrl && i < shard->old_capacity; i++) {
+                if (shard->old_ctrl[i] < 0) continue;
+                if (out && n < max) out[n] = shard->old_table[i];
+                n++;
+            }
         }
     }
-    pthread_mutex_unlock((pthread_mutex_t *)&shard->mutex);
-    return found;
+    return n;
 }
@@ -0,0 +1,687 @@
+/**
+ * @file fp_store.c
+ * @brief 分层指纹存储：内存热表 + 磁盘有序不可变 run（--max-dedup-memory）
+ *
+ * 热表为普通 FingerprintSet。当其槽位内存的 3 倍（热表 + 冻结表 + 排序缓冲）加上
+ * 各 run 常驻索引超过 --max-dedup-memory 时，插入线程在写锁下把热表整体冻结并换上新表，
+ * 后台线程导出冻结表、排序后顺序写成一个 run 文件，再以写锁发布并释放冻结表。
+ * run 数达到 FP_STORE_MAX_RUNS 时后台线程把全部 run 归并为一个。
+ *
+ * 每个 run 常驻内存的只有分块 Bloom（每键 10 位，一次查询只访问一条缓存行）与
+ * 每 4KB 一个的围栏键（每键约 0.03 字节）；键本身经 mmap 由页缓存按需调入，
+ * Bloom 命中后用围栏定位到唯一的一页再做二分查找，单次查询最多读一页磁盘。
+ *
+ * 插入先查冻结表与各 run，均未命中才写入热表；整个过程持读锁，
+ * 冻结 / 发布 / 合并只在写锁下切换指针，因此各层之间的键互不重复。
+ */
+#include "fp_store.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <endian.h>
+#include <sys/mman.h>
+
+#define FP_STORE_WRITE_BUF 65536    /* run 写入缓冲（条），1MB */
+
+/* ================================================================
+ * 键比较与 Bloom
+ * ================================================================ */
+
+/* 键的高 / 低 64 位（大端解释，与 memcmp 字节序一致） */
+static inline uint64_t fp_key_hi(const uint8_t md5[FP_SIZE]) {
+    uint64_t x;
+    memcpy(&x, md5, sizeof(x));
+    return be64toh(x);
+}
+
+static inline uint64_t fp_key_lo(const uint8_t md5[FP_SIZE]) {
+    uint64_t x;
+    memcpy(&x, md5 + sizeof(x), sizeof(x));
+    return be64toh(x);
+}
+
+/**
+ * @brief  按字节序比较两个指纹
+ * @param  a  const uint8_t*  指纹 a
+ * @param  b  const uint8_t*  指纹 b
+ * @return int  a < b 返回负数，相等返回 0，a > b 返回正数
+ */
+static inline int fp_key_cmp(const uint8_t *a, const uint8_t *b) {
+    uint64_t ah = fp_key_hi(a), bh = fp_key_hi(b);
+    if (ah != bh) return ah < bh ? -1 : 1;
+    uint64_t al = fp_key_lo(a), bl = fp_key_lo(b);
+    if (al != bl) return al < bl ? -1 : 1;
+    return 0;
+}
+
+static int fp_key_qsort_cmp(const void *a, const void *b) {
+    return fp_key_cmp(((const Fingerprint *)a)->md5, ((const Fingerprint *)b)->md5);
+}
+
+/**
+ * @brief  定位指纹在分块 Bloom 中的块
+ * @param  md5     const uint8_t[FP_SIZE]  指纹
+ * @param  blocks  size_t                  Bloom 块数，> 0
+ * @return uint64_t*  偏移（以 uint64_t 计）= 块号 * 8
+ *
+ * @note   指纹本身是 xxHash3 输出，直接取前 8 字节做乘法映射选块，后 8 字节切出 7 个 9 位位置。
+ */
+static inline size_t fp_bloom_block(const uint8_t md5[FP_SIZE], size_t blocks) {
+    uint64_t k0;
+    memcpy(&k0, md5, sizeof(k0));
+    return (size_t)(((unsigned __int128)k0 * blocks) >> 64) * 8;
+}
+
+static inline void fp_bloom_add(uint64_t *bloom, size_t blocks, const uint8_t md5[FP_SIZE]) {
+    uint64_t *blk = bloom + fp_bloom_block(md5, blocks);
+    uint64_t k1;
+    memcpy(&k1, md5 + sizeof(k1), sizeof(k1));
+    for (int i = 0; i < 7; i++, k1 >>= 9) {
+        unsigned pos = (unsigned)(k1 & 511);
+        blk[pos >> 6] |= 1ULL << (pos & 63);
+    }
+}
+
+static inline bool fp_bloom_test(const uint64_t *bloom, size_t blocks, const uint8_t md5[FP_SIZE]) {
+    const uint64_t *blk = bloom + fp_bloom_block(md5, blocks);
+    uint64_t k1;
+    memcpy(&k1, md5 + sizeof(k1), sizeof(k1));
+    for (int i = 0; i < 7; i++, k1 >>= 9) {
+        unsigned pos = (unsigned)(k1 & 511);
+        if (!(blk[pos >> 6] & (1ULL << (pos & 63)))) return false;
+    }
+    return true;
+}
+
+/* ================================================================
+ * Run 构建与查询
+ * ================================================================ */
+
+/* 顺序写入一个 run：边写边建围栏与 Bloom */
+typedef struct {
+    int fd;
+    Fingerprint *buf;
+    size_t buffered;
+    size_t count;
+    uint64_t *fence;
+    size_t fence_cap;
+    uint64_t *bloom;
+    size_t bloom_blocks;
+    bool failed;
+} FpRunBuilder;
+
+/**
+ * @brief  在 "{prefix}.fprun.XXXXXX" 创建 run 临时文件并准备写入
+ * @param  b         FpRunBuilder*  构建器，不能为空
+ * @param  prefix    const char*    文件名前缀，不能为空
+ * @param  expected  size_t         将写入的键数上限（决定 Bloom 与围栏大小）
+ * @return bool  成功返回 true；文件或内存分配失败返回 false
+ *
+ * @note   文件创建后立即 unlink，仅由 fd 持有：进程异常退出时由内核回收，不留残留文件。
+ */
+static bool fp_run_begin(FpRunBuilder *b, const char *prefix, size_t expected) {
+    memset(b, 0, sizeof(*b));
+    size_t len = strlen(prefix) + sizeof(".fprun.XXXXXX");
+    char *tmpl = malloc(len);
+    if (!tmpl) return false;
+    snprintf(tmpl, len, "%s.fprun.XXXXXX", prefix);
+    b->fd = mkstemp(tmpl);
+    if (b->fd < 0) {
+        log_error("[FPStore] 无法创建 run 文件 %s: %s", tmpl, strerror(errno));
+        free(tmpl);
+        return false;
+    }
+    unlink(tmpl);
+    free(tmpl);
+
+    b->bloom_blocks = (expected * FP_RUN_BLOOM_BITS + 511) / 512;
+    if (b->bloom_blocks == 0) b->bloom_blocks = 1;
+    b->fence_cap = expected / FP_RUN_FENCE_STRIDE + 1;
+    b->buf = malloc(FP_STORE_WRITE_BUF * sizeof(Fingerprint));
+    b->fence = malloc(b->fence_cap * sizeof(uint64_t));
+    b->bloom = calloc(b->bloom_blocks * 8, sizeof(uint64_t));
+    if (!b->buf || !b->fence || !b->bloom) {
+        free(b->buf);
+        free(b->fence);
+        free(b->bloom);
+        close(b->fd);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief  把写入缓冲落盘
+ * @param  b  FpRunBuilder*  构建器，不能为空
+ * @return void
+ */
+static void fp_run_flush(FpRunBuilder *b) {
+    const uint8_t *p = (const uint8_t *)b->buf;
+    size_t left = b->buffered * sizeof(Fingerprint);
+    while (left > 0 && !b->failed) {
+        ssize_t w = write(b->fd, p, left);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            log_error("[FPStore] run 写入失败: %s", strerror(errno));
+            b->failed = true;
+            break;
+        }
+        p += w;
+        left -= (size_t)w;
+    }
+    b->buffered = 0;
+}
+
+/**
+ * @brief  按升序追加一个键
+ * @param  b    FpRunBuilder*           构建器，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  键，必须不小于上一个追加的键
+ * @return void
+ */
+static void fp_run_append(FpRunBuilder *b, const uint8_t md5[FP_SIZE]) {
+    if (b->count % FP_RUN_FENCE_STRIDE == 0) {
+        size_t f = b->count / FP_RUN_FENCE_STRIDE;
+        if (f >= b->fence_cap) {
+            b->failed = true;   /* 超出 fp_run_begin 的 expected，调用方用法错误 */
+            return;
+        }
+        b->fence[f] = fp_key_hi(md5);
+    }
+    fp_bloom_add(b->bloom, b->bloom_blocks, md5);
+    memcpy(b->buf[b->buffered].md5, md5, FP_SIZE);
+    b->count++;
+    if (++b->buffered == FP_STORE_WRITE_BUF) fp_run_flush(b);
+}
+
+/**
+ * @brief  释放 run 占用的全部资源
+ * @param  r  FpRun*  允许为 NULL
+ * @return void
+ */
+static void fp_run_destroy(FpRun *r) {
+    if (!r) return;
+    if (r->keys) munmap((void *)r->keys, r->map_size);
+    if (r->fd >= 0) close(r->fd);
+    free(r->fence);
+    free(r->bloom);
+    free(r);
+}
+
+/**
+ * @brief  结束写入并只读映射 run
+ * @param  b  FpRunBuilder*  构建器，不能为空；返回后不可再使用
+ * @return FpRun*  成功返回 run；写入或映射失败返回 NULL（文件随 fd 关闭回收）
+ */
+static FpRun *fp_run_finish(FpRunBuilder *b) {
+    fp_run_flush(b);
+    free(b->buf);
+    FpRun *r = calloc(1, sizeof(FpRun));
+    if (!r || b->failed) {
+        free(r);
+        free(b->fence);
+        free(b->bloom);
+        close(b->fd);
+        return NULL;
+    }
+    r->fd = b->fd;
+    r->count = b->count;
+    r->fence = b->fence;
+    r->fence_count = (b->count + FP_RUN_FENCE_STRIDE - 1) / FP_RUN_FENCE_STRIDE;
+    r->bloom = b->bloom;
+    r->bloom_blocks = b->bloom_blocks;
+    if (r->count > 0) {
+        r->map_size = r->count * sizeof(Fingerprint);
+        void *p = mmap(NULL, r->map_size, PROT_READ, MAP_SHARED, r->fd, 0);
+        if (p == MAP_FAILED) {
+            log_error("[FPStore] run 映射失败: %s", strerror(errno));
+            fp_run_destroy(r);
+            return NULL;
+        }
+        madvise(p, r->map_size, MADV_RANDOM);
+        r->keys = p;
+    }
+    return r;
+}
+
+/* run 常驻内存的索引字节数 */
+static size_t fp_run_index_bytes(const FpRun *r) {
+    return r->bloom_blocks * 64 + r->fence_count * sizeof(uint64_t);
+}
+
+/**
+ * @brief  查询 run 是否包含指纹
+ * @param  r    const FpRun*            目标 run，不能为空
+ * @param  md5  const uint8_t[FP_SIZE]  指纹
+ * @return bool  存在返回 true
+ *
+ * @note   Bloom 未命中直接返回；命中后在围栏中二分出候选块（键的高 64 位随机分布，
+ *         实际总是唯一一块），只在该块的 FP_RUN_FENCE_STRIDE 个键内二分。
+ */
+static bool fp_run_contains(const FpRun *r, const uint8_t md5[FP_SIZE]) {
+    if (r->count == 0 || !fp_bloom_test(r->bloom, r->bloom_blocks, md5)) return false;
+
+    uint64_t hi = fp_key_hi(md5);
+    /* first: 第一个围栏 >= hi；last: 第一个围栏 > hi */
+    size_t lo = 0, up = r->fence_count;
+    while (lo < up) {
+        size_t mid = (lo + up) / 2;
+        if (r->fence[mid] < hi) lo = mid + 1; else up = mid;
+    }
+    size_t first = lo;
+    up = r->fence_count;
+    while (lo < up) {
+        size_t mid = (lo + up) / 2;
+        if (r->fence[mid] <= hi) lo = mid + 1; else up = mid;
+    }
+    size_t begin = (first > 0 ? first - 1 : 0) * FP_RUN_FENCE_STRIDE;
+    size_t end = lo * FP_RUN_FENCE_STRIDE;
+    if (end > r->count) end = r->count;
+
+    while (begin < end) {
+        size_t mid = (begin + end) / 2;
+        int c = fp_key_cmp(r->keys[mid].md5, md5);
+        if (c == 0) return true;
+        if (c < 0) begin = mid + 1; else end = mid;
+    }
+    return false;
+}
+
+/* ================================================================
+ * 后台下刷与合并
+ * ================================================================ */
+
+/**
+ * @brief  把冻结表导出、排序并写成一个 run
+ * @param  store   FpStore*               所属存储，不能为空
+ * @param  frozen  const FingerprintSet*  已冻结的热表（不再有插入），不能为空
+ * @return FpRun*  成功返回 run；失败返回 NULL
+ */
+static FpRun *fp_store_write_run(FpStore *store, const FingerprintSet *frozen) {
+    size_t n = fp_set_count(frozen);
+    Fingerprint *keys = malloc((n ? n : 1) * sizeof(Fingerprint));
+    if (!keys) {
+        log_error("[FPStore] 下刷排序缓冲分配失败: %zu 条", n);
+        return NULL;
+    }
+    n = fp_set_export(frozen, keys, n);
+    qsort(keys, n, sizeof(Fingerprint), fp_key_qsort_cmp);
+
+    FpRunBuilder b;
+    FpRun *run = NULL;
+    if (fp_run_begin(&b, store->spill_prefix, n)) {
+        for (size_t i = 0; i < n; i++) fp_run_append(&b, keys[i].md5);
+        run = fp_run_finish(&b);
+    }
+    free(keys);
+    return run;
+}
+
+/**
+ * @brief  把当前全部 run 归并为一个（仅后台线程调用）
+ * @param  store  FpStore*  所属存储，不能为空
+ * @return void
+ *
+ * @note   run 只由后台线程增删，归并期间读者继续查询旧 run；新 run 写完后在写锁下替换，
+ *         释放写锁后再回收旧 run（此时已没有读者持有它们）。失败时保留旧 run 不变。
+ */
+static void fp_store_compact(FpStore *store) {
+    size_t k = store->run_count;
+    FpRun **src = store->runs;
+    size_t total = 0;
+    for (size_t i = 0; i < k; i++) total += src[i]->count;
+
+    FpRunBuilder b;
+    if (!fp_run_begin(&b, store->spill_prefix, total)) return;
+
+    size_t *pos = calloc(k, sizeof(size_t));
+    if (!pos) {
+        b.failed = true;
+        fp_run_finish(&b);
+        return;
+    }
+    for (size_t i = 0; i < k; i++) madvise((void *)src[i]->keys, src[i]->map_size, MADV_SEQUENTIAL);
+    for (;;) {
+        const uint8_t *min = NULL;
+        size_t min_i = 0;
+        for (size_t i = 0; i < k; i++) {
+            if (pos[i] == src[i]->count) continue;
+            const uint8_t *key = src[i]->keys[pos[i]].md5;
+            if (!min || fp_key_cmp(key, min) < 0) {
+                min = key;
+                min_i = i;
+            }
+        }
+        if (!min) break;
+        fp_run_append(&b, min);
+        pos[min_i]++;
+    }
+    free(pos);
+
+    FpRun *merged = fp_run_finish(&b);
+    if (!merged) {
+        for (size_t i = 0; i < k; i++) madvise((void *)src[i]->keys, src[i]->map_size, MADV_RANDOM);
+        log_error("[FPStore] run 合并失败，保留 %zu 个 run", k);
+        return;
+    }
+    FpRun **runs = malloc(FP_STORE_MAX_RUNS * sizeof(FpRun *));
+    if (!runs) {
+        fp_run_destroy(merged);
+        return;
+    }
+    runs[0] = merged;
+
+    pthread_rwlock_wrlock(&store->lock);
+    store->runs = runs;
+    store->run_count = 1;
+    pthread_rwlock_unlock(&store->lock);
+
+    size_t freed = 0;
+    for (size_t i = 0; i < k; i++) {
+        freed += fp_run_index_bytes(src[i]);
+        fp_run_destroy(src[i]);
+    }
+    free(src);
+    atomic_fetch_add(&store->index_bytes, fp_run_index_bytes(merged));
+    atomic_fetch_sub(&store->index_bytes, freed);
+    atomic_fetch_add(&store->compactions, 1);
+    log_debug("[FPStore] 合并 %zu 个 run -> %zu 条", k, merged->count);
+}
+
+/**
+ * @brief  后台线程：下刷冻结表，run 过多时合并
+ * @param  arg  void*  FpStore*
+ * @return void*  NULL
+ *
+ * @note   下刷失败（磁盘满等）时把冻结表中的键并回热表并停止分层，保证不丢失去重状态。
+ */
+static void *fp_store_bg_entry(void *arg) {
+    FpStore *store = arg;
+    pthread_mutex_lock(&store->bg_mutex);
+    while (!store->bg_stop) {
+        if (!store->spill_pending) {
+            pthread_cond_wait(&store->bg_cond, &store->bg_mutex);
+            continue;
+        }
+        /* frozen 在写锁下设置、在 spill_pending 置位前完成，此处读取无需再加读写锁 */
+        FingerprintSet *frozen = store->frozen;
+        pthread_mutex_unlock(&store->bg_mutex);
+
+        FpRun *run = fp_store_write_run(store, frozen);
+        pthread_rwlock_wrlock(&store->lock);
+        if (run) {
+            store->runs[store->run_count++] = run;
+        } else {
+            size_t n = fp_set_count(frozen);
+            Fingerprint *keys = malloc((n ? n : 1) * sizeof(Fingerprint));
+            if (keys) {
+                n = fp_set_export(frozen, keys, n);
+                fp_set_insert_batch(store->hot, keys, n, NULL);
+                free(keys);
+            }
+            store->max_memory = 0;
+            log_error("[FPStore] 下刷失败，停止分层，后续全部保留在内存中");
+        }
+        store->frozen = NULL;
+        pthread_rwlock_unlock(&store->lock);
+        fp_set_destroy(frozen);
+
+        if (run) {
+            atomic_fetch_add(&store->index_bytes, fp_run_index_bytes(run));
+            atomic_fetch_add(&store->spilled, run->count);
+            atomic_fetch_add(&store->spills, 1);
+            log_debug("[FPStore] 下刷 %zu 条 -> run #%zu", run->count, store->run_count);
+            if (store->run_count >= FP_STORE_MAX_RUNS) fp_store_compact(store);
+        }
+
+        pthread_mutex_lock(&store->bg_mutex);
+        store->spill_pending = false;
+        pthread_cond_broadcast(&store->bg_cond);
+    }
+    pthread_mutex_unlock(&store->bg_mutex);
+    return NULL;
+}
+
+/* ================================================================
+ * 热表冻结
+ * ================================================================ */
+
+/**
+ * @brief  热表是否已超出预算（调用方持读锁或写锁）
+ * @param  store  FpStore*  目标存储，不能为空
+ * @return bool  需要冻结返回 true
+ *
+ * @note   预算：热表 + 冻结表 + 排序缓冲约为热表的 3 倍，再加各 run 的常驻索引。
+ *         索引本身超出预算时热表仍保留 max_memory / 16 的下限，避免每次插入都触发冻结。
+ */
+static bool fp_store_over_budget(FpStore *store) {
+    if (store->max_memory == 0) return false;
+    size_t index = atomic_load_explicit(&store->index_bytes, memory_order_relaxed);
+    size_t limit = index < store->max_memory ? (store->max_memory - index) / 3 : 0;
+    if (limit < store->max_memory / 16) limit = store->max_memory / 16;
+    return fp_set_memory(store->hot) >= limit;
+}
+
+/**
+ * @brief  冻结热表并交给后台线程下刷（插入线程在释放读锁后调用）
+ * @param  store  FpStore*  目标存储，不能为空
+ * @return void
+ *
+ * @note   上一张冻结表尚未下刷完时等待（背压），保证同一时刻最多一张冻结表。
+ *         锁顺序：bg_mutex → lock（写）。
+ */
+static void fp_store_freeze(FpStore *store) {
+    pthread_mutex_lock(&store->bg_mutex);
+    while (store->spill_pending && !store->bg_stop) pthread_cond_wait(&store->bg_cond, &store->bg_mutex);
+    if (store->bg_stop) {
+        pthread_mutex_unlock(&store->bg_mutex);
+        return;
+    }
+    pthread_rwlock_wrlock(&store->lock);
+    if (fp_store_over_budget(store) && store->run_count < FP_STORE_MAX_RUNS) {
+        FingerprintSet *fresh = fp_set_create(store->hot_expected, store->mode);
+        if (fresh) {
+            store->frozen = store->hot;
+            store->hot = fresh;
+            store->spill_pending = true;
+            pthread_cond_broadcast(&store->bg_cond);
+        }
+    }
+    pthread_rwlock_unlock(&store->lock);
+    pthread_mutex_unlock(&store->bg_mutex);
+}
+
+/**
+ * @brief  查询冻结表与各 run（调用方持读锁）
+ * @param  store  FpStore*                目标存储，不能为空
+ * @param  md5    const uint8_t[FP_SIZE]  指纹
+ * @return bool  任一层存在返回 true
+ *
+ * @note   新 run 更可能命中近期重复，倒序查询。
+ */
+static bool fp_store_cold_contains(FpStore *store, const uint8_t md5[FP_SIZE]) {
+    if (store->frozen && fp_set_contains(store->frozen, md5)) return true;
+    for (size_t i = store->run_count; i-- > 0;) {
+        if (fp_run_contains(store->runs[i], md5)) return true;
+    }
+    return false;
+}
+
+/* ================================================================
+ * 公共接口
+ * ================================================================ */
+
+/**
+ * @brief  创建分层指纹存储
+ * @param  expected_count  size_t      预估元素数量，取值范围: > 0
+ * @param  mode            FpSetMode   热表实现
+ * @param  max_memory      size_t      内存预算（字节），0 表示不分层
+ * @param  spill_prefix    const char* run 文件名前缀，max_memory > 0 时不能为空
+ * @return FpStore*  成功返回存储；内存不足或后台线程创建失败时返回 NULL
+ *
+ * @note   分层时热表的预估容量不超过预算的 1/3 所能容纳的条目数，避免初始分配就超出预算。
+ */
+FpStore* fp_store_create(size_t expected_count, FpSetMode mode, size_t max_memory, const char *spill_prefix) {
+    FpStore *store = calloc(1, sizeof(FpStore));
+    if (!store) return NULL;
+    store->mode = mode;
+    store->max_memory = spill_prefix ? max_memory : 0;
+    store->hot_expected = expected_count;
+    if (store->max_memory) {
+        /* fp_set_create 按 2 倍预估、每分片向上取 2 的幂分配，最坏每条 4 个槽位 */
+        size_t cap = store->max_memory / 3 / (4 * (sizeof(Fingerprint) + 1));
+        if (cap < 1024) cap = 1024;
+        if (store->hot_expected > cap) store->hot_expected = cap;
+    }
+    store->hot = fp_set_create(store->hot_expected, mode);
+    if (!store->hot) {
+        free(store);
+        return NULL;
+    }
+    if (!store->max_memory) return store;
+
+    store->spill_prefix = strdup(spill_prefix);
+    store->runs = malloc(FP_STORE_MAX_RUNS * sizeof(FpRun *));
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+    /* 读者持续不断，写者优先，避免冻结 / 发布饿死 */
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(&store->lock, &attr);
+    pthread_rwlockattr_destroy(&attr);
+    pthread_mutex_init(&store->bg_mutex, NULL);
+    pthread_cond_init(&store->bg_cond, NULL);
+    if (!store->spill_prefix || !store->runs ||
+        pthread_create(&store->bg_tid, NULL, fp_store_bg_entry, store) != 0) {
+        store->bg_running = false;
+        fp_store_destroy(store);
+        return NULL;
+    }
+    store->bg_running = true;
+    return store;
+}
+
+/**
+ * @brief  销毁存储：停止后台线程，释放热表、冻结表与全部 run
+ * @param  store  FpStore*  允许为 NULL
+ * @return void
+ */
+void fp_store_destroy(FpStore *store) {
+    if (!store) return;
+    if (store->spill_prefix || store->runs) {
+        if (store->bg_running) {
+            pthread_mutex_lock(&store->bg_mutex);
+            store->bg_stop = true;
+            pthread_cond_broadcast(&store->bg_cond);
+            pthread_mutex_unlock(&store->bg_mutex);
+            pthread_join(store->bg_tid, NULL);
+        }
+        for (size_t i = 0; i < store->run_count; i++) fp_run_destroy(store->runs[i]);
+        free(store->runs);
+        fp_set_destroy(store->frozen);
+        free(store->spill_prefix);
+        pthread_rwlock_destroy(&store->lock);
+        pthread_mutex_destroy(&store->bg_mutex);
+        pthread_cond_destroy(&store->bg_cond);
+    }
+    fp_set_destroy(store->hot);
+    free(store);
+}
+
+/**
+ * @brief  插入一个指纹
+ * @param  store  FpStore*                目标存储，不能为空
+ * @param  md5    const uint8_t[FP_SIZE]  指纹
+ * @return bool  返回 true 表示已存在（任一层）；false 表示新插入热表
+ */
+bool fp_store_insert(FpStore *store, const uint8_t md5[FP_SIZE]) {
+    if (!store->spill_prefix) return fp_set_insert(store->hot, md5);
+
+    pthread_rwlock_rdlock(&store->lock);
+    bool exists = fp_store_cold_contains(store, md5) || fp_set_insert(store->hot, md5);
+    bool freeze = fp_store_over_budget(store);
+    pthread_rwlock_unlock(&store->lock);
+    if (freeze) fp_store_freeze(store);
+    return exists;
+}
+
+/**
+ * @brief  批量插入指纹
+ * @param  store    FpStore*           目标存储，不能为空
+ * @param  fps      const Fingerprint* 指纹数组，n > 0 时不能为空
+ * @param  n        size_t             指纹个数
+ * @param  results  bool*              输出数组（长度 >= n），允许为 NULL；语义同 fp_set_insert_batch
+ * @return void
+ *
+ * @note   每 FP_INSERT_BATCH 条为一块：先逐条查冷层，未命中的键聚合后一次 fp_set_insert_batch 写入热表。
+ */
+void fp_store_insert_batch(FpStore *store, const Fingerprint *fps, size_t n, bool *results) {
+    if (!store->spill_prefix) {
+        fp_set_insert_batch(store->hot, fps, n, results);
+        return;
+    }
+
+    Fingerprint todo[FP_INSERT_BATCH];
+    bool hot_res[FP_INSERT_BATCH];
+    size_t slot[FP_INSERT_BATCH];
+    for (size_t off = 0; off < n; off += FP_INSERT_BATCH) {
+        size_t m = n - off < FP_INSERT_BATCH ? n - off : FP_INSERT_BATCH;
+        pthread_rwlock_rdlock(&store->lock);
+        size_t t = 0;
+        for (size_t i = 0; i < m; i++) {
+            bool cold = fp_store_cold_contains(store, fps[off + i].md5);
+            if (results) results[off + i] = cold;
+            if (!cold) {
+                todo[t] = fps[off + i];
+                slot[t++] = off + i;
+            }
+        }
+        fp_set_insert_batch(store->hot, todo, t, hot_res);
+        if (results) {
+            for (size_t i = 0; i < t; i++) results[slot[i]] = hot_res[i];
+        }
+        bool freeze = fp_store_over_budget(store);
+        pthread_rwlock_unlock(&store->lock);
+        if (freeze) fp_store_freeze(store);
+    }
+}
+
+/**
+ * @brief  查询指纹是否存在于任一层
+ * @param  store  FpStore*                目标存储，不能为空
+ * @param  md5    const uint8_t[FP_SIZE]  指纹
+ * @return bool  存在返回 true
+ */
+bool fp_store_contains(FpStore *store, const uint8_t md5[FP_SIZE]) {
+    if (!store->spill_prefix) return fp_set_contains(store->hot, md5);
+
+    pthread_rwlock_rdlock(&store->lock);
+    bool found = fp_set_contains(store->hot, md5) || fp_store_cold_contains(store, md5);
+    pthread_rwlock_unlock(&store->lock);
+    return found;
+}
+
+/**
+ * @brief  读取分层统计
+ * @param  store  FpStore*        目标存储，不能为空
+ * @param  out    FpStoreStats*   输出，不能为空
+ * @return void
+ */
+void fp_store_stats(FpStore *store, FpStoreStats *out) {
+    memset(out, 0, sizeof(*out));
+    if (!store->spill_prefix) {
+        fp_set_resize_stats(store->hot, &out->hot);
+        out->hot_bytes = fp_set_memory(store->hot);
+        return;
+    }
+    pthread_rwlock_rdlock(&store->lock);
+    fp_set_resize_stats(store->hot, &out->hot);
+    out->hot_bytes = fp_set_memory(store->hot) + (store->frozen ? fp_set_memory(store->frozen) : 0);
+    out->runs = store->run_count;
+    pthread_rwlock_unlock(&store->lock);
+    out->index_bytes = atomic_load(&store->index_bytes);
+    out->spilled = atomic_load(&store->spilled);
+    out->spills = atomic_load(&store->spills);
+    out->compactions = atomic_load(&store->compactions);
+}
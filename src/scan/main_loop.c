@@ -52,30 +52,33 @@ static void handle_return_message(AppContext *ctx, IpcThreadMsg *msg) {
             if (msg->data_len >= sizeof(RetErrorPayload)) {
                 RetErrorPayload *err = (RetErrorPayload*)msg->data;
                 IpcErrorHeader hdr = { err->errno_code, err->dev };
+                /* v15.1.1: 设备级错误不替换 Worker；credit 由随后的 FINISH 归还 */
                 main_loop_handle_error(ctx, msg->slot_id, &hdr, err->path);
-                /* v15.1.1: 设备级错误不替换 Worker，Worker 回到 IDLE */
-                atomic_store(&ctx->worker_pool->slots[msg->slot_id].state, WORKER_STATE_IDLE);
             }
             break;
         }
         case RET_READY: {
             log_info("[Bus] Worker %d READY", msg->slot_id);
             atomic_store(&ctx->worker_pool->slots[msg->slot_id].last_heartbeat, time(NULL));
-            /* v15.1.1: 无论之前是 INITIALIZING 还是其他状态，收到 READY 后置 IDLE */
+            /* v15.1.1: 无论之前是 INITIALIZING 还是其他状态，收到 READY 后可接受任务 */
             atomic_store(&ctx->worker_pool->slots[msg->slot_id].state, WORKER_STATE_IDLE);
+            worker_slot_refresh_state(&ctx->worker_pool->slots[msg->slot_id]);
             break;
         }
         case RET_FINISH: {
             log_info("[Bus] Worker %d FINISH (pending_tasks=%ld)", msg->slot_id, atomic_load(&ctx->pending_tasks));
-            atomic_fetch_sub(&ctx->pending_tasks, 1);
-            atomic_store(&ctx->worker_pool->slots[msg->slot_id].state, WORKER_STATE_IDLE); /* v15.1.0 */
-            /* Task completed, Worker is now IDLE */
+            /* Task completed: return its credit, the next queued directory is already at the worker */
+            if (msg->data) {
+                dispatch_task_finished(ctx, msg->slot_id, (const char *)msg->data);
+            }
             break;
         }
         case RET_DEAD: {
             WorkerSlot *slot = &ctx->worker_pool->slots[msg->slot_id];
-            if (atomic_load(&slot->is_alive) && slot->pid != -1) {
-                /* Stale RET_DEAD after replacement; ignore */
+            pid_t dead_pid = msg->data_len >= sizeof(RetDeadPayload)
+                           ? ((const RetDeadPayload *)msg->data)->pid : -1;
+            if (atomic_load(&slot->is_alive) && slot->pid != dead_pid) {
+                /* 槽位已换上新进程（或同一次死亡的重复通知，pid 为 -1）：忽略 */
                 break;
             }
             log_error("[Bus] Worker %d DEAD reported by IPC thread", msg->slot_id);
@@ -92,12 +95,14 @@ static void handle_return_message(AppContext *ctx, IpcThreadMsg *msg) {
             cleanup_dead_worker_slot(ctx, msg->slot_id, false);
             break;
         }
+        case RET_STOLEN: {
+            dispatch_stolen_tasks(ctx, msg->slot_id, msg->data, msg->data_len);
+            break;
+        }
         case MSG_DROP: {
             if (msg->data_len >= sizeof(DropPayload)) {
                 DropPayload *drop = (DropPayload*)msg->data;
-                if (!lost_tasks_push(&ctx->lost_tasks, strdup(drop->path))) {
-                    log_warn("[Bus] MSG_DROP requeue failed: %s", path_log_mask(drop->path));
-                }
+                dispatch_task_dropped(ctx, msg->slot_id, drop->path);
             }
             break;
         }
@@ -107,8 +112,7 @@ static void handle_return_message(AppContext *ctx, IpcThreadMsg *msg) {
             break;
         }
     }
-    free(msg->data);
-    msg->data = NULL;
+    msg_release_data(msg);
 }
 
 /* ================================================================
@@ -345,12 +349,14 @@ void main_loop_run(AppContext *ctx) {
                 cleanup_dead_worker_slot(ctx, i, true);
                 log_info("[Replace] Replacing dead worker %d", i);
                 worker_pool_replace(ctx->worker_pool, i);
-                send_replace_to_ipc(ctx, i, slot->fd_cmd, slot->fd_data, slot->fd_ctrl, slot->pid);
+                send_replace_to_ipc(ctx, i, slot->fd_cmd, slot->fd_data, slot->fd_ctrl, slot->pid, slot->ring);
+                slot->ring = NULL; /* 引用已移交 IPC 线程 */
             }
         }
 
-        /* 7. Dispatch lost tasks */
+        /* 7. Dispatch lost tasks, then steal worker-local subdirectories for idle workers */
         dispatch_lost_tasks(ctx);
+        dispatch_steal_for_idle(ctx);
 
         /* 8. Termination check */
         if (atomic_load(&ctx->pending_tasks) == 0 && !ctx->resume_active
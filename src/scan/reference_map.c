@@ -2,15 +2,45 @@
  * @file reference_map.c
  * @brief 指纹 → (mtime, d_type) 映射表实现
  *
- * 基于开放寻址法（线性探测）的哈希表，用于支撑半增量扫描中的 blind-trust 机制。
+ * 基于开放寻址法的哈希表（Swiss table 控制字节 + 16 槽位分组探测，见 swiss_group.h），
+ * 用于支撑半增量扫描中的 blind-trust 机制。Worker 对每个条目都要查询一次，
+ * 未命中时只需比较控制字节，不必逐个访问 24 字节的 ReferenceEntry。
+ * 本表同时承担历史存在性判断（不再另建 reference_set），构建完成后只读，查询无锁。
  * 当文件/目录的 mtime 超过 skip_interval 未变化时，可直接复用历史记录中的元数据，
  * 避免重复的 lstat 系统调用，显著降低 I/O 开销。
  *
  * 本模块与 fingerprint_set.c 使用相同的 splitmix64 哈希函数，确保哈希一致性。
+ *
+ * 快照文件（{base}.fpsnap）即映射表本身的内存布局：
+ *   [RefSnapHeader 64B][ctrl: capacity 字节][对齐到 64B][entries: capacity * 24B]
+ * 写入端扫描期间只把记录顺序追加到日志，任务结束时按记录数一次建表（不扩容），补写头部 magic 后 rename 发布；
+ * 读取端只读 mmap 后即可查询，Worker fork 后经页缓存共享同一份物理页。
  */
 #include "reference_map.h"
+#include "swiss_group.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REF_SNAP_MAGIC   0x31504E534D46524CULL   /* "LRFMSNP1" */
+#define REF_SNAP_VERSION 2   /* 2: ReferenceEntry 压缩为 24 字节 */
+
+/* 快照文件头部，固定 64 字节；magic 在封口时最后写入，未封口的文件不会被读取端接受 */
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t entry_size;      /* sizeof(ReferenceEntry)，拒绝布局不同的快照 */
+    uint64_t capacity;
+    uint64_t count;
+    uint64_t entries_off;
+    uint8_t  _pad[24];
+} RefSnapHeader;
+
+_Static_assert(sizeof(RefSnapHeader) == 64, "RefSnapHeader must be 64 bytes");
 
 /* 与 fingerprint_set.c 使用完全相同的哈希函数 */
 
@@ -30,18 +60,62 @@ static inline uint64_t splitmix64(uint64_t x) {
 }
 
 /**
- * @brief  计算指纹的哈希桶索引
- * @param  md5       const uint8_t[FP_SIZE]  16 字节指纹数据
- * @param  capacity  size_t                   哈希表当前容量，必须为 2 的幂次
- * @return size_t  映射到 [0, capacity-1] 范围内的桶索引
+ * @brief  计算指纹的 64-bit 探测哈希
+ * @param  md5  const uint8_t[FP_SIZE]  16 字节指纹数据
+ * @return uint64_t  高位（swiss_h1）选择起始分组，低 7 位（swiss_h2）作为控制字节标签
  *
- * @note   取指纹前 8 字节作为 splitmix64 的输入，再与 capacity-1 做位与运算。
- *         要求 capacity 为 2 的幂，以保证均匀分布。
+ * @note   取指纹前 8 字节作为 splitmix64 的输入。
  */
-static inline size_t fp_hash(const uint8_t md5[FP_SIZE], size_t capacity) {
+static inline uint64_t fp_hash(const uint8_t md5[FP_SIZE]) {
     uint64_t x;
     memcpy(&x, md5, sizeof(x));
-    return (size_t)(splitmix64(x) & (capacity - 1));
+    return splitmix64(x);
+}
+
+/**
+ * @brief  按组三角探测查找指纹所在槽位
+ * @param  map       const ReferenceMap*     目标映射表指针，不能为空
+ * @param  fp        const uint8_t[FP_SIZE]  要查找的 16 字节指纹
+ * @param  h         uint64_t                fp_hash(fp)
+ * @param  free_pos  size_t*  输出参数，允许为 NULL；未找到时返回探测链上第一个空槽位置
+ * @return size_t  命中返回槽位下标；未命中返回 (size_t)-1
+ *
+ * @note   组内以 7-bit 标签做一次 16 路比较，仅对标签命中的槽位比较完整指纹；
+ *         某组内出现 SWISS_EMPTY 即说明指纹不在表中。
+ */
+static size_t ref_map_find(const ReferenceMap *map, const uint8_t fp[FP_SIZE],
+                           uint64_t h, size_t *free_pos) {
+    size_t group_mask = map->capacity / SWISS_GROUP_WIDTH - 1;
+    size_t g = swiss_h1(h) & group_mask;
+    int8_t tag = swiss_h2(h);
+    if (free_pos) *free_pos = (size_t)-1;
+
+    for (size_t i = 0; i <= group_mask; i++) {
+        const int8_t *ctrl = map->ctrl + g * SWISS_GROUP_WIDTH;
+        uint32_t m = swiss_match(ctrl, tag);
+        while (m) {
+            size_t pos = g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(m);
+            if (memcmp(map->entries[pos].fingerprint, fp, FP_SIZE) == 0) return pos;
+            m &= m - 1;
+        }
+        uint32_t e = swiss_match_empty(ctrl);
+        if (e) {
+            if (free_pos) *free_pos = g * SWISS_GROUP_WIDTH + (size_t)__builtin_ctz(e);
+            break;
+        }
+        g = (g + i + 1) & group_mask;
+    }
+    return (size_t)-1;
+}
+
+/**
+ * @brief  把 mtime 与 d_type 打包为 ReferenceEntry::meta
+ * @param  mtime   time_t   修改时间
+ * @param  d_type  uint8_t  文件类型
+ * @return int64_t  (mtime << 8) | d_type
+ */
+static inline int64_t ref_meta_pack(time_t mtime, uint8_t d_type) {
+    return (int64_t)((uint64_t)(int64_t)mtime << 8) | d_type;
 }
 
 /**
@@ -57,31 +131,146 @@ static size_t next_pow2(size_t n) {
     return p;
 }
 
+/**
+ * @brief  计算快照文件中 entries 区的起始偏移
+ * @param  cap  size_t  表容量（2 的幂，>= 16）
+ * @return size_t  头部 + 控制字节之后按 64 字节对齐的偏移
+ */
+static size_t ref_snap_entries_off(size_t cap) {
+    return (sizeof(RefSnapHeader) + cap + 63) & ~(size_t)63;
+}
+
+/**
+ * @brief  为映射表分配一张容量为 cap 的空表（堆内存或文件映射）
+ * @param  map   ReferenceMap*  目标映射表，成功时其 ctrl/entries/base/base_size/capacity 被替换，count 清零
+ * @param  path  const char*    NULL 表示堆内存；否则在该路径创建（截断）文件并 MAP_SHARED 映射
+ * @param  cap   size_t         新容量，2 的幂且 >= 16
+ * @return bool  成功返回 true；失败时 map 保持不变
+ *
+ * @note   文件表先 ftruncate 到完整大小（entries 区为稀疏空洞，仅写入的页占用磁盘），
+ *         头部 magic 保持为 0，直到 ref_map_seal 封口。
+ */
+static bool ref_map_table_alloc(ReferenceMap *map, const char *path, size_t cap) {
+    if (!path) {
+        int8_t *ctrl = malloc(cap);
+        ReferenceEntry *entries = malloc(cap * sizeof(ReferenceEntry));
+        if (!ctrl || !entries) {
+            free(ctrl);
+            free(entries);
+            return false;
+        }
+        swiss_ctrl_reset(ctrl, cap);
+        map->ctrl = ctrl;
+        map->entries = entries;
+        map->base = NULL;
+        map->base_size = 0;
+    } else {
+        size_t off = ref_snap_entries_off(cap);
+        size_t size = off + cap * sizeof(ReferenceEntry);
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        if (ftruncate(fd, (off_t)size) != 0) {
+            close(fd);
+            unlink(path);
+            return false;
+        }
+        void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) {
+            unlink(path);
+            return false;
+        }
+        /* 写入端只属于 Master，之后重新拉起的 Worker 不继承这段映射 */
+        madvise(base, size, MADV_DONTFORK);
+        RefSnapHeader *hdr = base;
+        hdr->version = REF_SNAP_VERSION;
+        hdr->entry_size = sizeof(ReferenceEntry);
+        hdr->capacity = cap;
+        hdr->entries_off = off;
+        map->ctrl = (int8_t *)((uint8_t *)base + sizeof(RefSnapHeader));
+        map->entries = (ReferenceEntry *)((uint8_t *)base + off);
+        swiss_ctrl_reset(map->ctrl, cap);
+        map->base = base;
+        map->base_size = size;
+    }
+    map->capacity = cap;
+    map->count = 0;
+    return true;
+}
+
+/**
+ * @brief  释放一张表的存储（不触及 ReferenceMap 结构体本身）
+ * @param  ctrl       int8_t*          堆表的控制字节数组
+ * @param  entries    ReferenceEntry*  堆表的条目数组
+ * @param  base       void*            文件映射起始地址，NULL 表示堆表
+ * @param  base_size  size_t           文件映射长度
+ * @return void
+ */
+static void ref_map_table_free(int8_t *ctrl, ReferenceEntry *entries, void *base, size_t base_size) {
+    if (base) {
+        munmap(base, base_size);
+    } else {
+        free(ctrl);
+        free(entries);
+    }
+}
+
 /**
  * @brief  创建 ReferenceMap 实例
  * @param  expected_count  size_t  预估元素数量，取值范围: > 0
  * @return ReferenceMap*  成功返回指向新分配映射表的指针；内存不足时返回 NULL
  *
  * @note   实际分配容量为 next_pow2(expected_count * 2)，且最小为 16。
- *         内部使用 calloc 分配 meta 和 entries 数组，初始状态均为空。
+ *         控制字节数组初始化为 SWISS_EMPTY，entries 不做清零。
  */
 ReferenceMap* ref_map_create(size_t expected_count) {
-    ReferenceMap *map = malloc(sizeof(ReferenceMap));
+    ReferenceMap *map = calloc(1, sizeof(ReferenceMap));
     if (!map) return NULL;
 
     size_t cap = next_pow2(expected_count * 2);
     if (cap < 16) cap = 16;
 
-    map->meta = calloc(cap, sizeof(uint8_t));
-    map->entries = calloc(cap, sizeof(ReferenceEntry));
-    if (!map->meta || !map->entries) {
-        free(map->meta);
-        free(map->entries);
+    if (!ref_map_table_alloc(map, NULL, cap)) {
+        free(map);
+        return NULL;
+    }
+    return map;
+}
+
+/**
+ * @brief  创建可写的快照 ReferenceMap（快照写入端）
+ * @param  path  const char*  快照临时文件路径，不能为空；封口时在该路径建表
+ * @return ReferenceMap*  成功返回映射表指针；日志文件创建失败时返回 NULL
+ *
+ * @note   封口前不建表：ref_map_insert 只把 24 字节条目追加到 "{path}.log"（stdio 缓冲，顺序写），
+ *         Master 主线程上每条记录的代价与写 pbin 相当，不会因表扩容停顿。
+ *         日志打开后立即 unlink，进程退出或 ref_map_destroy 时自动回收，崩溃不会残留。
+ *         记录数在扫描开始时未知（--estimated-files 只是预估，断点恢复还要重放历史），
+ *         由 ref_map_seal 按实际记录数定容后一次插入完成。
+ *         封口前的映射表不能用于 ref_map_lookup。
+ */
+ReferenceMap* ref_map_create_mapped(const char *path) {
+    ReferenceMap *map = calloc(1, sizeof(ReferenceMap));
+    if (!map) return NULL;
+    map->path = strdup(path);
+    if (!map->path) {
+        free(map);
+        return NULL;
+    }
+
+    size_t len = strlen(path) + sizeof(".log");
+    char *log_path = malloc(len);
+    if (log_path) {
+        snprintf(log_path, len, "%s.log", path);
+        map->log = fopen(log_path, "w+b");
+        if (map->log) unlink(log_path);
+        free(log_path);
+    }
+    if (!map->log) {
+        free(map->path);
         free(map);
         return NULL;
     }
-    map->capacity = cap;
-    map->count = 0;
     return map;
 }
 
@@ -89,11 +278,14 @@ ReferenceMap* ref_map_create(size_t expected_count) {
  * @brief  销毁 ReferenceMap 实例并释放所有内部内存
  * @param  map  ReferenceMap*  要销毁的映射表指针，允许传入 NULL（空操作）
  * @return void
+ *
+ * @note   文件映射的表只解除映射，不删除文件；未封口的写入端文件由调用方负责清理。
  */
 void ref_map_destroy(ReferenceMap *map) {
     if (!map) return;
-    free(map->meta);
-    free(map->entries);
+    if (map->log) fclose(map->log);
+    ref_map_table_free(map->ctrl, map->entries, map->base, map->base_size);
+    free(map->path);
     free(map);
 }
 
@@ -106,53 +298,51 @@ void ref_map_destroy(ReferenceMap *map) {
  * @return void
  *
  * @note   若指纹已存在，则覆盖更新其 mtime 和 d_type。
- *         当负载因子超过 0.75（count*2 >= capacity*3）时自动扩容至 2 倍容量，
- *         并重新哈希所有已有条目。
+ *         堆表在负载因子达到 0.75（count*4 >= capacity*3）时自动扩容至 2 倍容量，
+ *         并重新哈希所有已有条目；扩容内存不足时保留原表继续使用。
+ *         快照写入端封口前只追加到记录日志（count 为已追加的记录数，含重复），不查表。
  */
 void ref_map_insert(ReferenceMap *map, const uint8_t fp[FP_SIZE], time_t mtime, uint8_t d_type) {
-    /* 是否需要扩容 */
-    if (map->count * 2 >= map->capacity * 3) {
+    if (map->log) {
+        ReferenceEntry rec;
+        memcpy(rec.fingerprint, fp, FP_SIZE);
+        rec.meta = ref_meta_pack(mtime, d_type);
+        if (fwrite(&rec, sizeof(rec), 1, map->log) == 1) map->count++;
+        return;
+    }
+
+    /* 是否需要扩容（文件表在封口时按记录数定容，负载因子不超过 0.5，不会走到这里） */
+    if (!map->base && map->count * 4 >= map->capacity * 3) {
         size_t old_cap = map->capacity;
-        uint8_t *old_meta = map->meta;
+        int8_t *old_ctrl = map->ctrl;
         ReferenceEntry *old_entries = map->entries;
 
-        size_t new_cap = old_cap << 1;
-        map->meta = calloc(new_cap, sizeof(uint8_t));
-        map->entries = calloc(new_cap, sizeof(ReferenceEntry));
-        map->capacity = new_cap;
-        map->count = 0;
-
-        for (size_t i = 0; i < old_cap; i++) {
-            if (old_meta[i] == 1) {
-                ref_map_insert(map, old_entries[i].fingerprint,
-                               old_entries[i].mtime, old_entries[i].d_type);
+        if (ref_map_table_alloc(map, NULL, old_cap << 1)) {
+            for (size_t i = 0; i < old_cap; i++) {
+                if (old_ctrl[i] >= 0) {
+                    ref_map_insert(map, old_entries[i].fingerprint,
+                                   ref_entry_mtime(&old_entries[i]), ref_entry_dtype(&old_entries[i]));
+                }
             }
+            ref_map_table_free(old_ctrl, old_entries, NULL, 0);
         }
-        free(old_meta);
-        free(old_entries);
     }
 
-    size_t idx = fp_hash(fp, map->capacity);
-    for (size_t i = 0; i < map->capacity; i++) {
-        size_t pos = (idx + i) & (map->capacity - 1);
-        uint8_t m = map->meta[pos];
-
-        if (m == 0) {
-            /* 空槽，插入 */
-            memcpy(map->entries[pos].fingerprint, fp, FP_SIZE);
-            map->entries[pos].mtime = mtime;
-            map->entries[pos].d_type = d_type;
-            map->meta[pos] = 1;
-            map->count++;
-            return;
-        }
-        if (m == 1 && memcmp(map->entries[pos].fingerprint, fp, FP_SIZE) == 0) {
-            /* 已存在，覆盖更新（mtime/d_type 可能变化） */
-            map->entries[pos].mtime = mtime;
-            map->entries[pos].d_type = d_type;
-            return;
-        }
+    uint64_t h = fp_hash(fp);
+    size_t pos;
+    size_t hit = ref_map_find(map, fp, h, &pos);
+    if (hit != (size_t)-1) {
+        /* 已存在，覆盖更新（mtime/d_type 可能变化） */
+        map->entries[hit].meta = ref_meta_pack(mtime, d_type);
+        return;
     }
+    if (pos == (size_t)-1) return;  /* 表满且扩容失败 */
+
+    ReferenceEntry *e = &map->entries[pos];
+    memcpy(e->fingerprint, fp, FP_SIZE);
+    e->meta = ref_meta_pack(mtime, d_type);
+    map->ctrl[pos] = swiss_h2(h);
+    map->count++;
 }
 
 /**
@@ -163,15 +353,104 @@ void ref_map_insert(ReferenceMap *map, const uint8_t fp[FP_SIZE], time_t mtime,
  *
  * @note   返回的指针指向映射表内部存储，调用方不应修改或释放该指针。
  *         若后续执行了 ref_map_insert 导致扩容，该指针将失效。
+ *         不加锁：构建完成后表只读，Worker 进程中并发查询安全。
  */
 const ReferenceEntry* ref_map_lookup(const ReferenceMap *map, const uint8_t fp[FP_SIZE]) {
-    size_t idx = fp_hash(fp, map->capacity);
-    for (size_t i = 0; i < map->capacity; i++) {
-        size_t pos = (idx + i) & (map->capacity - 1);
-        uint8_t m = map->meta[pos];
-        if (m == 0) return NULL;
-        if (m == 1 && memcmp(map->entries[pos].fingerprint, fp, FP_SIZE) == 0)
-            return &map->entries[pos];
+    size_t pos = ref_map_find(map, fp, fp_hash(fp), NULL);
+    return pos == (size_t)-1 ? NULL : &map->entries[pos];
+}
+
+/**
+ * @brief  按记录日志建表并发布快照文件
+ * @param  map         ReferenceMap*  由 ref_map_create_mapped 创建的映射表，不能为空
+ * @param  final_path  const char*    发布路径，不能为空；已存在的旧快照被原子替换
+ * @return bool  成功返回 true；map 不是写入端、日志读写出错、建表或 msync/rename 失败时返回 false
+ *
+ * @note   顺序：按日志记录数定容（next_pow2(count * 2)）在 map->path 建表 → 顺序读回日志逐条插入
+ *         （重复指纹以后写为准）→ 写 count → msync 数据 → 写 magic → msync 头部 → rename。
+ *         一次定容、无扩容重建；任何一步之前崩溃，读取端都只会看到旧快照或 magic 为 0 的临时文件。
+ *         封口后 map 仍可查询，但不应再插入。失败时 map->path 上可能残留未封口的表，由调用方清理。
+ */
+bool ref_map_seal(ReferenceMap *map, const char *final_path) {
+    if (!map->log || !map->path) return false;
+    FILE *log = map->log;
+    map->log = NULL;
+
+    size_t records = map->count;
+    size_t cap = next_pow2(records * 2);
+    if (cap < 16) cap = 16;
+    bool ok = fflush(log) == 0 && !ferror(log) && fseek(log, 0, SEEK_SET) == 0 &&
+              ref_map_table_alloc(map, map->path, cap);
+    if (ok) {
+        ReferenceEntry buf[1024];
+        size_t n, seen = 0;
+        while ((n = fread(buf, sizeof(buf[0]), 1024, log)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                ref_map_insert(map, buf[i].fingerprint, ref_entry_mtime(&buf[i]), ref_entry_dtype(&buf[i]));
+            }
+            seen += n;
+        }
+        ok = !ferror(log) && seen == records;
+    }
+    fclose(log);
+    if (!ok) return false;
+
+    RefSnapHeader *hdr = map->base;
+    hdr->count = map->count;
+    if (msync(map->base, map->base_size, MS_SYNC) != 0) return false;
+    hdr->magic = REF_SNAP_MAGIC;
+    if (msync(map->base, sizeof(RefSnapHeader), MS_SYNC) != 0) return false;
+    if (rename(map->path, final_path) != 0) return false;
+    free(map->path);
+    map->path = NULL;
+    return true;
+}
+
+/**
+ * @brief  只读映射一个已封口的快照文件
+ * @param  path  const char*  快照文件路径，不能为空
+ * @return ReferenceMap*  成功返回只读映射表；文件不存在、未封口或布局不符时返回 NULL
+ *
+ * @note   O(1) 打开：只校验头部与文件大小，不读取表内容，页面在首次查询时按需调入。
+ *         映射为 MAP_SHARED + PROT_READ，fork 出的 Worker 直接共享页缓存，无 COW 复制。
+ *         整个映射设置 MADV_RANDOM，避免随机查询触发无用的预读。
+ *         返回的映射表只能用于 ref_map_lookup，插入会导致段错误。
+ */
+ReferenceMap* ref_map_open_snapshot(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    RefSnapHeader hdr;
+    if (fstat(fd, &st) != 0 || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+        close(fd);
+        return NULL;
     }
-    return NULL;
+    size_t cap = (size_t)hdr.capacity;
+    if (hdr.magic != REF_SNAP_MAGIC || hdr.version != REF_SNAP_VERSION ||
+        hdr.entry_size != sizeof(ReferenceEntry) ||
+        cap < 16 || (cap & (cap - 1)) != 0 || hdr.count > cap ||
+        hdr.entries_off != ref_snap_entries_off(cap) ||
+        (uint64_t)st.st_size != hdr.entries_off + (uint64_t)cap * sizeof(ReferenceEntry)) {
+        close(fd);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    ReferenceMap *map = calloc(1, sizeof(ReferenceMap));
+    if (!map) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    map->ctrl = (int8_t *)((uint8_t *)base + sizeof(RefSnapHeader));
+    map->entries = (ReferenceEntry *)((uint8_t *)base + hdr.entries_off);
+    map->capacity = cap;
+    map->count = (size_t)hdr.count;
+    map->base = base;
+    map->base_size = (size_t)st.st_size;
+    madvise(base, map->base_size, MADV_RANDOM);
+    return map;
 }
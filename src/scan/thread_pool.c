@@ -6,6 +6,7 @@
  * 将 CPU 密集型的指纹计算与设备黑名单检查 offload 到工作线程，
  * 避免阻塞 epoll 主循环。
  * 队列满时自动降级为同步处理（由调用方在主线程直接执行）。
+ * 启动阶段的并行恢复（progress_archive.c）也复用本线程池：以 TPBatch::job 携带归档块任务。
  */
 #include "thread_pool.h"
 #include <stdlib.h>
@@ -18,6 +19,43 @@
 
 #define TP_QUEUE_CAPACITY 256
 
+/**
+ * @brief  分配可容纳 count 条记录的 batch
+ * @param  count  int  记录数，取值范围: >= 0
+ * @return TPBatch*  成功返回 batch（results 清零、arena 为 NULL）；内存不足返回 NULL
+ *
+ * @note   结构体、stats、paths、results 共用一次分配，按 stat → 指针 → 字节的顺序排列保证对齐；
+ *         整块随 tp_batch_free 一次释放。
+ */
+TPBatch* tp_batch_create(int count) {
+    if (count < 0) return NULL;
+    size_t n = (size_t)count;
+    size_t stats_off = (sizeof(TPBatch) + _Alignof(struct stat) - 1) & ~(_Alignof(struct stat) - 1);
+    size_t paths_off = stats_off + n * sizeof(struct stat);
+    size_t results_off = paths_off + n * sizeof(char *);
+    char *mem = malloc(results_off + n);
+    if (!mem) return NULL;
+
+    TPBatch *batch = (TPBatch *)mem;
+    memset(batch, 0, sizeof(*batch));
+    batch->stats = (struct stat *)(mem + stats_off);
+    batch->paths = (char **)(mem + paths_off);
+    batch->results = (uint8_t *)(mem + results_off);
+    memset(batch->results, 0, n);
+    return batch;
+}
+
+/**
+ * @brief  释放 batch 及其路径缓冲引用
+ * @param  batch  TPBatch*  允许传入 NULL（空操作）
+ * @return void
+ */
+void tp_batch_free(TPBatch *batch) {
+    if (!batch) return;
+    path_arena_unref(batch->arena);
+    free(batch);
+}
+
 /**
  * @brief 线程池完成队列链表节点
  *
@@ -185,11 +223,7 @@ void thread_pool_destroy(ThreadPool *tp) {
     /* 清理完成队列中残留的 batch（不执行副作用，直接释放内存） */
     TPBatch *batch;
     while ((batch = thread_pool_poll_completed(tp)) != NULL) {
-        for (int i = 0; i < batch->count; i++) free(batch->paths[i]);
-        free(batch->paths);
-        free(batch->stats);
-        free(batch->results);
-        free(batch);
+        tp_batch_free(batch);
     }
     
     pthread_mutex_destroy(&tp->queue_mutex);
@@ -228,7 +262,7 @@ bool thread_pool_submit(ThreadPool *tp, TPBatch *batch) {
  * @return TPBatch*  成功返回指向已完成 batch 的指针；队列为空时返回 NULL
  *
  * @note   本函数由主线程在 epoll 收到 eventfd 通知后调用。
- *         返回的 batch 内存由调用方负责释放（包括内部的 paths、stats、results 数组）。
+ *         返回的 batch 由调用方以 tp_batch_free 释放。
  *         线程安全，内部自动加锁。
  */
 TPBatch* thread_pool_poll_completed(ThreadPool *tp) {
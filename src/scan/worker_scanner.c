@@ -3,13 +3,19 @@
  * @brief Worker 扫描引擎：目录遍历、blind-trust、批次发送与 Scanner 线程
  *
  * 包含 Worker 进程内部的扫描逻辑：
- * - scan_and_send：readdir + lstat（或 blind-trust 跳过）+ 批次发送
- * - worker_scanner_thread：Scanner 线程主循环，通过 pthread_cond 等待任务
+ * - scan_and_send：getdents64/readdir + statx（同步或 io_uring 批量，或 blind-trust 跳过）+ 批次发送；
+ *   半增量模式下目录自身未变化时直接按上次的目录清单发出子条目，不再读取目录（目录级 blind-trust）
+ * - 数据通道：有共享内存环时 BATCH 直接序列化进环，否则经 fd_data 管道发送
+ * - worker_scanner_thread：Scanner 线程主循环，通过 pthread_cond 等待任务；
+ *   --scanner-threads 个线程共享本地任务队列（worker_scanners_start / worker_scanners_join）
  * - worker_set_context：fork 前由 Master 设置只读上下文（COW）
  */
 #define _GNU_SOURCE
 #include "worker_scanner.h"
 #include "ipc_protocol.h"
+#include "dir_reader.h"
+#include "dir_index.h"
+#include "uring_stat.h"
 #include "log.h"
 #include <stdlib.h>
 #include <string.h>
@@ -17,29 +23,65 @@
 #include <stdio.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <time.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 /* Read-only context inherited via fork (COW, never modified by parent after fork) */
 static const Config *g_worker_cfg = NULL;
-static const FingerprintSet *g_worker_ref_set = NULL;
 static const ReferenceMap *g_worker_ref_map = NULL;
+static const DirIndex *g_worker_dir_index = NULL;   /* 上次任务的目录清单（目录级 blind-trust） */
+static int g_worker_dirlist_fd = -1;                /* 本次任务的目录清单写入端（O_APPEND） */
+static unsigned int g_worker_statx_mask = STATX_BASIC_STATS;
+static int g_worker_statx_sync = AT_STATX_SYNC_AS_STAT;
+static uint16_t g_worker_batch_fields = 0;  /* BATCH 记录携带的可选字段（IPC_BATCH_F_*） */
+
+/* Scanner 线程私有的 getdents64 缓冲区，跨目录复用 */
+static __thread char *t_dirent_buf = NULL;
+static __thread size_t t_dirent_buf_size = 0;
+
+/* Scanner 线程私有的 io_uring 批量 statx 实例（--uring-depth > 0 时按需创建） */
+static __thread UringStat *t_uring = NULL;
+static __thread bool t_uring_unavailable = false;
+
+/* Scanner 线程私有的目录清单构建缓冲区 */
+static __thread DirListBuilder t_dirlist;
 
 /**
  * @brief  设置 Worker 进程只读上下文（fork 前由主进程调用）
  * @param  cfg      const Config*        全局配置指针，允许为 NULL
- * @param  ref_set  const FingerprintSet* 半增量参考指纹集合指针，允许为 NULL（非半增量模式）
  * @param  ref_map  const ReferenceMap*   半增量参考映射表指针，允许为 NULL（非半增量模式）
+ * @param  dir_index   const DirIndex*   上次任务发布的目录清单，允许为 NULL（不做目录级 blind-trust）
+ * @param  dirlist_fd  int               本次任务目录清单的 O_APPEND 写入端，-1 表示不记录
+ * @param  statx_mask  unsigned int      statx 请求字段掩码（由 format_statx_mask 推导）
  * @return void
  *
  * @note   这些指针仅在 Worker 进程（fork 后的子进程）中只读访问。
  *         利用 Linux 的写时复制（COW）机制，实现零拷贝共享上下文。
+ *         dirlist_fd 由 fork 继承，Worker 关闭继承 fd 时需保留（见 worker_get_dirlist_fd）。
+ *         cfg->statx_dont_sync 为 true 时 statx 使用 AT_STATX_DONT_SYNC。
+ *         BATCH 记录只携带 statx_mask 中请求的可选字段，其余属性 Master 不会使用。
  */
-void worker_set_context(const Config *cfg, const FingerprintSet *ref_set, const ReferenceMap *ref_map) {
+void worker_set_context(const Config *cfg, const ReferenceMap *ref_map, const DirIndex *dir_index,
+                        int dirlist_fd, unsigned int statx_mask) {
     g_worker_cfg = cfg;
-    g_worker_ref_set = ref_set;
     g_worker_ref_map = ref_map;
+    g_worker_dir_index = dir_index;
+    g_worker_dirlist_fd = dirlist_fd;
+    g_worker_statx_mask = statx_mask;
+    g_worker_statx_sync = (cfg && cfg->statx_dont_sync) ? AT_STATX_DONT_SYNC : AT_STATX_SYNC_AS_STAT;
+
+    uint16_t fields = 0;
+    if (statx_mask & STATX_SIZE)  fields |= IPC_BATCH_F_SIZE;
+    if (statx_mask & STATX_UID)   fields |= IPC_BATCH_F_UID;
+    if (statx_mask & STATX_GID)   fields |= IPC_BATCH_F_GID;
+    if (statx_mask & STATX_ATIME) fields |= IPC_BATCH_F_ATIME;
+    if (statx_mask & STATX_CTIME) fields |= IPC_BATCH_F_CTIME;
+    if (statx_mask & STATX_NLINK) fields |= IPC_BATCH_F_NLINK;
+    g_worker_batch_fields = fields;
 }
 
 /**
@@ -52,6 +94,16 @@ const Config* worker_get_config(void) {
     return g_worker_cfg;
 }
 
+/**
+ * @brief  获取目录清单写入端 fd
+ * @return int  worker_set_context 设置的 fd；未记录目录清单时返回 -1
+ *
+ * @note   Worker 子进程 fork 后关闭继承 fd 时据此保留写入端。
+ */
+int worker_get_dirlist_fd(void) {
+    return g_worker_dirlist_fd;
+}
+
 /* ================================================================
  * Scan helpers
  * ================================================================ */
@@ -77,6 +129,15 @@ static mode_t dt_to_mode(unsigned char d_type) {
     }
 }
 
+/**
+ * @brief  判断条目是否因缺少链接数而不能 blind-trust
+ * @param  d_type  unsigned char  条目类型（来自 dirent 或目录清单）
+ * @return bool  返回 true 表示须实际 stat（--dedup=links 下的非目录条目）
+ */
+static inline bool trust_needs_stat(unsigned char d_type) {
+    return d_type != DT_DIR && (g_worker_statx_mask & STATX_NLINK);
+}
+
 /**
  * @brief  尝试对已知文件执行 blind-trust（跳过 lstat）
  * @param  full_path  const char*      文件绝对路径，不能为空
@@ -87,60 +148,213 @@ static mode_t dt_to_mode(unsigned char d_type) {
  * @return bool  返回 true 表示 blind-trust 成功，out_st 已填充；false 表示无法信任，需要执行 lstat
  *
  * @note   信任条件：
- *         1. 半增量模式已启用（g_worker_ref_set 和 g_worker_ref_map 均不为 NULL）
+ *         1. 半增量模式已启用（g_worker_ref_map 不为 NULL）
  *         2. d_type 和 d_ino 均有效（非 DT_UNKNOWN、非 0）
- *         3. 指纹存在于 reference_set 中
- *         4. reference_map 中存在匹配记录且 d_type 一致
- *         5. 当前时间与 mtime 的差值超过 skip_interval
+ *         3. reference_map 中存在匹配记录且 d_type 一致（一次无锁查询）
+ *         4. 当前时间与 mtime 的差值超过 skip_interval
+ *         5. 非目录条目仅在不需要链接数时信任：参考记录不含 st_nlink，
+ *            --dedup=links（statx 掩码含 NLINK）下须实际 stat 才能识别多链接文件
  *         满足以上条件时，直接用历史 mtime 构造 stat，避免 lstat 系统调用。
  */
 static bool try_blind_trust(const char *full_path, uint64_t dir_dev, uint64_t d_ino,
                             unsigned char d_type, struct stat *out_st) {
-    if (!g_worker_ref_set || !g_worker_ref_map) return false;
+    if (!g_worker_ref_map) return false;
     if (d_type == DT_UNKNOWN || d_ino == 0) return false;
+    if (trust_needs_stat(d_type)) return false;
 
     uint8_t fp[FP_SIZE];
     fp_compute(full_path, dir_dev, d_ino, fp);
 
-    if (!fp_set_contains(g_worker_ref_set, fp)) return false;
-
     const ReferenceEntry *ref = ref_map_lookup(g_worker_ref_map, fp);
-    if (!ref || ref->d_type != d_type) return false;
+    if (!ref || ref_entry_dtype(ref) != d_type) return false;
 
     time_t now = time(NULL);
+    time_t mtime = ref_entry_mtime(ref);
     if (g_worker_cfg->skip_interval <= 0) return false;
-    if (now - ref->mtime <= g_worker_cfg->skip_interval) return false;
+    if (now - mtime <= g_worker_cfg->skip_interval) return false;
 
     memset(out_st, 0, sizeof(*out_st));
     out_st->st_dev   = dir_dev;
     out_st->st_ino   = d_ino;
-    out_st->st_mtime = ref->mtime;
+    out_st->st_mtime = mtime;
     out_st->st_mode  = dt_to_mode(d_type);
     return true;
 }
 
+/**
+ * @brief  计算 BATCH 记录中可选属性字段的字节数
+ * @param  fields  uint16_t  IPC_BATCH_F_* 组合
+ * @return size_t  可选字段总字节数
+ */
+static size_t batch_opt_size(uint16_t fields) {
+    size_t n = 0;
+    if (fields & IPC_BATCH_F_SIZE)  n += sizeof(uint64_t);
+    if (fields & IPC_BATCH_F_UID)   n += sizeof(uint32_t);
+    if (fields & IPC_BATCH_F_GID)   n += sizeof(uint32_t);
+    if (fields & IPC_BATCH_F_ATIME) n += sizeof(int64_t);
+    if (fields & IPC_BATCH_F_CTIME) n += sizeof(int64_t);
+    if (fields & IPC_BATCH_F_NLINK) n += sizeof(uint32_t);
+    return n;
+}
+
+/**
+ * @brief  将单个条目的属性编码为 BATCH v2 紧凑记录（不含名字部分）
+ * @param  p       uint8_t*            输出位置，不能为空；须有 sizeof(IpcBatchStat) + batch_opt_size(fields) 字节
+ * @param  st      const struct stat*  条目属性，不能为空
+ * @param  fields  uint16_t            IPC_BATCH_F_* 组合
+ * @return uint8_t*  写入结束后的位置
+ */
+static uint8_t *batch_put_stat(uint8_t *p, const struct stat *st, uint16_t fields) {
+    IpcBatchStat bs = {
+        .dev   = (uint64_t)st->st_dev,
+        .ino   = (uint64_t)st->st_ino,
+        .mode  = (uint32_t)st->st_mode,
+        .mtime = (int64_t)st->st_mtime,
+    };
+    memcpy(p, &bs, sizeof(bs)); p += sizeof(bs);
+    if (fields & IPC_BATCH_F_SIZE) {
+        uint64_t v = (uint64_t)st->st_size;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    if (fields & IPC_BATCH_F_UID) {
+        uint32_t v = (uint32_t)st->st_uid;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    if (fields & IPC_BATCH_F_GID) {
+        uint32_t v = (uint32_t)st->st_gid;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    if (fields & IPC_BATCH_F_ATIME) {
+        int64_t v = (int64_t)st->st_atime;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    if (fields & IPC_BATCH_F_CTIME) {
+        int64_t v = (int64_t)st->st_ctime;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    if (fields & IPC_BATCH_F_NLINK) {
+        uint32_t v = (uint32_t)st->st_nlink;
+        memcpy(p, &v, sizeof(v)); p += sizeof(v);
+    }
+    return p;
+}
+
+/**
+ * @brief  经数据通道发送一条消息（调用方持有 send_mutex）
+ * @param  ctx       WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  msg_type  uint32_t          消息类型（IPC_MSG_BATCH / FINISH / STOLEN / ERROR）
+ * @param  payload   const void*       负载，允许为 NULL（当 len == 0 时）
+ * @param  len       uint32_t          负载字节数
+ * @return int  0 表示成功；-1 表示发送失败（管道断开、环已停止或负载超过环上限）
+ *
+ * @note   有共享内存环时拷入环内记录；否则写 fd_data，EAGAIN 时以 1ms 间隔重试。
+ *         所有数据消息经同一通道串行发送，Master 看到的顺序与发送顺序一致。
+ */
+static int worker_send_locked(WorkerThreadCtx *ctx, uint32_t msg_type, const void *payload, uint32_t len) {
+    if (ctx->ring) {
+        void *dst = shm_ring_reserve(ctx->ring, msg_type, len, &ctx->stop_flag);
+        if (!dst) return -1;
+        if (len > 0) memcpy(dst, payload, len);
+        shm_ring_commit(ctx->ring);
+        return 0;
+    }
+
+    int rc;
+    int retry = 0;
+    while ((rc = ipc_send(ctx->fd_data, msg_type, payload, len)) == -2) {
+        usleep(1000); /* 1ms */
+        retry++;
+        if (retry % 1000 == 0) {
+            log_warn("[W%d] data send (type=%u) EAGAIN retry %d", ctx->worker_id, msg_type, retry);
+        }
+    }
+    return rc == 0 ? 0 : -1;
+}
+
+/**
+ * @brief  将一批条目编码为 BATCH v2 负载
+ * @param  p        uint8_t*            输出位置，不能为空；须有 batch_payload_size 返回的字节数
+ * @param  dir      const char*         条目所在目录路径
+ * @param  dir_len  size_t              目录路径长度
+ * @param  paths    char**              文件完整路径数组
+ * @param  stats    const struct stat*  对应的 stat 信息数组
+ * @param  local    const uint8_t*      本地下探标记数组，允许为 NULL
+ * @param  count    int                 条目数
+ * @param  fields   uint16_t            IPC_BATCH_F_* 组合
+ * @return void
+ */
+static void batch_encode(uint8_t *p, const char *dir, size_t dir_len, char **paths,
+                         const struct stat *stats, const uint8_t *local, int count, uint16_t fields) {
+    size_t name_off = dir_len + 1;
+    IpcBatchHeader bh = { IPC_BATCH_VERSION, fields, (uint32_t)count, (uint32_t)dir_len };
+    memcpy(p, &bh, sizeof(bh)); p += sizeof(bh);
+    if (dir_len > 0) {
+        memcpy(p, dir, dir_len); p += dir_len;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const char *name = paths[i] + name_off;
+        uint16_t nlen = (uint16_t)strlen(name);
+        uint16_t wire_len = (local && local[i]) ? (uint16_t)(nlen | IPC_BATCH_LOCAL) : nlen;
+        memcpy(p, &wire_len, sizeof(wire_len)); p += sizeof(wire_len);
+        memcpy(p, name, nlen);                  p += nlen;
+        p = batch_put_stat(p, &stats[i], fields);
+    }
+}
+
 /**
  * @brief  向 Master 发送一批扫描结果
- * @param  fd_out  int            输出文件描述符（指向 Master 的 fd_out），取值范围: >= 0 的可写 fd
- * @param  paths   char**         文件路径字符串数组，允许为 NULL（当 count == 0 时）
- * @param  stats   struct stat*   对应的 stat 信息数组，允许为 NULL（当 count == 0 时）
- * @param  count   int            本次批次中的文件数量，取值范围: >= 0
+ * @param  ctx      WorkerThreadCtx*  Worker 线程上下文（经 ctx->ring 或 ctx->fd_data 发送），不能为空
+ * @param  dir      const char*    条目所在目录路径，允许为 NULL（当 count == 0 时）
+ * @param  dir_len  size_t         目录路径长度；paths[i] 形如 dir + "/" + name
+ * @param  paths    char**         文件完整路径数组，允许为 NULL（当 count == 0 时）
+ * @param  stats    struct stat*   对应的 stat 信息数组，允许为 NULL（当 count == 0 时）
+ * @param  local    const uint8_t* 本地下探标记数组，允许为 NULL；非 0 的条目在 name_len 上置 IPC_BATCH_LOCAL
+ * @param  count    int            本次批次中的文件数量，取值范围: >= 0
  * @return void
  *
  * @note   即使 count == 0 也会发送空批次，确保 Master 的 pending_tasks 正确递减。
- *         负载格式：IpcBatchHeader + count * ([uint32_t plen][char path[plen]][struct stat st])。
- *         Worker 侧遇到 EAGAIN 时以 1ms 间隔重试，直至成功。
- *         若内存分配失败，递归发送空批次防止 Master 挂起。
+ *         负载格式（v2）：IpcBatchHeader + dir + count * ([uint16_t nlen][name][IpcBatchStat][可选字段])，
+ *         目录路径只出现一次，每条记录只带 d_name 与本次运行需要的属性。
+ *         有共享内存环时直接序列化进环内记录，不经中间缓冲；超过单条记录上限时对半拆分。
+ *         管道模式遇到 EAGAIN 时以 1ms 间隔重试；若内存分配失败，递归发送空批次防止 Master 挂起。
  */
-static void send_batch(int fd_out, char **paths, struct stat *stats, int count) {
+static void send_batch(WorkerThreadCtx *ctx, const char *dir, size_t dir_len,
+                       char **paths, struct stat *stats, const uint8_t *local, int count) {
     /* Always send a batch (even count==0) so Master can decrement pending_tasks */
+    if (count == 0) dir_len = 0;
+    uint16_t fields = g_worker_batch_fields;
+    size_t rec_fixed = sizeof(uint16_t) + sizeof(IpcBatchStat) + batch_opt_size(fields);
+    size_t name_off = dir_len + 1;
 
     /* Calculate total payload size */
-    size_t total = sizeof(IpcBatchHeader);
+    size_t total = sizeof(IpcBatchHeader) + dir_len;
     for (int i = 0; i < count; i++) {
-        total += sizeof(uint32_t);
-        total += strlen(paths[i]);
-        total += sizeof(struct stat);
+        total += rec_fixed + strlen(paths[i] + name_off);
+    }
+
+    if (ctx->ring) {
+        if (total > shm_ring_max_payload(ctx->ring) && count > 1) {
+            int half = count / 2;
+            send_batch(ctx, dir, dir_len, paths, stats, local, half);
+            send_batch(ctx, dir, dir_len, paths + half, stats + half, local ? local + half : NULL, count - half);
+            return;
+        }
+        pthread_mutex_lock(&ctx->send_mutex);
+        void *dst = (total <= UINT32_MAX)
+                  ? shm_ring_reserve(ctx->ring, IPC_MSG_BATCH, (uint32_t)total, &ctx->stop_flag)
+                  : NULL;
+        if (dst) {
+            batch_encode(dst, dir, dir_len, paths, stats, local, count, fields);
+            shm_ring_commit(ctx->ring);
+        }
+        pthread_mutex_unlock(&ctx->send_mutex);
+        if (!dst) {
+            log_error("[Worker] send_batch to ring FAILED (total=%zu)", total);
+        } else {
+            log_debug("[Worker] send_batch OK (ring, total=%zu)", total);
+        }
+        return;
     }
 
     if (total > UINT32_MAX) {
@@ -151,26 +365,16 @@ static void send_batch(int fd_out, char **paths, struct stat *stats, int count)
     uint8_t *buf = malloc(total);
     if (!buf) {
         /* 内存不足时发送空 batch，确保 Master 能正确递减 pending_tasks */
-        send_batch(fd_out, NULL, NULL, 0);
+        send_batch(ctx, NULL, 0, NULL, NULL, NULL, 0);
         return;
     }
 
-    uint8_t *p = buf;
-    IpcBatchHeader bh = { (uint32_t)count };
-    memcpy(p, &bh, sizeof(bh)); p += sizeof(bh);
-
-    for (int i = 0; i < count; i++) {
-        uint32_t plen = (uint32_t)strlen(paths[i]);
-        memcpy(p, &plen, sizeof(plen)); p += sizeof(plen);
-        memcpy(p, paths[i], plen);      p += plen;
-        memcpy(p, &stats[i], sizeof(struct stat)); p += sizeof(struct stat);
-    }
+    batch_encode(buf, dir, dir_len, paths, stats, local, count, fields);
 
     /* Worker side: retry on EAGAIN until success (pipe buffer should be large enough) */
-    int rc;
-    while ((rc = ipc_send(fd_out, IPC_MSG_BATCH, buf, (uint32_t)total)) == -2) {
-        usleep(1000); /* 1ms */
-    }
+    pthread_mutex_lock(&ctx->send_mutex);
+    int rc = worker_send_locked(ctx, IPC_MSG_BATCH, buf, (uint32_t)total);
+    pthread_mutex_unlock(&ctx->send_mutex);
     if (rc != 0) {
         log_error("[Worker] send_batch FAILED (rc=%d, total=%zu)", rc, total);
     } else {
@@ -181,7 +385,7 @@ static void send_batch(int fd_out, char **paths, struct stat *stats, int count)
 
 /**
  * @brief  发送设备级错误通知并追加空批次
- * @param  fd_out    int          输出文件描述符，取值范围: >= 0 的可写 fd
+ * @param  ctx       WorkerThreadCtx*  Worker 线程上下文，不能为空
  * @param  err_code  int          错误码，取值范围: ETIMEDOUT(110)、EIO(5) 等系统 errno
  * @param  path      const char*  发生错误的文件/目录路径，不能为空
  * @return void
@@ -189,7 +393,7 @@ static void send_batch(int fd_out, char **paths, struct stat *stats, int count)
  * @note   仅在 err_code 为 ETIMEDOUT 或 EIO 时发送 IPC_MSG_ERROR，
  *         其他错误码仅发送空批次。空批次确保 Master 正确递减 pending_tasks。
  */
-static void send_error_and_empty_batch(int fd_out, int err_code, const char *path) {
+static void send_error_and_empty_batch(WorkerThreadCtx *ctx, int err_code, const char *path) {
     if (err_code == ETIMEDOUT || err_code == EIO) {
         IpcErrorHeader eh = { (uint32_t)err_code, 0 };
         uint32_t plen = (uint32_t)strlen(path);
@@ -198,32 +402,404 @@ static void send_error_and_empty_batch(int fd_out, int err_code, const char *pat
             memcpy(buf, &eh, sizeof(eh));
             memcpy(buf + sizeof(eh), &plen, sizeof(plen));
             memcpy(buf + sizeof(eh) + sizeof(plen), path, plen);
-            ipc_send(fd_out, IPC_MSG_ERROR, buf, (uint32_t)(sizeof(eh) + sizeof(plen) + plen));
+            pthread_mutex_lock(&ctx->send_mutex);
+            worker_send_locked(ctx, IPC_MSG_ERROR, buf, (uint32_t)(sizeof(eh) + sizeof(plen) + plen));
+            pthread_mutex_unlock(&ctx->send_mutex);
             free(buf);
         }
     }
-    send_batch(fd_out, NULL, NULL, 0);
+    send_batch(ctx, NULL, 0, NULL, NULL, NULL, 0);
+}
+
+/**
+ * @brief  将 statx 结果转换为 struct stat
+ * @param  stx  const struct statx*  statx 结果，不能为空
+ * @param  st   struct stat*         输出缓冲区，不能为空；未请求的字段由内核置 0
+ * @return void
+ */
+static void statx_to_stat(const struct statx *stx, struct stat *st) {
+    memset(st, 0, sizeof(*st));
+    st->st_dev   = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    st->st_ino   = stx->stx_ino;
+    st->st_mode  = stx->stx_mode;
+    st->st_nlink = stx->stx_nlink;
+    st->st_uid   = stx->stx_uid;
+    st->st_gid   = stx->stx_gid;
+    st->st_rdev  = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    st->st_size  = (off_t)stx->stx_size;
+    st->st_blksize = stx->stx_blksize;
+    st->st_blocks  = (blkcnt_t)stx->stx_blocks;
+    st->st_atim.tv_sec  = stx->stx_atime.tv_sec;
+    st->st_atim.tv_nsec = stx->stx_atime.tv_nsec;
+    st->st_mtim.tv_sec  = stx->stx_mtime.tv_sec;
+    st->st_mtim.tv_nsec = stx->stx_mtime.tv_nsec;
+    st->st_ctim.tv_sec  = stx->stx_ctime.tv_sec;
+    st->st_ctim.tv_nsec = stx->stx_ctime.tv_nsec;
+}
+
+/**
+ * @brief  相对目录 fd 获取条目属性（statx 按掩码请求，内核不支持时回退 fstatat）
+ * @param  dirfd  int           已打开目录的 fd
+ * @param  name   const char*   条目名（d_name），不能为空
+ * @param  flags  int           0 或 AT_SYMLINK_NOFOLLOW
+ * @param  st     struct stat*  输出缓冲区，不能为空；未请求的字段置 0
+ * @return int  0 表示成功；-1 表示失败（errno 有效）
+ */
+static int stat_entry_at(int dirfd, const char *name, int flags, struct stat *st) {
+    /* 多个 Scanner 线程并发读写：relaxed 即可，最坏多试一次 statx */
+    static _Atomic bool statx_unsupported = false;
+
+    if (!atomic_load_explicit(&statx_unsupported, memory_order_relaxed)) {
+        struct statx stx;
+        if (statx(dirfd, name, flags | g_worker_statx_sync, g_worker_statx_mask, &stx) == 0) {
+            statx_to_stat(&stx, st);
+            return 0;
+        }
+        if (errno != ENOSYS) return -1;
+        atomic_store_explicit(&statx_unsupported, true, memory_order_relaxed);
+    }
+    return fstatat(dirfd, name, st, flags);
+}
+
+/* ================================================================
+ * io_uring batched statx
+ * ================================================================ */
+
+/* 待 stat 条目：先以路径占位进批次数组，批次满或目录结束时统一提交 */
+typedef struct {
+    int *idx;               /* 在批次数组中的下标 */
+    const char **names;     /* 条目名（指向 paths[idx] 中的 d_name 部分） */
+    struct statx *stx;
+    int *res;
+    int count;
+} PendingStats;
+
+/**
+ * @brief  获取当前 Scanner 线程的 io_uring 实例（首次调用时按 --uring-depth 创建）
+ * @return UringStat*  实例指针；未启用或 io_uring 不可用时返回 NULL（走同步 statx）
+ */
+static UringStat *get_uring(void) {
+    if (t_uring || t_uring_unavailable) return t_uring;
+    int depth = g_worker_cfg ? g_worker_cfg->uring_depth : 0;
+    if (depth > 0) {
+        t_uring = uring_stat_create((unsigned)depth);
+        if (!t_uring) log_info("[Worker] io_uring statx unavailable, using synchronous statx");
+    }
+    if (!t_uring) t_uring_unavailable = true;
+    return t_uring;
+}
+
+/**
+ * @brief  提交全部待 stat 条目，结果直接写入批次数组，并剔除失败条目
+ * @param  ps     PendingStats*  待处理集合，不能为空；返回后清空
+ * @param  dirfd  int            目录 fd
+ * @param  flags  int            0 或 AT_SYMLINK_NOFOLLOW
+ * @param  paths  char**         批次路径数组（失败条目在此释放并移除）
+ * @param  stats  struct stat*   批次 stat 数组
+ * @param  count  int            批次当前条数
+ * @return int  剔除失败条目后的批次条数
+ *
+ * @note   io_uring 提交本身失败时销毁实例并逐条回退同步 statx，本线程后续不再使用 io_uring。
+ */
+static int flush_pending_stats(PendingStats *ps, int dirfd, int flags,
+                               char **paths, struct stat *stats, int count) {
+    if (ps->count == 0) return count;
+
+    int rc = -1;
+    if (t_uring) {
+        rc = uring_stat_batch(t_uring, dirfd, ps->names, ps->count,
+                              flags | g_worker_statx_sync, g_worker_statx_mask, ps->stx, ps->res);
+        if (rc != 0) {
+            uring_stat_destroy(t_uring);
+            t_uring = NULL;
+            t_uring_unavailable = true;
+        }
+    }
+
+    for (int j = 0; j < ps->count; j++) {
+        int i = ps->idx[j];
+        bool ok;
+        if (rc == 0) {
+            ok = (ps->res[j] == 0);
+            if (ok) statx_to_stat(&ps->stx[j], &stats[i]);
+        } else {
+            ok = (stat_entry_at(dirfd, ps->names[j], flags, &stats[i]) == 0);
+        }
+        if (!ok) {
+            free(paths[i]);
+            paths[i] = NULL;
+        }
+    }
+    ps->count = 0;
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (!paths[i]) continue;
+        if (kept != i) {
+            paths[kept] = paths[i];
+            stats[kept] = stats[i];
+        }
+        kept++;
+    }
+    return kept;
+}
+
+/**
+ * @brief  获取当前 Scanner 线程的 getdents64 缓冲区（首次调用时按配置分配）
+ * @param  out_size  size_t*  输出缓冲区容量，不能为空
+ * @return char*  缓冲区指针；配置为 0 或分配失败时返回 NULL（调用方退化为 readdir）
+ */
+static char *get_dirent_buffer(size_t *out_size) {
+    size_t want = g_worker_cfg ? g_worker_cfg->dirent_buffer : DEFAULT_DIRENT_BUFFER;
+    if (want == 0) {
+        *out_size = 0;
+        return NULL;
+    }
+    if (!t_dirent_buf) {
+        t_dirent_buf = malloc(want);
+        if (!t_dirent_buf) {
+            log_warn("[Worker] dirent buffer alloc failed (%zu bytes), falling back to readdir", want);
+            *out_size = 0;
+            return NULL;
+        }
+        t_dirent_buf_size = want;
+    }
+    *out_size = t_dirent_buf_size;
+    return t_dirent_buf;
+}
+
+/* ================================================================
+ * Local subtree descent
+ * ================================================================ */
+
+/**
+ * @brief  向本地下探队列尾部追加一个子目录（调用方持有 task_mutex）
+ * @param  ctx    WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  path   char*             malloc 分配的目录路径，成功时所有权转移
+ * @param  root   WorkerTaskRoot*   所属根任务
+ * @param  depth  int               相对根任务的深度
+ * @param  dev    uint64_t          目录所在设备号
+ * @return bool  返回 true 表示入队成功；false 表示扩容失败
+ */
+static bool local_push_locked(WorkerThreadCtx *ctx, char *path, WorkerTaskRoot *root, int depth,
+                              uint64_t dev) {
+    if (ctx->local_count == ctx->local_capacity) {
+        int new_cap = ctx->local_capacity ? ctx->local_capacity * 2 : 64;
+        WorkerLocalDir *q = malloc((size_t)new_cap * sizeof(WorkerLocalDir));
+        if (!q) return false;
+        for (int i = 0; i < ctx->local_count; i++) {
+            q[i] = ctx->local[(ctx->local_head + i) % ctx->local_capacity];
+        }
+        free(ctx->local);
+        ctx->local = q;
+        ctx->local_head = 0;
+        ctx->local_capacity = new_cap;
+    }
+    WorkerLocalDir *d = &ctx->local[(ctx->local_head + ctx->local_count) % ctx->local_capacity];
+    d->path = path;
+    d->root = root;
+    d->depth = depth;
+    d->dev = dev;
+    ctx->local_count++;
+    return true;
+}
+
+/**
+ * @brief  从本批次中挑出可在本地继续下探的子目录
+ * @param  ctx      WorkerThreadCtx*       Worker 线程上下文，不能为空
+ * @param  item     const WorkerLocalDir*  当前正在扫描的目录
+ * @param  paths    char**                 批次路径数组
+ * @param  stats    const struct stat*     批次 stat 数组
+ * @param  local    uint8_t*               输出：被本地认领的条目置 1
+ * @param  count    int                    批次条数
+ * @param  dir_dev  uint64_t               当前目录设备号
+ * @return void
+ *
+ * @note   只认领与父目录同设备的真实目录：跨设备的目录交回 Master，保留按设备的
+ *         超时/黑名单管理；--follow-symlinks 时 stat 跟随链接，无法区分目录链接，
+ *         由调用方整体关闭本地下探。根任务累计条目超过 --local-entries 后停止认领。
+ *         当前目录位于 Master 已裁剪（PRUNE）的子树内时不认领，Master 会整批丢弃其条目。
+ */
+static void claim_subdirs(WorkerThreadCtx *ctx, const WorkerLocalDir *item, char **paths,
+                          const struct stat *stats, uint8_t *local, int count, uint64_t dir_dev) {
+    long budget = g_worker_cfg->local_entries;
+    bool claimed = false;
+
+    pthread_mutex_lock(&ctx->task_mutex);
+    item->root->entries += count;
+    bool pruned = ctx->pruned && fp_set_contains_path_prefix(ctx->pruned, item->path, strlen(item->path),
+                                                             strlen(item->root->path));
+    for (int i = 0; i < count; i++) {
+        local[i] = 0;
+        if (pruned) continue;
+        if (!S_ISDIR(stats[i].st_mode) || (uint64_t)stats[i].st_dev != dir_dev) continue;
+        if (item->root->entries > budget) continue;
+        char *dup = strdup(paths[i]);
+        if (!dup || !local_push_locked(ctx, dup, item->root, item->depth + 1, (uint64_t)stats[i].st_dev)) {
+            free(dup);
+            continue;
+        }
+        item->root->refs++;
+        local[i] = 1;
+        claimed = true;
+    }
+    if (claimed) pthread_cond_signal(&ctx->task_cond);
+    pthread_mutex_unlock(&ctx->task_mutex);
+}
+
+/* ================================================================
+ * Directory-level blind trust
+ * ================================================================ */
+
+/**
+ * @brief  发送一批条目：认领本地子目录、追加到目录清单、发送并释放路径
+ * @param  ctx         WorkerThreadCtx*       Worker 线程上下文，不能为空
+ * @param  item        const WorkerLocalDir*  当前目录
+ * @param  paths       char**                 批次路径数组，发送后逐条释放
+ * @param  stats       struct stat*           批次 stat 数组
+ * @param  local       uint8_t*               本地下探标记数组，NULL 表示不下探
+ * @param  count       int                    批次条数（> 0）
+ * @param  dir_dev     uint64_t               当前目录设备号
+ * @param  prefix_len  size_t                 目录前缀长度（含末尾 '/'）
+ * @param  listing     bool                   是否把条目追加到 t_dirlist
+ * @return void
+ */
+static void send_dir_batch(WorkerThreadCtx *ctx, const WorkerLocalDir *item, char **paths,
+                           struct stat *stats, uint8_t *local, int count,
+                           uint64_t dir_dev, size_t prefix_len, bool listing) {
+    if (local) claim_subdirs(ctx, item, paths, stats, local, count, dir_dev);
+    if (listing) {
+        for (int i = 0; i < count; i++) {
+            dir_list_add(&t_dirlist, paths[i] + prefix_len, strlen(paths[i] + prefix_len),
+                         IFTODT(stats[i].st_mode), stats[i].st_ino, stats[i].st_mtime);
+        }
+    }
+    send_batch(ctx, item->path, prefix_len - 1, paths, stats, local, count);
+    for (int i = 0; i < count; i++) free(paths[i]);
+}
+
+/**
+ * @brief  判断目录能否整体信任上次的目录清单（跳过 opendir/getdents）
+ * @param  dir_path  const char*         目录路径，不能为空
+ * @param  dir_st    const struct stat*  本次 lstat 结果，不能为空
+ * @return const DirListHeader*  可信任时返回清单记录；否则返回 NULL
+ *
+ * @note   信任条件：
+ *         1. 半增量模式且已载入目录清单，未启用 --follow-symlinks
+ *         2. 清单中存在该目录（指纹含路径、设备号、inode），且记录的 mtime、ctime 与本次 lstat 一致
+ *         3. 当前时间与目录 mtime 的差值超过 skip_interval
+ *         目录增删、重命名子条目都会更新目录 mtime，mtime/ctime 未变说明成员集合未变。
+ */
+static const DirListHeader *try_dir_trust(const char *dir_path, const struct stat *dir_st) {
+    if (!g_worker_dir_index || g_worker_cfg->follow_symlinks) return NULL;
+    if (g_worker_cfg->skip_interval <= 0) return NULL;
+    if (time(NULL) - dir_st->st_mtime <= g_worker_cfg->skip_interval) return NULL;
+
+    uint8_t fp[FP_SIZE];
+    fp_compute(dir_path, dir_st->st_dev, dir_st->st_ino, fp);
+    const DirListHeader *hdr = dir_index_lookup(g_worker_dir_index, fp);
+    if (!hdr || hdr->mtime != (int64_t)dir_st->st_mtime || hdr->ctime != (int64_t)dir_st->st_ctime)
+        return NULL;
+    return hdr;
+}
+
+/**
+ * @brief  按目录清单发出子条目（目录级 blind-trust）
+ * @param  ctx         WorkerThreadCtx*       Worker 线程上下文，不能为空
+ * @param  item        const WorkerLocalDir*  当前目录
+ * @param  hdr         const DirListHeader*   上次的目录清单记录
+ * @param  paths       char**                 批次路径数组（容量 batch_size）
+ * @param  stats       struct stat*           批次 stat 数组（容量 batch_size）
+ * @param  local       uint8_t*               本地下探标记数组，允许为 NULL
+ * @param  batch_size  int                    批次容量
+ * @param  dir_dev     uint64_t               当前目录设备号
+ * @param  listing     bool                   是否为本次任务重写目录清单
+ * @return int  发出的条目数
+ *
+ * @note   子条目 mtime 早于 skip_interval 时与 try_blind_trust 相同，直接以清单中的
+ *         (dev, ino, mtime, d_type) 构造 stat；较新的子条目（及 --dedup=links 下的非目录子条目）相对目录 fd 执行 statx 取得完整属性
+ *         （目录 fd 以 O_PATH 在首个需要 stat 的子条目处打开，打开失败时退回完整路径），
+ *         已消失的子条目被跳过。
+ */
+static int scan_from_listing(WorkerThreadCtx *ctx, const WorkerLocalDir *item,
+                             const DirListHeader *hdr, char **paths, struct stat *stats,
+                             uint8_t *local, int batch_size, uint64_t dir_dev, bool listing) {
+    char full_path[4096];
+    size_t prefix_len = strlen(item->path);
+    if (prefix_len + 1 >= sizeof(full_path)) return 0;
+    memcpy(full_path, item->path, prefix_len);
+    full_path[prefix_len++] = '/';
+    int stat_flags = AT_SYMLINK_NOFOLLOW;
+    time_t now = time(NULL);
+    int dirfd = -1;
+    bool dirfd_tried = false;
+
+    DirListChild child;
+    size_t pos = 0;
+    int count = 0, sent = 0;
+    while (dir_list_next(hdr, &pos, &child)) {
+        if (prefix_len + child.name_len >= sizeof(full_path)) continue;
+        memcpy(full_path + prefix_len, child.name, child.name_len);
+        full_path[prefix_len + child.name_len] = '\0';
+
+        struct stat *st = &stats[count];
+        if (child.d_type != DT_UNKNOWN && child.ino != 0 && !trust_needs_stat(child.d_type) &&
+            now - child.mtime > g_worker_cfg->skip_interval) {
+            memset(st, 0, sizeof(*st));
+            st->st_dev   = dir_dev;
+            st->st_ino   = child.ino;
+            st->st_mtime = child.mtime;
+            st->st_mode  = dt_to_mode(child.d_type);
+        } else {
+            if (!dirfd_tried) {
+                dirfd = open(item->path, O_RDONLY | O_DIRECTORY | O_PATH | O_CLOEXEC);
+                dirfd_tried = true;
+            }
+            int rc = dirfd >= 0 ? stat_entry_at(dirfd, full_path + prefix_len, stat_flags, st)
+                                : stat_entry_at(AT_FDCWD, full_path, stat_flags, st);
+            if (rc != 0) continue;
+        }
+        paths[count++] = strdup(full_path);
+
+        if (count >= batch_size) {
+            send_dir_batch(ctx, item, paths, stats, local, count, dir_dev, prefix_len, listing);
+            sent += count;
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        send_dir_batch(ctx, item, paths, stats, local, count, dir_dev, prefix_len, listing);
+        sent += count;
+    }
+    if (dirfd >= 0) close(dirfd);
+    return sent;
 }
 
 /**
  * @brief  扫描单个目录并将结果批次发送回 Master
- * @param  fd_out     int          输出文件描述符，取值范围: >= 0 的可写 fd
- * @param  dir_path   const char*  要扫描的目录路径，不能为空
- * @param  worker_id  int          Worker 编号（当前未使用，保留用于日志），取值范围: >= 0
+ * @param  ctx   WorkerThreadCtx*       Worker 线程上下文（fd_data、worker_id 与本地下探队列），不能为空
+ * @param  item  const WorkerLocalDir*  要扫描的目录及其根任务、深度，不能为空
  * @return void
  *
- * @note   先对目录本身执行 lstat 获取设备号；然后 opendir/readdir 遍历条目。
- *         对每个条目：跳过 . 和 ..；尝试 blind-trust；失败则执行 lstat/stat；
+ * @note   先对目录本身执行 lstat 获取设备号；然后通过 DirReader（getdents64 大缓冲区）遍历条目。
+ *         对每个条目：跳过 . 和 ..；尝试 blind-trust；失败则相对目录 fd 执行
+ *         statx(AT_SYMLINK_NOFOLLOW)，仅请求格式所需字段（--follow-symlinks 时跟随链接）；
+ *         启用 --uring-depth 时条目先占位入批次，批次满时以 io_uring 批量提交 statx；
  *         收集到 batch_size 条后发送批次；遍历结束后发送剩余批次（或空批次）。
+ *         每批发送前由 claim_subdirs 认领可本地下探的子目录，并在批次中打上 IPC_BATCH_LOCAL 标记。
  *         若 opendir 或 lstat 失败，发送错误通知和空批次。
+ *         目录自身可信（try_dir_trust）时不打开目录，由 scan_from_listing 按上次的目录清单发出子条目。
+ *         记录目录清单时，完整读完的目录以一次 write() 追加一条清单记录；mtime/ctime 距今不足
+ *         2 秒的目录不记录，避免同一秒内的后续修改被秒级时间戳掩盖。
  */
-static void scan_and_send(int fd_out, const char *dir_path, int worker_id) {
-    (void)worker_id;
+static void scan_and_send(WorkerThreadCtx *ctx, const WorkerLocalDir *item) {
+    int worker_id = ctx->worker_id;
+    const char *dir_path = item->path;
     log_debug("[W%d-Scanner] scan_and_send entered: %s", worker_id, dir_path);
     struct stat dir_st;
     if (lstat(dir_path, &dir_st) != 0) {
         log_warn("[W%d-Scanner] lstat failed on %s: %s", worker_id, dir_path, strerror(errno));
-        send_error_and_empty_batch(fd_out, errno, dir_path);
+        send_error_and_empty_batch(ctx, errno, dir_path);
         return;
     }
 
@@ -236,81 +812,361 @@ static void scan_and_send(int fd_out, const char *dir_path, int worker_id) {
     struct stat *stats = calloc(batch_size, sizeof(struct stat));
     int count = 0;
 
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
+    /* 本地下探：深度未达上限时，同设备子目录直接进入本 Worker 的队列 */
+    uint8_t *local = NULL;
+    if (g_worker_cfg && !g_worker_cfg->follow_symlinks && item->depth < g_worker_cfg->local_depth) {
+        local = calloc(batch_size, 1);
+    }
+
+    /* 目录清单：仅记录已静止的目录（--follow-symlinks 时条目属性来自链接目标，不记录） */
+    time_t dir_changed = dir_st.st_mtime > dir_st.st_ctime ? dir_st.st_mtime : dir_st.st_ctime;
+    bool listing = g_worker_dirlist_fd >= 0 && g_worker_cfg && !g_worker_cfg->follow_symlinks &&
+                   time(NULL) - dir_changed >= 2;
+    if (listing) {
+        uint8_t dir_fp[FP_SIZE];
+        fp_compute(dir_path, dir_st.st_dev, dir_st.st_ino, dir_fp);
+        dir_list_begin(&t_dirlist, dir_fp, dir_st.st_mtime, dir_st.st_ctime);
+    }
+
+    const DirListHeader *trusted = g_worker_cfg ? try_dir_trust(dir_path, &dir_st) : NULL;
+    if (trusted) {
+        int sent = scan_from_listing(ctx, item, trusted, paths, stats, local, batch_size, dir_dev, listing);
+        log_debug("[W%d-Scanner] dir trusted, readdir skipped: %s (entries=%d)", worker_id, dir_path, sent);
+        if (sent == 0) send_batch(ctx, NULL, 0, NULL, NULL, NULL, 0);
+        if (listing) dir_list_write(&t_dirlist, g_worker_dirlist_fd);
+        goto cleanup;
+    }
+
+    size_t dirent_buf_size = 0;
+    char *dirent_buf = get_dirent_buffer(&dirent_buf_size);
+
+    DirReader reader;
+    if (dir_reader_open(&reader, dir_path, dirent_buf, dirent_buf_size) != 0) {
         log_warn("[W%d-Scanner] opendir failed on %s: %s", worker_id, dir_path, strerror(errno));
-        send_error_and_empty_batch(fd_out, errno, dir_path);
+        send_error_and_empty_batch(ctx, errno, dir_path);
         goto cleanup;
     }
     log_debug("[W%d-Scanner] opendir success: %s", worker_id, dir_path);
 
-    struct dirent *entry;
+    /* 目录前缀只拼接一次，逐条目仅追加 d_name；stat 走 dirfd 相对路径，避免内核重复解析整条路径 */
+    char full_path[4096];
+    size_t prefix_len = strlen(dir_path);
+    if (prefix_len + 1 < sizeof(full_path)) {
+        memcpy(full_path, dir_path, prefix_len);
+        full_path[prefix_len++] = '/';
+    } else {
+        prefix_len = sizeof(full_path); /* 目录路径超长：所有条目都将被跳过 */
+    }
+    int stat_flags = (g_worker_cfg && g_worker_cfg->follow_symlinks) ? 0 : AT_SYMLINK_NOFOLLOW;
+
+    PendingStats pending = { 0 };
+    if (get_uring()) {
+        pending.idx   = malloc(batch_size * sizeof(int));
+        pending.names = malloc(batch_size * sizeof(char *));
+        pending.stx   = malloc(batch_size * sizeof(struct statx));
+        pending.res   = malloc(batch_size * sizeof(int));
+        if (!pending.idx || !pending.names || !pending.stx || !pending.res) {
+            free(pending.idx); free(pending.names); free(pending.stx); free(pending.res);
+            memset(&pending, 0, sizeof(pending));
+        }
+    }
+    bool use_uring = (pending.idx != NULL);
+
+    DirEntry entry;
     int entry_count = 0;
-    while ((entry = readdir(dir)) != NULL) {
+    int rd;
+    while ((rd = dir_reader_next(&reader, &entry)) > 0) {
         entry_count++;
-        if (entry->d_name[0] == '.' &&
-            (entry->d_name[1] == '\0' || (entry->d_name[1] == '.' && entry->d_name[2] == '\0'))) {
+        if (entry.name[0] == '.' &&
+            (entry.name[1] == '\0' || (entry.name[1] == '.' && entry.name[2] == '\0'))) {
             continue;
         }
 
-        char full_path[4096];
-        int n = snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, entry->d_name);
-        if (n >= (int)sizeof(full_path)) continue;
+        size_t name_len = strlen(entry.name);
+        if (prefix_len + name_len >= sizeof(full_path)) continue;
+        memcpy(full_path + prefix_len, entry.name, name_len + 1);
 
         struct stat st;
-        bool got = false;
-
-        if (try_blind_trust(full_path, dir_dev, entry->d_ino, entry->d_type, &st)) {
-            got = true;
+        if (try_blind_trust(full_path, dir_dev, entry.ino, entry.type, &st)) {
+            paths[count] = strdup(full_path);
+            stats[count] = st;
+            count++;
+        } else if (use_uring) {
+            /* 占位：路径先入批次，statx 结果在 flush 时直接回填 stats[count] */
+            paths[count] = strdup(full_path);
+            pending.idx[pending.count] = count;
+            pending.names[pending.count] = paths[count] + prefix_len;
+            pending.count++;
+            count++;
         } else {
-            if (g_worker_cfg && g_worker_cfg->follow_symlinks) {
-                if (stat(full_path, &st) != 0) continue;
-            } else {
-                if (lstat(full_path, &st) != 0) continue;
-            }
-            got = true;
-        }
-
-        if (got) {
+            if (stat_entry_at(reader.fd, entry.name, stat_flags, &st) != 0) continue;
             paths[count] = strdup(full_path);
             stats[count] = st;
             count++;
         }
 
         if (count >= batch_size) {
-            send_batch(fd_out, paths, stats, count);
-            for (int i = 0; i < count; i++) free(paths[i]);
+            count = flush_pending_stats(&pending, reader.fd, stat_flags, paths, stats, count);
+            send_dir_batch(ctx, item, paths, stats, local, count, dir_dev, prefix_len, listing);
             count = 0;
         }
     }
 
+    if (rd < 0) {
+        log_warn("[W%d-Scanner] getdents failed on %s: %s", worker_id, dir_path, strerror(errno));
+    }
+    count = flush_pending_stats(&pending, reader.fd, stat_flags, paths, stats, count);
+
     if (count > 0) {
         log_debug("[W%d-Scanner] sending final batch (count=%d)", worker_id, count);
-        send_batch(fd_out, paths, stats, count);
-        for (int i = 0; i < count; i++) free(paths[i]);
+        send_dir_batch(ctx, item, paths, stats, local, count, dir_dev, prefix_len, listing);
     } else {
         /* Empty directory: send empty batch so Master decrements pending_tasks */
         log_debug("[W%d-Scanner] empty dir, sending empty batch", worker_id);
-        send_batch(fd_out, NULL, NULL, 0);
+        send_batch(ctx, NULL, 0, NULL, NULL, NULL, 0);
     }
+    /* getdents 中途出错时成员集合不完整，不记录清单 */
+    if (listing && rd == 0) dir_list_write(&t_dirlist, g_worker_dirlist_fd);
 
     log_debug("[W%d-Scanner] readdir loop done (entries=%d)", worker_id, entry_count);
-    closedir(dir);
+    dir_reader_close(&reader);
+    free(pending.idx);
+    free(pending.names);
+    free(pending.stx);
+    free(pending.res);
 cleanup:
     free(paths);
     free(stats);
+    free(local);
+}
+
+/* ================================================================
+ * Worker-local task queue (credit window)
+ * ================================================================ */
+
+/**
+ * @brief  将 SCAN 目录加入 Worker 本地队列并唤醒 Scanner 线程
+ * @param  ctx   WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  path  char*             malloc 分配的目录路径，成功时所有权转移给队列
+ * @return bool  返回 true 表示已入队；false 表示扩容失败（调用方负责释放 path）
+ *
+ * @note   Master 按 --worker-credits 限制每个 Worker 的在途任务数，
+ *         因此队列长度有上界；扩容按 2 倍增长并把环形区间展开到新数组头部。
+ */
+bool worker_task_push(WorkerThreadCtx *ctx, char *path) {
+    pthread_mutex_lock(&ctx->task_mutex);
+    if (ctx->task_count == ctx->task_capacity) {
+        int new_cap = ctx->task_capacity ? ctx->task_capacity * 2 : 8;
+        char **q = malloc((size_t)new_cap * sizeof(char *));
+        if (!q) {
+            pthread_mutex_unlock(&ctx->task_mutex);
+            return false;
+        }
+        for (int i = 0; i < ctx->task_count; i++) {
+            q[i] = ctx->task_queue[(ctx->task_head + i) % ctx->task_capacity];
+        }
+        free(ctx->task_queue);
+        ctx->task_queue = q;
+        ctx->task_head = 0;
+        ctx->task_capacity = new_cap;
+    }
+    ctx->task_queue[(ctx->task_head + ctx->task_count) % ctx->task_capacity] = path;
+    ctx->task_count++;
+    pthread_cond_signal(&ctx->task_cond);
+    pthread_mutex_unlock(&ctx->task_mutex);
+    return true;
+}
+
+/**
+ * @brief  经数据通道发送根任务的 FINISH（调用方持有 send_mutex）
+ * @param  ctx   WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  path  const char*       Master 下发的根任务路径
+ * @return void
+ */
+static void send_finish_locked(WorkerThreadCtx *ctx, const char *path) {
+    IpcFinishPayload fin = { 0, 0 };
+    uint32_t plen = (uint32_t)strlen(path);
+    fin.status = 0; /* OK */
+    fin.path_len = plen;
+    size_t fin_total = sizeof(fin) + plen;
+    uint8_t *fin_buf = malloc(fin_total);
+    if (!fin_buf) return;
+    memcpy(fin_buf, &fin, sizeof(fin));
+    memcpy(fin_buf + sizeof(fin), path, plen);
+    int rc = worker_send_locked(ctx, IPC_MSG_FINISH, fin_buf, (uint32_t)fin_total);
+    log_debug("[W%d-Scanner] IPC_MSG_FINISH sent (rc=%d, path=%s)", ctx->worker_id, rc, path);
+    free(fin_buf);
+}
+
+/**
+ * @brief  释放根任务的一个引用，归零时发送 FINISH 并释放根任务
+ * @param  ctx   WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  root  WorkerTaskRoot*   根任务
+ * @return void
+ *
+ * @note   FINISH 与 BATCH 同走数据通道，Master 收到 FINISH 时该子树的批次均已在其之前入队。
+ *         先取 send_mutex 再判断引用：与 worker_steal_local 互斥，
+ *         保证被窃取目录的 STOLEN 一定先于根任务的 FINISH 到达 Master。
+ */
+static void task_root_release(WorkerThreadCtx *ctx, WorkerTaskRoot *root) {
+    pthread_mutex_lock(&ctx->send_mutex);
+    pthread_mutex_lock(&ctx->task_mutex);
+    bool done = (--root->refs == 0);
+    pthread_mutex_unlock(&ctx->task_mutex);
+    if (done) {
+        send_finish_locked(ctx, root->path);
+        free(root->path);
+        free(root);
+    }
+    pthread_mutex_unlock(&ctx->send_mutex);
+}
+
+/**
+ * @brief  响应 Master 的 STEAL：把本地下探队列头部最早入队的子目录经数据通道交回 Master
+ * @param  ctx        WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  max_count  uint32_t          最多交回的目录数
+ * @return void
+ *
+ * @note   队列头部是最早、最浅的目录，子树通常最大，交给空闲 Worker 收益最高。
+ *         总是回复 STOLEN（可能为 0 条），Master 据此清除等待标记。
+ *         被窃取目录释放其根任务引用；若因此归零，在 STOLEN 之后补发根任务 FINISH。
+ *         使用共享内存环时交回条数受单条记录上限约束。
+ */
+void worker_steal_local(WorkerThreadCtx *ctx, uint32_t max_count) {
+    pthread_mutex_lock(&ctx->send_mutex);
+    pthread_mutex_lock(&ctx->task_mutex);
+    uint32_t n = (uint32_t)ctx->local_count;
+    if (n > max_count) n = max_count;
+    WorkerLocalDir *taken = n ? malloc(n * sizeof(WorkerLocalDir)) : NULL;
+    if (!taken) n = 0;
+    size_t total = sizeof(IpcStolenHeader);
+    size_t limit = ctx->ring ? shm_ring_max_payload(ctx->ring) : UINT32_MAX;
+    for (uint32_t i = 0; i < n; i++) {
+        size_t need = sizeof(uint32_t) + sizeof(uint64_t) + strlen(ctx->local[ctx->local_head].path);
+        if (total + need > limit) {
+            n = i;
+            break;
+        }
+        taken[i] = ctx->local[ctx->local_head];
+        ctx->local_head = (ctx->local_head + 1) % ctx->local_capacity;
+        ctx->local_count--;
+        total += need;
+    }
+    pthread_mutex_unlock(&ctx->task_mutex);
+
+    uint8_t *buf = malloc(total);
+    if (buf) {
+        uint8_t *p = buf;
+        IpcStolenHeader sh = { n };
+        memcpy(p, &sh, sizeof(sh)); p += sizeof(sh);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t plen = (uint32_t)strlen(taken[i].path);
+            memcpy(p, &plen, sizeof(plen)); p += sizeof(plen);
+            memcpy(p, &taken[i].dev, sizeof(taken[i].dev)); p += sizeof(taken[i].dev);
+            memcpy(p, taken[i].path, plen);  p += plen;
+        }
+        worker_send_locked(ctx, IPC_MSG_STOLEN, buf, (uint32_t)total);
+        free(buf);
+        log_debug("[Worker-%d] STOLEN %u local dirs", ctx->worker_id, n);
+    } else if (n > 0) {
+        /* 无法回复：放回队列头部，不丢任务 */
+        pthread_mutex_lock(&ctx->task_mutex);
+        for (uint32_t i = n; i-- > 0; ) {
+            ctx->local_head = (ctx->local_head - 1 + ctx->local_capacity) % ctx->local_capacity;
+            ctx->local[ctx->local_head] = taken[i];
+            ctx->local_count++;
+        }
+        pthread_mutex_unlock(&ctx->task_mutex);
+        n = 0;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        WorkerTaskRoot *root = taken[i].root;
+        free(taken[i].path);
+        pthread_mutex_lock(&ctx->task_mutex);
+        bool done = (--root->refs == 0);
+        pthread_mutex_unlock(&ctx->task_mutex);
+        if (done) {
+            send_finish_locked(ctx, root->path);
+            free(root->path);
+            free(root);
+        }
+    }
+    free(taken);
+    pthread_mutex_unlock(&ctx->send_mutex);
+}
+
+/**
+ * @brief  响应 Master 的 PRUNE：记录被拒绝的子树根
+ * @param  ctx   WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  path  const char*       Master 判定为已访问的本地下探目录
+ * @return void
+ *
+ * @note   只记录不遍历队列：claim_subdirs 不再认领该子树下的目录，Scanner 取出队列中
+ *         位于该子树内的目录时直接释放（见 worker_scanner_thread）。PRUNE 到达前已开始的
+ *         扫描照常完成，其条目由 Master 丢弃。
+ */
+void worker_prune_local(WorkerThreadCtx *ctx, const char *path) {
+    pthread_mutex_lock(&ctx->task_mutex);
+    if (!ctx->pruned) ctx->pruned = fp_set_create(256, FP_SET_MUTEX);
+    if (ctx->pruned) fp_set_insert_path(ctx->pruned, path);
+    pthread_mutex_unlock(&ctx->task_mutex);
+    log_debug("[Worker-%d] PRUNE %s", ctx->worker_id, path);
+}
+
+/**
+ * @brief  释放本地队列中尚未执行的目录
+ * @param  ctx  WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @return void
+ *
+ * @note   仅在 Scanner 线程已退出后调用。未执行的任务由 Master 在
+ *         Worker 退出/死亡时按在途记录重新入队，此处只释放内存。
+ */
+void worker_task_queue_free(WorkerThreadCtx *ctx) {
+    for (int i = 0; i < ctx->task_count; i++) {
+        free(ctx->task_queue[(ctx->task_head + i) % ctx->task_capacity]);
+    }
+    free(ctx->task_queue);
+    ctx->task_queue = NULL;
+    ctx->task_head = ctx->task_count = ctx->task_capacity = 0;
+
+    for (int i = 0; i < ctx->local_count; i++) {
+        WorkerLocalDir *d = &ctx->local[(ctx->local_head + i) % ctx->local_capacity];
+        free(d->path);
+        if (--d->root->refs == 0) {
+            free(d->root->path);
+            free(d->root);
+        }
+    }
+    free(ctx->local);
+    ctx->local = NULL;
+    ctx->local_head = ctx->local_count = ctx->local_capacity = 0;
+
+    fp_set_destroy(ctx->pruned);
+    ctx->pruned = NULL;
 }
 
 /* ================================================================
  * Scanner thread
  * ================================================================ */
 
+/**
+ * @brief  Scanner 线程主循环
+ * @param  arg  void*  WorkerScanner*（所属线程组的一个槽位）
+ * @return void*  始终返回 NULL
+ *
+ * @note   优先从本地下探队列尾部取目录（深度优先，复用刚热起来的 dentry 缓存），
+ *         本地队列为空时再取 Master 下发的下一个根任务；位于已裁剪子树内的本地目录跳过。
+ *         多个 Scanner 线程共享同一组队列：根任务的 refs 计数覆盖所有线程认领的子目录，
+ *         最后一个完成的线程负责发送 FINISH。
+ */
 void *worker_scanner_thread(void *arg) {
-    WorkerThreadCtx *ctx = (WorkerThreadCtx *)arg;
+    WorkerScanner *self = (WorkerScanner *)arg;
+    WorkerThreadCtx *ctx = self->ctx;
 
     while (1) {
         pthread_mutex_lock(&ctx->task_mutex);
-        while (!ctx->task_ready && !ctx->stop_flag) {
+        while (ctx->local_count == 0 && ctx->task_count == 0 && !ctx->stop_flag) {
             pthread_cond_wait(&ctx->task_cond, &ctx->task_mutex);
         }
         if (ctx->stop_flag) {
@@ -318,54 +1174,156 @@ void *worker_scanner_thread(void *arg) {
             break;
         }
 
-        char path[4096];
-        strncpy(path, ctx->task_path, sizeof(path) - 1);
-        path[sizeof(path) - 1] = '\0';
-        ctx->task_ready = false;
+        WorkerLocalDir item;
+        bool pruned = false;
+        if (ctx->local_count > 0) {
+            ctx->local_count--;
+            item = ctx->local[(ctx->local_head + ctx->local_count) % ctx->local_capacity];
+            pruned = ctx->pruned && fp_set_contains_path_prefix(ctx->pruned, item.path, strlen(item.path),
+                                                                strlen(item.root->path));
+        } else {
+            char *path = ctx->task_queue[ctx->task_head];
+            ctx->task_queue[ctx->task_head] = NULL;
+            ctx->task_head = (ctx->task_head + 1) % ctx->task_capacity;
+            ctx->task_count--;
+            WorkerTaskRoot *root = calloc(1, sizeof(WorkerTaskRoot));
+            if (!root) {
+                pthread_mutex_unlock(&ctx->task_mutex);
+                log_error("[W%d-Scanner%d] task root alloc failed, dropping %s",
+                          ctx->worker_id, self->index, path);
+                free(path);
+                continue;
+            }
+            root->path = path;
+            root->refs = 1;
+            item.path = path;
+            item.root = root;
+            item.depth = 0;
+            item.dev = 0;
+        }
+        if (pruned) {
+            /* Master 已拒绝该子树：不扫描，只释放根任务引用 */
+            pthread_mutex_unlock(&ctx->task_mutex);
+            free(item.path);
+            task_root_release(ctx, item.root);
+            continue;
+        }
+        strncpy(self->current_task, item.path, sizeof(self->current_task) - 1);
+        self->current_task[sizeof(self->current_task) - 1] = '\0';
         pthread_mutex_unlock(&ctx->task_mutex);
 
         /* 记录扫描开始 */
         pthread_mutex_lock(&ctx->progress_mutex);
-        ctx->last_progress = time(NULL);
-        ctx->scanner_active = true;
+        self->last_progress = time(NULL);
+        self->active = true;
         pthread_mutex_unlock(&ctx->progress_mutex);
 
-        log_debug("[W%d-Scanner] start scanning: %s", ctx->worker_id, path);
+        log_debug("[W%d-Scanner%d] start scanning: %s (depth=%d)",
+                  ctx->worker_id, self->index, item.path, item.depth);
 
         /* 扫描 — 结果通过 fd_data 发送 */
-        scan_and_send(ctx->fd_data, path, ctx->worker_id);
+        scan_and_send(ctx, &item);
 
-        log_debug("[W%d-Scanner] scan_and_send returned: %s", ctx->worker_id, path);
+        log_debug("[W%d-Scanner%d] scan_and_send returned: %s", ctx->worker_id, self->index, item.path);
 
-        /* 发送 FINISH 信号，通知 Master 当前任务完成 */
-        IpcFinishPayload fin = { 0, 0 };
-        uint32_t plen = (uint32_t)strlen(path);
-        fin.status = 0; /* OK */
-        fin.path_len = plen;
-        size_t fin_total = sizeof(fin) + plen;
-        uint8_t *fin_buf = malloc(fin_total);
-        if (fin_buf) {
-            memcpy(fin_buf, &fin, sizeof(fin));
-            memcpy(fin_buf + sizeof(fin), path, plen);
-            int rc;
-            int retry = 0;
-            while ((rc = ipc_send(ctx->fd_ctrl, IPC_MSG_FINISH, fin_buf, (uint32_t)fin_total)) == -2) {
-                usleep(1000);
-                retry++;
-                if (retry % 1000 == 0) {
-                    log_warn("[W%d-Scanner] IPC_MSG_FINISH EAGAIN retry %d", ctx->worker_id, retry);
-                }
-            }
-            log_debug("[W%d-Scanner] IPC_MSG_FINISH sent (rc=%d, path=%s, retries=%d)", ctx->worker_id, rc, path, retry);
-            free(fin_buf);
-        }
+        /* 本地子目录完成：释放根任务引用，子树全部完成时才向 Master 发送 FINISH */
+        if (item.path != item.root->path) free(item.path);
+        task_root_release(ctx, item.root);
 
         /* 记录扫描完成 */
         pthread_mutex_lock(&ctx->progress_mutex);
-        ctx->last_progress = time(NULL);
-        ctx->scanner_active = false;
+        self->last_progress = time(NULL);
+        self->active = false;
         pthread_mutex_unlock(&ctx->progress_mutex);
     }
 
+    free(t_dirent_buf);
+    t_dirent_buf = NULL;
+    t_dirent_buf_size = 0;
+    uring_stat_destroy(t_uring);
+    t_uring = NULL;
+    dir_list_free(&t_dirlist);
     return NULL;
 }
+
+/**
+ * @brief  启动 Scanner 线程组
+ * @param  ctx    WorkerThreadCtx*  Worker 线程上下文，不能为空；task_mutex 等须已初始化
+ * @param  count  int               期望线程数，取值范围: >= 1
+ * @return int  实际启动的线程数；0 表示一个都未能启动
+ *
+ * @note   部分线程创建失败时以已启动的线程继续运行（仅降低并发度），不视为致命错误。
+ */
+int worker_scanners_start(WorkerThreadCtx *ctx, int count) {
+    if (count < 1) count = 1;
+    ctx->scanners = calloc((size_t)count, sizeof(WorkerScanner));
+    if (!ctx->scanners) return 0;
+
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        WorkerScanner *sc = &ctx->scanners[i];
+        sc->ctx = ctx;
+        sc->index = i;
+        sc->last_progress = time(NULL);
+        if (pthread_create(&sc->tid, NULL, worker_scanner_thread, sc) != 0) {
+            log_warn("[W%d] failed to create scanner thread %d: %s", ctx->worker_id, i, strerror(errno));
+            break;
+        }
+        sc->started = true;
+        started++;
+    }
+    ctx->scanner_count = started;
+    if (started == 0) {
+        free(ctx->scanners);
+        ctx->scanners = NULL;
+    }
+    return started;
+}
+
+/**
+ * @brief  停止并回收 Scanner 线程组
+ * @param  ctx  WorkerThreadCtx*  Worker 线程上下文，不能为空；未启动线程组时安全
+ * @return void
+ */
+void worker_scanners_join(WorkerThreadCtx *ctx) {
+    pthread_mutex_lock(&ctx->task_mutex);
+    ctx->stop_flag = true;
+    pthread_cond_broadcast(&ctx->task_cond);
+    pthread_mutex_unlock(&ctx->task_mutex);
+
+    for (int i = 0; i < ctx->scanner_count; i++) {
+        if (ctx->scanners[i].started) pthread_join(ctx->scanners[i].tid, NULL);
+    }
+    free(ctx->scanners);
+    ctx->scanners = NULL;
+    ctx->scanner_count = 0;
+}
+
+/**
+ * @brief  查询开始时间最早的活跃 Scanner（供 IPC 线程做卡死检测）
+ * @param  ctx        WorkerThreadCtx*  Worker 线程上下文，不能为空
+ * @param  since      time_t*           输出：该 Scanner 最近一次推进的时间，不能为空
+ * @param  path       char*             输出：该 Scanner 当前扫描的目录，允许为 NULL
+ * @param  path_size  size_t            path 缓冲区容量
+ * @return bool  返回 true 表示至少有一个 Scanner 正在扫描
+ */
+bool worker_scanners_oldest_active(WorkerThreadCtx *ctx, time_t *since, char *path, size_t path_size) {
+    int oldest = -1;
+    pthread_mutex_lock(&ctx->progress_mutex);
+    for (int i = 0; i < ctx->scanner_count; i++) {
+        const WorkerScanner *sc = &ctx->scanners[i];
+        if (!sc->active) continue;
+        if (oldest < 0 || sc->last_progress < ctx->scanners[oldest].last_progress) oldest = i;
+    }
+    if (oldest >= 0) *since = ctx->scanners[oldest].last_progress;
+    pthread_mutex_unlock(&ctx->progress_mutex);
+    if (oldest < 0) return false;
+
+    if (path && path_size > 0) {
+        pthread_mutex_lock(&ctx->task_mutex);
+        strncpy(path, ctx->scanners[oldest].current_task, path_size - 1);
+        path[path_size - 1] = '\0';
+        pthread_mutex_unlock(&ctx->task_mutex);
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file path_arena.c
+ * @brief 引用计数的路径缓冲实现
+ */
+#include "path_arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief  创建路径缓冲
+ * @param  size  size_t  数据区容量（字节）
+ * @return PathArena*  成功返回缓冲（引用为 1）；内存不足返回 NULL
+ */
+PathArena *path_arena_create(size_t size) {
+    PathArena *a = malloc(sizeof(PathArena) + size);
+    if (!a) return NULL;
+    atomic_init(&a->refs, 1);
+    a->size = size;
+    a->used = 0;
+    return a;
+}
+
+/**
+ * @brief  在缓冲尾部拼接一条完整路径
+ * @param  a           PathArena*   缓冲，不能为空；仅创建者在共享之前调用
+ * @param  prefix      const char*  目录前缀，允许为 NULL（当 prefix_len == 0 时）
+ * @param  prefix_len  size_t       目录前缀长度
+ * @param  name        const char*  条目名，不要求以 '\0' 结尾
+ * @param  name_len    size_t       条目名长度
+ * @return char*  缓冲内以 '\0' 结尾的 prefix + "/" + name；容量不足返回 NULL
+ */
+char *path_arena_join(PathArena *a, const char *prefix, size_t prefix_len, const char *name, size_t name_len) {
+    size_t need = prefix_len + 1 + name_len + 1;
+    if (need > a->size - a->used) return NULL;
+    char *p = a->data + a->used;
+    memcpy(p, prefix, prefix_len);
+    p[prefix_len] = '/';
+    memcpy(p + prefix_len + 1, name, name_len);
+    p[prefix_len + 1 + name_len] = '\0';
+    a->used += need;
+    return p;
+}
+
+/**
+ * @brief  增加一个引用
+ * @param  a  PathArena*  缓冲，不能为空
+ * @return void
+ */
+void path_arena_ref(PathArena *a) {
+    atomic_fetch_add_explicit(&a->refs, 1, memory_order_relaxed);
+}
+
+/**
+ * @brief  释放一个引用，归零时释放缓冲
+ * @param  a  PathArena*  缓冲，允许为 NULL（空操作）
+ * @return void
+ */
+void path_arena_unref(PathArena *a) {
+    if (!a) return;
+    if (atomic_fetch_sub_explicit(&a->refs, 1, memory_order_acq_rel) == 1) {
+        free(a);
+    }
+}